@@ -0,0 +1,116 @@
+// Device.hpp
+#pragma once
+#include <stddef.h>
+#include "EspActuator.hpp"
+
+//=====================================================
+// FixedString / joinTopic()
+// ----------------------------------------------------
+// Compile-time string concatenation used to build MQTT topics from the
+// thing name. The result is a plain char array that lives in flash/.rodata,
+// so no String or heap buffer is needed at runtime. Requires C++17
+// (arduino-esp32 3.x).
+//=====================================================
+template <size_t N>
+struct FixedString {
+    char data[N] = {};
+    constexpr const char* c_str() const { return data; }
+};
+
+template <size_t... N>
+constexpr FixedString<(N + ...) - sizeof...(N) + 1> joinTopic(const char (&... parts)[N]) {
+    FixedString<(N + ...) - sizeof...(N) + 1> out;
+    size_t pos = 0;
+    for (const char* part : {static_cast<const char*>(parts)...}) {
+        while (*part) out.data[pos++] = *part++;
+    }
+    return out;
+}
+
+// shadowTopic(): topic of a named shadow,
+//   $aws/things/<thing>/shadow/name/<shadow><suffix>
+// or of the classic shadow when `shadow` is "",
+//   $aws/things/<thing>/shadow<suffix>
+// Still resolved at compile time.
+template <size_t T, size_t S, size_t X>
+constexpr auto shadowTopic(const char (&thing)[T], const char (&shadow)[S], const char (&suffix)[X]) {
+    auto named = joinTopic("$aws/things/", thing, "/shadow/name/", shadow, suffix);
+    if (shadow[0] != '\0') return named;
+
+    auto classic = joinTopic("$aws/things/", thing, "/shadow", suffix);
+    decltype(named) out;
+    for (size_t i = 0; i < sizeof(classic.data); i++) out.data[i] = classic.data[i];
+    return out;
+}
+
+//=====================================================
+// Device<Config>
+// ----------------------------------------------------
+// Statically configured EspActuator. All settings come
+// from `Config` as constexpr members, and topics are
+// derived from Config::thingName and Config::shadowName
+// at compile time. An empty shadowName uses the classic
+// shadow; "interiorDoor" subscribes to the deltas of
+// that door's named shadow only.
+// Declare it as a global (static storage) in the sketch:
+//
+//   struct ActuatorConfig {
+//       static constexpr byte          actuatorPin         = 12;
+//       static constexpr char          ssid[]              = "...";
+//       static constexpr char          password[]          = "...";
+//       static constexpr char          server[]            = "...amazonaws.com";
+//       static constexpr int           port                = 8883;
+//       static constexpr char          thingName[]         = "iot_thing";
+//       static constexpr char          shadowName[]        = ""; // or "interiorDoor"
+//       static constexpr char          clientId[]          = "ESP_CLIENT_Actuator";
+//       static constexpr uint16_t      mqttBufferSize      = 1024;
+//       static constexpr unsigned long telemetryIntervalMs = 60000;
+//       static constexpr bool          recordEvents        = false; // Inputs on Serial for tools/replay
+//       static constexpr bool          eventLoop           = true;  // false = busy loop()
+//   };
+//   Device<ActuatorConfig> espActuator;
+//
+// Together with the by-value members of EspActuator,
+// the whole object graph lives in .bss, leaving the
+// heap unfragmented for TLS.
+//=====================================================
+template <typename Config>
+class Device : public EspActuator {
+public:
+    // $aws/things/<thing>/shadow[/name/<shadowName>]/update
+    static constexpr auto updateTopic =
+        shadowTopic(Config::thingName, Config::shadowName, "/update");
+
+    // $aws/things/<thing>/shadow[/name/<shadowName>]/update/delta
+    static constexpr auto deltaTopic =
+        shadowTopic(Config::thingName, Config::shadowName, "/update/delta");
+
+    // <thing>/telemetry/<clientId>
+    static constexpr auto telemetryTopic =
+        joinTopic(Config::thingName, "/telemetry/", Config::clientId);
+
+    // <thing>/ota/<clientId>
+    static constexpr auto otaTopic =
+        joinTopic(Config::thingName, "/ota/", Config::clientId);
+
+    // <thing>/trace/<clientId>
+    static constexpr auto traceTopic =
+        joinTopic(Config::thingName, "/trace/", Config::clientId);
+
+    Device()
+        : EspActuator(Config::actuatorPin,
+                      Config::ssid,
+                      Config::password,
+                      Config::server,
+                      Config::port,
+                      updateTopic.c_str(),
+                      deltaTopic.c_str(),
+                      Config::clientId,
+                      telemetryTopic.c_str(),
+                      Config::telemetryIntervalMs,
+                      Config::mqttBufferSize,
+                      otaTopic.c_str(),
+                      traceTopic.c_str(),
+                      Config::recordEvents,
+                      Config::eventLoop) {}
+};
\ No newline at end of file
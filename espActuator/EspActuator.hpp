@@ -2,22 +2,53 @@
 #pragma once
 #include "Mqtt.hpp"
 #include "ServoController.hpp"
+#include "Telemetry.hpp"
+#include "ShadowStreamParser.hpp"
+#include "OtaUpdater.hpp"
+#include "Tracer.hpp"
+#include "EventRecorder.hpp"
+#include "EventDispatcher.hpp"
 #include <ArduinoJson.h>
 
 class EspActuator {
 private:
-    // Controls the physical servo that opens/closes the interior door
-    ServoController*  servoController;
+    // While recording, how often loop() wakes to look for the SNTP clock
+    static const uint32_t RECORD_CLOCK_MS = 1000;
 
-    // MQTT client wrapper used to communicate with AWS IoT Core
-    MqttClient*       mqtt;
+    // Components are stored by value so that constructing an EspActuator
+    // (or a Device<Config>, see Device.hpp) performs no heap allocation.
+    // Declaration order matters: each member is built from the previous ones.
+
+    // Controls the physical servo that opens/closes the interior door
+    ServoController   servoController;
 
     // Wi-Fi / TLS configuration and handler
-    NetworkConfig*    networkConfig;
-    NetworkHandler*   net;
+    NetworkConfig     networkConfig;
+    NetworkHandler    net;
 
     // MQTT connection configuration (endpoint, clientId, callback, port)
-    MqttConfig*       mqttConfig;
+    MqttConfig        mqttConfig;
+
+    // MQTT client wrapper used to communicate with AWS IoT Core
+    MqttClient        mqtt;
+
+    // Wakes loop() on socket data and deadlines instead of busy polling
+    EventDispatcher   events;
+
+    // Periodic device health reports (CBOR on a separate topic)
+    TelemetryPublisher telemetry;
+
+    // Extracts interiorDoor from payloads larger than the MQTT buffer
+    ShadowStreamParser shadowParser;
+
+    // Delta firmware updates over MQTT (dedicated job topic)
+    OtaUpdater        ota;
+
+    // End-to-end command traces (clientToken echo + trace topic)
+    Tracer            tracer;
+
+    // Records incoming messages on Serial for tools/replay (off by default)
+    EventRecorder     recorder;
 
     // Static instance pointer used by the static MQTT callback
     static EspActuator* instance;
@@ -28,47 +59,90 @@ private:
 
     /**
      * Static MQTT callback required by PubSubClient.
-     * Delegates the handling of the message to the singleton instance.
+     * Delegates the handling of the message to the singleton instance
+     * (OTA chunks to the updater, shadow messages to handleMessage),
+     * then resets the streaming parser for the next message.
      */
     static void mqttCallback(char* topic, uint8_t* payload, unsigned int length) {
-        if (instance) instance->handleMessage(topic, payload, length);
+        if (!instance) return;
+        instance->recorder.message(topic, payload, length, instance->shadowParser.received);
+        if (instance->ota.matches(topic)) {
+            instance->ota.handleChunk(payload, length, instance->mqtt.isOversized(length));
+        } else {
+            instance->handleMessage(topic, payload, length);
+        }
+        instance->mqtt.endMessage();
     }
 
     /**
      * Process messages coming from AWS IoT (shadow updates / deltas).
      *  - Logs the raw JSON payload.
      *  - Parses the JSON and extracts the requested door state.
+     *    Messages larger than the MQTT buffer only arrive truncated here;
+     *    their door state comes from shadowParser, which saw every byte.
      *  - Moves the servo accordingly.
-     *  - Publishes a "reported" state back to the device shadow.
+     *  - Publishes a "reported" state back to the device shadow, echoing
+     *    the clientToken of the command, and its trace record.
      */
     void handleMessage(char* topic, uint8_t* payload, unsigned int length) {
+        // Receive time: wall clock for cross-host hops, micros() for local ones
+        uint64_t      rxMs = Tracer::nowMs();
+        unsigned long rxUs = micros();
+
+        // Event-to-handler latency: from the wakeup that found the socket
+        // readable (TLS record read and decrypted since)
+        events.recordLatency(events.wokeAtUs());
+
         Serial.print("Mensaje recibido [");
         Serial.print(topic);
         Serial.print("]: ");
 
-        // Dump raw JSON payload for debugging
-        String msg;
-        for (unsigned int i = 0; i < length; i++) msg += (char)payload[i];
-        Serial.println(msg);
-
-        StaticJsonDocument<512> doc;
-        // IMPORTANT: use the provided length when deserializing
-        DeserializationError error = deserializeJson(doc, payload, length);
-        if (error) {
-            Serial.print("Error parseando JSON: ");
-            Serial.println(error.c_str());
-            return;
-        }
-
         // AWS IoT Shadow may send:
         //  - delta:   { "state": { "interiorDoor": "OPEN" }, ... }
         //  - desired: { "state": { "desired": { "interiorDoor": "OPEN" } } }
         const char* doorState = nullptr;
+        const char* token     = nullptr;   // Correlation id set by the Lambda
+
+        // Filtered so metadata and unrelated keys never occupy the document
+        StaticJsonDocument<96> filter;
+        filter["state"]["interiorDoor"]            = true;
+        filter["state"]["desired"]["interiorDoor"] = true;
+        filter["clientToken"]                      = true;
+        StaticJsonDocument<192> doc;
+
+        if (mqtt.isOversized(length)) {
+            Serial.print("(");
+            Serial.print(shadowParser.received);
+            Serial.println(" bytes, procesado por streaming)");
+
+            doorState = shadowParser.doorState();
+            if (!doorState) {
+                mqtt.countDropped();
+                Serial.println("No viene interiorDoor en el JSON (mensaje grande)");
+                return;
+            }
+        } else {
+            // Dump raw JSON payload for debugging
+            Serial.write(payload, length);
+            Serial.println();
 
-        if (doc["state"]["interiorDoor"]) {
-            doorState = doc["state"]["interiorDoor"];
-        } else if (doc["state"]["desired"]["interiorDoor"]) {
-            doorState = doc["state"]["desired"]["interiorDoor"];
+            // IMPORTANT: use the provided length when deserializing
+            unsigned long parseStart = micros();
+            DeserializationError error = deserializeJson(doc, payload, length,
+                                                         DeserializationOption::Filter(filter));
+            Serial.printf("(%u bytes, parse %lu us)\n", length, micros() - parseStart);
+            if (error) {
+                Serial.print("Error parseando JSON: ");
+                Serial.println(error.c_str());
+                return;
+            }
+
+            if (doc["state"]["interiorDoor"]) {
+                doorState = doc["state"]["interiorDoor"];
+            } else if (doc["state"]["desired"]["interiorDoor"]) {
+                doorState = doc["state"]["desired"]["interiorDoor"];
+            }
+            token = doc["clientToken"];
         }
 
         if (!doorState) {
@@ -81,18 +155,29 @@ private:
 
         // Drive the servo according to the requested state
         if (strcmp(doorState, "OPEN") == 0) {
-            servoController->open();
+            servoController.open();
         } else if (strcmp(doorState, "CLOSE") == 0) {
-            servoController->close();
+            servoController.close();
         }
+        unsigned long actUs = micros() - rxUs;
 
         // Build and publish the REPORTED state back to the shadow
         StaticJsonDocument<256> responseDoc;
         responseDoc["state"]["reported"]["interiorDoor"] = doorState;
+        if (token) responseDoc["clientToken"] = token;
+
+        char out[192];
+        serializeJson(responseDoc, out, sizeof(out));
 
-        String out;
-        serializeJson(responseDoc, out);
-        mqtt->publish(publishTopic, out.c_str());
+        // doc points into the MQTT packet buffer, which publishState()
+        // reuses: the trace record needs its own copy of the token
+        char traced[Tracer::MAX_TOKEN + 1] = "";
+        if (token) snprintf(traced, sizeof(traced), "%s", token);
+        // Always acked, even with the value we reported last: the delta
+        // means the shadow does not hold it (changed meanwhile, or our
+        // earlier report lost). Still paced and coalesced by the governor.
+        mqtt.publishState(publishTopic, "interiorDoor", doorState, out, true);
+        tracer.publish(token ? traced : nullptr, rxMs, actUs, micros() - rxUs);
 
         Serial.print("Shadow report (interiorDoor): ");
         Serial.println(out);
@@ -105,6 +190,11 @@ public:
      *  - MQTT client configuration and callback
      *  - Servo controller
      *  - Topics used for shadow update / delta
+     *  - Health telemetry publisher (disabled when telemetryTopic is null)
+     *  - OTA updater (disabled when otaTopic is null)
+     *  - Command tracer (disabled when traceTopic is null)
+     *  - Input recorder for host replay (recordEvents)
+     *  - Event-driven loop, or the busy loop when eventLoop is false
      */
     EspActuator(byte actuatorPin,
                 const char* ssid,
@@ -113,18 +203,32 @@ public:
                 int port,
                 const char* publishTopic,
                 const char* subscribeTopic,
-                const char* clientId) {
+                const char* clientId,
+                const char* telemetryTopic = nullptr,
+                unsigned long telemetryIntervalMs = 60000,
+                uint16_t mqttBufferSize = 0,
+                const char* otaTopic = nullptr,
+                const char* traceTopic = nullptr,
+                bool recordEvents = false,
+                bool eventLoop = true)
+        : servoController(actuatorPin),
+          networkConfig(ssid, password),
+          net(&networkConfig),
+          mqttConfig(server, clientId, &mqttCallback, port, mqttBufferSize),
+          mqtt(&mqttConfig, &net),
+          events(eventLoop),
+          telemetry(&mqtt, telemetryTopic, telemetryIntervalMs, &events),
+          shadowParser("interiorDoor"),
+          ota(&mqtt, otaTopic),
+          tracer(&mqtt, traceTopic),
+          recorder(recordEvents)
+    {
+        mqtt.setPayloadStream(&shadowParser);
 
         // Set singleton instance so the static callback can delegate here
         instance             = this;
         this->publishTopic   = publishTopic;
         this->subscribeTopic = subscribeTopic;
-
-        networkConfig   = new NetworkConfig(ssid, password);
-        net             = new NetworkHandler(networkConfig);
-        servoController = new ServoController(actuatorPin);
-        mqttConfig      = new MqttConfig(server, clientId, &mqttCallback, port);
-        mqtt            = new MqttClient(mqttConfig, net);
     }
 
     /**
@@ -132,22 +236,46 @@ public:
      */
     void setup() {
         Serial.begin(115200);
-        servoController->begin();   // move servo to initial position
-        mqtt->initialize();
-        mqtt->subscribe(subscribeTopic);
+        recorder.begin("actuator");
+        servoController.begin();   // move servo to initial position
+        mqtt.initialize();
+        tracer.begin();            // SNTP, for trace timestamps
+        mqtt.subscribe(subscribeTopic);
+        ota.subscribe();
+        events.begin(net.getClient());
+
+        // Heap high-water mark once TLS is up, and firmware size
+        Serial.printf("Heap: free=%u min=%u | Sketch: %u bytes\n",
+                      ESP.getFreeHeap(), ESP.getMinFreeHeap(), ESP.getSketchSize());
     }
 
     /**
      * Main loop:
+     *  - Waits for socket data or the next deadline (returns at once
+     *    when eventLoop is off).
      *  - Ensures MQTT connection is alive (reconnects if needed).
      *  - Processes incoming MQTT messages.
+     *  - Publishes health telemetry when due, continues an OTA update.
+     *  - Sets the deadlines of the next wait.
      */
     void loop() {
-        if (!mqtt->connected()) {
-            mqtt->reconnect();
-            mqtt->subscribe(subscribeTopic);
+        uint32_t ready = events.wait();
+        unsigned long loopStart = micros();
+
+        // Reconnects (and restores subscriptions) if needed
+        if (ready & (EventDispatcher::SOCKET | EventDispatcher::DEADLINE)) mqtt.loop();
+
+        if (ready & EventDispatcher::DEADLINE) {
+            recorder.loop();
+            telemetry.loop();
+            ota.loop();
         }
-        mqtt->loop();
+        telemetry.recordLoop(micros() - loopStart);
+
+        events.wakeBy(mqtt.nextDueMs());
+        events.wakeBy(telemetry.nextDueMs());
+        events.wakeBy(ota.nextDueMs());
+        if (recorder.isEnabled()) events.wakeBy(RECORD_CLOCK_MS);
     }
 };
 
@@ -1,23 +1,61 @@
 #pragma once
 #include <PubSubClient.h>
 #include "Network.hpp"
+#include "PublishGovernor.hpp"
 
 //-----------------------------------------------
 // MQTT Configuration
 //-----------------------------------------------
 // Holds server settings, client ID, callback,
-// and port used by the MQTT client.
+// port and packet buffer size used by the MQTT client.
 class MqttConfig {
     public:
         const char* server;   // MQTT broker endpoint (AWS IoT Core)
         const char* clientId; // Unique MQTT client ID
         void (*callback)(char*, uint8_t*, unsigned int); // Message callback handler
         int port;             // MQTT port (AWS uses 8883 TLS)
+        uint16_t bufferSize;  // MQTT packet buffer, 0 = library default
 
         MqttConfig(const char* server, const char* clientId,
                    void (*callback)(char*, uint8_t*, unsigned int),
-                   int port)
-            : server(server), clientId(clientId), callback(callback), port(port) {}
+                   int port, uint16_t bufferSize = 0)
+            : server(server), clientId(clientId), callback(callback), port(port),
+              bufferSize(bufferSize) {}
+};
+
+//-----------------------------------------------
+// Payload Stream
+//-----------------------------------------------
+// PubSubClient copies every PUBLISH payload, byte
+// by byte, into an attached Stream *before* the
+// callback runs, and with a stream attached it no
+// longer drops packets larger than its buffer: the
+// callback gets the truncated head instead.
+// Subclasses consume the bytes incrementally, so a
+// large message can be parsed without holding all
+// of it in RAM.
+//-----------------------------------------------
+class PayloadStream : public Stream {
+    public:
+        size_t received = 0; // Payload bytes seen for the current message
+
+        size_t write(uint8_t b) override {
+            received++;
+            consume(b);
+            return 1;
+        }
+
+        // Called for every payload byte
+        virtual void consume(uint8_t b) = 0;
+
+        // Called once the message has been handled
+        virtual void reset() { received = 0; }
+
+        // Write-only stream
+        int available() override { return 0; }
+        int read() override { return -1; }
+        int peek() override { return -1; }
+        void flush() override {}
 };
 
 //-----------------------------------------------
@@ -29,37 +67,80 @@ class MqttConfig {
 // - Subscriptions
 // - Publishing messages
 // - Processing MQTT loop
+// - Accounting for messages larger than the
+//   configured packet buffer
+// - Deduplicating and rate limiting shadow
+//   "reported" writes (PublishGovernor)
+// The PubSubClient is stored inline (no heap use
+// besides the library's own packet buffer).
 //-----------------------------------------------
 class MqttClient {
     public:
         MqttConfig* config;            // Pointer to MQTT configuration
-        PubSubClient* client;          // PubSubClient instance (MQTT engine)
+        PubSubClient pubSub;           // PubSubClient instance (MQTT engine)
+        PubSubClient* client;          // Points at pubSub
         NetworkHandler* networkHandler;// Handles Wi-Fi/TLS connection
+        uint32_t connectCount = 0;     // Successful MQTT connections since boot
+
+        static const uint8_t MAX_SUBSCRIPTIONS = 4;
+        const char* subscriptions[MAX_SUBSCRIPTIONS] = {}; // Restored on reconnect
+        uint8_t subscriptionCount = 0;
+        PayloadStream* payloadStream = nullptr; // Incremental parser for large payloads
+        uint32_t oversizedCount = 0;   // Messages larger than the packet buffer
+        uint32_t droppedCount = 0;     // Oversized messages that could not be handled
+        PublishGovernor governor;      // Dedup + token bucket for publishState()
 
         // Constructor with config and network provider
         MqttClient(MqttConfig* config, NetworkHandler* networkHandler)
-            : config(config), networkHandler(networkHandler) {
-            // Bind PubSubClient to TLS-enabled network client
-            client = new PubSubClient(*networkHandler->getClient());
-            client->setServer(config->server, config->port);
-            client->setCallback(config->callback);
+            : client(&pubSub) {
+            setAll(config, networkHandler);
         }
 
         // Default constructor (optional)
-        MqttClient() {}
+        MqttClient() : client(&pubSub) {}
 
         // Allows setting objects after construction
         void setAll(MqttConfig* config, NetworkHandler* networkHandler) {
             this->config = config;
             this->networkHandler = networkHandler;
-            client = new PubSubClient(*networkHandler->getClient());
+            // Bind PubSubClient to TLS-enabled network client
+            client->setClient(*networkHandler->getClient());
             client->setServer(config->server, config->port);
             client->setCallback(config->callback);
+            if (config->bufferSize > 0) client->setBufferSize(config->bufferSize);
         }
 
-        // Destructor releases dynamically allocated MQTT client
-        ~MqttClient() {
-            delete client;
+        //-----------------------------------------------
+        // Streams every incoming payload into `stream`
+        //-----------------------------------------------
+        void setPayloadStream(PayloadStream* stream) {
+            payloadStream = stream;
+            client->setStream(*stream);
+        }
+
+        //-----------------------------------------------
+        // Call at the start of the message callback:
+        // true when `length` is only the head of a
+        // larger payload. Without a payload stream
+        // PubSubClient drops such messages silently
+        // and they cannot be counted here.
+        //-----------------------------------------------
+        bool isOversized(unsigned int length) {
+            if (payloadStream && payloadStream->received > length) {
+                oversizedCount++;
+                return true;
+            }
+            return false;
+        }
+
+        // Records an oversized message that was lost
+        void countDropped() {
+            droppedCount++;
+        }
+
+        // Call at the end of the message callback
+        void endMessage() {
+            if (payloadStream) payloadStream->reset();
         }
 
         //-----------------------------------------------
@@ -79,6 +160,11 @@ class MqttClient {
                 Serial.print("Attempting MQTT connection...");
                 if (client->connect(config->clientId)) {
                     Serial.println("connected");
+                    connectCount++;
+                    governor.forgetSent();
+                    for (uint8_t i = 0; i < subscriptionCount; i++) {
+                        client->subscribe(subscriptions[i]);
+                    }
                 } else {
                     Serial.print("failed, rc=");
                     Serial.print(client->state());
@@ -108,9 +194,73 @@ class MqttClient {
         }
 
         //-----------------------------------------------
-        // Subscribe to an MQTT topic
+        // Publish raw bytes (e.g. CBOR telemetry)
+        //-----------------------------------------------
+        void publish(const char* topic, const uint8_t* payload, unsigned int length) {
+            if (client->connected()) {
+                client->publish(topic, payload, length);
+            } else {
+                Serial.println("MQTT client not connected. Reconnecting...");
+                reconnect();
+            }
+        }
+
+        //-----------------------------------------------
+        // Shadow "reported" write of `value` under
+        // `key` through the publish governor: a value
+        // equal to the last one sent is suppressed,
+        // others are paced by its token bucket and
+        // wait (coalesced) while no token or
+        // connection is available. `force` skips the
+        // no-op check (acks to a delta). Returns
+        // false if the write was suppressed.
+        //-----------------------------------------------
+        bool publishState(const char* topic, const char* key, const char* value, const char* payload,
+                          bool force = false) {
+            switch (governor.submit(topic, key, value, payload, force)) {
+                case PublishGovernor::SUPPRESSED:
+                    return false;
+                case PublishGovernor::BYPASS:
+                    publish(topic, payload);
+                    return true;
+                default:
+                    break;
+            }
+            if (!client->connected()) {
+                Serial.println("MQTT client not connected. Reconnecting...");
+                reconnect();
+            }
+            flushStates();
+            return true;
+        }
+
+        //-----------------------------------------------
+        // Publishes the governed writes that have a
+        // token (also run by loop())
+        //-----------------------------------------------
+        void flushStates() {
+            if (!client->connected()) return;
+            PublishGovernor::Slot* slot;
+            while ((slot = governor.next(millis())) != nullptr) {
+                bool ok = client->publish(slot->topic, slot->payload);
+                governor.done(slot, ok);
+                if (!ok) break;
+            }
+        }
+
+        //-----------------------------------------------
+        // Reconnections after the first connect
+        //-----------------------------------------------
+        uint32_t getReconnectCount() {
+            return connectCount > 0 ? connectCount - 1 : 0;
+        }
+
+        //-----------------------------------------------
+        // Subscribe to an MQTT topic (and again after
+        // every reconnect)
         //-----------------------------------------------
         void subscribe(const char* topic) {
+            remember(topic);
             if (client->connected()) {
                 client->subscribe(topic);
             } else {
@@ -119,12 +269,38 @@ class MqttClient {
             }
         }
 
+        //-----------------------------------------------
+        // Adds a topic to the resubscribe list
+        // (the pointer must stay valid)
+        //-----------------------------------------------
+        void remember(const char* topic) {
+            for (uint8_t i = 0; i < subscriptionCount; i++) {
+                if (strcmp(subscriptions[i], topic) == 0) return;
+            }
+            if (subscriptionCount < MAX_SUBSCRIPTIONS) {
+                subscriptions[subscriptionCount++] = topic;
+            }
+        }
+
+        //-----------------------------------------------
+        // Longest an event-driven caller may wait
+        // before loop() must run without socket
+        // activity: now to reconnect, the next token
+        // for waiting writes, else half the keep-alive
+        //-----------------------------------------------
+        uint32_t nextDueMs() {
+            if (!client->connected()) return 0;
+            if (governor.hasPending()) return governor.msUntilToken(millis());
+            return MQTT_KEEPALIVE * 1000UL / 2;
+        }
+
         //-----------------------------------------------
         // Processes incoming MQTT messages and maintains connection
         //-----------------------------------------------
         void loop() {
             if (client->connected()) {
                 client->loop();
+                flushStates();
             } else {
                 Serial.println("MQTT client not connected. Reconnecting...");
                 reconnect();
@@ -9,19 +9,19 @@
 // This class handles Wi-Fi credentials and prepares a
 // TLS-secured WiFiClientSecure instance loaded with the
 // certificates required to authenticate with AWS IoT.
+// The secure client is stored inline (no heap use).
 //=====================================================
 class NetworkConfig {
     public:
         const char* ssid;       // Wi-Fi network SSID
         const char* password;   // Wi-Fi network password
-        WiFiClientSecure* client; // TLS-secured network client
+        WiFiClientSecure secureClient; // TLS-secured network client (inline)
+        WiFiClientSecure* client; // Points at secureClient
 
         // Constructor using certificates defined in certificates.h
         NetworkConfig(const char* ssid, const char* password)
-            : ssid(ssid), password(password) 
+            : ssid(ssid), password(password), client(&secureClient)
         {
-            client = new WiFiClientSecure();
-
             // Load the AWS IoT Root CA certificate
             client->setCACert(AWS_ROOT_CA_CERTIFICATE);
 
@@ -35,18 +35,12 @@ class NetworkConfig {
         // Constructor allowing custom certificate inputs
         NetworkConfig(const char* ssid, const char* password,
                       const char* root_ca, const char* private_key, const char* client_cert)
-            : ssid(ssid), password(password)
+            : ssid(ssid), password(password), client(&secureClient)
         {
-            client = new WiFiClientSecure();
             client->setCACert(root_ca);
             client->setPrivateKey(private_key);
             client->setCertificate(client_cert);
         }
-
-        // Destructor cleans the secure client instance
-        ~NetworkConfig() {
-            delete client;
-        }
 };
 
 //=====================================================
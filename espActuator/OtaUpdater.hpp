@@ -0,0 +1,264 @@
+// OtaUpdater.hpp
+#pragma once
+#include <Arduino.h>
+#include <esp_ota_ops.h>
+#include <esp_partition.h>
+#include <mbedtls/sha256.h>
+#include "Mqtt.hpp"
+#include "DeltaPatcher.hpp"
+
+//==========================================================================
+// OtaUpdater
+// -------------------------------------------------------------------------
+// Delta firmware updates streamed over MQTT on a dedicated job topic.
+//
+// Each message on the topic is one chunk:
+//     u32 sequence (little-endian) | patch bytes
+// Sequence 0 starts a new update and carries exactly the 76-byte patch
+// header; any gap aborts it. Chunks must fit in the MQTT packet buffer (see
+// MqttConfig::bufferSize).
+//
+// The patch (see DeltaPatcher.hpp) is applied against the running partition
+// and written straight into the inactive OTA partition, so RAM use is
+// bounded by DeltaPatcher's buffers. Before writing, the source hash in the
+// patch header is checked against the running image. At the end the SHA-256
+// of the written image must match the header; only then is the boot
+// partition switched and the device restarted.
+//
+// The MQTT callback only feeds the patcher. The slow flash work runs from
+// loop():
+//  - hashing the running image, HASH_SLICE bytes per call, so keep-alive
+//    and the other handlers keep running;
+//  - opening the target partition, with sequential writes: sectors are
+//    erased as they are written rather than all at once;
+//  - validating the new image.
+// The device reports "ready" once it accepts the next chunks; a chunk
+// that arrives before that aborts the update ("not ready").
+//
+// Progress and errors are published as small JSON documents on
+// "<topic>/status". Patches and chunking: tools/ota-delta.js.
+//==========================================================================
+class OtaUpdater : public PatchIO {
+private:
+    static const uint8_t  PROGRESS_EVERY = 64;    // Chunks between progress reports
+    static const uint32_t HASH_SLICE     = 16384; // Running image bytes hashed per loop()
+
+    enum Phase : uint8_t {
+        IDLE,
+        RECEIVING,    // Applying chunks
+        PREPARING,    // Header accepted, hashing the running image (loop())
+        FINISHING     // Patch complete, validating the image (loop())
+    };
+
+    MqttClient*  mqtt;
+    const char*  topic;           // Job topic (nullptr = OTA disabled)
+    char         statusTopic[96];
+
+    DeltaPatcher patcher;
+    Phase        phase;
+    bool         otaOpen;         // esp_ota_begin() succeeded
+    uint32_t     nextSeq;         // Expected chunk sequence
+    uint32_t     hashed;          // Running image bytes hashed (PREPARING)
+
+    const esp_partition_t* running;
+    const esp_partition_t* target;
+    esp_ota_handle_t       handle;
+    mbedtls_sha256_context sha;   // Running image, then written image (phase != IDLE)
+
+    //------------------------------------------------------------------------
+    // publishStatus(): {"state":"<state>","seq":N,"bytes":N[,"error":"..."]}
+    //------------------------------------------------------------------------
+    void publishStatus(const char* state, const char* error = nullptr) {
+        char out[128];
+        if (error) {
+            snprintf(out, sizeof(out), "{\"state\":\"%s\",\"seq\":%u,\"bytes\":%u,\"error\":\"%s\"}",
+                     state, nextSeq, patcher.bytesWritten(), error);
+        } else {
+            snprintf(out, sizeof(out), "{\"state\":\"%s\",\"seq\":%u,\"bytes\":%u}",
+                     state, nextSeq, patcher.bytesWritten());
+        }
+        mqtt->publish(statusTopic, out);
+        Serial.print("OTA ");
+        Serial.println(out);
+    }
+
+    // Releases the OTA handle and hash context, if any
+    void close() {
+        if (otaOpen) esp_ota_abort(handle);
+        if (phase != IDLE) mbedtls_sha256_free(&sha);
+        otaOpen = false;
+        phase   = IDLE;
+    }
+
+    void restartHash() {
+        mbedtls_sha256_free(&sha);
+        mbedtls_sha256_init(&sha);
+        mbedtls_sha256_starts(&sha, 0);
+    }
+
+    void abort(const char* error) {
+        close();
+        publishStatus("failed", error);
+    }
+
+    //------------------------------------------------------------------------
+    // prepare(): hashes the next HASH_SLICE bytes of the running image. Once
+    // all of them match the patch header, opens the target partition and
+    // reports "ready".
+    //------------------------------------------------------------------------
+    void prepare() {
+        const PatchHeader& header = patcher.getHeader();
+        uint8_t  buf[256];
+        uint32_t end = header.sourceSize - hashed > HASH_SLICE ? hashed + HASH_SLICE : header.sourceSize;
+
+        while (hashed < end) {
+            uint32_t n = end - hashed < sizeof(buf) ? end - hashed : sizeof(buf);
+            if (esp_partition_read(running, hashed, buf, n) != ESP_OK) { abort("read"); return; }
+            mbedtls_sha256_update(&sha, buf, n);
+            hashed += n;
+        }
+        if (hashed < header.sourceSize) return;
+
+        uint8_t digest[32];
+        mbedtls_sha256_finish(&sha, digest);
+        if (memcmp(digest, header.sourceHash, 32) != 0) {
+            Serial.println("OTA: patch was made for a different image");
+            abort("source");
+            return;
+        }
+
+        if (esp_ota_begin(target, OTA_WITH_SEQUENTIAL_WRITES, &handle) != ESP_OK) {
+            abort("begin");
+            return;
+        }
+        restartHash();
+        otaOpen = true;
+        phase   = RECEIVING;
+        publishStatus("ready");
+    }
+
+    void finish() {
+        uint8_t digest[32];
+        mbedtls_sha256_finish(&sha, digest);
+
+        if (memcmp(digest, patcher.getHeader().targetHash, 32) != 0) {
+            abort("hash");
+            return;
+        }
+
+        mbedtls_sha256_free(&sha);
+        otaOpen = false;
+        phase   = IDLE;
+
+        // Also validates the image header / checksum
+        if (esp_ota_end(handle) != ESP_OK) {
+            publishStatus("failed", "image");
+            return;
+        }
+        if (esp_ota_set_boot_partition(target) != ESP_OK) {
+            publishStatus("failed", "boot");
+            return;
+        }
+
+        publishStatus("done");
+        mqtt->loop();
+        delay(200);
+        ESP.restart();
+    }
+
+public:
+    OtaUpdater(MqttClient* mqtt, const char* topic)
+        : mqtt(mqtt), topic(topic), patcher(this), phase(IDLE), otaOpen(false), nextSeq(0), hashed(0),
+          running(nullptr), target(nullptr), handle(0) {
+        snprintf(statusTopic, sizeof(statusTopic), "%s/status", topic ? topic : "");
+    }
+
+    bool enabled() const { return topic != nullptr; }
+
+    bool matches(const char* t) const {
+        return enabled() && strcmp(t, topic) == 0;
+    }
+
+    void subscribe() {
+        if (enabled()) mqtt->subscribe(topic);
+    }
+
+    //------------------------------------------------------------------------
+    // handleChunk(): feeds one MQTT message to the patcher.
+    // `truncated` is true when the message exceeded the MQTT buffer.
+    //------------------------------------------------------------------------
+    void handleChunk(const uint8_t* payload, unsigned int length, bool truncated) {
+        if (length < 4) return;
+        uint32_t seq = (uint32_t)payload[0] | ((uint32_t)payload[1] << 8)
+                     | ((uint32_t)payload[2] << 16) | ((uint32_t)payload[3] << 24);
+
+        if (seq == 0) {
+            if (phase != IDLE) abort("restarted");
+            close();
+            patcher.reset();
+            mbedtls_sha256_init(&sha);
+            mbedtls_sha256_starts(&sha, 0);
+            nextSeq = 0;
+            phase   = RECEIVING;
+            publishStatus("started");
+        } else if (phase == IDLE || phase == FINISHING) {
+            return;
+        }
+
+        if (truncated) { abort("chunk too large"); return; }
+        if (seq != nextSeq) { abort("sequence"); return; }
+        if (phase == PREPARING) { abort("not ready"); return; }
+        if (seq == 0 && length - 4 != DeltaPatcher::HEADER_SIZE) { abort("header chunk"); return; }
+        nextSeq++;
+
+        DeltaPatcher::Status st = patcher.feed(payload + 4, length - 4);
+
+        if (st == DeltaPatcher::DONE) {
+            phase = FINISHING;
+        } else if (st != DeltaPatcher::IN_PROGRESS) {
+            char error[16];
+            snprintf(error, sizeof(error), "patch %u", (unsigned)st);
+            abort(error);
+        } else if (nextSeq % PROGRESS_EVERY == 0) {
+            publishStatus("applying");
+        }
+    }
+
+    //------------------------------------------------------------------------
+    // loop(): the flash work deferred from the MQTT callback
+    //------------------------------------------------------------------------
+    void loop() {
+        if (phase == PREPARING)      prepare();
+        else if (phase == FINISHING) finish();
+    }
+
+    // 0 while loop() has work to do, UINT32_MAX otherwise
+    uint32_t nextDueMs() const {
+        return phase == PREPARING || phase == FINISHING ? 0 : UINT32_MAX;
+    }
+
+    //------------------------------------------------------------------------
+    // PatchIO: running partition -> inactive partition. begin() only checks
+    // the sizes; the source hash and esp_ota_begin() follow in loop().
+    //------------------------------------------------------------------------
+    bool begin(const PatchHeader& header) override {
+        running = esp_ota_get_running_partition();
+        target  = esp_ota_get_next_update_partition(nullptr);
+        if (!running || !target) return false;
+        if (header.sourceSize > running->size || header.targetSize > target->size) return false;
+
+        hashed = 0;
+        phase  = PREPARING;
+        return true;
+    }
+
+    bool readSource(uint32_t offset, uint8_t* buf, size_t len) override {
+        return esp_partition_read(running, offset, buf, len) == ESP_OK;
+    }
+
+    bool writeTarget(const uint8_t* buf, size_t len) override {
+        if (esp_ota_write(handle, buf, len) != ESP_OK) return false;
+        mbedtls_sha256_update(&sha, buf, len);
+        return true;
+    }
+};
\ No newline at end of file
@@ -0,0 +1,175 @@
+// PublishGovernor.hpp
+#pragma once
+#include <stdint.h>
+#include <string.h>
+
+//==========================================================================
+// PublishGovernor
+// -------------------------------------------------------------------------
+// Decides which shadow "reported" writes actually go on the wire
+// (see MqttClient::publishState()). Each write names its topic, the key it
+// reports and the value; per topic/key the governor keeps the last value
+// that was handed to the broker and the newest value not sent yet.
+//
+//  - No-op writes are suppressed: a value equal to the last one sent is
+//    not published again (e.g. a bounce back to the reported state).
+//    Forced writes skip this check: an ack to a delta must go out even if
+//    it repeats the last value, since the delta says the shadow does not
+//    hold it (changed by someone else, or the earlier write lost).
+//  - Writes are paced by a token bucket shared by all keys (one bucket per
+//    device, i.e. per thing for AWS' per-thing shadow update limits): BURST
+//    writes at once, then one every REFILL_MS. A token is only spent by a
+//    publish that PubSubClient accepted.
+//  - A write that finds no token, or no connection, is not dropped: it
+//    waits in its slot and is coalesced with later writes of the same key,
+//    so only the newest value is published once a token is available.
+//
+// "Sent" means accepted by PubSubClient (QoS 0, the broker does not ack).
+// The memory of sent values is forgotten on every reconnect, since whatever
+// happened to the shadow meanwhile is unknown; the first write after a
+// reconnect always goes out.
+//
+// Topic and key pointers must stay valid (string literals, Device<> topics).
+// Payloads longer than PAYLOAD_SIZE, or beyond MAX_SLOTS keys, bypass the
+// governor.
+//==========================================================================
+class PublishGovernor {
+public:
+    static const uint8_t  MAX_SLOTS    = 2;
+    static const size_t   PAYLOAD_SIZE = 192;
+    static const uint8_t  BURST        = 4;
+    static const uint32_t REFILL_MS    = 250;
+
+    struct Slot {
+        const char* topic;
+        const char* key;
+        uint32_t    sentHash;    // Value last handed to the broker
+        uint32_t    pendingHash; // Value waiting in `payload`
+        bool        hasSent;
+        bool        pending;
+        char        payload[PAYLOAD_SIZE];
+    };
+
+    uint32_t suppressedCount = 0; // No-op writes (nothing pending) not published
+    uint32_t coalescedCount  = 0; // Writes replaced by a newer value before going out
+
+private:
+    Slot     slots[MAX_SLOTS] = {};
+    uint8_t  slotCount = 0;
+    uint32_t tokens    = BURST;
+    uint32_t refillAt  = 0;       // millis() of the last refill
+
+    static uint32_t hash(const char* s) {
+        uint32_t h = 2166136261u;   // FNV-1a
+        while (*s) {
+            h ^= (uint8_t)*s++;
+            h *= 16777619u;
+        }
+        return h;
+    }
+
+    Slot* find(const char* topic, const char* key) {
+        for (uint8_t i = 0; i < slotCount; i++) {
+            if (strcmp(slots[i].topic, topic) == 0 && strcmp(slots[i].key, key) == 0) return &slots[i];
+        }
+        if (slotCount == MAX_SLOTS) return nullptr;
+        Slot* s  = &slots[slotCount++];
+        s->topic = topic;
+        s->key   = key;
+        return s;
+    }
+
+    // While the bucket is full the refill clock stands at `nowMs`, so the
+    // next token comes REFILL_MS after the first one is spent, however
+    // often (or rarely) the owner calls next()
+    void refill(uint32_t nowMs) {
+        if (tokens == BURST) {
+            refillAt = nowMs;
+            return;
+        }
+        uint32_t earned = (nowMs - refillAt) / REFILL_MS;
+        if (earned == 0) return;
+        refillAt += earned * REFILL_MS;
+        tokens = tokens + earned > BURST ? BURST : tokens + earned;
+        if (tokens == BURST) refillAt = nowMs;
+    }
+
+public:
+    enum Verdict : uint8_t {
+        QUEUED,      // Stored in its slot; flush with next()/done()
+        SUPPRESSED,  // Same as the value last sent, nothing to do
+        BYPASS       // Not governed (payload too long / no slot): publish directly
+    };
+
+    //------------------------------------------------------------------------
+    // submit(): offers a new value for topic/key. A pending older value of
+    // the same key is replaced (coalesced). `force` queues it even if it
+    // equals the value last sent.
+    //------------------------------------------------------------------------
+    Verdict submit(const char* topic, const char* key, const char* value, const char* payload,
+                   bool force = false) {
+        if (strlen(payload) >= PAYLOAD_SIZE) return BYPASS;
+        Slot* s = find(topic, key);
+        if (!s) return BYPASS;
+
+        // Each write counts once: a pending value it discards (replaced, or
+        // reverted to what was sent) is a coalesce, otherwise a no-op write
+        // is a suppression
+        uint32_t h = hash(value);
+        if (!force && s->hasSent && s->sentHash == h) {
+            if (s->pending) coalescedCount++;
+            else            suppressedCount++;
+            s->pending = false;
+            return SUPPRESSED;
+        }
+        if (s->pending) coalescedCount++;
+
+        strcpy(s->payload, payload);
+        s->pendingHash = h;
+        s->pending     = true;
+        return QUEUED;
+    }
+
+    //------------------------------------------------------------------------
+    // next(): a pending slot to publish now; nullptr if nothing is pending
+    // or the bucket is empty. The token is taken by done().
+    //------------------------------------------------------------------------
+    Slot* next(uint32_t nowMs) {
+        refill(nowMs);
+        if (tokens == 0) return nullptr;
+        for (uint8_t i = 0; i < slotCount; i++) {
+            if (slots[i].pending) return &slots[i];
+        }
+        return nullptr;
+    }
+
+    // Result of publishing a slot returned by next(): a token is spent only
+    // if the publish went out
+    void done(Slot* s, bool ok) {
+        if (!ok) return;   // Stays pending, retried on the next flush
+        if (tokens > 0) tokens--;
+        s->sentHash = s->pendingHash;
+        s->hasSent  = true;
+        s->pending  = false;
+    }
+
+    // Writes still waiting for a token or a connection
+    bool hasPending() const {
+        for (uint8_t i = 0; i < slotCount; i++) {
+            if (slots[i].pending) return true;
+        }
+        return false;
+    }
+
+    // Milliseconds until next() can hand out a token again
+    uint32_t msUntilToken(uint32_t nowMs) const {
+        if (tokens > 0) return 0;
+        uint32_t since = nowMs - refillAt;
+        return since >= REFILL_MS ? 0 : REFILL_MS - since;
+    }
+
+    // New MQTT session: the shadow may have changed, resend the next value
+    void forgetSent() {
+        for (uint8_t i = 0; i < slotCount; i++) slots[i].hasSent = false;
+    }
+};
@@ -0,0 +1,174 @@
+#pragma once
+#include <string.h>
+#include "Mqtt.hpp"
+
+//=====================================================
+// ShadowStreamParser
+// ----------------------------------------------------
+// Incremental JSON scanner fed byte-by-byte by
+// PubSubClient (see PayloadStream). It extracts one
+// door key from a shadow document without keeping the
+// document in memory, which lets the actuator handle
+// delta / get-accepted documents larger than the MQTT
+// packet buffer (e.g. with big "metadata" sections).
+//
+// Recognized locations, same precedence as the
+// ArduinoJson path in EspActuator::handleMessage():
+//  - delta:   { "state": { "<key>": "OPEN" } }
+//  - desired: { "state": { "desired": { "<key>": "OPEN" } } }
+//
+// Memory use is fixed (~80 bytes) whatever the payload
+// size. Keys or values longer than TOKEN_LEN are never
+// matched.
+//=====================================================
+class ShadowStreamParser : public PayloadStream {
+  private:
+    static const uint8_t MAX_DEPTH = 8;   // Deeper nesting is tracked but not recorded
+    static const uint8_t PATH_DEPTH = 3;  // state / desired / <key>
+    static const uint8_t TOKEN_LEN = 16;  // Longest key/value we care about
+
+    enum LexState { IDLE, IN_STRING, IN_ESCAPE };
+
+    const char* doorKey;                   // Key to extract, e.g. "interiorDoor"
+
+    LexState lex;
+    uint8_t  depth;                        // Current container nesting
+    bool     isObject[MAX_DEPTH];          // Container type per level
+    bool     expectKey;                    // Next string is an object key
+    char     path[PATH_DEPTH][TOKEN_LEN];  // Key that opened each level
+    char     token[TOKEN_LEN];             // String being read
+    uint8_t  tokenLen;
+    bool     tokenOverflow;
+
+    char     value[TOKEN_LEN];             // Extracted door state
+    bool     foundDelta;                   // Matched state.<key>
+    bool     foundDesired;                 // Matched state.desired.<key>
+
+    bool inObject() const {
+        return depth > 0 && (depth > MAX_DEPTH || isObject[depth - 1]);
+    }
+
+    void push(bool object) {
+        if (depth < MAX_DEPTH) isObject[depth] = object;
+        depth++;
+        expectKey = object;
+    }
+
+    void pop() {
+        if (depth > 0) depth--;
+        expectKey = false;
+    }
+
+    // Handles a complete string token (key or value)
+    void onString() {
+        if (tokenOverflow) {
+            token[0] = '\0';
+        }
+
+        if (expectKey) {
+            if (depth >= 1 && depth <= PATH_DEPTH) {
+                memcpy(path[depth - 1], token, TOKEN_LEN);
+            }
+            return;
+        }
+
+        if (!inObject()) return;
+
+        bool delta = depth == 2
+                  && strcmp(path[0], "state") == 0
+                  && strcmp(path[1], doorKey) == 0;
+
+        bool desired = depth == 3
+                    && strcmp(path[0], "state") == 0
+                    && strcmp(path[1], "desired") == 0
+                    && strcmp(path[2], doorKey) == 0;
+
+        // A delta value always wins over a desired one
+        if (delta || (desired && !foundDelta)) {
+            memcpy(value, token, TOKEN_LEN);
+            foundDelta   = foundDelta || delta;
+            foundDesired = foundDesired || desired;
+        }
+    }
+
+    void append(char c) {
+        if (tokenLen < TOKEN_LEN - 1) {
+            token[tokenLen++] = c;
+            token[tokenLen]   = '\0';
+        } else {
+            tokenOverflow = true;
+        }
+    }
+
+  public:
+    ShadowStreamParser(const char* doorKey) : doorKey(doorKey) {
+        reset();
+    }
+
+    //-----------------------------------------------------
+    // Feeds one payload byte to the scanner
+    //-----------------------------------------------------
+    void consume(uint8_t b) override {
+        char c = (char)b;
+
+        switch (lex) {
+            case IN_ESCAPE:
+                append(c);      // Escapes are kept raw; keys never contain them
+                lex = IN_STRING;
+                return;
+
+            case IN_STRING:
+                if (c == '\\') {
+                    lex = IN_ESCAPE;
+                } else if (c == '"') {
+                    lex = IDLE;
+                    onString();
+                } else {
+                    append(c);
+                }
+                return;
+
+            case IDLE:
+                switch (c) {
+                    case '"':
+                        lex           = IN_STRING;
+                        tokenLen      = 0;
+                        token[0]      = '\0';
+                        tokenOverflow = false;
+                        break;
+                    case '{': push(true);  break;
+                    case '[': push(false); break;
+                    case '}':
+                    case ']': pop();       break;
+                    case ':': expectKey = false; break;
+                    case ',': expectKey = inObject(); break;
+                    default:  break;    // Whitespace, numbers, true/false/null
+                }
+                return;
+        }
+    }
+
+    //-----------------------------------------------------
+    // Clears all state before the next message
+    //-----------------------------------------------------
+    void reset() override {
+        PayloadStream::reset();
+        lex           = IDLE;
+        depth         = 0;
+        expectKey     = false;
+        tokenLen      = 0;
+        tokenOverflow = false;
+        token[0]      = '\0';
+        value[0]      = '\0';
+        foundDelta    = false;
+        foundDesired  = false;
+        for (uint8_t i = 0; i < PATH_DEPTH; i++) path[i][0] = '\0';
+    }
+
+    //-----------------------------------------------------
+    // Extracted door state, or nullptr if none was found
+    //-----------------------------------------------------
+    const char* doorState() const {
+        return (foundDelta || foundDesired) ? value : nullptr;
+    }
+};
\ No newline at end of file
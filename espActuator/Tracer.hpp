@@ -0,0 +1,75 @@
+// Tracer.hpp
+#pragma once
+#include <Arduino.h>
+#include <sys/time.h>
+#include <time.h>
+#include "Mqtt.hpp"
+
+//=====================================================
+// Tracer
+// ----------------------------------------------------
+// Per-command trace records for end-to-end latency.
+//
+// The Lambda sends every desired update with a shadow
+// clientToken ("<id>:<send epoch ms>"); AWS IoT copies it
+// into the delta. For each traced delta the actuator
+// echoes the token in its reported update and publishes
+// one JSON line on the trace topic:
+//
+//   {"hop":"actuator","token":"...","rx":<epoch ms>,
+//    "actUs":N,"pubUs":N,"synced":1}
+//
+// rx is wall-clock time (SNTP, UTC) so it can be compared
+// with the Lambda's clock; actUs / pubUs are monotonic
+// offsets from rx to the servo command and to the
+// reported publish. synced is 0 until SNTP has set the
+// clock, in which case rx must not be used across hosts.
+//
+// Records are collected and analysed by
+// tools/trace-collector.js.
+//=====================================================
+class Tracer {
+  private:
+    MqttClient* mqtt;
+    const char* topic;   // Trace topic (nullptr = tracing disabled)
+
+  public:
+    static const size_t MAX_TOKEN = 48;   // Longest token kept in a record
+
+    Tracer(MqttClient* mqtt, const char* topic) : mqtt(mqtt), topic(topic) {}
+
+    bool enabled() const { return topic != nullptr; }
+
+    //-----------------------------------------------------
+    // Starts SNTP (non-blocking, the clock is set in the
+    // background once Wi-Fi is up)
+    //-----------------------------------------------------
+    void begin() {
+        if (enabled()) configTime(0, 0, "pool.ntp.org", "time.google.com");
+    }
+
+    // True once SNTP has set the clock (any date after 2023)
+    static bool synced() {
+        return time(nullptr) > 1700000000;
+    }
+
+    // Wall-clock time in milliseconds since the epoch
+    static uint64_t nowMs() {
+        struct timeval tv;
+        gettimeofday(&tv, nullptr);
+        return (uint64_t)tv.tv_sec * 1000ULL + tv.tv_usec / 1000;
+    }
+
+    //-----------------------------------------------------
+    // Publishes the trace record of one command
+    //-----------------------------------------------------
+    void publish(const char* token, uint64_t rxMs, unsigned long actUs, unsigned long pubUs) {
+        if (!enabled() || !token) return;
+
+        char out[160];
+        snprintf(out, sizeof(out),
+                 "{\"hop\":\"actuator\",\"token\":\"%.*s\",\"rx\":%llu,\"actUs\":%lu,\"pubUs\":%lu,\"synced\":%d}",
+                 (int)MAX_TOKEN, token, (unsigned long long)rxMs, actUs, pubUs, synced() ? 1 : 0);
+        mqtt->publish(topic, out);
+    }
+};
\ No newline at end of file
@@ -1,26 +1,36 @@
-#include "EspActuator.hpp"
+#include "Device.hpp"
 
-// Create the global actuator instance.
+// Compile-time device configuration.
+// Every setting is constexpr; Device<> derives the shadow and
+// telemetry topics from thingName (and shadowName) at compile time.
+// Named shadows need the Lambda deployed with SHADOW_MODE=named.
+struct ActuatorConfig {
+    static constexpr byte          actuatorPin         = 12;                    // Servo control pin
+    static constexpr char          ssid[]              = "RIVERA WIFI 2.4";     // Wi-Fi SSID
+    static constexpr char          password[]          = "2880203CB.";          // Wi-Fi Password
+    static constexpr char          server[]            = "a1acybki981kqw-ats.iot.us-east-2.amazonaws.com"; // AWS IoT Core endpoint
+    static constexpr int           port                = 8883;                  // MQTT port with TLS
+    static constexpr char          thingName[]         = "iot_thing";           // AWS IoT thing (shadow owner)
+    static constexpr char          shadowName[]        = "";                    // "" = classic shadow, "interiorDoor" = per-door named shadow
+    static constexpr char          clientId[]          = "ESP_CLIENT_Actuator"; // MQTT client ID for this device
+    static constexpr uint16_t      mqttBufferSize      = 1024;                  // PubSubClient packet buffer (bytes)
+    static constexpr unsigned long telemetryIntervalMs = 60000;                 // Health telemetry cadence (ms)
+    static constexpr bool          recordEvents        = false;                 // "@rec" input lines on Serial (tools/replay.js)
+    static constexpr bool          eventLoop           = true;                  // Block between events (false = busy loop)
+};
+
+// Global actuator instance, in static storage (not on the heap).
 // This object manages Wi-Fi, MQTT, TLS certificates, servo motor control,
 // and communication with AWS IoT Device Shadow.
-EspActuator* espActuator = new EspActuator(
-    12,                                         // Servo control pin
-    "RIVERA WIFI 2.4",                          // Wi-Fi SSID
-    "2880203CB.",                               // Wi-Fi Password
-    "a1acybki981kqw-ats.iot.us-east-2.amazonaws.com", // AWS IoT Core endpoint
-    8883,                                       // MQTT port with TLS
-    "$aws/things/iot_thing/shadow/update",      // Publish topic (reported state)
-    "$aws/things/iot_thing/shadow/update/delta",// Subscribe topic (shadow delta updates)
-    "ESP_CLIENT_Actuator"                       // MQTT client ID for this device
-);
+Device<ActuatorConfig> espActuator;
 
 void setup() {
     // Initialize Wi-Fi, MQTT connection, TLS certificates,
     // subscribe to shadow delta, and set servo to initial position.
-    espActuator->setup();
+    espActuator.setup();
 }
 
 void loop() {
     // Process incoming MQTT messages and keep connection alive.
-    espActuator->loop();
+    espActuator.loop();
 }
\ No newline at end of file
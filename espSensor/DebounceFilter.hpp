@@ -0,0 +1,175 @@
+// DebounceFilter.hpp
+#pragma once
+#include <stdint.h>
+#include <atomic>
+
+// Plain C++17, no Arduino or ESP-IDF headers: the sampling logic of
+// MagneticSensor runs unchanged on the host (tools/debounce-replay.cpp).
+
+//==========================================================================
+// DebounceFilter
+// -------------------------------------------------------------------------
+// Contact-bounce filter for a sampled digital input. The filtered state
+// only follows the raw input after `stableSamples` consecutive samples at
+// the new level; any sample back at the current level restarts the count.
+// At a fixed sample rate this is a fixed debounce time:
+// stableSamples = debounceMs * sampleHz / 1000.
+// update() and reset() belong to the sampling context; settling() may be
+// called from another task (the count is atomic, single writer).
+//==========================================================================
+class DebounceFilter {
+private:
+    uint16_t              stableSamples;
+    std::atomic<uint16_t> count;   // Consecutive samples differing from `state`
+    bool                  state;
+
+public:
+    explicit DebounceFilter(uint16_t stableSamples = 1)
+        : stableSamples(stableSamples ? stableSamples : 1), count(0), state(false) {}
+
+    void reset(bool level) {
+        state = level;
+        count.store(0, std::memory_order_relaxed);
+    }
+
+    //------------------------------------------------------------------------
+    // update(): feeds one raw sample; true when the filtered state changed
+    //------------------------------------------------------------------------
+    bool update(bool raw) {
+        if (raw == state) {
+            count.store(0, std::memory_order_relaxed);
+            return false;
+        }
+        uint16_t n = count.load(std::memory_order_relaxed) + 1;
+        if (n < stableSamples) {
+            count.store(n, std::memory_order_relaxed);
+            return false;
+        }
+        state = raw;
+        count.store(0, std::memory_order_relaxed);
+        return true;
+    }
+
+    bool value() const { return state; }
+
+    // True while a change is being confirmed
+    bool settling() const { return count.load(std::memory_order_relaxed) != 0; }
+};
+
+//==========================================================================
+// JitterMeter
+// -------------------------------------------------------------------------
+// Achieved sample-rate statistics of a periodic sampler: mean and worst
+// absolute deviation of the sample interval from the nominal period.
+// Intervals longer than GAP_PERIODS periods (light sleep, a blocked timer
+// task) are counted as gaps and kept out of the jitter figures.
+//
+// Only the sampling context touches the running window. Another task gets
+// the figures through requestWindow() / takeWindow(): the sampler closes
+// the window at its next add(), copies it aside and starts a new one, so
+// the reader never sees it torn nor resets it under the sampler.
+//==========================================================================
+struct JitterMeter {
+    static const uint32_t GAP_PERIODS = 4;
+
+    // A closed window, as handed to the reader
+    struct Window {
+        uint32_t samples;
+        uint32_t meanUs;
+        uint32_t maxUs;
+        uint32_t gaps;
+    };
+
+    uint32_t periodUs  = 0;
+    uint32_t samples   = 0;   // Intervals measured in this window
+    uint64_t totalUs   = 0;   // Sum of |interval - period|
+    uint32_t maxUs     = 0;   // Worst |interval - period|
+    uint32_t gaps      = 0;
+
+private:
+    enum : uint8_t { IDLE, REQUESTED, READY };
+    std::atomic<uint8_t> handoff{IDLE};
+    Window               closed = {};
+
+public:
+    // Sampling context, before the sampler starts
+    void reset(uint32_t period) {
+        periodUs = period;
+        samples  = 0;
+        totalUs  = 0;
+        maxUs    = 0;
+        gaps     = 0;
+    }
+
+    // Sampling context: one measured interval
+    void add(uint32_t intervalUs) {
+        if (handoff.load(std::memory_order_acquire) == REQUESTED) {
+            closed = {samples, meanUs(), maxUs, gaps};
+            reset(periodUs);
+            handoff.store(READY, std::memory_order_release);
+        }
+        if (intervalUs > GAP_PERIODS * periodUs) {
+            gaps++;
+            return;
+        }
+        uint32_t dev = intervalUs > periodUs ? intervalUs - periodUs : periodUs - intervalUs;
+        samples++;
+        totalUs += dev;
+        if (dev > maxUs) maxUs = dev;
+    }
+
+    uint32_t meanUs() const { return samples ? (uint32_t)(totalUs / samples) : 0; }
+
+    // Reader: asks the sampler to close the running window
+    void requestWindow() {
+        uint8_t idle = IDLE;
+        handoff.compare_exchange_strong(idle, REQUESTED, std::memory_order_acq_rel);
+    }
+
+    // Reader: the window closed since requestWindow(); false if the sampler
+    // has not ticked since
+    bool takeWindow(Window& out) {
+        if (handoff.load(std::memory_order_acquire) != READY) return false;
+        out = closed;
+        handoff.store(IDLE, std::memory_order_release);
+        return true;
+    }
+};
+
+//==========================================================================
+// SpscQueue<T, N>
+// -------------------------------------------------------------------------
+// Wait-free single-producer / single-consumer ring (N must be a power of
+// two, N - 1 usable slots). The producer (timer task) never blocks: when
+// the ring is full push() fails and the caller counts the overflow.
+//==========================================================================
+template <typename T, uint8_t N>
+class SpscQueue {
+    static_assert((N & (N - 1)) == 0, "N must be a power of two");
+
+private:
+    T                    items[N];
+    std::atomic<uint8_t> head{0};   // Next slot to write (producer)
+    std::atomic<uint8_t> tail{0};   // Next slot to read (consumer)
+
+public:
+    bool push(const T& item) {
+        uint8_t h = head.load(std::memory_order_relaxed);
+        if ((uint8_t)(h - tail.load(std::memory_order_acquire)) == N - 1) return false;
+        items[h % N] = item;
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool pop(T& item) {
+        uint8_t t = tail.load(std::memory_order_relaxed);
+        if (t == head.load(std::memory_order_acquire)) return false;
+        item = items[t % N];
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool empty() const {
+        return tail.load(std::memory_order_acquire) == head.load(std::memory_order_acquire);
+    }
+};
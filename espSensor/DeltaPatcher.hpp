@@ -0,0 +1,219 @@
+// DeltaPatcher.hpp
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+//==========================================================================
+// Delta patch format (all integers little-endian)
+// -------------------------------------------------------------------------
+//   Header (76 bytes)
+//     "DPT1"            magic
+//     u32 sourceSize    bytes of the running image the patch was made against
+//     u32 targetSize    bytes of the image the patch produces
+//     u8[32] sourceHash SHA-256 of the first sourceSize bytes of the source
+//     u8[32] targetHash SHA-256 of the produced image
+//
+//   Operations, until END
+//     'C' u32 offset u32 length   copy `length` bytes of the source at `offset`
+//     'A' u32 length <bytes>      append `length` literal bytes
+//     'E'                         end of patch
+//
+// Patches are produced by tools/ota-delta.js.
+//==========================================================================
+struct PatchHeader {
+    uint32_t sourceSize;
+    uint32_t targetSize;
+    uint8_t  sourceHash[32];
+    uint8_t  targetHash[32];
+};
+
+//==========================================================================
+// PatchIO
+// -------------------------------------------------------------------------
+// Storage interface used by DeltaPatcher. On the ESP32 it is backed by the
+// running and the inactive OTA partitions (see OtaUpdater); on a host it
+// can be backed by plain buffers or files.
+//==========================================================================
+class PatchIO {
+public:
+    // Header parsed; return false to reject the patch (e.g. wrong source)
+    virtual bool begin(const PatchHeader& header) = 0;
+
+    // Reads `len` bytes of the source image at `offset`
+    virtual bool readSource(uint32_t offset, uint8_t* buf, size_t len) = 0;
+
+    // Appends `len` bytes to the target image
+    virtual bool writeTarget(const uint8_t* buf, size_t len) = 0;
+
+    virtual ~PatchIO() {}
+};
+
+//==========================================================================
+// DeltaPatcher
+// -------------------------------------------------------------------------
+// Streaming decoder for the format above. Input may be fed in chunks of
+// any size (e.g. one MQTT message at a time); output is written strictly
+// sequentially, so it can go straight into flash. RAM use is fixed:
+// a 76-byte header buffer and a COPY_CHUNK buffer, whatever the image size.
+//
+// Platform independent: no Arduino or ESP-IDF dependencies.
+//==========================================================================
+class DeltaPatcher {
+public:
+    enum Status : uint8_t {
+        IN_PROGRESS,
+        DONE,
+        ERR_MAGIC,       // Not a DPT1 patch
+        ERR_REJECTED,    // PatchIO::begin() refused the header
+        ERR_OPCODE,      // Unknown operation
+        ERR_RANGE,       // Copy outside the source or output past targetSize
+        ERR_IO,          // Source read / target write failed
+        ERR_SIZE         // END reached before targetSize bytes were written
+    };
+
+    static const size_t HEADER_SIZE = 76;
+    static const size_t COPY_CHUNK  = 256;
+
+private:
+    enum Stage : uint8_t { HEADER, OPCODE, COPY_ARGS, ADD_ARGS, ADD_DATA, FINISHED };
+
+    PatchIO*    io;
+    Stage       stage;
+    Status      status;
+    PatchHeader header;
+
+    uint8_t  scratch[HEADER_SIZE]; // Accumulates header / operation arguments
+    size_t   scratchLen;
+    size_t   scratchNeed;
+
+    uint32_t remaining;            // Bytes left in the current ADD
+    uint32_t written;              // Target bytes produced so far
+    uint8_t  copyBuf[COPY_CHUNK];
+
+    static uint32_t readU32(const uint8_t* p) {
+        return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+    }
+
+    void expect(Stage next, size_t bytes) {
+        stage       = next;
+        scratchLen  = 0;
+        scratchNeed = bytes;
+    }
+
+    Status fail(Status s) {
+        status = s;
+        stage  = FINISHED;
+        return s;
+    }
+
+    bool emit(const uint8_t* buf, size_t len) {
+        if (len > header.targetSize - written) { fail(ERR_RANGE); return false; }
+        if (!io->writeTarget(buf, len))        { fail(ERR_IO);    return false; }
+        written += len;
+        return true;
+    }
+
+    // Executes a COPY op in bounded chunks
+    bool copy(uint32_t offset, uint32_t length) {
+        if (offset > header.sourceSize || length > header.sourceSize - offset) {
+            fail(ERR_RANGE);
+            return false;
+        }
+        while (length > 0) {
+            size_t n = length < COPY_CHUNK ? length : COPY_CHUNK;
+            if (!io->readSource(offset, copyBuf, n)) { fail(ERR_IO); return false; }
+            if (!emit(copyBuf, n)) return false;
+            offset += n;
+            length -= n;
+        }
+        return true;
+    }
+
+    // Handles a complete fixed-size field held in scratch
+    bool onField() {
+        switch (stage) {
+            case HEADER:
+                if (memcmp(scratch, "DPT1", 4) != 0) { fail(ERR_MAGIC); return false; }
+                header.sourceSize = readU32(scratch + 4);
+                header.targetSize = readU32(scratch + 8);
+                memcpy(header.sourceHash, scratch + 12, 32);
+                memcpy(header.targetHash, scratch + 44, 32);
+                if (!io->begin(header)) { fail(ERR_REJECTED); return false; }
+                expect(OPCODE, 1);
+                return true;
+
+            case OPCODE:
+                switch (scratch[0]) {
+                    case 'C': expect(COPY_ARGS, 8); return true;
+                    case 'A': expect(ADD_ARGS, 4);  return true;
+                    case 'E':
+                        if (written != header.targetSize) { fail(ERR_SIZE); return false; }
+                        stage  = FINISHED;
+                        status = DONE;
+                        return true;
+                    default:
+                        fail(ERR_OPCODE);
+                        return false;
+                }
+
+            case COPY_ARGS:
+                if (!copy(readU32(scratch), readU32(scratch + 4))) return false;
+                expect(OPCODE, 1);
+                return true;
+
+            case ADD_ARGS:
+                remaining = readU32(scratch);
+                if (remaining == 0) expect(OPCODE, 1);
+                else                stage = ADD_DATA;
+                return true;
+
+            default:
+                return false;
+        }
+    }
+
+public:
+    DeltaPatcher(PatchIO* io) : io(io) { reset(); }
+
+    void reset() {
+        status    = IN_PROGRESS;
+        remaining = 0;
+        written   = 0;
+        memset(&header, 0, sizeof(header));
+        expect(HEADER, HEADER_SIZE);
+    }
+
+    //------------------------------------------------------------------------
+    // feed(): consumes the next piece of the patch.
+    // Returns IN_PROGRESS until the END op, then DONE, or an error. Once
+    // DONE or failed, further input is ignored until reset().
+    //------------------------------------------------------------------------
+    Status feed(const uint8_t* data, size_t len) {
+        while (len > 0 && stage != FINISHED) {
+            if (stage == ADD_DATA) {
+                size_t n = len < remaining ? len : remaining;
+                if (!emit(data, n)) return status;
+                data      += n;
+                len       -= n;
+                remaining -= n;
+                if (remaining == 0) expect(OPCODE, 1);
+                continue;
+            }
+
+            size_t n = scratchNeed - scratchLen;
+            if (n > len) n = len;
+            memcpy(scratch + scratchLen, data, n);
+            scratchLen += n;
+            data       += n;
+            len        -= n;
+
+            if (scratchLen == scratchNeed && !onField()) return status;
+        }
+        return status;
+    }
+
+    Status getStatus() const { return status; }
+    uint32_t bytesWritten() const { return written; }
+    const PatchHeader& getHeader() const { return header; }
+};
\ No newline at end of file
@@ -0,0 +1,118 @@
+// Device.hpp
+#pragma once
+#include <stddef.h>
+#include "EspSensor.hpp"
+
+//==========================================================================
+// FixedString / joinTopic()
+// -------------------------------------------------------------------------
+// Compile-time string concatenation used to build MQTT topics from the
+// thing name. The result is a plain char array that lives in flash/.rodata,
+// so no String or heap buffer is needed at runtime. Requires C++17
+// (arduino-esp32 3.x).
+//==========================================================================
+template <size_t N>
+struct FixedString {
+    char data[N] = {};
+    constexpr const char* c_str() const { return data; }
+};
+
+template <size_t... N>
+constexpr FixedString<(N + ...) - sizeof...(N) + 1> joinTopic(const char (&... parts)[N]) {
+    FixedString<(N + ...) - sizeof...(N) + 1> out;
+    size_t pos = 0;
+    for (const char* part : {static_cast<const char*>(parts)...}) {
+        while (*part) out.data[pos++] = *part++;
+    }
+    return out;
+}
+
+// shadowTopic(): "$aws/things/<thing>/shadow/name/<shadow><suffix>" for a
+// named shadow, or "$aws/things/<thing>/shadow<suffix>" for the classic
+// shadow when `shadow` is "". Still resolved at compile time.
+template <size_t T, size_t S, size_t X>
+constexpr auto shadowTopic(const char (&thing)[T], const char (&shadow)[S], const char (&suffix)[X]) {
+    auto named = joinTopic("$aws/things/", thing, "/shadow/name/", shadow, suffix);
+    if (shadow[0] != '\0') return named;
+
+    auto classic = joinTopic("$aws/things/", thing, "/shadow", suffix);
+    decltype(named) out;
+    for (size_t i = 0; i < sizeof(classic.data); i++) out.data[i] = classic.data[i];
+    return out;
+}
+
+//==========================================================================
+// Device<Config>
+// -------------------------------------------------------------------------
+// Statically configured EspSensor. All settings come from `Config` as
+// constexpr members, and topics are derived from Config::thingName and
+// Config::shadowName at compile time. An empty shadowName uses the classic
+// shadow shared by both doors; naming the door ("exteriorDoor") gives the
+// sensor its own small shadow document. Declare it as a global (static
+// storage) in the sketch:
+//
+//   struct SensorConfig {
+//       static constexpr int           sensorPin           = 4;
+//       static constexpr char          ssid[]              = "...";
+//       static constexpr char          password[]          = "...";
+//       static constexpr char          server[]            = "...amazonaws.com";
+//       static constexpr int           port                = 8883;
+//       static constexpr char          thingName[]         = "iot_thing";
+//       static constexpr char          shadowName[]        = ""; // or "exteriorDoor"
+//       static constexpr char          clientId[]          = "ESP_CLIENT_SENSOR";
+//       static constexpr uint16_t      mqttBufferSize      = 512;
+//       static constexpr unsigned long telemetryIntervalMs = 60000;
+//       static constexpr PowerProfile  powerProfile        = PowerProfile::alwaysOn();
+//       static constexpr uint32_t      sampleHz            = 1000; // 0 = poll from loop()
+//       static constexpr uint32_t      debounceMs          = 20;
+//       static constexpr bool          recordEvents        = false; // Inputs on Serial for tools/replay
+//       static constexpr bool          eventLoop           = true;  // false = busy loop()
+//   };
+//   Device<SensorConfig> espSensor;
+//
+// Together with the by-value members of EspSensor, the whole object graph
+// then lives in .bss instead of the heap that TLS needs later.
+//==========================================================================
+template <typename Config>
+class Device : public EspSensor {
+public:
+    // $aws/things/<thing>/shadow[/name/<shadowName>]/update
+    static constexpr auto updateTopic =
+        shadowTopic(Config::thingName, Config::shadowName, "/update");
+
+    // $aws/things/<thing>/shadow[/name/<shadowName>]/update/delta
+    static constexpr auto deltaTopic =
+        shadowTopic(Config::thingName, Config::shadowName, "/update/delta");
+
+    // <thing>/telemetry/<clientId>
+    static constexpr auto telemetryTopic =
+        joinTopic(Config::thingName, "/telemetry/", Config::clientId);
+
+    // <thing>/ota/<clientId>
+    static constexpr auto otaTopic =
+        joinTopic(Config::thingName, "/ota/", Config::clientId);
+
+    // <thing>/journal/<clientId> (replies on .../reply)
+    static constexpr auto journalTopic =
+        joinTopic(Config::thingName, "/journal/", Config::clientId);
+
+    Device()
+        : EspSensor(Config::sensorPin,
+                    Config::ssid,
+                    Config::password,
+                    Config::server,
+                    Config::port,
+                    Config::clientId,
+                    updateTopic.c_str(),
+                    deltaTopic.c_str(),
+                    telemetryTopic.c_str(),
+                    Config::telemetryIntervalMs,
+                    Config::mqttBufferSize,
+                    Config::powerProfile,
+                    otaTopic.c_str(),
+                    journalTopic.c_str(),
+                    Config::sampleHz,
+                    Config::debounceMs,
+                    Config::recordEvents,
+                    Config::eventLoop) {}
+};
\ No newline at end of file
@@ -2,6 +2,12 @@
 #pragma once
 #include "Mqtt.hpp"
 #include "MagneticSensor.hpp"
+#include "Telemetry.hpp"
+#include "PowerManager.hpp"
+#include "OtaUpdater.hpp"
+#include "JournalService.hpp"
+#include "EventRecorder.hpp"
+#include "EventDispatcher.hpp"
 #include <ArduinoJson.h>
 
 //==========================================================================
@@ -13,22 +19,74 @@
 //
 // Key responsibilities:
 //  - Initialize WiFi + MQTT secure connection (TLS)
-//  - Continuously monitor a reed switch sensor
+//  - Sample a reed switch sensor at a fixed rate (timer driven)
 //  - Detect state changes on the door (with debouncing behavior inside MagneticSensor)
 //  - Publish state updates to the AWS IoT Device Shadow
+//  - Publish periodic health telemetry (CBOR) on a separate topic
+//  - Apply a power profile (always-on, modem sleep, light sleep, deep sleep)
+//  - Apply delta firmware updates received on the OTA job topic
+//  - Journal every transition in flash and answer history queries
+//  - Optionally record its inputs on Serial for host replay (EventRecorder)
+//  - Block between events (socket, confirmed reed change, deadlines)
+//    instead of spinning, unless eventLoop is off (EventDispatcher)
 //
 // This device does NOT modify the desired state. It ONLY reports the real one.
 //==========================================================================
 class EspSensor {
 private:
-    MagneticSensor* doorSensor;   // Handles hardware state of the magnetic sensor
-    MqttClient*     mqtt;         // MQTT wrapper for AWS IoT Core
-    NetworkConfig*  networkConfig;
-    NetworkHandler* net;
-    MqttConfig*     mqttConfig;
+    static const unsigned long SAMPLER_REPORT_MS = 60000; // Reed sampler jitter log cadence
+    static const uint32_t      RECORD_DRAIN_MS   = 50;    // Recorded edges to Serial, while recording
+    static const uint32_t      SLEEP_RECHECK_MS  = 10;    // Idle but not allowed to sleep yet
+    static const uint32_t      REED              = 1u << 0; // EventDispatcher bit: reed transition
+
+    // Components are stored by value: constructing an EspSensor (or a
+    // Device<Config>, see Device.hpp) performs no heap allocation itself.
+    // Declaration order matters, each member is built from the previous ones.
+    MagneticSensor  doorSensor;   // Handles hardware state of the magnetic sensor
+    NetworkConfig   networkConfig;
+    NetworkHandler  net;
+    MqttConfig      mqttConfig;
+    MqttClient      mqtt;         // MQTT wrapper for AWS IoT Core
+    PayloadCounter  payloadCounter; // Full size of each incoming message
+    EventDispatcher events;       // Wakes loop() for socket, reed and deadline events
+    TelemetryPublisher telemetry; // Periodic device health reports
+    PowerManager    power;        // Radio/CPU sleep according to the power profile
+    OtaUpdater      ota;          // Delta firmware updates over MQTT
+    JournalService  journal;      // Transition history in flash + queries
+    EventRecorder   recorder;     // Input recording for tools/replay (off by default)
     static EspSensor* instance;   // Allows static MQTT callback (if needed)
     const char*     publishTopic; // Topic used to publish Shadow "reported" states
     const char*     subscribeTopic;
+    unsigned long   lastSamplerReport = 0;
+
+    //-------------------------------------------------------------------------
+    // MQTT callback: OTA chunks go to the updater, history queries to the
+    // journal, anything else is logged. Messages larger than the MQTT buffer
+    // arrive truncated (see PayloadCounter): the updater aborts on them,
+    // others are counted as dropped.
+    //-------------------------------------------------------------------------
+    static void mqttCallback(char* topic, uint8_t* payload, unsigned int length) {
+        if (!instance) return;
+        instance->recorder.message(topic, payload, length, instance->payloadCounter.received);
+        bool oversized = instance->mqtt.isOversized(length);
+
+        if (instance->ota.matches(topic)) {
+            instance->ota.handleChunk(payload, length, oversized);
+        } else if (oversized) {
+            instance->mqtt.countDropped();
+            Serial.printf("Dropped MQTT message [%s]: %u bytes\n", topic,
+                          (unsigned)instance->payloadCounter.received);
+        } else if (instance->journal.matches(topic)) {
+            instance->journal.handleQuery(payload, length);
+        } else {
+            Serial.print("Received MQTT message [");
+            Serial.print(topic);
+            Serial.print("]: ");
+            for (unsigned int i = 0; i < length; i++) Serial.print((char)payload[i]);
+            Serial.println();
+        }
+        instance->mqtt.endMessage();
+    }
 
 public:
 
@@ -42,37 +100,34 @@ public:
               int port,
               const char* clientId,
               const char* publishTopic,
-              const char* subscribeTopic) {
+              const char* subscribeTopic,
+              const char* telemetryTopic = nullptr,
+              unsigned long telemetryIntervalMs = 60000,
+              uint16_t mqttBufferSize = 0,
+              const PowerProfile& powerProfile = PowerProfile::alwaysOn(),
+              const char* otaTopic = nullptr,
+              const char* journalTopic = nullptr,
+              uint32_t sampleHz = 1000,
+              uint32_t debounceMs = 20,
+              bool recordEvents = false,
+              bool eventLoop = true)
+        : doorSensor(sensorPin, sampleHz, debounceMs), // Magnetic reed sensor interface
+          networkConfig(ssid, password),              // Certificates are loaded here
+          net(&networkConfig),
+          mqttConfig(server, clientId, &mqttCallback, port, mqttBufferSize),
+          mqtt(&mqttConfig, &net),
+          events(eventLoop),                          // false = busy loop, as before
+          telemetry(&mqtt, telemetryTopic, telemetryIntervalMs, &events), // Disabled if no topic
+          power(powerProfile, sensorPin),             // The reed pin is the wake source
+          ota(&mqtt, otaTopic),                       // Disabled if no topic
+          journal(&mqtt, journalTopic),               // Disabled if no topic
+          recorder(recordEvents)
+    {
+        mqtt.setPayloadStream(&payloadCounter);
 
         instance              = this;
         this->publishTopic    = publishTopic;    // Usually: $aws/things/<thing>/shadow/update
         this->subscribeTopic  = subscribeTopic;  // (Not used, but provided for completeness)
-
-        // Setup secure WiFi config (certificates are loaded from NetworkConfig)
-        networkConfig = new NetworkConfig(ssid, password);
-        net           = new NetworkHandler(networkConfig);
-
-        // Initialize the magnetic reed sensor interface
-        doorSensor    = new MagneticSensor(sensorPin);
-
-        // Setup MQTT/IoT Core configuration
-        mqttConfig = new MqttConfig(
-            server,
-            clientId,
-            // --------------------------------------------------------------
-            // MQTT callback (not used here, but logs anything received)
-            // --------------------------------------------------------------
-            [](char* topic, uint8_t* payload, unsigned int length) {
-                Serial.print("Received MQTT message [");
-                Serial.print(topic);
-                Serial.print("]: ");
-                for (unsigned int i = 0; i < length; i++) Serial.print((char)payload[i]);
-                Serial.println();
-            },
-            port
-        );
-
-        mqtt = new MqttClient(mqttConfig, net);
     }
 
     //-------------------------------------------------------------------------
@@ -81,58 +136,178 @@ public:
     void setup() {
         Serial.begin(115200);
 
-        // Initialize GPIO and read initial state
-        doorSensor->begin();
+        // Wake cause + release the reed pin from the RTC domain
+        power.begin();
+
+        // Initialize GPIO and read initial state; with the event loop,
+        // confirmed transitions wake loop()
+        recorder.begin("sensor");
+        doorSensor.recordEdges(recorder.isEnabled());
+        if (events.begin(net.getClient())) doorSensor.onChange(&wakeOnReed, &events);
+        doorSensor.begin();
+        recorder.gpio(doorSensor.getPin(), doorSensor.getLastState() ? LOW : HIGH, esp_timer_get_time());
+
+        // Mount the journal; a transition that woke us from deep sleep (or
+        // happened while powered off) is recorded here
+        journal.begin();
+        journal.record(doorSensor.getLastState());
+
+        // Establish WiFi + MQTT secure connection (power save / fast reconnect
+        // according to the profile)
+        power.configureNetwork(net);
+        mqtt.initialize();
+        power.onConnected();
 
-        // Establish WiFi + MQTT secure connection
-        mqtt->initialize();
+        // Heap high-water mark once TLS is up, and firmware size
+        Serial.printf("Heap: free=%u min=%u | Sketch: %u bytes\n",
+                      ESP.getFreeHeap(), ESP.getMinFreeHeap(), ESP.getSketchSize());
 
         // If needed, we could subscribe:
-        // mqtt->subscribe(subscribeTopic);
+        // mqtt.subscribe(subscribeTopic);
+
+        // OTA job topic (not reachable while deep sleeping)
+        ota.subscribe();
+
+        // History query topic
+        journal.subscribe();
+
+        if (power.reportOnWake()) {
+            reportState(doorSensor.getLastState());
+        }
+
+        // Deep sleep: report and go straight back to sleep
+        if (power.mode() == PowerMode::DEEP_SLEEP) {
+            mqtt.loop();
+            mqtt.client->disconnect();   // Flushes the publish with a clean DISCONNECT
+            power.deepSleep(doorSensor.getLastState());
+        }
     }
 
     //-------------------------------------------------------------------------
     // loop(): main execution loop
+    // - Waits for socket data, a reed transition or the next deadline
+    //   (returns at once with everything ready when eventLoop is off)
     // - Polls MQTT client
-    // - Detects door state changes
+    // - Picks up door state changes confirmed by the reed sampler
     // - Publishes Shadow "reported" attribute updates to AWS
+    // - Publishes health telemetry when due, continues an OTA update
+    // - Sets the deadlines of the next wait
+    // - Naps between polls when the power profile allows it: the next wait
+    //   blocks for up to napMs, and the chip light-sleeps meanwhile
     //-------------------------------------------------------------------------
     void loop() {
-        mqtt->loop();
+        uint32_t ready = events.wait();
+        unsigned long loopStart = micros();
+
+        // The nap used the reed pin as its wake source: look at it again
+        if (power.endNap()) {
+            doorSensor.armInterrupt();
+            ready |= REED;
+        }
+
+        if (ready & (EventDispatcher::SOCKET | EventDispatcher::DEADLINE)) mqtt.loop();
+        if (ready & (REED | EventDispatcher::DEADLINE)) recordInputs();
 
         // Check if physical state has changed since last loop
-        if (doorSensor->hasStateChanged()) {
+        while ((ready & REED) && doorSensor.hasStateChanged()) {
 
-            bool isOpen = doorSensor->getLastState();
+            bool isOpen = doorSensor.getLastState();
+            events.recordLatency(doorSensor.getLastChangeUs());
 
             Serial.print("Exterior door state changed -> ");
             Serial.println(isOpen ? "OPEN" : "CLOSE");
 
-            // --------------------------------------------------------------
-            // Create AWS IoT Shadow "reported" JSON payload:
-            //
-            // {
-            //   "state": {
-            //     "reported": {
-            //       "exteriorDoor": "OPEN"
-            //     }
-            //   }
-            // }
-            //
-            // This tells AWS the REAL hardware state.
-            // --------------------------------------------------------------
-            StaticJsonDocument<256> doc;
-            doc["state"]["reported"]["exteriorDoor"] = isOpen ? "OPEN" : "CLOSE";
-
-            String out;
-            serializeJson(doc, out);
-
-            // Publish state update to AWS IoT Shadow
-            mqtt->publish(publishTopic, out.c_str());
-
-            Serial.print("Shadow report (exteriorDoor): ");
-            Serial.println(out);
+            power.onStateChange();
+            journal.record(isOpen);
+            reportState(isOpen);
+        }
+
+        if (ready & EventDispatcher::DEADLINE) {
+            telemetry.loop();
+            ota.loop();
+
+            if (millis() - lastSamplerReport >= SAMPLER_REPORT_MS) {
+                lastSamplerReport = millis();
+                doorSensor.reportSampler();
+            }
+        }
+        telemetry.recordLoop(micros() - loopStart);
+
+        events.wakeBy(mqtt.nextDueMs());
+        events.wakeBy(telemetry.nextDueMs());
+        events.wakeBy(ota.nextDueMs());
+        unsigned long sinceReport = millis() - lastSamplerReport;
+        events.wakeBy(sinceReport >= SAMPLER_REPORT_MS ? 0 : SAMPLER_REPORT_MS - sinceReport);
+        if (recorder.isEnabled()) events.wakeBy(RECORD_DRAIN_MS);
+
+        bool napping = power.sleepIfIdle(doorSensor.getLastState(),
+                                         !mqtt.connected() || mqtt.governor.hasPending() || doorSensor.isSettling());
+        if (napping) {
+            events.wakeBy(power.napMs());
+        } else {
+            uint32_t sleepIn = power.nextDueMs();
+            events.wakeBy(sleepIn ? sleepIn : SLEEP_RECHECK_MS);
+        }
+
+        // The busy loop never blocks in wait(): nap here instead
+        if (napping && !events.isEventDriven()) {
+            int64_t idleStart = esp_timer_get_time();
+            delay(power.napMs());
+            events.addIdle(esp_timer_get_time() - idleStart);
+        }
+    }
+
+private:
+
+    // MagneticSensor wake hook (esp_timer task, or ISR when polling)
+    static void IRAM_ATTR wakeOnReed(void* arg) {
+        static_cast<EventDispatcher*>(arg)->notify(REED);
+    }
+
+    //-------------------------------------------------------------------------
+    // recordInputs(): raw reed edges queued by the sampler, and the wall
+    // clock, to the recorder
+    //-------------------------------------------------------------------------
+    void recordInputs() {
+        if (!recorder.isEnabled()) return;
+        ReedEdge edge;
+        while (doorSensor.nextEdge(edge)) recorder.gpio(doorSensor.getPin(), edge.level, edge.atUs);
+        recorder.loop();
+    }
+
+    //-------------------------------------------------------------------------
+    // reportState(): publishes the Shadow "reported" attribute
+    //-------------------------------------------------------------------------
+    void reportState(bool isOpen) {
+        // --------------------------------------------------------------
+        // Create AWS IoT Shadow "reported" JSON payload:
+        //
+        // {
+        //   "state": {
+        //     "reported": {
+        //       "exteriorDoor": "OPEN"
+        //     }
+        //   }
+        // }
+        //
+        // This tells AWS the REAL hardware state.
+        // --------------------------------------------------------------
+        StaticJsonDocument<256> doc;
+        doc["state"]["reported"]["exteriorDoor"] = isOpen ? "OPEN" : "CLOSE";
+
+        char out[128];
+        serializeJson(doc, out, sizeof(out));
+
+        // Publish state update to AWS IoT Shadow (skipped if it is the value
+        // already reported, paced if the door is flapping)
+        if (!mqtt.publishState(publishTopic, "exteriorDoor", isOpen ? "OPEN" : "CLOSE", out)) {
+            Serial.println("Shadow report unchanged, not sent");
+            return;
         }
+        power.onPublished();
+
+        Serial.print("Shadow report (exteriorDoor): ");
+        Serial.println(out);
     }
 };
 
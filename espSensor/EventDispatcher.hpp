@@ -0,0 +1,216 @@
+// EventDispatcher.hpp
+#pragma once
+#include <Arduino.h>
+#include <WiFiClientSecure.h>
+#include <esp_timer.h>
+#include <esp_vfs_eventfd.h>
+#include <sys/select.h>
+#include <unistd.h>
+#include <atomic>
+
+//==========================================================================
+// EventDispatcher
+// -------------------------------------------------------------------------
+// Lets loop() block until there is something to do, instead of spinning.
+// Three sources wake it, all through a single select():
+//
+//   SOCKET    the MQTT socket is readable (or TLS already holds decrypted
+//             bytes, which select() cannot see)
+//   DEADLINE  the earliest time passed to wakeBy() since the last wait:
+//             keep-alive, telemetry, publish pacing, ...
+//   app bits  notify(bits) from a task, an esp_timer callback or an ISR,
+//             through an eventfd (bits below DEADLINE are the device's own)
+//
+// wait() returns the bits that are ready; loop() runs only the handlers
+// those bits name, sets its next deadlines and calls wait() again. Several
+// events arriving while the loop is busy are coalesced into one wakeup.
+//
+// Disabled (or if the eventfd cannot be created), wait() returns at once
+// with every bit set, which is exactly the old busy loop; the statistics
+// are kept either way so both modes can be compared (TelemetryPublisher):
+//
+//   cpuPct    share of the window the loop task was not blocked in wait()
+//             (or napping, see addIdle())
+//   latAvgUs  mean / max time from an event (recordLatency()) to the start
+//   latMaxUs  of its handler
+//   wakeups   wait() returns, i.e. loop() runs
+//==========================================================================
+class EventDispatcher {
+public:
+    static const uint32_t SOCKET   = 1u << 31;
+    static const uint32_t DEADLINE = 1u << 30;
+    static const uint32_t ALL      = 0xFFFFFFFFu;
+
+    static const uint32_t MAX_BLOCK_MS   = 1000; // Longest wait without a deadline
+    static const uint32_t SOCKET_POLL_MS = 10;   // Wait cap while the socket fd is unknown
+
+    struct Stats {
+        uint32_t cpuPct;
+        uint32_t latAvgUs;
+        uint32_t latMaxUs;
+        uint32_t wakeups;
+    };
+
+private:
+    bool                  enabled;
+    Client*               client;
+    int                   eventFd;
+    std::atomic<uint32_t> pending;     // Bits notified since the last wait()
+    int64_t               deadlineUs;  // Earliest wakeBy() for the next wait, 0 = none
+    int64_t               wokeUs;      // esp_timer time of the last wait() return
+
+    // Statistics window
+    int64_t  windowUs;
+    int64_t  idleUs;
+    uint32_t wakeups;
+    uint32_t latCount;
+    uint64_t latTotalUs;
+    uint32_t latMaxUs;
+
+    // Waits for the eventfd or the socket, at most until the deadline
+    uint32_t block(uint32_t ready, int64_t startUs) {
+        int sock = client ? client->fd() : -1;
+
+        int64_t timeoutUs = (int64_t)MAX_BLOCK_MS * 1000;
+        if (sock < 0)  timeoutUs = (int64_t)SOCKET_POLL_MS * 1000;
+        if (deadlineUs && deadlineUs - startUs < timeoutUs) timeoutUs = deadlineUs - startUs;
+        if (ready || timeoutUs < 0) timeoutUs = 0;
+
+        fd_set fds;
+        FD_ZERO(&fds);
+        FD_SET(eventFd, &fds);
+        if (sock >= 0) FD_SET(sock, &fds);
+        struct timeval tv;
+        tv.tv_sec  = (time_t)(timeoutUs / 1000000);
+        tv.tv_usec = (suseconds_t)(timeoutUs % 1000000);
+
+        int n = select((sock > eventFd ? sock : eventFd) + 1, &fds, nullptr, nullptr, &tv);
+        if (n < 0) return ALL;   // select() failed: behave like the busy loop
+
+        if (FD_ISSET(eventFd, &fds)) {
+            uint64_t count;
+            read(eventFd, &count, sizeof(count));
+        }
+        if (sock < 0 || FD_ISSET(sock, &fds)) ready |= SOCKET;
+        return ready | pending.exchange(0);
+    }
+
+public:
+    EventDispatcher(bool enabled)
+        : enabled(enabled), client(nullptr), eventFd(-1), pending(0), deadlineUs(0), wokeUs(0),
+          windowUs(0), idleUs(0), wakeups(0), latCount(0), latTotalUs(0), latMaxUs(0) {}
+
+    //------------------------------------------------------------------------
+    // begin()
+    // `client` is the MQTT transport (its socket changes on reconnect, so
+    // it is looked up on every wait). Returns false when running as a busy
+    // loop, by configuration or because the eventfd is not available.
+    //------------------------------------------------------------------------
+    bool begin(Client* client) {
+        this->client = client;
+        windowUs     = esp_timer_get_time();
+        wokeUs       = windowUs;
+        if (!enabled) return false;
+
+        // The first wait() returns every bit: loop() runs all its handlers
+        // once and sets its deadlines
+        pending.store(ALL);
+
+        esp_vfs_eventfd_config_t config = ESP_VFS_EVENTD_CONFIG_DEFAULT();
+        esp_err_t err = esp_vfs_eventfd_register(&config);
+        if (err == ESP_OK || err == ESP_ERR_INVALID_STATE) eventFd = eventfd(0, EFD_SUPPORT_ISR);
+        if (eventFd < 0) {
+            Serial.println("Event loop: eventfd unavailable, busy polling");
+            enabled = false;
+        }
+        return enabled;
+    }
+
+    bool isEventDriven() const { return enabled; }
+
+    //------------------------------------------------------------------------
+    // notify()
+    // Marks `bits` ready and wakes wait(). Safe from tasks, esp_timer
+    // callbacks and ISRs.
+    //------------------------------------------------------------------------
+    void IRAM_ATTR notify(uint32_t bits) {
+        pending.fetch_or(bits);
+        if (eventFd < 0) return;
+        uint64_t one = 1;
+        write(eventFd, &one, sizeof(one));
+    }
+
+    // The next wait() returns by `ms` from now at the latest (UINT32_MAX = no
+    // limit). Callers count in millis(), so the deadline is the millisecond
+    // boundary at which millis() has advanced by `ms`.
+    void wakeBy(uint32_t ms) {
+        if (ms == UINT32_MAX) return;
+        int64_t at = (esp_timer_get_time() / 1000 + ms) * 1000;
+        if (!deadlineUs || at < deadlineUs) deadlineUs = at;
+    }
+
+    //------------------------------------------------------------------------
+    // wait()
+    // Blocks until an event or the deadline and returns the ready bits
+    // (0 after MAX_BLOCK_MS with nothing to do). The deadline is cleared
+    // once it fires; loop() sets its deadlines again after every wakeup.
+    //------------------------------------------------------------------------
+    uint32_t wait() {
+        int64_t  start = esp_timer_get_time();
+        uint32_t ready = ALL;
+
+        if (enabled) {
+            ready = pending.exchange(0);
+            if (client && client->available() > 0) ready |= SOCKET;
+            ready = block(ready, start);
+        }
+
+        wokeUs = esp_timer_get_time();
+        idleUs += wokeUs - start;
+        if (deadlineUs && wokeUs >= deadlineUs) ready |= DEADLINE;
+        if (ready & DEADLINE) deadlineUs = 0;
+        if (ready) wakeups++;
+        return ready;
+    }
+
+    // esp_timer time at which the current wakeup happened
+    int64_t wokeAtUs() const { return wokeUs; }
+
+    // Time spent off the CPU outside wait() (light-sleep naps)
+    void addIdle(int64_t us) { idleUs += us; }
+
+    //------------------------------------------------------------------------
+    // recordLatency()
+    // Call at the start of a handler with the esp_timer time of the event
+    // it handles.
+    //------------------------------------------------------------------------
+    void recordLatency(int64_t eventUs) {
+        uint32_t us = (uint32_t)(esp_timer_get_time() - eventUs);
+        latCount++;
+        latTotalUs += us;
+        if (us > latMaxUs) latMaxUs = us;
+    }
+
+    //------------------------------------------------------------------------
+    // take(): statistics since the previous call, and starts a new window
+    //------------------------------------------------------------------------
+    Stats take() {
+        int64_t now    = esp_timer_get_time();
+        int64_t window = now - windowUs;
+        int64_t busy   = window - idleUs;
+
+        Stats s;
+        s.cpuPct   = window > 0 ? (uint32_t)((busy > 0 ? busy : 0) * 100 / window) : 0;
+        s.latAvgUs = latCount ? (uint32_t)(latTotalUs / latCount) : 0;
+        s.latMaxUs = latMaxUs;
+        s.wakeups  = wakeups;
+
+        windowUs   = now;
+        idleUs     = 0;
+        wakeups    = 0;
+        latCount   = 0;
+        latTotalUs = 0;
+        latMaxUs   = 0;
+        return s;
+    }
+};
@@ -0,0 +1,418 @@
+// EventJournal.hpp
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+// Plain C++17, no Arduino or ESP-IDF headers: the same code runs in
+// tools/journal-bench.cpp on the host. The flash glue is JournalService.hpp.
+
+enum : uint8_t { JOURNAL_DOOR = 1 };       // JournalRecord::type
+enum : uint8_t { JOURNAL_SYNCED = 0x01 };  // JournalRecord::flags: time is SNTP wall-clock
+
+//==========================================================================
+// JournalRecord
+// -------------------------------------------------------------------------
+// One door transition, stored in flash as 16 bytes, little-endian:
+//    0  u32 seq       +1 per append, never 0xFFFFFFFF
+//    4  u32 time      Epoch seconds (seconds since boot if not synced)
+//    8  u16 ms        Millisecond part of the time
+//   10  u8  type      JOURNAL_DOOR
+//   11  u8  value     1 = OPEN, 0 = CLOSE
+//   12  u8  flags     JOURNAL_SYNCED
+//   13  u8  reserved  0xFF
+//   14  u16 crc       CRC-16/CCITT-FALSE of bytes 0..13
+// An erased slot reads all 0xFF; the CRC tells a torn write (power lost
+// while programming) from a valid record.
+//==========================================================================
+struct JournalRecord {
+    static const size_t SIZE = 16;
+
+    uint32_t seq;
+    uint32_t time;
+    uint16_t ms;
+    uint8_t  type;
+    uint8_t  value;
+    uint8_t  flags;
+
+    static uint16_t crc16(const uint8_t* data, size_t len) {
+        uint16_t crc = 0xFFFF;
+        for (size_t i = 0; i < len; i++) {
+            crc ^= (uint16_t)data[i] << 8;
+            for (int b = 0; b < 8; b++) crc = crc & 0x8000 ? (crc << 1) ^ 0x1021 : crc << 1;
+        }
+        return crc;
+    }
+
+    void encode(uint8_t out[SIZE]) const {
+        for (int i = 0; i < 4; i++) out[i]     = seq >> (8 * i);
+        for (int i = 0; i < 4; i++) out[4 + i] = time >> (8 * i);
+        out[8]  = ms;
+        out[9]  = ms >> 8;
+        out[10] = type;
+        out[11] = value;
+        out[12] = flags;
+        out[13] = 0xFF;
+        uint16_t crc = crc16(out, 14);
+        out[14] = crc;
+        out[15] = crc >> 8;
+    }
+
+    // False if the bytes are not a valid record
+    bool decode(const uint8_t in[SIZE]) {
+        if (crc16(in, 14) != (uint16_t)(in[14] | in[15] << 8)) return false;
+        seq = time = 0;
+        for (int i = 0; i < 4; i++) seq  |= (uint32_t)in[i] << (8 * i);
+        for (int i = 0; i < 4; i++) time |= (uint32_t)in[4 + i] << (8 * i);
+        ms    = in[8] | in[9] << 8;
+        type  = in[10];
+        value = in[11];
+        flags = in[12];
+        return seq != 0xFFFFFFFF;
+    }
+};
+
+//==========================================================================
+// EventJournal<Storage>
+// -------------------------------------------------------------------------
+// Append-only ring of JournalRecords over NOR flash sectors.
+//
+// Records are written one after the other; when the head reaches a new
+// sector that sector is erased first (it holds the oldest records once the
+// ring has wrapped). Every sector is therefore erased once per pass over
+// the ring, which spreads the wear evenly, and an append is a single
+// 16-byte program except once every SLOTS_PER_SECTOR appends.
+//
+// mount() rebuilds the state from flash alone: the newest sector is the
+// one whose first record has the highest seq, and the head is the first
+// erased slot in it (binary search). A torn record or a torn erase only
+// costs that slot / sector.
+//
+// Queries work on positions 0..size()-1 from the oldest slot to the
+// newest; seekSeq()/seekTime()/seekLast() find a start position by binary
+// search and scan() walks the valid records from there.
+//
+// Storage must provide:
+//   static constexpr uint32_t SECTOR_SIZE;                 // erase unit
+//   uint32_t size() const;                                 // bytes, multiple of SECTOR_SIZE
+//   bool read(uint32_t offset, void* buf, size_t len);
+//   bool write(uint32_t offset, const void* buf, size_t len);
+//   bool erase(uint32_t offset);                           // one sector
+//==========================================================================
+template <typename Storage>
+class EventJournal {
+public:
+    static const uint32_t SLOTS_PER_SECTOR = Storage::SECTOR_SIZE / JournalRecord::SIZE;
+
+private:
+    enum SlotState : uint8_t { ERASED, VALID, CORRUPT };
+
+    Storage* storage;
+    uint32_t sectors;     // Sectors in the ring
+    uint32_t slots;       // sectors * SLOTS_PER_SECTOR
+    uint32_t used;        // Sectors holding records (0..sectors)
+    uint32_t head;        // Next slot to write
+    uint32_t tail;        // First slot of the oldest sector
+    uint32_t nextSeq;
+    int      lastValue;   // Value of the newest record, -1 if none
+    bool     mounted;
+
+    uint32_t erases;      // Sector erases since mount
+    uint32_t failed;      // Failed programs / erases since mount
+
+    SlotState readSlot(uint32_t slot, JournalRecord& rec) {
+        uint8_t buf[JournalRecord::SIZE];
+        if (!storage->read(slot * JournalRecord::SIZE, buf, sizeof(buf))) return CORRUPT;
+
+        bool erased = true;
+        for (uint8_t b : buf) erased = erased && b == 0xFF;
+        if (erased) return ERASED;
+        return rec.decode(buf) ? VALID : CORRUPT;
+    }
+
+    // First valid record of a sector; false if none precedes its first erased slot
+    bool sectorFirst(uint32_t sector, JournalRecord& rec) {
+        for (uint32_t i = 0; i < SLOTS_PER_SECTOR; i++) {
+            SlotState s = readSlot(sector * SLOTS_PER_SECTOR + i, rec);
+            if (s == VALID)  return true;
+            if (s == ERASED) return false;
+        }
+        return false;
+    }
+
+    uint32_t slotAt(uint32_t pos) const { return (tail + pos) % slots; }
+
+    // First position in [0, size()) whose record does not satisfy `before`,
+    // looking only at valid records that satisfy `counts` (the others are
+    // stepped over like torn slots); `before` must be true for a prefix of
+    // those records
+    template <typename Counts, typename Pred>
+    uint32_t lowerBound(Counts counts, Pred before) {
+        uint32_t lo = 0;
+        uint32_t hi = size();
+        JournalRecord rec = {};
+        while (lo < hi) {
+            uint32_t mid = lo + (hi - lo) / 2;
+            uint32_t pos = mid;
+            while (pos < hi && !(readSlot(slotAt(pos), rec) == VALID && counts(rec))) pos++;
+            if (pos == hi)        hi = mid;
+            else if (before(rec)) lo = pos + 1;
+            else                  hi = mid;
+        }
+        return lo;
+    }
+
+public:
+    explicit EventJournal(Storage* storage)
+        : storage(storage), sectors(0), slots(0), used(0), head(0), tail(0), nextSeq(1),
+          lastValue(-1), mounted(false), erases(0), failed(0) {}
+
+    //------------------------------------------------------------------------
+    // mount(): finds head, tail and next seq from the flash contents.
+    // Needs at least two sectors.
+    //------------------------------------------------------------------------
+    bool mount() {
+        mounted = false;
+        sectors = storage->size() / Storage::SECTOR_SIZE;
+        if (sectors < 2) return false;
+        slots = sectors * SLOTS_PER_SECTOR;
+
+        JournalRecord rec = {};
+        int32_t  newest    = -1;
+        uint32_t newestSeq = 0;
+        for (uint32_t s = 0; s < sectors; s++) {
+            if (sectorFirst(s, rec) && (newest < 0 || rec.seq > newestSeq)) {
+                newest    = s;
+                newestSeq = rec.seq;
+            }
+        }
+
+        if (newest < 0) {
+            used = head = tail = 0;
+            nextSeq   = 1;
+            lastValue = -1;
+            mounted   = true;
+            return true;
+        }
+
+        // Head: first erased slot of the newest sector (1..SLOTS_PER_SECTOR)
+        uint32_t base = newest * SLOTS_PER_SECTOR;
+        uint32_t lo = 1;
+        uint32_t hi = SLOTS_PER_SECTOR;
+        while (lo < hi) {
+            uint32_t mid = (lo + hi) / 2;
+            if (readSlot(base + mid, rec) == ERASED) hi = mid;
+            else                                     lo = mid + 1;
+        }
+        head = (base + lo) % slots;
+
+        // Newest valid record: next seq and last value
+        nextSeq   = newestSeq + 1;
+        lastValue = -1;
+        for (uint32_t i = lo; i-- > 0;) {
+            if (readSlot(base + i, rec) == VALID) {
+                nextSeq   = rec.seq + 1;
+                lastValue = rec.value;
+                break;
+            }
+        }
+
+        // Tail: first sector after the newest one that holds older records
+        uint32_t tailSector = newest;
+        for (uint32_t k = 1; k < sectors; k++) {
+            uint32_t s = (newest + k) % sectors;
+            if (sectorFirst(s, rec) && rec.seq < newestSeq) {
+                tailSector = s;
+                break;
+            }
+        }
+        tail = tailSector * SLOTS_PER_SECTOR;
+        used = (newest + sectors - tailSector) % sectors + 1;
+
+        mounted = true;
+        return true;
+    }
+
+    //------------------------------------------------------------------------
+    // append(): writes one record; false if the journal is not mounted or
+    // the flash write failed (the slot is skipped either way)
+    //------------------------------------------------------------------------
+    bool append(uint8_t type, uint8_t value, uint32_t time, uint16_t ms, uint8_t flags) {
+        if (!mounted) return false;
+
+        if (head % SLOTS_PER_SECTOR == 0) {
+            if (!storage->erase(head / SLOTS_PER_SECTOR * Storage::SECTOR_SIZE)) {
+                failed++;
+                return false;
+            }
+            erases++;
+            // Full ring: the erased sector held the oldest records
+            if (used == sectors) {
+                tail = (tail + SLOTS_PER_SECTOR) % slots;
+            } else {
+                if (used == 0) tail = head;
+                used++;
+            }
+        }
+
+        JournalRecord rec = { nextSeq, time, ms, type, value, flags };
+        uint8_t buf[JournalRecord::SIZE];
+        rec.encode(buf);
+
+        bool ok = storage->write(head * JournalRecord::SIZE, buf, sizeof(buf));
+        head = (head + 1) % slots;
+        if (!ok) {
+            failed++;
+            return false;
+        }
+        nextSeq++;
+        lastValue = value;
+        return true;
+    }
+
+    // Slots from the oldest sector up to the head (valid or not)
+    uint32_t size() const {
+        if (!used) return 0;
+        uint32_t n = (head + slots - tail) % slots;
+        return n ? n : slots;
+    }
+
+    // First position with seq > afterSeq
+    uint32_t seekSeq(uint32_t afterSeq) {
+        return lowerBound([](const JournalRecord&) { return true; },
+                          [afterSeq](const JournalRecord& r) { return r.seq <= afterSeq; });
+    }
+
+    // First position with a synced time >= from. Unsynced records (written
+    // after a reboot, before SNTP) can sit anywhere between synced ones and
+    // have no place on the time line: the search steps over them, a run of
+    // them costs a linear walk, and the caller's scan must skip them too.
+    uint32_t seekTime(uint32_t from) {
+        return lowerBound([](const JournalRecord& r) { return (r.flags & JOURNAL_SYNCED) != 0; },
+                          [from](const JournalRecord& r) { return r.time < from; });
+    }
+
+    // Position of the n newest slots
+    uint32_t seekLast(uint32_t n) const {
+        return size() > n ? size() - n : 0;
+    }
+
+    //------------------------------------------------------------------------
+    // scan(): calls fn(record) for every valid record from `pos` to the
+    // newest one until fn returns false. Returns the position it stopped at.
+    //------------------------------------------------------------------------
+    template <typename Fn>
+    uint32_t scan(uint32_t pos, Fn fn) {
+        JournalRecord rec = {};
+        uint32_t end = size();
+        for (; pos < end; pos++) {
+            if (readSlot(slotAt(pos), rec) == VALID && !fn(rec)) return pos;
+        }
+        return end;
+    }
+
+    bool     isMounted() const { return mounted; }
+    int      last() const { return lastValue; }           // -1 if empty
+    uint32_t nextSequence() const { return nextSeq; }
+    uint32_t capacity() const { return slots; }
+    uint32_t eraseCount() const { return erases; }
+    uint32_t failures() const { return failed; }
+};
+
+//==========================================================================
+// JournalReply
+// -------------------------------------------------------------------------
+// Compact page of query results (one MQTT message):
+//   u8 version (1) | u8 flags | u16 id | u16 count | u32 firstSeq | u32 firstTime
+//   count x { u8 code | zigzag varint dTime [| varint seqGap] }
+// code: bit 0 value, bit 1 synced, bit 2 a seq gap follows, bits 4-7 type.
+// dTime is the time difference to the previous record (firstTime for the
+// first one); seqGap counts the sequence numbers skipped since the previous
+// record (torn slots, filtered records). Milliseconds are not sent.
+// A door event takes 2-4 bytes instead of 16 in flash (or ~60 as JSON).
+// Decoder: tools/journal-query.js.
+//==========================================================================
+enum : uint8_t {
+    REPLY_MORE      = 0x01,  // Another page of this query follows
+    REPLY_TRUNCATED = 0x02   // `max` reached; query again with after = last seq
+};
+
+class JournalReply {
+public:
+    static const size_t HEADER    = 14;
+    static const size_t MAX_ENTRY = 11;   // code + 2 x 5-byte varints
+
+private:
+    uint8_t* buf;
+    size_t   capacity;
+    size_t   len;
+    uint16_t id;
+    uint16_t count;
+    uint32_t prevSeq;
+    uint32_t prevTime;
+
+    void varint(uint32_t v) {
+        while (v >= 0x80) {
+            buf[len++] = (uint8_t)(v | 0x80);
+            v >>= 7;
+        }
+        buf[len++] = (uint8_t)v;
+    }
+
+    void put32(size_t at, uint32_t v) {
+        for (int i = 0; i < 4; i++) buf[at + i] = v >> (8 * i);
+    }
+
+public:
+    JournalReply(uint8_t* buf, size_t capacity, uint16_t id)
+        : buf(buf), capacity(capacity), len(HEADER), id(id), count(0), prevSeq(0), prevTime(0) {}
+
+    void reset() {
+        len   = HEADER;
+        count = 0;
+    }
+
+    //------------------------------------------------------------------------
+    // add(): appends a record; false (and nothing written) if the page is full
+    //------------------------------------------------------------------------
+    bool add(const JournalRecord& rec) {
+        if (len + MAX_ENTRY > capacity || count == 0xFFFF) return false;
+        if (count == 0) {
+            put32(6, rec.seq);
+            put32(10, rec.time);
+            prevSeq  = rec.seq - 1;
+            prevTime = rec.time;
+        }
+
+        uint32_t gap  = rec.seq - prevSeq - 1;
+        int32_t  dt   = (int32_t)(rec.time - prevTime);
+        uint8_t  code = (rec.value & 1) | (rec.flags & JOURNAL_SYNCED ? 0x02 : 0) |
+                        (gap ? 0x04 : 0) | (uint8_t)(rec.type << 4);
+        buf[len++] = code;
+        varint(((uint32_t)dt << 1) ^ (uint32_t)(dt >> 31));
+        if (gap) varint(gap);
+
+        prevSeq  = rec.seq;
+        prevTime = rec.time;
+        count++;
+        return true;
+    }
+
+    bool     empty() const { return count == 0; }
+    uint32_t lastSeq() const { return prevSeq; }
+
+    // Writes the header; returns the page length
+    size_t finish(uint8_t flags) {
+        buf[0] = 1;
+        buf[1] = flags;
+        buf[2] = id;
+        buf[3] = id >> 8;
+        buf[4] = count;
+        buf[5] = count >> 8;
+        if (count == 0) {
+            put32(6, 0);
+            put32(10, 0);
+        }
+        return len;
+    }
+};
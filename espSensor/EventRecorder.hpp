@@ -0,0 +1,101 @@
+// EventRecorder.hpp
+#pragma once
+#include <Arduino.h>
+#include <esp_timer.h>
+#include <time.h>
+
+//==========================================================================
+// EventRecorder
+// -------------------------------------------------------------------------
+// Records everything that drives the device from outside, on Serial, so a
+// session can be replayed deterministically on the host
+// (tools/replay/, tools/replay.js). One line per event, timestamped with
+// esp_timer (microseconds since boot):
+//
+//   @rec <us> H <device> <version>        start of a recording
+//   @rec <us> G <pin> <level>             raw level change of an input pin
+//   @rec <us> M <topic> <bytes> <base64>  incoming MQTT message
+//   @rec <us> C <epoch s>                 wall clock (SNTP), then every minute
+//
+// Lines are interleaved with the normal log; the replay tool ignores
+// everything else. Messages larger than the MQTT buffer only reach the
+// callback truncated, so only their head is recorded; <bytes> is the full
+// size and the replay reports the message as partial.
+// Disabled (the default) it prints nothing.
+//==========================================================================
+class EventRecorder {
+public:
+    static const uint8_t       VERSION           = 1;
+    static const unsigned long CLOCK_INTERVAL_MS = 60000;
+
+private:
+    bool          enabled;
+    bool          clockSeen;   // First SNTP time recorded
+    unsigned long lastClock;
+
+    static bool synced() {
+        return time(nullptr) > 1700000000;
+    }
+
+    void head(char kind) {
+        Serial.printf("@rec %lld %c ", (long long)esp_timer_get_time(), kind);
+    }
+
+    void base64(const uint8_t* data, unsigned int len) {
+        static const char ALPHABET[] =
+            "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+        char out[4];
+        for (unsigned int i = 0; i < len; i += 3) {
+            uint32_t n = (uint32_t)data[i] << 16;
+            if (i + 1 < len) n |= (uint32_t)data[i + 1] << 8;
+            if (i + 2 < len) n |= data[i + 2];
+            out[0] = ALPHABET[(n >> 18) & 63];
+            out[1] = ALPHABET[(n >> 12) & 63];
+            out[2] = i + 1 < len ? ALPHABET[(n >> 6) & 63] : '=';
+            out[3] = i + 2 < len ? ALPHABET[n & 63] : '=';
+            Serial.write((const uint8_t*)out, 4);
+        }
+    }
+
+public:
+    explicit EventRecorder(bool enabled) : enabled(enabled), clockSeen(false), lastClock(0) {}
+
+    bool isEnabled() const { return enabled; }
+
+    // Header line: which firmware the trace belongs to
+    void begin(const char* device) {
+        if (!enabled) return;
+        head('H');
+        Serial.printf("%s %u\n", device, VERSION);
+    }
+
+    // Raw (not debounced) input level at esp_timer time `atUs`
+    void gpio(int pin, int level, int64_t atUs) {
+        if (!enabled) return;
+        Serial.printf("@rec %lld G %d %d\n", (long long)atUs, pin, level);
+    }
+
+    //------------------------------------------------------------------------
+    // message(): one MQTT message as the callback got it. `total` is the
+    // full payload size when `length` is only its head.
+    //------------------------------------------------------------------------
+    void message(const char* topic, const uint8_t* payload, unsigned int length, size_t total) {
+        if (!enabled) return;
+        head('M');
+        Serial.printf("%s %u ", topic, (unsigned)(total > length ? total : length));
+        base64(payload, length);
+        Serial.println();
+    }
+
+    //------------------------------------------------------------------------
+    // loop(): wall clock once SNTP has set it, then every CLOCK_INTERVAL_MS
+    //------------------------------------------------------------------------
+    void loop() {
+        if (!enabled || !synced()) return;
+        if (clockSeen && millis() - lastClock < CLOCK_INTERVAL_MS) return;
+        clockSeen = true;
+        lastClock = millis();
+        head('C');
+        Serial.printf("%lld\n", (long long)time(nullptr));
+    }
+};
@@ -0,0 +1,199 @@
+// JournalService.hpp
+#pragma once
+#include <Arduino.h>
+#include <esp_partition.h>
+#include <sys/time.h>
+#include <time.h>
+#include <ArduinoJson.h>
+#include "Mqtt.hpp"
+#include "EventJournal.hpp"
+
+//==========================================================================
+// FlashPartition
+// -------------------------------------------------------------------------
+// EventJournal storage on a raw data partition, found by label (see
+// partitions.csv). No filesystem: EventJournal does its own wear levelling
+// over the 4 KB sectors.
+//==========================================================================
+class FlashPartition {
+private:
+    const esp_partition_t* part;
+
+public:
+    static constexpr uint32_t SECTOR_SIZE = 4096;
+
+    FlashPartition() : part(nullptr) {}
+
+    bool begin(const char* label) {
+        part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, label);
+        return part != nullptr;
+    }
+
+    uint32_t size() const { return part ? part->size : 0; }
+
+    bool read(uint32_t offset, void* buf, size_t len) {
+        return esp_partition_read(part, offset, buf, len) == ESP_OK;
+    }
+
+    bool write(uint32_t offset, const void* buf, size_t len) {
+        return esp_partition_write(part, offset, buf, len) == ESP_OK;
+    }
+
+    bool erase(uint32_t offset) {
+        return esp_partition_erase_range(part, offset, SECTOR_SIZE) == ESP_OK;
+    }
+};
+
+//==========================================================================
+// JournalService
+// -------------------------------------------------------------------------
+// Keeps a history of the door transitions in flash (EventJournal over the
+// "journal" partition) and answers history queries over MQTT.
+//
+// record() appends one record per change of the door state, online or not,
+// so transitions seen while the broker is unreachable (or while deep
+// sleeping, see EspSensor::setup()) are kept. Timestamps are SNTP wall-clock
+// once synced; before that they are seconds since boot and the record is
+// flagged as unsynced. Every reboot that loses the RTC time (power on, reset)
+// adds such records among the synced ones: `after` and `last` queries return
+// them, time ranges leave them out.
+//
+// Queries are small JSON documents on the query topic:
+//     {"id":7,"after":1200,"from":1718000000,"to":1718086400,"max":100}
+//     {"id":8,"last":10}
+// every field optional: `after` = only seq > after, `from`/`to` = epoch
+// seconds (inclusive), `last` = the newest N records, `max` = record limit
+// (default 200, at most MAX_PER_QUERY). Results are published on
+// "<topic>/reply" as JournalReply pages (see EventJournal.hpp) of up to
+// PAGE_SIZE bytes. Client: tools/journal-query.js.
+//==========================================================================
+class JournalService {
+private:
+    static const uint32_t DEFAULT_MAX   = 200;
+    static const uint32_t MAX_PER_QUERY = 1000;
+    static const size_t   PAGE_SIZE     = 192;   // Page + topic fit the default 256-byte MQTT buffer
+
+    MqttClient*  mqtt;
+    const char*  topic;            // Query topic (nullptr = journal disabled)
+    char         replyTopic[96];
+
+    FlashPartition             flash;
+    EventJournal<FlashPartition> journal;
+
+    static bool synced() {
+        return time(nullptr) > 1700000000;
+    }
+
+    void publishPage(JournalReply& page, uint8_t flags, uint8_t* buf) {
+        size_t len = page.finish(flags);
+        mqtt->publish(replyTopic, buf, len);
+    }
+
+public:
+    JournalService(MqttClient* mqtt, const char* topic)
+        : mqtt(mqtt), topic(topic), journal(&flash) {
+        snprintf(replyTopic, sizeof(replyTopic), "%s/reply", topic ? topic : "");
+    }
+
+    bool enabled() const { return topic != nullptr; }
+
+    bool matches(const char* t) const {
+        return enabled() && strcmp(t, topic) == 0;
+    }
+
+    //------------------------------------------------------------------------
+    // begin(): mounts the journal and starts SNTP (the clock is set in the
+    // background once Wi-Fi is up)
+    //------------------------------------------------------------------------
+    void begin() {
+        if (!enabled()) return;
+
+        if (!flash.begin("journal") || !journal.mount()) {
+            Serial.println("Journal: no \"journal\" partition, history disabled");
+            return;
+        }
+        configTime(0, 0, "pool.ntp.org", "time.google.com");
+
+        Serial.printf("Journal: %u/%u slots, next seq %u\n",
+                      journal.size(), journal.capacity(), journal.nextSequence());
+    }
+
+    void subscribe() {
+        if (enabled() && journal.isMounted()) mqtt->subscribe(topic);
+    }
+
+    //------------------------------------------------------------------------
+    // record(): appends the door state if it differs from the newest record
+    //------------------------------------------------------------------------
+    void record(bool isOpen) {
+        if (!journal.isMounted() || journal.last() == (isOpen ? 1 : 0)) return;
+
+        struct timeval tv;
+        gettimeofday(&tv, nullptr);
+        bool sync = synced();
+        if (!journal.append(JOURNAL_DOOR, isOpen ? 1 : 0, (uint32_t)tv.tv_sec,
+                            (uint16_t)(tv.tv_usec / 1000), sync ? JOURNAL_SYNCED : 0)) {
+            Serial.println("Journal: append failed");
+        }
+    }
+
+    //------------------------------------------------------------------------
+    // handleQuery(): answers one JSON query with one or more reply pages
+    //------------------------------------------------------------------------
+    void handleQuery(const uint8_t* payload, unsigned int length) {
+        if (!journal.isMounted()) return;
+
+        StaticJsonDocument<192> doc;
+        if (deserializeJson(doc, payload, length)) {
+            Serial.println("Journal: malformed query");
+            return;
+        }
+        uint16_t id    = doc["id"] | 0;
+        uint32_t after = doc["after"] | 0;
+        uint32_t from  = doc["from"] | 0;
+        uint32_t to    = doc["to"] | 0xFFFFFFFFUL;
+        uint32_t last  = doc["last"] | 0;
+        uint32_t max   = doc["max"] | DEFAULT_MAX;
+        if (max > MAX_PER_QUERY) max = MAX_PER_QUERY;
+        bool timeRange = from != 0 || to != 0xFFFFFFFFUL;
+
+        // Start position: the furthest of what each filter allows to skip
+        uint32_t pos = last ? journal.seekLast(last) : 0;
+        if (after) {
+            uint32_t p = journal.seekSeq(after);
+            if (p > pos) pos = p;
+        }
+        if (from) {
+            uint32_t p = journal.seekTime(from);
+            if (p > pos) pos = p;
+        }
+
+        uint8_t      buf[PAGE_SIZE];
+        JournalReply page(buf, sizeof(buf), id);
+        uint32_t     sent      = 0;
+        bool         truncated = false;
+
+        journal.scan(pos, [&](const JournalRecord& rec) {
+            if (rec.seq <= after) return true;
+            bool sync = rec.flags & JOURNAL_SYNCED;
+            if (timeRange) {
+                if (sync && rec.time > to) return false;   // Synced time only grows from here
+                if (!sync || rec.time < from) return true;
+            }
+            if (sent == max) {
+                truncated = true;
+                return false;
+            }
+            if (!page.add(rec)) {
+                publishPage(page, REPLY_MORE, buf);
+                page.reset();
+                page.add(rec);
+            }
+            sent++;
+            return true;
+        });
+        publishPage(page, truncated ? REPLY_TRUNCATED : 0, buf);
+
+        Serial.printf("Journal: query %u -> %u records%s\n", id, sent, truncated ? " (truncated)" : "");
+    }
+};
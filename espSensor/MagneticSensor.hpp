@@ -1,6 +1,34 @@
 // MagneticSensor.hpp
 #pragma once
 #include <Arduino.h>
+#include <esp_timer.h>
+#include <driver/gpio.h>
+#include <soc/soc_caps.h>
+#if SOC_GPIO_SUPPORT_PIN_GLITCH_FILTER
+#include <driver/gpio_filter.h>
+#endif
+#include "DebounceFilter.hpp"
+
+//==========================================================================
+// ReedChange
+// -------------------------------------------------------------------------
+// One debounced transition, as handed from the sampler to the main loop.
+//==========================================================================
+struct ReedChange {
+    bool    open;   // New state: true = OPEN
+    int64_t atUs;   // esp_timer time of the sample that confirmed it
+};
+
+//==========================================================================
+// ReedEdge
+// -------------------------------------------------------------------------
+// One change of the raw pin level as sampled, before debouncing. Only
+// collected while edge recording is on (EventRecorder).
+//==========================================================================
+struct ReedEdge {
+    uint8_t level;  // Pin level, 0 = OPEN
+    int64_t atUs;   // esp_timer time of the sample
+};
 
 //==========================================================================
 // MagneticSensor
@@ -10,6 +38,27 @@
 //  - LOW  -> sensor triggered (magnet far, door open)
 //  - HIGH -> sensor idle (magnet near, door closed)
 // The class tracks state changes and exposes the last known state.
+//
+// Sampling: with sampleHz > 0 the pin is read by a periodic esp_timer at
+// a fixed rate, in the esp_timer task, independent of how long loop()
+// spends in TLS or MQTT. Samples go through a DebounceFilter (debounceMs
+// of stable level) and only confirmed transitions are pushed to the main
+// context through a wait-free SpscQueue; hasStateChanged() drains it.
+// Where the chip has one (SOC_GPIO_SUPPORT_PIN_GLITCH_FILTER: S3, C3, C6,
+// ...) the GPIO glitch filter also removes sub-microsecond spikes before
+// they are sampled. The achieved sample interval is measured (JitterMeter)
+// and reported by EspSensor.
+//
+// sampleHz = 0 keeps the old behaviour: the pin is read on every
+// hasStateChanged() call, at whatever rate loop() runs.
+//
+// recordEdges() additionally queues every raw level change the sampler
+// sees (at sample resolution) for EventRecorder; nextEdge() drains them.
+//
+// onChange() registers a wake hook for an event-driven loop
+// (EventDispatcher): the sampler calls it after queueing a confirmed
+// transition, and with sampleHz = 0 a CHANGE interrupt on the pin calls it
+// so the loop knows when to poll. It may run in an ISR.
 //==========================================================================
 
 class MagneticSensor {
@@ -17,19 +66,111 @@ private:
     int  pin;         // GPIO where the magnetic switch is connected
     bool lastState;   // Cached state: true = OPEN, false = CLOSE
 
+    uint32_t                  sampleHz;
+    DebounceFilter            filter;
+    JitterMeter               jitter;
+    SpscQueue<ReedChange, 16> changes;
+    std::atomic<uint32_t>     overflows;   // Transitions lost to a full queue
+    SpscQueue<ReedEdge, 64>   edges;       // Raw level changes, while recording
+    bool                      recording;
+    uint8_t                   lastRaw;
+    std::atomic<uint32_t>     edgesLost;
+    int64_t                   lastSampleUs;
+    int64_t                   lastChangeUs;
+    esp_timer_handle_t        timer;
+    void                      (*wake)(void*);
+    void*                     wakeArg;
+
+    static void onTimer(void* arg) {
+        static_cast<MagneticSensor*>(arg)->sample();
+    }
+
+    static void IRAM_ATTR onEdge(void* arg) {
+        MagneticSensor* self = static_cast<MagneticSensor*>(arg);
+        self->wake(self->wakeArg);
+    }
+
+    //------------------------------------------------------------------------
+    // sample(): one timer tick (esp_timer task context)
+    //------------------------------------------------------------------------
+    void sample() {
+        int64_t now = esp_timer_get_time();
+        if (lastSampleUs) jitter.add((uint32_t)(now - lastSampleUs));
+        lastSampleUs = now;
+
+        int raw = gpio_get_level((gpio_num_t)pin);
+        if (recording && raw != lastRaw) {
+            lastRaw = raw;
+            if (!edges.push({(uint8_t)raw, now})) edgesLost.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        if (filter.update(raw == 0)) {
+            if (!changes.push({filter.value(), now})) overflows.fetch_add(1, std::memory_order_relaxed);
+            if (wake) wake(wakeArg);
+        }
+    }
+
+    void enableGlitchFilter() {
+#if SOC_GPIO_SUPPORT_PIN_GLITCH_FILTER
+        gpio_glitch_filter_handle_t glitch = nullptr;
+        gpio_pin_glitch_filter_config_t cfg = {};
+        cfg.clk_src  = GLITCH_FILTER_CLK_SRC_DEFAULT;
+        cfg.gpio_num = (gpio_num_t)pin;
+        if (gpio_new_pin_glitch_filter(&cfg, &glitch) == ESP_OK) gpio_glitch_filter_enable(glitch);
+#endif
+    }
+
 public:
-    // Constructor stores GPIO and initializes lastState to "CLOSE" by default
-    MagneticSensor(int pin) : pin(pin), lastState(false) {}
+    // Constructor stores GPIO and initializes lastState to "CLOSE" by default.
+    // sampleHz = 0 disables the timer sampler (polling from loop()).
+    MagneticSensor(int pin, uint32_t sampleHz = 1000, uint32_t debounceMs = 20)
+        : pin(pin), lastState(false), sampleHz(sampleHz),
+          filter(sampleHz ? (uint16_t)((debounceMs * sampleHz + 999) / 1000) : 1),
+          overflows(0), recording(false), lastRaw(0), edgesLost(0),
+          lastSampleUs(0), lastChangeUs(0), timer(nullptr), wake(nullptr), wakeArg(nullptr) {}
 
     //------------------------------------------------------------------------
     // begin()
     // Initializes the pin as INPUT_PULLUP since reed switches are
     // typically wired to short to ground when activated.
-    // Also stores the initial state as the baseline for change detection.
+    // Also stores the initial state as the baseline for change detection
+    // and starts the sampler.
     //------------------------------------------------------------------------
     void begin() {
         pinMode(pin, INPUT_PULLUP);
         lastState = isOpen();
+        if (sampleHz == 0) {
+            armInterrupt();
+            return;
+        }
+
+        enableGlitchFilter();
+        filter.reset(lastState);
+        lastRaw = lastState ? LOW : HIGH;
+        jitter.reset(1000000 / sampleHz);
+
+        esp_timer_create_args_t args = {};
+        args.callback              = &MagneticSensor::onTimer;
+        args.arg                   = this;
+        args.dispatch_method       = ESP_TIMER_TASK;
+        args.name                  = "reed";
+        args.skip_unhandled_events = true;   // No catch-up burst after light sleep
+        if (esp_timer_create(&args, &timer) != ESP_OK ||
+            esp_timer_start_periodic(timer, 1000000 / sampleHz) != ESP_OK) {
+            Serial.println("Reed sampler: esp_timer failed, polling from loop()");
+            sampleHz = 0;
+            armInterrupt();
+        }
+    }
+
+    //------------------------------------------------------------------------
+    // armInterrupt()
+    // Polling mode only: wakes the hook on every pin edge. Also call after
+    // a light-sleep nap, which takes over the pin's interrupt for the wake.
+    //------------------------------------------------------------------------
+    void armInterrupt() {
+        if (sampleHz || !wake) return;
+        attachInterruptArg(pin, &MagneticSensor::onEdge, this, CHANGE);
     }
 
     //------------------------------------------------------------------------
@@ -44,12 +185,22 @@ public:
     //------------------------------------------------------------------------
     // hasStateChanged()
     // Returns true when the sensor transitions between OPEN/CLOSE.
-    // Updates lastState so future calls detect only new changes.
+    // Updates lastState so future calls detect only new changes. With the
+    // sampler, one queued transition is consumed per call.
     //------------------------------------------------------------------------
     bool hasStateChanged() {
+        if (sampleHz) {
+            ReedChange change;
+            if (!changes.pop(change)) return false;
+            lastState    = change.open;
+            lastChangeUs = change.atUs;
+            return true;
+        }
+
         bool currentState = isOpen();
         if (currentState != lastState) {
-            lastState = currentState;
+            lastState    = currentState;
+            lastChangeUs = esp_timer_get_time();
             return true;
         }
         return false;
@@ -63,4 +214,45 @@ public:
     bool getLastState() {
         return lastState;
     }
-};
\ No newline at end of file
+
+    // esp_timer time at which the last transition was confirmed
+    int64_t getLastChangeUs() const { return lastChangeUs; }
+
+    // A transition is queued or being debounced: do not sleep yet
+    bool isSettling() {
+        if (sampleHz) return !changes.empty() || filter.settling();
+        return isOpen() != lastState;
+    }
+
+    // Queue raw level changes for nextEdge() (sampler only). Call before begin().
+    void recordEdges(bool on) { recording = on && sampleHz; }
+
+    // Wake hook for an event-driven loop (ISR safe). Call before begin().
+    void onChange(void (*fn)(void*), void* arg) {
+        wake    = fn;
+        wakeArg = arg;
+    }
+
+    // Next recorded raw level change; false when none is queued
+    bool nextEdge(ReedEdge& edge) { return edges.pop(edge); }
+
+    int getPin() const { return pin; }
+
+    //------------------------------------------------------------------------
+    // reportSampler()
+    // Prints the achieved sample interval jitter of the window closed at
+    // the previous call, and has the sampler close the current one (the
+    // timer task owns the figures, see JitterMeter).
+    //------------------------------------------------------------------------
+    void reportSampler() {
+        if (!sampleHz) return;
+        JitterMeter::Window w;
+        if (jitter.takeWindow(w)) {
+            Serial.printf("Reed sampler: %u Hz, n=%u jitter mean=%u max=%u us, gaps=%u, lost=%u\n",
+                          sampleHz, w.samples, w.meanUs, w.maxUs, w.gaps, overflows.load(std::memory_order_relaxed));
+        }
+        uint32_t lost = edgesLost.load(std::memory_order_relaxed);
+        if (lost) Serial.printf("Reed sampler: %u recorded edges lost\n", lost);
+        jitter.requestWindow();
+    }
+};
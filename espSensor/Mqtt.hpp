@@ -1,13 +1,15 @@
 #pragma once
 #include <PubSubClient.h>
 #include "Network.hpp"
+#include "PublishGovernor.hpp"
 
 //=============================================================================
 // MqttConfig
 // -----------------------------------------------------------------------------
 // Holds all MQTT configuration parameters required to establish a connection
 // with AWS IoT (or any MQTT broker). This includes server address, port,
-// client ID, and the callback function that will handle incoming messages.
+// client ID, the callback function that will handle incoming messages and
+// the PubSubClient packet buffer size (0 keeps the library default).
 //=============================================================================
 class MqttConfig {
     public:
@@ -15,12 +17,59 @@ class MqttConfig {
         const char* clientId;                            // Unique client ID
         void (*callback)(char*, uint8_t*, unsigned int); // Incoming message handler
         int port;                                        // MQTT/TLS port (8883 for AWS)
+        uint16_t bufferSize;                             // MQTT packet buffer (bytes)
 
         MqttConfig(const char* server,
                    const char* clientId,
                    void (*callback)(char*, uint8_t*, unsigned int),
-                   int port)
-            : server(server), clientId(clientId), callback(callback), port(port) {}
+                   int port,
+                   uint16_t bufferSize = 0)
+            : server(server), clientId(clientId), callback(callback), port(port),
+              bufferSize(bufferSize) {}
+};
+
+//=============================================================================
+// PayloadStream
+// -----------------------------------------------------------------------------
+// PubSubClient copies every PUBLISH payload, byte by byte, into an attached
+// Stream *before* invoking the callback. With a stream attached it also stops
+// dropping packets larger than its buffer and hands the callback the truncated
+// head instead. Subclasses consume the bytes incrementally, so large messages
+// can be parsed without holding them in RAM.
+//=============================================================================
+class PayloadStream : public Stream {
+    public:
+        size_t received = 0;   // Payload bytes seen for the current message
+
+        size_t write(uint8_t b) override {
+            received++;
+            consume(b);
+            return 1;
+        }
+
+        // Called for every payload byte
+        virtual void consume(uint8_t b) = 0;
+
+        // Called once the message has been handled
+        virtual void reset() { received = 0; }
+
+        // Write-only stream
+        int available() override { return 0; }
+        int read() override { return -1; }
+        int peek() override { return -1; }
+        void flush() override {}
+};
+
+//=============================================================================
+// PayloadCounter
+// -----------------------------------------------------------------------------
+// PayloadStream that only counts the bytes. Attached when no message needs
+// incremental parsing, it still lets MqttClient see (and count) messages
+// larger than the packet buffer, which PubSubClient would drop unseen.
+//=============================================================================
+class PayloadCounter : public PayloadStream {
+    public:
+        void consume(uint8_t) override {}
 };
 
 //=============================================================================
@@ -31,30 +80,40 @@ class MqttConfig {
 //  ✔ TLS-secured WiFi connection (via NetworkHandler)
 //  ✔ MQTT connection management (connect, reconnect, subscribe, publish)
 //  ✔ Automatic reconnection if WiFi or MQTT drops
+//  ✔ Accounting for messages larger than the configured packet buffer
+//  ✔ Shadow "reported" writes deduplicated and rate limited (PublishGovernor)
 //
 // This class ensures that the ESP32 maintains a stable connection to AWS IoT
-// and sends/receives messages reliably.
+// and sends/receives messages reliably. The PubSubClient is stored inline;
+// only its packet buffer is allocated (once) by the library.
 //=============================================================================
 class MqttClient {
     public:
         MqttConfig* config;           // Holds MQTT settings
-        PubSubClient* client;         // Underlying MQTT client
+        PubSubClient pubSub;          // Underlying MQTT client (inline)
+        PubSubClient* client;         // Points at pubSub
         NetworkHandler* networkHandler;  // Manages WiFi/TLS network layer
+        uint32_t connectCount = 0;       // Successful MQTT connections since boot
+
+        static const uint8_t MAX_SUBSCRIPTIONS = 4;
+        const char* subscriptions[MAX_SUBSCRIPTIONS] = {}; // Restored after reconnect
+        uint8_t subscriptionCount = 0;
+        PayloadStream* payloadStream = nullptr; // Incremental parser for large payloads
+        uint32_t oversizedCount = 0;     // Messages larger than the packet buffer
+        uint32_t droppedCount = 0;       // Oversized messages that could not be handled
+        PublishGovernor governor;        // Dedup + token bucket for publishState()
 
         //-------------------------------------------------------------------------
         // Constructor: builds a PubSubClient based on the WiFi secure client
         // provided by NetworkHandler, then sets server and callback.
         //-------------------------------------------------------------------------
         MqttClient(MqttConfig* config, NetworkHandler* networkHandler)
-            : config(config), networkHandler(networkHandler) {
-            
-            client = new PubSubClient(*networkHandler->getClient());
-            client->setServer(config->server, config->port);
-            client->setCallback(config->callback);
+            : client(&pubSub) {
+            setAll(config, networkHandler);
         }
 
         // Default constructor for optional delayed initialization
-        MqttClient() {}
+        MqttClient() : client(&pubSub) {}
 
         //-------------------------------------------------------------------------
         // setAll(): allows late injection of config + network handler
@@ -64,14 +123,43 @@ class MqttClient {
             this->config = config;
             this->networkHandler = networkHandler;
 
-            client = new PubSubClient(*networkHandler->getClient());
+            client->setClient(*networkHandler->getClient());
             client->setServer(config->server, config->port);
             client->setCallback(config->callback);
+            if (config->bufferSize > 0) client->setBufferSize(config->bufferSize);
         }
 
-        // Destructor cleans up allocated PubSubClient
-        ~MqttClient() {
-            delete client;
+        //-------------------------------------------------------------------------
+        // setPayloadStream()
+        // Streams every incoming payload into `stream` (see PayloadStream).
+        //-------------------------------------------------------------------------
+        void setPayloadStream(PayloadStream* stream) {
+            payloadStream = stream;
+            client->setStream(*stream);
+        }
+
+        //-------------------------------------------------------------------------
+        // isOversized()
+        // Call at the start of the message callback. Returns true when `length`
+        // is only the head of a larger payload. Without a payload stream,
+        // PubSubClient drops such messages silently and they cannot be counted.
+        //-------------------------------------------------------------------------
+        bool isOversized(unsigned int length) {
+            if (payloadStream && payloadStream->received > length) {
+                oversizedCount++;
+                return true;
+            }
+            return false;
+        }
+
+        // Records an oversized message that was lost
+        void countDropped() {
+            droppedCount++;
+        }
+
+        // Call at the end of the message callback
+        void endMessage() {
+            if (payloadStream) payloadStream->reset();
         }
 
         //-------------------------------------------------------------------------
@@ -96,6 +184,11 @@ class MqttClient {
 
                 if (client->connect(config->clientId)) {
                     Serial.println("connected");
+                    connectCount++;
+                    governor.forgetSent();
+                    for (uint8_t i = 0; i < subscriptionCount; i++) {
+                        client->subscribe(subscriptions[i]);
+                    }
                 } else {
                     Serial.print("failed, rc=");
                     Serial.print(client->state());
@@ -127,11 +220,76 @@ class MqttClient {
             }
         }
 
+        //-------------------------------------------------------------------------
+        // publish() (binary)
+        // Sends a raw byte payload (e.g. CBOR telemetry) to a topic.
+        //-------------------------------------------------------------------------
+        void publish(const char* topic, const uint8_t* payload, unsigned int length) {
+            if (client->connected()) {
+                client->publish(topic, payload, length);
+            } else {
+                Serial.println("MQTT client not connected. Reconnecting...");
+                reconnect();
+            }
+        }
+
+        //-------------------------------------------------------------------------
+        // publishState()
+        // Shadow "reported" write of `value` under `key`, through the publish
+        // governor: a value equal to the last one sent is suppressed, others
+        // are paced by its token bucket and wait (coalesced) while no token or
+        // connection is available. `force` skips the no-op check (acks to a
+        // delta). Returns false if the write was suppressed.
+        //-------------------------------------------------------------------------
+        bool publishState(const char* topic, const char* key, const char* value, const char* payload,
+                          bool force = false) {
+            switch (governor.submit(topic, key, value, payload, force)) {
+                case PublishGovernor::SUPPRESSED:
+                    return false;
+                case PublishGovernor::BYPASS:
+                    publish(topic, payload);
+                    return true;
+                default:
+                    break;
+            }
+            if (!client->connected()) {
+                Serial.println("MQTT client not connected. Reconnecting...");
+                reconnect();
+            }
+            flushStates();
+            return true;
+        }
+
+        //-------------------------------------------------------------------------
+        // flushStates()
+        // Publishes the governed writes that have a token. Also run by loop().
+        //-------------------------------------------------------------------------
+        void flushStates() {
+            if (!client->connected()) return;
+            PublishGovernor::Slot* slot;
+            while ((slot = governor.next(millis())) != nullptr) {
+                bool ok = client->publish(slot->topic, slot->payload);
+                governor.done(slot, ok);
+                if (!ok) break;
+            }
+        }
+
+        //-------------------------------------------------------------------------
+        // getReconnectCount()
+        // Number of times the connection had to be re-established after the
+        // first successful connect.
+        //-------------------------------------------------------------------------
+        uint32_t getReconnectCount() {
+            return connectCount > 0 ? connectCount - 1 : 0;
+        }
+
         //-------------------------------------------------------------------------
         // subscribe()
-        // Subscribes to a topic. Handles reconnection if needed.
+        // Subscribes to a topic. Handles reconnection if needed. The topic is
+        // remembered and subscribed again after every reconnect.
         //-------------------------------------------------------------------------
         void subscribe(const char* topic) {
+            remember(topic);
             if (client->connected()) {
                 client->subscribe(topic);
             } else {
@@ -140,6 +298,32 @@ class MqttClient {
             }
         }
 
+        //-------------------------------------------------------------------------
+        // remember()
+        // Adds a topic to the resubscribe list (pointer must stay valid).
+        //-------------------------------------------------------------------------
+        void remember(const char* topic) {
+            for (uint8_t i = 0; i < subscriptionCount; i++) {
+                if (strcmp(subscriptions[i], topic) == 0) return;
+            }
+            if (subscriptionCount < MAX_SUBSCRIPTIONS) {
+                subscriptions[subscriptionCount++] = topic;
+            }
+        }
+
+        //-------------------------------------------------------------------------
+        // nextDueMs()
+        // Longest an event-driven caller may wait before loop() has to run
+        // again without socket activity: at once to reconnect, the next
+        // token while governed writes wait, otherwise in time for the
+        // keep-alive PINGREQ.
+        //-------------------------------------------------------------------------
+        uint32_t nextDueMs() {
+            if (!client->connected()) return 0;
+            if (governor.hasPending()) return governor.msUntilToken(millis());
+            return MQTT_KEEPALIVE * 1000UL / 2;
+        }
+
         //-------------------------------------------------------------------------
         // loop()
         // Processes incoming MQTT messages and keeps TCP connection alive.
@@ -148,6 +332,7 @@ class MqttClient {
         void loop() {
             if (client->connected()) {
                 client->loop();
+                flushStates();
             } else {
                 Serial.println("MQTT client not connected. Reconnecting...");
                 reconnect();
@@ -1,6 +1,7 @@
 #pragma once
 #include <WiFiClientSecure.h>
 #include <WiFi.h>
+#include <esp_wifi.h>
 #include "certificates.h"
 
 //=============================================================================
@@ -15,20 +16,21 @@
 //   • Device certificate
 //
 // It produces a fully configured WiFiClientSecure instance used by MQTT.
+// The secure client is stored inline, so no heap allocation is needed.
 //=============================================================================
 class NetworkConfig {
     public:
         const char* ssid;                 // WiFi network name
         const char* password;             // WiFi password
-        WiFiClientSecure* client;         // TLS-enabled network client
+        WiFiClientSecure secureClient;    // TLS-enabled network client (inline)
+        WiFiClientSecure* client;         // Points at secureClient
 
         //-------------------------------------------------------------------------
         // Constructor: loads certificates from compile-time constants.
         //-------------------------------------------------------------------------
         NetworkConfig(const char* ssid, const char* password)
-            : ssid(ssid), password(password) {
+            : ssid(ssid), password(password), client(&secureClient) {
 
-            client = new WiFiClientSecure();
             client->setCACert(AWS_ROOT_CA_CERTIFICATE);      // AWS Root CA
             client->setPrivateKey(AWS_PRIVATE_KEY);          // Device private key
             client->setCertificate(AWS_CLIENT_CERTIFICATE);  // Device certificate
@@ -42,18 +44,12 @@ class NetworkConfig {
                       const char* root_ca,
                       const char* private_key,
                       const char* client_cert)
-            : ssid(ssid), password(password) {
+            : ssid(ssid), password(password), client(&secureClient) {
 
-            client = new WiFiClientSecure();
             client->setCACert(root_ca);
             client->setPrivateKey(private_key);
             client->setCertificate(client_cert);
         }
-
-        // Cleanup allocated secure client
-        ~NetworkConfig() {
-            delete client;
-        }
 };
 
 //=============================================================================
@@ -65,6 +61,8 @@ class NetworkConfig {
 //   ✔ Connection to the access point
 //   ✔ Auto-reconnect logic
 //   ✔ Providing the secure client for MQTT
+//   ✔ Optional modem power save with a tuned listen interval (DTIM)
+//   ✔ Optional fast reconnect to a known channel/BSSID (no scan)
 //
 // Designed to maintain a stable connection required by AWS IoT Core.
 //=============================================================================
@@ -72,25 +70,71 @@ class NetworkHandler {
     public:
         NetworkConfig* config;     // Pointer to certificate + WiFi settings
 
+        bool     powerSave      = false;   // Modem sleep between beacons
+        uint8_t  listenInterval = 0;       // Beacons between wakes (0 = AP DTIM)
+        int32_t  fastChannel    = 0;       // Known AP channel (0 = scan)
+        const uint8_t* fastBssid = nullptr; // Known AP BSSID (nullptr = scan)
+
         //-------------------------------------------------------------------------
         // Constructor: injects configuration dependency.
         //-------------------------------------------------------------------------
         NetworkHandler(NetworkConfig* config) : config(config) {}
 
+        //-------------------------------------------------------------------------
+        // setPowerSave()
+        // Must be called before initialize(). With a listen interval the radio
+        // uses max modem sleep and only wakes every `listenInterval` beacons.
+        //-------------------------------------------------------------------------
+        void setPowerSave(bool enable, uint8_t listenInterval) {
+            this->powerSave      = enable;
+            this->listenInterval = listenInterval;
+        }
+
+        //-------------------------------------------------------------------------
+        // setFastConnect()
+        // Skips the channel scan on the next connect() (e.g. after deep sleep).
+        //-------------------------------------------------------------------------
+        void setFastConnect(int32_t channel, const uint8_t* bssid) {
+            fastChannel = channel;
+            fastBssid   = bssid;
+        }
+
         //-------------------------------------------------------------------------
         // connect()
         // Establishes WiFi connection. Loops until the ESP32 successfully joins
         // the access point. Prints connection attempts for debugging.
         //-------------------------------------------------------------------------
         void connect() {
-            WiFi.begin(config->ssid, config->password);
+            WiFi.begin(config->ssid, config->password, fastChannel, fastBssid);
 
+            // A known AP usually associates in ~100 ms, so poll finely
+            unsigned long step = fastBssid ? 10 : 1000;
             while (WiFi.status() != WL_CONNECTED) {
-                delay(1000);
-                Serial.println("Connecting to WiFi...");
+                delay(step);
+                if (step == 1000) Serial.println("Connecting to WiFi...");
             }
 
             Serial.println("Connected to WiFi");
+            applyListenInterval();
+        }
+
+        //-------------------------------------------------------------------------
+        // applyListenInterval()
+        // The listen interval is negotiated at association time, so after the
+        // first connect it is written to the STA config and the link is
+        // re-associated once.
+        //-------------------------------------------------------------------------
+        void applyListenInterval() {
+            if (!powerSave || listenInterval == 0) return;
+
+            wifi_config_t conf;
+            if (esp_wifi_get_config(WIFI_IF_STA, &conf) != ESP_OK) return;
+            if (conf.sta.listen_interval == listenInterval) return;
+
+            conf.sta.listen_interval = listenInterval;
+            esp_wifi_set_config(WIFI_IF_STA, &conf);
+            WiFi.reconnect();
+            while (WiFi.status() != WL_CONNECTED) delay(10);
         }
 
         //-------------------------------------------------------------------------
@@ -122,12 +166,19 @@ class NetworkHandler {
 
         //-------------------------------------------------------------------------
         // initialize()
-        // Configures WiFi in station mode, disables sleep (improves MQTT stability),
-        // and enables automatic reconnection at the hardware level.
+        // Configures WiFi in station mode, disables sleep unless power save was
+        // requested (always-on improves MQTT stability), and enables automatic
+        // reconnection at the hardware level.
         //-------------------------------------------------------------------------
         void initialize() {
             WiFi.mode(WIFI_STA);            // Client mode
-            WiFi.setSleep(false);           // Prevent WiFi power saving
+            if (!powerSave) {
+                WiFi.setSleep(false);       // Prevent WiFi power saving
+            } else if (listenInterval > 0) {
+                WiFi.setSleep(WIFI_PS_MAX_MODEM); // Wake every listenInterval beacons
+            } else {
+                WiFi.setSleep(WIFI_PS_MIN_MODEM); // Wake every DTIM beacon
+            }
             WiFi.setAutoReconnect(true);    // Automatic reconnect
             WiFi.persistent(true);          // Save WiFi config to flash
         }
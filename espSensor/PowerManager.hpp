@@ -0,0 +1,227 @@
+// PowerManager.hpp
+#pragma once
+#include <Arduino.h>
+#include <WiFi.h>
+#include <esp_sleep.h>
+#include <esp_pm.h>
+#include <esp_idf_version.h>
+#include <esp_timer.h>
+#include <driver/gpio.h>
+#include <driver/rtc_io.h>
+#include "Network.hpp"
+#include "PowerProfile.hpp"
+
+//==========================================================================
+// PowerManager
+// -------------------------------------------------------------------------
+// Applies a PowerProfile on the ESP32:
+//  - Configures modem sleep / listen interval on the NetworkHandler
+//  - Caches the AP channel + BSSID in RTC memory for fast reconnects
+//  - Automatic light sleep, naps and deep sleep with wake on the reed pin
+//  - Measures wake-to-publish latency (kept in RTC memory across deep
+//    sleeps so the numbers accumulate per profile)
+//
+// Decisions come from PowerPolicy; this class only touches hardware.
+// Reed wiring follows MagneticSensor: LOW = OPEN, so while the door is
+// open we wake on HIGH and vice versa.
+//
+// Light sleep is never started by hand: esp_light_sleep_start() while
+// associated stops the radio and the AP drops the station. With the
+// LIGHT_SLEEP profile the power management driver sleeps the chip
+// whenever every task is blocked, and wakes it for each DTIM beacon (min
+// modem sleep), for timers and for the reed pin, so Wi-Fi and the MQTT
+// connection stay up. A nap only arms the reed pin and lets the loop block
+// (EspSensor::loop()).
+//==========================================================================
+class PowerManager {
+private:
+    // Survive deep sleep (defined in RTC memory below)
+    static int32_t          rtcChannel;
+    static uint8_t          rtcBssid[6];
+    static bool             rtcApValid;
+    static WakeLatencyStats rtcLatency;
+
+    PowerPolicy policy;
+    int         wakePin;     // Reed switch GPIO (must be an RTC GPIO for ext0)
+    WakeCause   cause;
+    int64_t     wakeUs;      // esp_timer time of the last wake, -1 once reported
+    bool        autoSleep;   // Automatic light sleep configured
+    bool        napping;     // Reed pin armed as a light-sleep wake source
+
+    // Lets the power management driver light-sleep the chip when idle
+    bool enableAutoLightSleep() {
+#if ESP_IDF_VERSION_MAJOR >= 5
+        esp_pm_config_t pm = {};
+#else
+        esp_pm_config_esp32_t pm = {};
+#endif
+        pm.max_freq_mhz       = getCpuFrequencyMhz();
+        pm.min_freq_mhz       = getXtalFrequencyMhz();
+        pm.light_sleep_enable = true;
+        esp_err_t err = esp_pm_configure(&pm);
+        if (err != ESP_OK) {
+            Serial.printf("Power: automatic light sleep unavailable (%d), modem sleep only\n", (int)err);
+            return false;
+        }
+        return true;
+    }
+
+public:
+    PowerManager(const PowerProfile& profile, int wakePin)
+        : policy(profile), wakePin(wakePin), cause(WakeCause::POWER_ON), wakeUs(-1),
+          autoSleep(false), napping(false) {}
+
+    PowerMode mode() const { return policy.getProfile().mode; }
+    WakeCause wakeCause() const { return cause; }
+    bool reportOnWake() const { return policy.reportOnWake(cause); }
+    const WakeLatencyStats& latency() const { return rtcLatency; }
+
+    //------------------------------------------------------------------------
+    // begin()
+    // Call before MagneticSensor::begin(): after an ext0 wake the reed pin
+    // is still routed to the RTC domain and must be released first.
+    // Determines the wake cause and starts the wake-to-publish timer.
+    // After deep sleep esp_timer restarts at boot, so the figure includes
+    // the boot and reconnect time (ROM boot before esp_timer starts is not
+    // counted).
+    //------------------------------------------------------------------------
+    void begin() {
+        switch (esp_sleep_get_wakeup_cause()) {
+            case ESP_SLEEP_WAKEUP_EXT0:  cause = WakeCause::REED_PIN; break;
+            case ESP_SLEEP_WAKEUP_TIMER: cause = WakeCause::TIMER;    break;
+            default:                     cause = WakeCause::POWER_ON; break;
+        }
+
+        if (mode() == PowerMode::DEEP_SLEEP) rtc_gpio_deinit((gpio_num_t)wakePin);
+        wakeUs = esp_timer_get_time();
+    }
+
+    //------------------------------------------------------------------------
+    // configureNetwork()
+    // Call before MqttClient::initialize(). LIGHT_SLEEP uses min modem sleep
+    // (the radio wakes for every DTIM beacon, whatever listenInterval says)
+    // with automatic light sleep in between.
+    //------------------------------------------------------------------------
+    void configureNetwork(NetworkHandler& net) {
+        const PowerProfile& p = policy.getProfile();
+        if (p.mode == PowerMode::LIGHT_SLEEP) {
+            net.setPowerSave(true, 0);
+            autoSleep = enableAutoLightSleep();
+        } else {
+            net.setPowerSave(p.mode != PowerMode::ALWAYS_ON, p.listenInterval);
+        }
+
+        if (p.mode == PowerMode::DEEP_SLEEP && rtcApValid) {
+            net.setFastConnect(rtcChannel, rtcBssid);
+        }
+    }
+
+    // Remembers the AP for the next fast reconnect
+    void onConnected() {
+        const uint8_t* bssid = WiFi.BSSID();
+        if (!bssid) return;
+        rtcChannel = WiFi.channel();
+        memcpy(rtcBssid, bssid, sizeof(rtcBssid));
+        rtcApValid = true;
+    }
+
+    // Door state changed: restart the idle timer and the latency clock
+    void onStateChange() {
+        if (wakeUs < 0) wakeUs = esp_timer_get_time();
+        policy.activity(millis());
+    }
+
+    //------------------------------------------------------------------------
+    // onPublished()
+    // Records wake-to-publish latency for the first report after a wake.
+    //------------------------------------------------------------------------
+    void onPublished() {
+        policy.activity(millis());
+        if (wakeUs < 0) return;
+
+        rtcLatency.record((uint32_t)(esp_timer_get_time() - wakeUs));
+        wakeUs = -1;
+
+        Serial.printf("Wake->publish: %u us (n=%u min=%u mean=%u max=%u)\n",
+                      rtcLatency.lastUs, rtcLatency.count,
+                      rtcLatency.minUs, rtcLatency.meanUs(), rtcLatency.maxUs);
+    }
+
+    //------------------------------------------------------------------------
+    // sleepIfIdle()
+    // Called at the end of every loop(). Returns true when the policy allows
+    // a nap: the reed pin is then armed and the caller blocks for up to
+    // napMs() (and calls endNap() once it runs again).
+    //------------------------------------------------------------------------
+    bool sleepIfIdle(bool doorOpen, bool publishPending) {
+        SleepAction action = policy.next(millis(), publishPending);
+
+        if (action == SleepAction::DEEP_SLEEP) {
+            deepSleep(doorOpen);
+        } else if (action == SleepAction::NAP) {
+            return nap(doorOpen);
+        }
+        return false;
+    }
+
+    // Milliseconds until sleepIfIdle() may sleep (UINT32_MAX = never)
+    uint32_t nextDueMs() const { return policy.msUntilIdle(millis()); }
+
+    uint32_t napMs() const { return policy.getProfile().napMs; }
+
+    //------------------------------------------------------------------------
+    // nap()
+    // Arms the reed pin (opposite level) to end a light sleep. The level
+    // wake takes over the pin's interrupt, so a CHANGE interrupt is
+    // detached until endNap(). False without automatic light sleep: there
+    // is nothing to gain from blocking then.
+    //------------------------------------------------------------------------
+    bool nap(bool doorOpen) {
+        if (!autoSleep) return false;
+        detachInterrupt(wakePin);
+        gpio_wakeup_enable((gpio_num_t)wakePin, doorOpen ? GPIO_INTR_HIGH_LEVEL : GPIO_INTR_LOW_LEVEL);
+        esp_sleep_enable_gpio_wakeup();
+        napping = true;
+        return true;
+    }
+
+    //------------------------------------------------------------------------
+    // endNap()
+    // Disarms the reed wake. Returns true if a nap was in progress: the pin
+    // interrupt must be attached again (MagneticSensor::armInterrupt()).
+    //------------------------------------------------------------------------
+    bool endNap() {
+        if (!napping) return false;
+        gpio_wakeup_disable((gpio_num_t)wakePin);
+        napping = false;
+        return true;
+    }
+
+    //------------------------------------------------------------------------
+    // deepSleep()
+    // Arms ext0 on the opposite reed level (plus the heartbeat timer) and
+    // powers down. Does not return: the next wake is a reboot.
+    //------------------------------------------------------------------------
+    void deepSleep(bool doorOpen) {
+        const PowerProfile& p = policy.getProfile();
+
+        // The digital pull-up is lost in deep sleep; use the RTC one
+        rtc_gpio_pullup_en((gpio_num_t)wakePin);
+        rtc_gpio_pulldown_dis((gpio_num_t)wakePin);
+        esp_sleep_enable_ext0_wakeup((gpio_num_t)wakePin, doorOpen ? 1 : 0);
+
+        if (p.heartbeatS > 0) {
+            esp_sleep_enable_timer_wakeup((uint64_t)p.heartbeatS * 1000000ULL);
+        }
+
+        Serial.println("Entering deep sleep");
+        Serial.flush();
+        WiFi.disconnect(true);
+        esp_deep_sleep_start();
+    }
+};
+
+RTC_DATA_ATTR int32_t          PowerManager::rtcChannel  = 0;
+RTC_DATA_ATTR uint8_t          PowerManager::rtcBssid[6] = {};
+RTC_DATA_ATTR bool             PowerManager::rtcApValid  = false;
+RTC_DATA_ATTR WakeLatencyStats PowerManager::rtcLatency  = {};
\ No newline at end of file
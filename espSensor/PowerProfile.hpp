@@ -0,0 +1,147 @@
+// PowerProfile.hpp
+#pragma once
+#include <stdint.h>
+
+//==========================================================================
+// PowerMode / PowerProfile
+// -------------------------------------------------------------------------
+// Selectable trade-offs between current draw and wake-to-publish latency:
+//
+//   ALWAYS_ON    Radio never sleeps. Lowest latency, highest draw.
+//   MODEM_SLEEP  Radio sleeps between beacons; the CPU keeps polling.
+//                listenInterval > 0 stretches the wake period (DTIM tuning).
+//   LIGHT_SLEEP  Min modem sleep (every DTIM beacon, listenInterval is not
+//                used) plus automatic light sleep while the loop is
+//                blocked; once idle, the loop naps up to napMs at a time,
+//                woken early by the reed pin. The station stays associated.
+//   DEEP_SLEEP   Everything off; ext0 wake on the reed pin (and optionally
+//                a heartbeat timer), fast reconnect, report, sleep again.
+//                For battery deployments.
+//==========================================================================
+enum class PowerMode : uint8_t {
+    ALWAYS_ON,
+    MODEM_SLEEP,
+    LIGHT_SLEEP,
+    DEEP_SLEEP
+};
+
+struct PowerProfile {
+    PowerMode mode;
+    uint8_t   listenInterval; // Beacons between radio wakes (0 = AP DTIM)
+    uint32_t  idleMs;         // Inactivity before the next nap / sleep
+    uint32_t  napMs;          // Light-sleep nap length
+    uint32_t  heartbeatS;     // Deep-sleep timer wake for a periodic report (0 = off)
+
+    static constexpr PowerProfile alwaysOn()   { return { PowerMode::ALWAYS_ON,   0,  0,    0,    0 }; }
+    static constexpr PowerProfile modemSleep() { return { PowerMode::MODEM_SLEEP, 3,  0,    0,    0 }; }
+    static constexpr PowerProfile lightSleep() { return { PowerMode::LIGHT_SLEEP, 0,  200,  300,  0 }; }
+    static constexpr PowerProfile deepSleep()  { return { PowerMode::DEEP_SLEEP,  0,  0,    0,    3600 }; }
+};
+
+//==========================================================================
+// WakeCause
+// -------------------------------------------------------------------------
+// Why the device is running, as reported by the platform (or simulated).
+//==========================================================================
+enum class WakeCause : uint8_t {
+    POWER_ON,   // Cold boot / reset
+    REED_PIN,   // Door sensor changed while sleeping
+    TIMER       // Heartbeat or nap timer expired
+};
+
+//==========================================================================
+// SleepAction
+// -------------------------------------------------------------------------
+// What PowerPolicy asks the device to do next.
+//==========================================================================
+enum class SleepAction : uint8_t {
+    STAY_AWAKE,
+    NAP,        // Light sleep for PowerProfile::napMs
+    DEEP_SLEEP  // Deep sleep until the reed pin changes (or heartbeat)
+};
+
+//==========================================================================
+// PowerPolicy
+// -------------------------------------------------------------------------
+// Platform-independent decision logic. Time is always passed in, so the
+// policy can be driven on the host by a simulated clock and wake source;
+// PowerManager applies its decisions on the ESP32.
+//==========================================================================
+class PowerPolicy {
+private:
+    PowerProfile profile;
+    uint32_t     lastActivityMs; // Last publish / state change
+
+public:
+    PowerPolicy(const PowerProfile& profile)
+        : profile(profile), lastActivityMs(0) {}
+
+    const PowerProfile& getProfile() const { return profile; }
+
+    // Marks "something happened" (state change, publish, incoming message)
+    void activity(uint32_t nowMs) { lastActivityMs = nowMs; }
+
+    //------------------------------------------------------------------------
+    // reportOnWake()
+    // Deep-sleep devices report on every wake; a timer wake is a heartbeat.
+    // Other profiles only report on change, after the initial boot report.
+    //------------------------------------------------------------------------
+    bool reportOnWake(WakeCause cause) const {
+        if (profile.mode == PowerMode::DEEP_SLEEP) return true;
+        return cause == WakeCause::POWER_ON;
+    }
+
+    //------------------------------------------------------------------------
+    // next()
+    // Decides whether to sleep now. Never sleeps with a publish pending.
+    //------------------------------------------------------------------------
+    SleepAction next(uint32_t nowMs, bool publishPending) const {
+        if (publishPending) return SleepAction::STAY_AWAKE;
+
+        switch (profile.mode) {
+            case PowerMode::LIGHT_SLEEP:
+                return (nowMs - lastActivityMs >= profile.idleMs)
+                     ? SleepAction::NAP : SleepAction::STAY_AWAKE;
+            case PowerMode::DEEP_SLEEP:
+                return (nowMs - lastActivityMs >= profile.idleMs)
+                     ? SleepAction::DEEP_SLEEP : SleepAction::STAY_AWAKE;
+            default:
+                return SleepAction::STAY_AWAKE;
+        }
+    }
+
+    //------------------------------------------------------------------------
+    // msUntilIdle()
+    // Time left before next() may ask for sleep, so an event-driven loop
+    // can wake for it; UINT32_MAX for profiles that never sleep.
+    //------------------------------------------------------------------------
+    uint32_t msUntilIdle(uint32_t nowMs) const {
+        if (profile.mode != PowerMode::LIGHT_SLEEP &&
+            profile.mode != PowerMode::DEEP_SLEEP) return UINT32_MAX;
+        uint32_t idle = nowMs - lastActivityMs;
+        return idle >= profile.idleMs ? 0 : profile.idleMs - idle;
+    }
+};
+
+//==========================================================================
+// WakeLatencyStats
+// -------------------------------------------------------------------------
+// Wake-to-publish latency summary (microseconds) per profile.
+//==========================================================================
+struct WakeLatencyStats {
+    uint32_t count;
+    uint32_t lastUs;
+    uint32_t minUs;
+    uint32_t maxUs;
+    uint64_t totalUs;
+
+    void record(uint32_t us) {
+        if (count == 0 || us < minUs) minUs = us;
+        if (us > maxUs) maxUs = us;
+        lastUs   = us;
+        totalUs += us;
+        count++;
+    }
+
+    uint32_t meanUs() const { return count ? (uint32_t)(totalUs / count) : 0; }
+};
\ No newline at end of file
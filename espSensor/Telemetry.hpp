@@ -0,0 +1,247 @@
+// Telemetry.hpp
+#pragma once
+#include <Arduino.h>
+#include <WiFi.h>
+#include "Mqtt.hpp"
+#include "EventDispatcher.hpp"
+
+//==========================================================================
+// DeviceHealth
+// -------------------------------------------------------------------------
+// Fixed-size snapshot of the counters we need for fleet capacity planning.
+// Sampled periodically by TelemetryPublisher and encoded as CBOR.
+//==========================================================================
+struct DeviceHealth {
+    uint32_t uptimeS;          // Seconds since boot
+    int32_t  rssi;             // Wi-Fi signal strength (dBm)
+    uint32_t freeHeap;         // Current free heap (bytes)
+    uint32_t minFreeHeap;      // Heap low-water mark since boot (bytes)
+    uint32_t largestBlock;     // Largest allocatable block (bytes)
+    uint32_t fragmentationPct; // 100 - largestBlock * 100 / freeHeap
+    uint32_t reconnects;       // MQTT reconnections since boot
+    uint32_t oversized;        // Messages larger than the MQTT buffer
+    uint32_t dropped;          // Oversized messages that were lost
+    uint32_t suppressed;       // No-op shadow writes not published
+    uint32_t coalesced;        // Shadow writes merged into a newer one
+    uint32_t loopAvgUs;        // Mean loop() duration over the last period
+    uint32_t loopMaxUs;        // Worst loop() duration over the last period
+    uint32_t cpuPct;           // Loop task busy share (EventDispatcher)
+    uint32_t eventLatAvgUs;    // Mean event-to-handler latency
+    uint32_t eventLatMaxUs;    // Worst event-to-handler latency
+    uint32_t wakeups;          // loop() runs over the last period
+};
+
+//==========================================================================
+// CborWriter
+// -------------------------------------------------------------------------
+// Minimal CBOR (RFC 8949) encoder writing into a caller-provided buffer.
+// It never allocates; if the buffer is too small the writer flags an
+// overflow and stops writing, so the caller can drop the sample.
+//==========================================================================
+class CborWriter {
+private:
+    uint8_t* buf;       // Output buffer (not owned)
+    size_t   capacity;  // Buffer size in bytes
+    size_t   len;       // Bytes written so far
+    bool     overflow;  // True once a write did not fit
+
+    // Writes a major type + argument using the shortest encoding
+    void writeHead(uint8_t major, uint32_t value) {
+        major <<= 5;
+        if (value < 24) {
+            put(major | value);
+        } else if (value <= 0xFF) {
+            put(major | 24);
+            put(value);
+        } else if (value <= 0xFFFF) {
+            put(major | 25);
+            put(value >> 8);
+            put(value);
+        } else {
+            put(major | 26);
+            put(value >> 24);
+            put(value >> 16);
+            put(value >> 8);
+            put(value);
+        }
+    }
+
+    void put(uint8_t b) {
+        if (len < capacity) buf[len++] = b;
+        else overflow = true;
+    }
+
+public:
+    CborWriter(uint8_t* buf, size_t capacity)
+        : buf(buf), capacity(capacity), len(0), overflow(false) {}
+
+    // Map with a known number of key/value pairs
+    void beginMap(uint32_t pairs) { writeHead(5, pairs); }
+
+    // Text string key (keys are kept short to save bytes)
+    void key(const char* k) {
+        size_t n = strlen(k);
+        writeHead(3, n);
+        for (size_t i = 0; i < n; i++) put(k[i]);
+    }
+
+    void value(uint32_t v) { writeHead(0, v); }
+
+    // Negative values use major type 1 with argument -1 - v
+    void value(int32_t v) {
+        if (v < 0) writeHead(1, (uint32_t)(-1 - v));
+        else       writeHead(0, (uint32_t)v);
+    }
+
+    size_t size() const { return len; }
+    bool   ok()   const { return !overflow; }
+};
+
+// Largest encoding of a map of `count` text keys (each shorter than 24
+// bytes) to 32-bit integers: every value at its widest, 5 bytes
+constexpr size_t cborMaxMapSize(const char* const* keys, size_t count) {
+    size_t size = count < 24 ? 1 : 2;
+    for (size_t i = 0; i < count; i++) {
+        size_t len = 0;
+        while (keys[i][len]) len++;
+        size += 1 + len + 5;
+    }
+    return size;
+}
+
+//==========================================================================
+// TelemetryPublisher
+// -------------------------------------------------------------------------
+// Samples DeviceHealth every `intervalMs` and publishes it as a CBOR map
+// on a dedicated topic, separate from the shadow. A typical sample is
+// ~115 bytes, against ~185 bytes for the same keys serialized as JSON.
+//
+// The owning device reports each loop() duration through recordLoop() so
+// the publisher can track mean/max loop latency between samples. With an
+// EventDispatcher, its CPU share, event latency and wakeup count are
+// sampled too (zero without one).
+// A null topic or a zero interval disables telemetry.
+//==========================================================================
+class TelemetryPublisher {
+public:
+    // CBOR keys, in DeviceHealth / encoding order (kept short to save bytes)
+    static constexpr const char* KEYS[] = {
+        "up", "rssi", "heap", "minh", "blk", "frag", "rc", "ovs", "drop",
+        "sup", "coal", "lavg", "lmax", "cpu", "elat", "emax", "wake"
+    };
+    static constexpr size_t FIELDS = sizeof(KEYS) / sizeof(KEYS[0]);
+
+    // Worst case encoding (163 bytes); the publish buffer is this size
+    static constexpr size_t MAX_ENCODED_SIZE = cborMaxMapSize(KEYS, FIELDS);
+
+private:
+    static const size_t BUFFER_SIZE = MAX_ENCODED_SIZE;
+
+    MqttClient*      mqtt;
+    EventDispatcher* events;
+    const char*   topic;
+    unsigned long intervalMs;
+    unsigned long lastPublish;
+
+    // Loop latency accumulators for the current period
+    uint32_t loopCount;
+    uint64_t loopTotalUs;
+    uint32_t loopMaxUs;
+
+    uint8_t buffer[BUFFER_SIZE];
+
+public:
+    TelemetryPublisher(MqttClient* mqtt, const char* topic, unsigned long intervalMs,
+                       EventDispatcher* events = nullptr)
+        : mqtt(mqtt), events(events), topic(topic), intervalMs(intervalMs), lastPublish(0),
+          loopCount(0), loopTotalUs(0), loopMaxUs(0) {}
+
+    bool enabled() const { return topic != nullptr && intervalMs > 0; }
+
+    //------------------------------------------------------------------------
+    // recordLoop(): accumulates one loop() duration in microseconds
+    //------------------------------------------------------------------------
+    void recordLoop(uint32_t us) {
+        loopCount++;
+        loopTotalUs += us;
+        if (us > loopMaxUs) loopMaxUs = us;
+    }
+
+    //------------------------------------------------------------------------
+    // sample(): fills a DeviceHealth snapshot and resets loop accumulators
+    //------------------------------------------------------------------------
+    DeviceHealth sample() {
+        DeviceHealth h;
+        h.uptimeS          = millis() / 1000;
+        h.rssi             = WiFi.RSSI();
+        h.freeHeap         = ESP.getFreeHeap();
+        h.minFreeHeap      = ESP.getMinFreeHeap();
+        h.largestBlock     = ESP.getMaxAllocHeap();
+        h.fragmentationPct = h.freeHeap ? 100 - (uint32_t)((uint64_t)h.largestBlock * 100 / h.freeHeap) : 0;
+        h.reconnects       = mqtt->getReconnectCount();
+        h.oversized        = mqtt->oversizedCount;
+        h.dropped          = mqtt->droppedCount;
+        h.suppressed       = mqtt->governor.suppressedCount;
+        h.coalesced        = mqtt->governor.coalescedCount;
+        h.loopAvgUs        = loopCount ? (uint32_t)(loopTotalUs / loopCount) : 0;
+        h.loopMaxUs        = loopMaxUs;
+
+        EventDispatcher::Stats e = events ? events->take() : EventDispatcher::Stats{};
+        h.cpuPct           = e.cpuPct;
+        h.eventLatAvgUs    = e.latAvgUs;
+        h.eventLatMaxUs    = e.latMaxUs;
+        h.wakeups          = e.wakeups;
+
+        loopCount   = 0;
+        loopTotalUs = 0;
+        loopMaxUs   = 0;
+        return h;
+    }
+
+    //------------------------------------------------------------------------
+    // encode(): writes `h` as a CBOR map into `out`.
+    // Returns the encoded size, or 0 if `out` is too small.
+    //------------------------------------------------------------------------
+    static size_t encode(const DeviceHealth& h, uint8_t* out, size_t capacity) {
+        CborWriter w(out, capacity);
+        const char* const* k = KEYS;
+        w.beginMap(FIELDS);
+        w.key(*k++); w.value(h.uptimeS);
+        w.key(*k++); w.value(h.rssi);
+        w.key(*k++); w.value(h.freeHeap);
+        w.key(*k++); w.value(h.minFreeHeap);
+        w.key(*k++); w.value(h.largestBlock);
+        w.key(*k++); w.value(h.fragmentationPct);
+        w.key(*k++); w.value(h.reconnects);
+        w.key(*k++); w.value(h.oversized);
+        w.key(*k++); w.value(h.dropped);
+        w.key(*k++); w.value(h.suppressed);
+        w.key(*k++); w.value(h.coalesced);
+        w.key(*k++); w.value(h.loopAvgUs);
+        w.key(*k++); w.value(h.loopMaxUs);
+        w.key(*k++); w.value(h.cpuPct);
+        w.key(*k++); w.value(h.eventLatAvgUs);
+        w.key(*k++); w.value(h.eventLatMaxUs);
+        w.key(*k++); w.value(h.wakeups);
+        return w.ok() ? w.size() : 0;
+    }
+
+    // Milliseconds until the next sample is due (UINT32_MAX when disabled)
+    uint32_t nextDueMs() const {
+        if (!enabled()) return UINT32_MAX;
+        unsigned long since = millis() - lastPublish;
+        return since >= intervalMs ? 0 : intervalMs - since;
+    }
+
+    //------------------------------------------------------------------------
+    // loop(): publishes a sample when the interval has elapsed
+    //------------------------------------------------------------------------
+    void loop() {
+        if (!enabled() || !mqtt->connected()) return;
+        if (millis() - lastPublish < intervalMs) return;
+        lastPublish = millis();
+
+        size_t n = encode(sample(), buffer, BUFFER_SIZE);
+        if (n > 0) mqtt->publish(topic, buffer, n);
+    }
+};
\ No newline at end of file
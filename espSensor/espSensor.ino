@@ -1,4 +1,40 @@
-#include "EspSensor.hpp"
+#include "Device.hpp"
+
+//==========================================================================
+// Compile-time device configuration
+// -------------------------------------------------------------------------
+// Every setting is constexpr; Device<> derives the shadow and telemetry
+// topics from thingName (and shadowName) at compile time. Named shadows
+// need the Lambda deployed with SHADOW_MODE=named. The transition history
+// (<thing>/journal/<clientId>) lives in the "journal" partition of
+// partitions.csv; without it the device runs with the journal disabled.
+//==========================================================================
+struct SensorConfig {
+    static constexpr int           sensorPin           = 4;                   // GPIO of the magnetic sensor
+    static constexpr char          ssid[]              = "RIVERA WIFI 2.4";   // WiFi SSID
+    static constexpr char          password[]          = "2880203CB.";        // WiFi password
+    static constexpr char          server[]            = "a1acybki981kqw-ats.iot.us-east-2.amazonaws.com"; // AWS IoT Core endpoint
+    static constexpr int           port                = 8883;                // Secure MQTT TLS port
+    static constexpr char          thingName[]         = "iot_thing";         // AWS IoT thing (shadow owner)
+    static constexpr char          shadowName[]        = "";                  // "" = classic shadow, "exteriorDoor" = per-door named shadow
+    static constexpr char          clientId[]          = "ESP_CLIENT_SENSOR"; // MQTT client ID for this device
+    static constexpr uint16_t      mqttBufferSize      = 512;                 // PubSubClient packet buffer (bytes)
+    static constexpr unsigned long telemetryIntervalMs = 60000;               // Health telemetry cadence (ms)
+
+    // Power/latency trade-off: alwaysOn(), modemSleep(), lightSleep() or deepSleep()
+    static constexpr PowerProfile  powerProfile        = PowerProfile::alwaysOn();
+
+    // Reed sampling: fixed-rate timer (0 = poll from loop()) and debounce time
+    static constexpr uint32_t      sampleHz            = 1000;                // Samples per second
+    static constexpr uint32_t      debounceMs          = 20;                  // Stable time before a change counts
+
+    // Print "@rec" input lines on Serial for host replay (tools/replay.js)
+    static constexpr bool          recordEvents        = false;
+
+    // Block in loop() until socket data, a reed change or a deadline; false
+    // restores the busy loop (compare "cpu" / "elat" in the telemetry)
+    static constexpr bool          eventLoop           = true;
+};
 
 //==========================================================================
 // Global instance of the sensor controller
@@ -6,18 +42,9 @@
 // This ESP32 acts as the *exterior door sensor device*.
 // It reads the magnetic reed switch and reports "OPEN"/"CLOSE" to AWS IoT Core
 // via the Device Shadow (reported state).
+// The instance lives in static storage, not on the heap.
 //==========================================================================
-
-EspSensor* espSensor = new EspSensor(
-    4,                                          // GPIO pin where the magnetic sensor is connected
-    "RIVERA WIFI 2.4",                          // WiFi SSID
-    "2880203CB.",                               // WiFi password
-    "a1acybki981kqw-ats.iot.us-east-2.amazonaws.com", // AWS IoT Core endpoint
-    8883,                                       // Secure MQTT TLS port
-    "ESP_CLIENT_SENSOR",                        // MQTT client ID for this device
-    "$aws/things/iot_thing/shadow/update",      // Topic used to publish Shadow "reported" updates
-    "$aws/things/iot_thing/shadow/update/delta" // Topic normally used for desired-state deltas (not used here)
-);
+Device<SensorConfig> espSensor;
 
 //==========================================================================
 // setup()
@@ -30,7 +57,7 @@ EspSensor* espSensor = new EspSensor(
 //  - Magnetic sensor initial state
 //==========================================================================
 void setup() {
-    espSensor->setup();
+    espSensor.setup();
 }
 
 //==========================================================================
@@ -42,5 +69,5 @@ void setup() {
 //  - Publishes new "reported" state to AWS IoT Shadow when needed
 //==========================================================================
 void loop() {
-    espSensor->loop();
+    espSensor.loop();
 }
\ No newline at end of file
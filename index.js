@@ -1,127 +1,657 @@
-// Main Alexa SDK and AWS SDK imports
-const Alexa = require('ask-sdk-core');
-const AWS   = require('aws-sdk');
+// Main Alexa SDK import. The AWS SDK v3 clients (@aws-sdk/*, bundled with the
+// Node.js 18+ Lambda runtimes) are required on first use, see "AWS CLIENTS".
+const Alexa  = require('ask-sdk-core');
+const http   = require('http');
+const https  = require('https');
+const crypto = require('crypto');
+const log    = require('./logger');
 
 // ---------- AWS IoT and DynamoDB configuration ----------
-const IotData = new AWS.IotData({
-    // AWS IoT endpoint for this account / region
-    endpoint: 'a1acybki981kqw-ats.iot.us-east-2.amazonaws.com'
-});
-
-// DynamoDB client used to map Alexa user → IoT thing
-const dynamodb   = new AWS.DynamoDB.DocumentClient();
+// AWS IoT endpoint for this account / region.
+// IOT_ENDPOINT overrides it, e.g. http://localhost:8080 for tools/shadow-emulator.js
+const IOT_ENDPOINT = process.env.IOT_ENDPOINT || 'a1acybki981kqw-ats.iot.us-east-2.amazonaws.com';
+
+// Open the connections to IoT / DynamoDB while the container initialises
+// (default: only when running on Lambda)
+const PREWARM = (process.env.PREWARM || (process.env.AWS_LAMBDA_FUNCTION_NAME ? 'true' : 'false')) === 'true';
+
+// HTTP keep-alive for the SDK clients (HTTP_KEEP_ALIVE=false only for benchmarks)
+const HTTP_KEEP_ALIVE = process.env.HTTP_KEEP_ALIVE !== 'false';
+
+// Shadow layout, must match the firmwares' Config::shadowName:
+//  - 'classic': both doors share the thing's classic shadow
+//  - 'named':   one named shadow per door ("interiorDoor", "exteriorDoor"),
+//               so reads and updates only carry that door's document
+const SHADOW_MODE = process.env.SHADOW_MODE === 'named' ? 'named' : 'classic';
+
+// Confirmed actuation: Open/Close intents wait (up to CONFIRM_BUDGET_MS from
+// the start of the handler, well inside Alexa's 8 s deadline) until the
+// actuator reports the requested state. Notifications arrive over MQTT
+// (WebSocket + SigV4 to IOT_ENDPOINT, or IOT_MQTT_URL for a local broker).
+const CONFIRM_ACTUATION = process.env.CONFIRM_ACTUATION === 'true';
+const CONFIRM_BUDGET_MS = Number(process.env.CONFIRM_BUDGET_MS || 6000);
+
+// Created on first use and kept across warm invocations
+let shadowWatch = null;
+
+// DynamoDB table used to map Alexa user → IoT thing(s)
+// (DYNAMODB_ENDPOINT points the client at a local stand-in such as tools/shadow-emulator.js)
 const TABLE_NAME = 'user_thing';
 
+// Optional per-thing metadata for the home status: spoken alias and doors
+// ({ thing_name, alias, doors: ["interiorDoor", "exteriorDoor"] })
+const THING_INFO_TABLE = process.env.THING_INFO_TABLE || 'thing_info';
+const DOORS            = ['interiorDoor', 'exteriorDoor'];
+const BATCH_GET_MAX    = 100;   // DynamoDB BatchGetItem limit
+
+// Shadow GETs in flight at once for the home status
+const SHADOW_FETCH_CONCURRENCY = Number(process.env.SHADOW_FETCH_CONCURRENCY || 8);
+
+// Warm-invocation caches (module scope survives between invocations of the
+// same Lambda container). A TTL of 0 disables a cache.
+const THING_CACHE_TTL_MS  = Number(process.env.THING_CACHE_TTL_MS  || 300000);
+const THING_CACHE_SIZE    = Number(process.env.THING_CACHE_SIZE    || 1000);
+const SHADOW_CACHE_TTL_MS = Number(process.env.SHADOW_CACHE_TTL_MS || 2000);
+// Defaults cached after a failed thing_info read, so a throttled or missing
+// table is not queried again on every invocation
+const THING_INFO_RETRY_MS = Number(process.env.THING_INFO_RETRY_MS || 30000);
+
+// ================== AWS CLIENTS ==================
+
+// One agent per protocol shared by every client, so the TCP/TLS connection
+// set up by the first call (or by prewarm()) is reused for the rest of the
+// container's life instead of being negotiated again on every call.
+const agents = {
+    httpAgent:  new http.Agent({ keepAlive: HTTP_KEEP_ALIVE, maxSockets: 50 }),
+    httpsAgent: new https.Agent({ keepAlive: HTTP_KEEP_ALIVE, maxSockets: 50 })
+};
+
+const withScheme = (endpoint) => (endpoint.includes('://') ? endpoint : `https://${endpoint}`);
+
+// "<id>-ats.iot.<region>.amazonaws.com" → region
+const regionOf = (endpoint) => (/\.iot\.([a-z0-9-]+)\.amazonaws\.com/.exec(endpoint) || [])[1];
+
+// Created on first use and kept across warm invocations
+const clients = { iot: null, ddb: null };
+
+/**
+ * IoT data plane client and its command classes: { sdk, client }.
+ */
+function iotData() {
+    if (!clients.iot) {
+        const sdk = require('@aws-sdk/client-iot-data-plane');
+        clients.iot = {
+            sdk,
+            client: new sdk.IoTDataPlaneClient({
+                endpoint:       withScheme(IOT_ENDPOINT),
+                region:         regionOf(IOT_ENDPOINT) || process.env.AWS_REGION,
+                requestHandler: { ...agents, connectionTimeout: 2000 }
+            })
+        };
+    }
+    return clients.iot;
+}
+
+/**
+ * DynamoDB document client and its command classes: { sdk, client }.
+ */
+function documentClient() {
+    if (!clients.ddb) {
+        const { DynamoDBClient } = require('@aws-sdk/client-dynamodb');
+        const sdk = require('@aws-sdk/lib-dynamodb');
+        const options = { requestHandler: { ...agents, connectionTimeout: 2000 } };
+        if (process.env.DYNAMODB_ENDPOINT) options.endpoint = process.env.DYNAMODB_ENDPOINT;
+        clients.ddb = { sdk, client: sdk.DynamoDBDocumentClient.from(new DynamoDBClient(options)) };
+    }
+    return clients.ddb;
+}
+
+/**
+ * Builds both clients and opens one pooled connection to each endpoint, so
+ * the first invocation does not pay the TLS handshake. Runs in the init
+ * phase; the unauthenticated GET / only serves to leave a live socket in
+ * the agent's pool, its status and body are discarded.
+ */
+function prewarm() {
+    const t0 = Date.now();
+    const endpoints = [
+        withScheme(IOT_ENDPOINT),
+        process.env.DYNAMODB_ENDPOINT || `https://dynamodb.${process.env.AWS_REGION || 'us-east-1'}.amazonaws.com`
+    ];
+    iotData();
+    documentClient();
+
+    for (const endpoint of endpoints) {
+        const url = new URL(endpoint);
+        const lib = url.protocol === 'http:' ? http : https;
+        const req = lib.request({
+            host:   url.hostname,
+            port:   url.port || undefined,
+            method: 'GET',
+            path:   '/',
+            agent:  url.protocol === 'http:' ? agents.httpAgent : agents.httpsAgent
+        }, (res) => {
+            res.resume();
+            log.info('prewarm', { host: url.host, status: res.statusCode, elapsedMs: Date.now() - t0 });
+        });
+        req.on('error', (err) => log.warn('prewarm falló', { host: url.host, err }));
+        req.end();
+    }
+}
+
+if (PREWARM) prewarm();
+
+// ================== CACHES ==================
+
+/**
+ * LRU cache with a per-entry TTL. A Map iterates in insertion order, so
+ * re-inserting an entry on every hit keeps the least recently used one
+ * first, which is the one evicted when the cache is full.
+ */
+class LruCache {
+    constructor(name, maxEntries, ttlMs) {
+        this.name       = name;
+        this.maxEntries = maxEntries;
+        this.ttlMs      = ttlMs;
+        this.map        = new Map();
+        this.hits       = 0;
+        this.misses     = 0;
+    }
+
+    get(key) {
+        const entry = this.map.get(key);
+        if (!entry || entry.expires <= Date.now()) {
+            if (entry) this.map.delete(key);
+            this.misses++;
+            return undefined;
+        }
+        this.map.delete(key);
+        this.map.set(key, entry);
+        this.hits++;
+        return entry.value;
+    }
+
+    // Lookup without touching statistics or recency
+    peek(key) {
+        const entry = this.map.get(key);
+        return entry && entry.expires > Date.now() ? entry.value : undefined;
+    }
+
+    set(key, value, ttlMs = this.ttlMs) {
+        if (!(ttlMs > 0)) return;
+        this.map.delete(key);
+        this.map.set(key, { value, expires: Date.now() + ttlMs });
+        if (this.map.size > this.maxEntries) this.map.delete(this.map.keys().next().value);
+    }
+
+    delete(key) {
+        this.map.delete(key);
+    }
+
+    stats() {
+        const lookups = this.hits + this.misses;
+        return {
+            name:    this.name,
+            size:    this.map.size,
+            hits:    this.hits,
+            misses:  this.misses,
+            hitRate: lookups ? +(this.hits / lookups).toFixed(3) : 0
+        };
+    }
+}
+
+// userId → { thingName, things }
+const thingCache = new LruCache('thing', THING_CACHE_SIZE, THING_CACHE_TTL_MS);
+
+// thing name → { alias, doors }
+const thingInfoCache = new LruCache('thingInfo', THING_CACHE_SIZE, THING_CACHE_TTL_MS);
+
+// shadow key → { state, version }. Entries are dropped when we update the
+// shadow ourselves, and shadowVersionFloor remembers the version our update
+// produced so an older document is never cached afterwards.
+const shadowCache        = new LruCache('shadow', THING_CACHE_SIZE, SHADOW_CACHE_TTL_MS);
+const shadowVersionFloor = new LruCache('shadowVersionFloor', THING_CACHE_SIZE, THING_CACHE_TTL_MS);
+
+const shadowCacheKey = (params) => `${params.thingName}/${params.shadowName || ''}`;
+
+// Logs the hit rates every CACHE_LOG_EVERY lookups
+const CACHE_LOG_EVERY = 100;
+function logCacheStats(cache) {
+    if ((cache.hits + cache.misses) % CACHE_LOG_EVERY === 0) {
+        log.info('cache', cache.stats());
+    }
+}
+
 // ================== HELPERS ==================
 
 /**
- * Resolve the IoT thing name associated with the current Alexa user.
+ * IoT data plane parameters addressing the shadow that holds `door`:
+ * the classic shadow, or the door's named shadow in 'named' mode.
+ */
+function shadowParams(thingName, door) {
+    return SHADOW_MODE === 'named' ? { thingName, shadowName: door } : { thingName };
+}
+
+/**
+ * Resolve the IoT things associated with the current Alexa user.
  * 1. Reads the Alexa userId from the request.
- * 2. Queries DynamoDB table `user_thing` using user_id as partition key.
- * 3. If a mapping exists, returns the stored thing_name.
- * 4. If not, falls back to the default thing "iot_thing".
+ * 2. Returns the mapping from thingCache when present (warm invocations).
+ * 3. Otherwise queries DynamoDB table `user_thing` using user_id as partition key.
+ * 4. If a mapping exists, returns (and caches) { thingName, things }:
+ *    thing_name is the thing door commands go to, the optional thing_names
+ *    list (or string set) every thing of the user (house, garage, ...).
+ * 5. If not, falls back to the default thing "iot_thing".
  */
-async function getThingName(handlerInput) {
+async function getUserThings(handlerInput) {
     const userId = handlerInput.requestEnvelope.session.user.userId;
 
-    console.log("=== USER ID DE ALEXA (getThingName) ===");
-    console.log(userId);
-    console.log("=======================================");
+    const cached = thingCache.get(userId);
+    logCacheStats(thingCache);
+    if (cached) {
+        log.debug('things en caché', { things: cached.things });
+        return cached;
+    }
 
     const params = {
         TableName: TABLE_NAME,
         Key: { user_id: userId }
     };
 
-    console.log('Buscando thing para user:', userId);
-
+    const done = log.timer('dynamodb.get');
     try {
-        const data = await dynamodb.get(params).promise();
-        if (data.Item && data.Item.thing_name) {
-            console.log('Thing encontrado:', data.Item.thing_name);
-            return data.Item.thing_name;
+        const { sdk, client } = documentClient();
+        const data = await client.send(new sdk.GetCommand(params));
+        done();
+        const item = data.Item || {};
+        const listed = Array.from(item.thing_names || []);
+        if (item.thing_name || listed.length) {
+            const thingName = item.thing_name || listed[0];
+            const mapping   = { thingName, things: [...new Set([thingName, ...listed])] };
+            log.debug('things encontrados', { things: mapping.things });
+            thingCache.set(userId, mapping);
+            return mapping;
         } else {
             // Fallback when no explicit mapping is found for the user
-            console.log('No se encontró thing para este usuario, usando por defecto iot_thing');
-            return 'iot_thing';          // <- must match the actual IoT thing name
+            // The userId is what has to go into user_thing to map this user;
+            // only its hash is logged, to be matched against userHash() of
+            // the candidate ids
+            log.warn('usuario sin thing, se usa iot_thing', { user: log.userHash(userId) });
+            const mapping = { thingName: 'iot_thing', things: ['iot_thing'] };   // <- must match the actual IoT thing name
+            thingCache.set(userId, mapping);
+            return mapping;
         }
     } catch (err) {
         // On read error we still fall back to the default thing
-        console.log('Error leyendo de DynamoDB:', err);
-        return 'iot_thing';
+        done();
+        log.error('error leyendo user_thing de DynamoDB', { err });
+        return { thingName: 'iot_thing', things: ['iot_thing'] };
     }
 }
 
 /**
- * Retrieve the full AWS IoT Device Shadow for the given thing.
- * Logs both the raw shadow and the state subsection for debugging.
- * Returns `payload.state` (object with desired/reported sections) or null on error.
+ * The thing that door commands and single-door queries address
+ * (thing_name of the user's mapping, see getUserThings()).
  */
-async function getShadow(thingName) {
-    const params = { thingName };
+async function getThingName(handlerInput) {
+    return (await getUserThings(handlerInput)).thingName;
+}
 
-    console.log('Obteniendo shadow para thing:', thingName);
+/**
+ * Runs `fn` over `items` with at most `limit` calls in flight.
+ * Results keep the order of `items`.
+ */
+async function mapLimit(items, limit, fn) {
+    const results = new Array(items.length);
+    let next = 0;
+    const worker = async () => {
+        while (next < items.length) {
+            const i = next++;
+            results[i] = await fn(items[i], i);
+        }
+    };
+    await Promise.all(Array.from({ length: Math.max(1, Math.min(limit, items.length)) }, worker));
+    return results;
+}
 
-    try {
-        const data       = await IotData.getThingShadow(params).promise();
-        const payloadStr = data.payload.toString();
-        const payload    = JSON.parse(payloadStr);
+/**
+ * Metadata of each thing from THING_INFO_TABLE, read with BatchGetItem
+ * (chunks of 100 keys, in parallel) for the things not in thingInfoCache.
+ * Things without an item are named after the thing and have both doors.
+ * When the read fails those defaults are cached for THING_INFO_RETRY_MS only.
+ * Returns Map(thing name → { alias, doors }).
+ */
+async function getThingInfo(things) {
+    const info    = new Map();
+    const missing = [];
+    for (const thing of things) {
+        const cached = thingInfoCache.get(thing);
+        if (cached) info.set(thing, cached);
+        else missing.push(thing);
+    }
 
-        console.log("===== SHADOW COMPLETO =====");
-        console.log(JSON.stringify(payload, null, 2));
-        console.log("===== SOLO STATE =====");
-        console.log(JSON.stringify(payload.state, null, 2));
+    const chunks = [];
+    for (let i = 0; i < missing.length; i += BATCH_GET_MAX) chunks.push(missing.slice(i, i + BATCH_GET_MAX));
+
+    await mapLimit(chunks, SHADOW_FETCH_CONCURRENCY, async (chunk) => {
+        const { sdk, client } = documentClient();
+        let request = { [THING_INFO_TABLE]: { Keys: chunk.map((thing) => ({ thing_name: thing })) } };
+        const done  = log.timer('dynamodb.batchGet');
+        let failed  = false;
+        try {
+            // Keys left unprocessed (throttling) get one more attempt
+            for (let attempt = 0; attempt < 2 && request; attempt++) {
+                const data = await client.send(new sdk.BatchGetCommand({ RequestItems: request }));
+                for (const item of (data.Responses || {})[THING_INFO_TABLE] || []) {
+                    info.set(item.thing_name, {
+                        alias: item.alias || item.thing_name,
+                        doors: item.doors ? Array.from(item.doors) : DOORS
+                    });
+                }
+                request = data.UnprocessedKeys && Object.keys(data.UnprocessedKeys).length ? data.UnprocessedKeys : null;
+            }
+        } catch (err) {
+            log.error('error leyendo thing_info de DynamoDB', { err });
+            failed = true;
+        }
+        // Without an item the defaults below are final, cache them too; if
+        // the read failed or left keys unprocessed, only until the retry
+        const ttlMs   = failed || request ? THING_INFO_RETRY_MS : THING_CACHE_TTL_MS;
+        for (const thing of chunk) {
+            if (info.has(thing)) thingInfoCache.set(thing, info.get(thing));
+            else thingInfoCache.set(thing, { alias: thing, doors: DOORS }, ttlMs);
+        }
+        done();
+    });
 
-        if (payload.state) {
-            const desired  = payload.state.desired  || {};
-            const reported = payload.state.reported || {};
+    for (const thing of things) {
+        if (!info.has(thing)) info.set(thing, { alias: thing, doors: DOORS });
+    }
+    return info;
+}
 
-            console.log(">>> ESTADOS DE PUERTAS (DESIRED) <<<");
-            console.log("interiorDoor (desired):",  desired.interiorDoor);
-            console.log("exteriorDoor (desired):",  desired.exteriorDoor);
+/**
+ * Retrieve the AWS IoT Device Shadow that holds `door` for the given thing
+ * (the whole classic shadow, or only that door's named shadow).
+ * Served from shadowCache for SHADOW_CACHE_TTL_MS after a read.
+ * Logs the payload size and parse time, and the whole document at debug level.
+ * Returns `payload.state` (object with desired/reported sections) or null on error.
+ */
+async function getShadow(thingName, door) {
+    const params = shadowParams(thingName, door);
+    const key    = shadowCacheKey(params);
+
+    const cached = shadowCache.get(key);
+    logCacheStats(shadowCache);
+    if (cached) {
+        log.debug('shadow en caché', { shadow: key, version: cached.version });
+        return cached.state;
+    }
 
-            console.log(">>> ESTADOS DE PUERTAS (REPORTED) <<<");
-            console.log("interiorDoor (reported):", reported.interiorDoor);
-            console.log("exteriorDoor (reported):", reported.exteriorDoor);
+    const done = log.timer('shadow.get');
+    try {
+        const { sdk, client } = iotData();
+        const data       = await client.send(new sdk.GetThingShadowCommand(params));
+        const payloadStr = Buffer.from(data.payload).toString();
+        const parseStart = process.hrtime.bigint();
+        const payload    = JSON.parse(payloadStr);
+        done();
+
+        log.debug('shadow', {
+            shadow:  key,
+            version: payload.version,
+            bytes:   Buffer.byteLength(payloadStr),
+            parseUs: Number(process.hrtime.bigint() - parseStart) / 1000,
+            state:   payload.state
+        });
+
+        if (payload.version >= (shadowVersionFloor.peek(key) || 0)) {
+            shadowCache.set(key, { state: payload.state, version: payload.version });
         }
-
-        console.log("=====================================");
-
         return payload.state;
     } catch (err) {
         // Any failure while reading / parsing the shadow is logged and null is returned
-        console.log('Error al obtener el shadow:', err);
+        done();
+        log.error('error al obtener el shadow', { shadow: key, err });
         return null;
     }
 }
 
+/**
+ * MQTT topic prefix of the shadow that holds `door` (see shadowParams()).
+ */
+function shadowTopicPrefix(thingName, door) {
+    return SHADOW_MODE === 'named'
+        ? `$aws/things/${thingName}/shadow/name/${door}`
+        : `$aws/things/${thingName}/shadow`;
+}
+
+/**
+ * Emit CloudWatch metrics through the Embedded Metric Format: one
+ * structured log line, no API call on the request path.
+ * `metrics` maps name → [value, unit]; `properties` are extra searchable fields.
+ */
+function putMetrics(intentName, metrics, properties = {}) {
+    const values = {};
+    for (const [name, [value]] of Object.entries(metrics)) values[name] = value;
+
+    console.log(JSON.stringify({
+        _aws: {
+            Timestamp: Date.now(),
+            CloudWatchMetrics: [{
+                Namespace:  'AlexaIotDoor',
+                Dimensions: [['Intent']],
+                Metrics:    Object.entries(metrics).map(([name, [, unit]]) => ({ Name: name, Unit: unit }))
+            }]
+        },
+        Intent: intentName,
+        ...properties,
+        ...values
+    }));
+}
+
+/**
+ * Start a command trace for the current request: when Alexa issued it
+ * (request.timestamp) and when this handler started, both in epoch ms.
+ */
+function startTrace(handlerInput) {
+    const issued = Date.parse(handlerInput.requestEnvelope.request.timestamp);
+    return { alexa: Number.isNaN(issued) ? null : issued, start: Date.now() };
+}
+
 /**
  * Update the desired state of `interiorDoor` in the thing's shadow.
  * `newState` is typically "OPEN" or "CLOSE".
  * This does not wait for the device to actually move; it only updates the shadow.
+ *
+ * The update carries a clientToken "<id>:<send epoch ms>" that AWS IoT copies
+ * into the delta and the actuator echoes back (see espActuator/Tracer.hpp).
+ * A `TRACE {...}` log line records the Lambda side of the hop for
+ * tools/trace-collector.js.
  */
-async function setInteriorDoorDesired(thingName, newState) {
+async function setInteriorDoorDesired(thingName, newState, trace) {
+    const sent  = Date.now();
+    const token = `${crypto.randomBytes(4).toString('hex')}:${sent}`;
+
     const payload = {
         state: {
             desired: {
                 interiorDoor: newState
             }
-        }
+        },
+        clientToken: token
     };
 
-    console.log("Actualizando shadow de", thingName, "a:", newState);
-
     const params = {
-        thingName,
-        payload: JSON.stringify(payload)
+        ...shadowParams(thingName, 'interiorDoor'),
+        payload: Buffer.from(JSON.stringify(payload))
     };
 
+    // Whatever we cached for this shadow is stale from now on
+    const key = shadowCacheKey(params);
+    shadowCache.delete(key);
+
+    let ok = false;
+    const done = log.timer('shadow.update');
     try {
-        const data = await IotData.updateThingShadow(params).promise();
-        console.log("updateThingShadow OK:", data);
+        const { sdk, client } = iotData();
+        const data = await client.send(new sdk.UpdateThingShadowCommand(params));
+        ok = true;
+
+        const accepted = JSON.parse(Buffer.from(data.payload).toString());
+        if (accepted.version) shadowVersionFloor.set(key, accepted.version);
     } catch (err) {
-        console.log("Error en updateThingShadow:", err);
+        log.error('error en updateThingShadow', { shadow: key, err });
     }
+    done();
+
+    // Trace record for tools/trace-collector.js (always at info level)
+    log.info('trace', {
+        hop:   'lambda',
+        token,
+        thing: thingName,
+        value: newState,
+        alexa: trace ? trace.alexa : null,
+        start: trace ? trace.start : null,
+        sent,
+        ack:   Date.now(),
+        ok
+    });
+
+    return ok;
+}
+
+/**
+ * Confirmed variant of setInteriorDoorDesired(): subscribes to the shadow's
+ * update/documents topic, updates desired, then waits until a document shows
+ * reported.interiorDoor === desired.interiorDoor === newState, or until the
+ * budget runs out. Records wait time and outcome as metrics.
+ * Returns 'confirmed', 'timeout', 'error' (update failed) or 'unavailable'
+ * (no notification channel; the update was still sent).
+ */
+async function setInteriorDoorConfirmed(thingName, newState, trace, intentName) {
+    const topic    = `${shadowTopicPrefix(thingName, 'interiorDoor')}/update/documents`;
+    const deadline = trace.start + CONFIRM_BUDGET_MS;
+
+    try {
+        if (!shadowWatch) {
+            const { ShadowWatch } = require('./shadowWatch');
+            shadowWatch = process.env.IOT_MQTT_URL
+                ? new ShadowWatch({ url: process.env.IOT_MQTT_URL })
+                : new ShadowWatch({
+                    endpoint: IOT_ENDPOINT.replace(/^https?:\/\//, ''),
+                    region:   regionOf(IOT_ENDPOINT) || process.env.AWS_REGION
+                });
+        }
+        await shadowWatch.subscribe(topic);
+    } catch (err) {
+        log.warn('sin notificaciones del shadow, se envía sin confirmar', { err });
+        await setInteriorDoorDesired(thingName, newState, trace);
+        putMetrics(intentName, { ConfirmUnavailable: [1, 'Count'] }, { Outcome: 'unavailable' });
+        return 'unavailable';
+    }
+
+    // Registered before the update so the confirming document cannot be missed
+    const matches = (doc) => {
+        const state = (doc.current && doc.current.state) || {};
+        return (state.desired  || {}).interiorDoor === newState
+            && (state.reported || {}).interiorDoor === newState;
+    };
+    const confirmation = shadowWatch.waitFor(topic, matches, deadline);
+
+    const waitStart = Date.now();
+    if (!await setInteriorDoorDesired(thingName, newState, trace)) {
+        confirmation.cancel();
+        shadowWatch.unsubscribe(topic);
+        putMetrics(intentName, { ConfirmSuccess: [0, 'Count'] }, { Outcome: 'error' });
+        return 'error';
+    }
+
+    const doc     = await confirmation;
+    const waited  = Date.now() - waitStart;
+    shadowWatch.unsubscribe(topic);   // Not awaited: the UNSUBACK is not worth the latency
+    const outcome = doc ? 'confirmed' : 'timeout';
+    log.annotate({ confirm: outcome, confirmWaitMs: waited });
+
+    putMetrics(intentName, {
+        ConfirmWaitMs:  [waited, 'Milliseconds'],
+        ConfirmSuccess: [doc ? 1 : 0, 'Count'],
+        ConfirmTimeout: [doc ? 0 : 1, 'Count']
+    }, { Outcome: outcome });
+    return outcome;
+}
+
+/**
+ * Speech for a door command, according to the confirmation outcome
+ * (undefined when confirmed actuation is off).
+ */
+function commandSpeech(outcome, verb, adjective) {
+    switch (outcome) {
+        case 'confirmed':
+            return `Listo, la puerta interior está ${adjective}.`;
+        case 'timeout':
+            return `Solicité ${verb} la puerta interior, pero el dispositivo no confirmó a tiempo.`;
+        case 'error':
+            return `No pude enviar la orden de ${verb} la puerta interior. Intenta de nuevo.`;
+        default:
+            return `Solicitaste ${verb} la puerta interior.`;
+    }
+}
+
+const DOOR_NAMES = { interiorDoor: 'puerta interior', exteriorDoor: 'puerta exterior' };
+
+/**
+ * State of every door of every thing of the user. Reads one shadow per
+ * door ('named') or per thing ('classic'), at most SHADOW_FETCH_CONCURRENCY
+ * at a time. Returns [{ thing, alias, doors: [{ door, value }] }] where
+ * value is the reported (else desired) state, undefined if the shadow has
+ * none and null if the shadow could not be read.
+ */
+async function getHomeStatus(handlerInput) {
+    const { things } = await getUserThings(handlerInput);
+    const info = await getThingInfo(things);
+
+    const reads = new Map();   // shadow key → { thing, door }
+    for (const thing of things) {
+        for (const door of info.get(thing).doors) {
+            const key = shadowCacheKey(shadowParams(thing, door));
+            if (!reads.has(key)) reads.set(key, { thing, door });
+        }
+    }
+
+    const fetched = await mapLimit([...reads.values()], SHADOW_FETCH_CONCURRENCY,
+                                   ({ thing, door }) => getShadow(thing, door));
+    const states  = new Map([...reads.keys()].map((key, i) => [key, fetched[i]]));
+    const stateOf = (thing, door) => states.get(shadowCacheKey(shadowParams(thing, door)));
+
+    return things.map((thing) => ({
+        thing,
+        alias: info.get(thing).alias,
+        doors: info.get(thing).doors.map((door) => {
+            const state = stateOf(thing, door);
+            if (!state) return { door, value: null };
+            return { door, value: (state.reported || {})[door] || (state.desired || {})[door] };
+        })
+    }));
+}
+
+/**
+ * Speech for getHomeStatus(): one sentence per thing, prefixed with its
+ * alias when the user has more than one.
+ */
+function homeStatusSpeech(status) {
+    const phrase = ({ door, value }) => {
+        const name = DOOR_NAMES[door] || door;
+        if (value === null)                          return `no pude leer la ${name}`;
+        if (value === 'OPEN')                        return `la ${name} está abierta`;
+        if (value === 'CLOSE' || value === 'CLOSED') return `la ${name} está cerrada`;
+        return `la ${name} tiene un estado desconocido`;
+    };
+    const capitalize = (text) => text.charAt(0).toUpperCase() + text.slice(1);
+
+    return status.map(({ alias, doors }) => {
+        const text = doors.length ? doors.map(phrase).join(' y ') : 'no hay puertas configuradas';
+        return status.length > 1 ? `En ${alias}, ${text}.` : `${capitalize(text)}.`;
+    }).join(' ');
 }
 
 // ================== HANDLERS ==================
@@ -132,10 +662,6 @@ const LaunchRequestHandler = {
         return Alexa.getRequestType(handlerInput.requestEnvelope) === 'LaunchRequest';
     },
     handle(handlerInput) {
-        console.log("=== USER ID DE ALEXA (LaunchRequest) ===");
-        console.log(handlerInput.requestEnvelope.session.user.userId);
-        console.log("========================================");
-
         const speakOutput =
           'Bienvenido a tu objeto inteligente. ' +
           'Puedes abrir la puerta interior, cerrarla o consultar su estado. ¿Qué deseas hacer?';
@@ -154,14 +680,17 @@ const OpenInteriorDoorIntentHandler = {
             && Alexa.getIntentName(handlerInput.requestEnvelope) === 'OpenInteriorDoorIntent';
     },
     async handle(handlerInput) {
-        console.log("=== USER ID DE ALEXA (OpenInteriorDoorIntent) ===");
-        console.log(handlerInput.requestEnvelope.session.user.userId);
-        console.log("=================================================");
-
+        const trace     = startTrace(handlerInput);
         const thingName = await getThingName(handlerInput);
-        await setInteriorDoorDesired(thingName, "OPEN");
 
-        const speakOutput = 'Solicitaste abrir la puerta interior.';
+        let outcome;
+        if (CONFIRM_ACTUATION) {
+            outcome = await setInteriorDoorConfirmed(thingName, "OPEN", trace, 'OpenInteriorDoorIntent');
+        } else {
+            await setInteriorDoorDesired(thingName, "OPEN", trace);
+        }
+
+        const speakOutput = commandSpeech(outcome, 'abrir', 'abierta');
 
         return handlerInput.responseBuilder
             .speak(speakOutput)
@@ -177,14 +706,17 @@ const CloseInteriorDoorIntentHandler = {
             && Alexa.getIntentName(handlerInput.requestEnvelope) === 'CloseInteriorDoorIntent';
     },
     async handle(handlerInput) {
-        console.log("=== USER ID DE ALEXA (CloseInteriorDoorIntent) ===");
-        console.log(handlerInput.requestEnvelope.session.user.userId);
-        console.log("==================================================");
-
+        const trace     = startTrace(handlerInput);
         const thingName = await getThingName(handlerInput);
-        await setInteriorDoorDesired(thingName, "CLOSE");
 
-        const speakOutput = 'Solicitaste cerrar la puerta interior.';
+        let outcome;
+        if (CONFIRM_ACTUATION) {
+            outcome = await setInteriorDoorConfirmed(thingName, "CLOSE", trace, 'CloseInteriorDoorIntent');
+        } else {
+            await setInteriorDoorDesired(thingName, "CLOSE", trace);
+        }
+
+        const speakOutput = commandSpeech(outcome, 'cerrar', 'cerrada');
 
         return handlerInput.responseBuilder
             .speak(speakOutput)
@@ -200,12 +732,8 @@ const StateInteriorDoorHandler = {
             && Alexa.getIntentName(handlerInput.requestEnvelope) === 'StateInteriorDoorIntent';
     },
     async handle(handlerInput) {
-        console.log("=== USER ID DE ALEXA (StateInteriorDoorIntent) ===");
-        console.log(handlerInput.requestEnvelope.session.user.userId);
-        console.log("==================================================");
-
         const thingName   = await getThingName(handlerInput);
-        const shadowState = await getShadow(thingName);
+        const shadowState = await getShadow(thingName, 'interiorDoor');
 
         // Default error message if we cannot read the shadow
         let speakOutput = 'No pude obtener el estado de la puerta interior. Intenta de nuevo más tarde.';
@@ -216,7 +744,7 @@ const StateInteriorDoorHandler = {
             // Prefer reported; if not present fall back to desired
             const value = reported.interiorDoor || desired.interiorDoor;
 
-            console.log('Estado interiorDoor desde shadow:', value);
+            log.annotate({ interiorDoor: value });
 
             if (value === 'OPEN') {
                 speakOutput = 'La puerta interior está abierta.';
@@ -241,12 +769,8 @@ const StateExteriorDoorHandler = {
             && Alexa.getIntentName(handlerInput.requestEnvelope) === 'StateExteriorDoorIntent';
     },
     async handle(handlerInput) {
-        console.log("=== USER ID DE ALEXA (StateExteriorDoorIntent) ===");
-        console.log(handlerInput.requestEnvelope.session.user.userId);
-        console.log("==================================================");
-
         const thingName   = await getThingName(handlerInput);
-        const shadowState = await getShadow(thingName);
+        const shadowState = await getShadow(thingName, 'exteriorDoor');
 
         // Default error message if we cannot read the shadow
         let speakOutput = 'No pude obtener el estado de la puerta exterior. Intenta de nuevo más tarde.';
@@ -257,7 +781,7 @@ const StateExteriorDoorHandler = {
             // Prefer reported; if not present fall back to desired
             const value = reported.exteriorDoor || desired.exteriorDoor;
 
-            console.log('Estado exteriorDoor desde shadow:', value);
+            log.annotate({ exteriorDoor: value });
 
             if (value === 'OPEN') {
                 speakOutput = 'La puerta exterior está abierta.';
@@ -275,6 +799,41 @@ const StateExteriorDoorHandler = {
     }
 };
 
+// Handles "estado de la casa": every door of every thing of the user in one answer
+const HomeStatusIntentHandler = {
+    canHandle(handlerInput) {
+        return Alexa.getRequestType(handlerInput.requestEnvelope) === 'IntentRequest'
+            && Alexa.getIntentName(handlerInput.requestEnvelope) === 'HomeStatusIntent';
+    },
+    async handle(handlerInput) {
+        const start  = Date.now();
+        const status = await getHomeStatus(handlerInput);
+        const doors  = status.reduce((n, t) => n + t.doors.length, 0);
+        const failed = status.reduce((n, t) => n + t.doors.filter((d) => d.value === null).length, 0);
+
+        putMetrics('HomeStatusIntent', {
+            HomeStatusMs:     [Date.now() - start, 'Milliseconds'],
+            HomeStatusThings: [status.length, 'Count'],
+            HomeStatusFailed: [failed, 'Count']
+        });
+
+        // Default error message if no shadow could be read
+        let speakOutput;
+        if (doors === 0) {
+            speakOutput = 'No tienes puertas configuradas en tu casa.';
+        } else if (failed === doors) {
+            speakOutput = 'No pude obtener el estado de la casa. Intenta de nuevo más tarde.';
+        } else {
+            speakOutput = homeStatusSpeech(status);
+        }
+
+        return handlerInput.responseBuilder
+            .speak(speakOutput)
+            .reprompt('¿Quieres hacer otra consulta?')
+            .getResponse();
+    }
+};
+
 // ================== GENERIC / BUILT-IN HANDLERS ==================
 
 /**
@@ -288,7 +847,8 @@ const HelpIntentHandler = {
     handle(handlerInput) {
         const speakOutput =
           'Puedes decir: abre la puerta interior, cierra la puerta interior, ' +
-          'o pregunta por el estado de la puerta interior o exterior. ¿Qué deseas hacer?';
+          'pregunta por el estado de la puerta interior o exterior, ' +
+          'o pide el estado de la casa. ¿Qué deseas hacer?';
 
         return handlerInput.responseBuilder
             .speak(speakOutput)
@@ -328,7 +888,8 @@ const FallbackIntentHandler = {
     handle(handlerInput) {
         const speakOutput =
           'Lo siento, no entendí. Puedes pedir abrir o cerrar la puerta interior, ' +
-          'o preguntar por el estado de la puerta interior o exterior.';
+          'preguntar por el estado de la puerta interior o exterior, ' +
+          'o pedir el estado de la casa.';
 
         return handlerInput.responseBuilder
             .speak(speakOutput)
@@ -345,7 +906,9 @@ const SessionEndedRequestHandler = {
         return Alexa.getRequestType(handlerInput.requestEnvelope) === 'SessionEndedRequest';
     },
     handle(handlerInput) {
-        console.log(`~~~~ Session ended: ${JSON.stringify(handlerInput.requestEnvelope)}`);
+        const request = handlerInput.requestEnvelope.request;
+        log.annotate({ reason: request.reason, error: request.error });
+        log.debug('session ended', { request });
         // No response is required; just return an empty response
         return handlerInput.responseBuilder.getResponse();
     }
@@ -371,23 +934,19 @@ const IntentReflectorHandler = {
 
 /**
  * Global error handler. Catches any exception thrown in the skill,
- * logs diagnostic information (including the Alexa userId if available),
- * and returns a generic apology message to the user.
+ * logs diagnostic information (the hashed Alexa userId if available), and
+ * returns a generic apology message to the user.
  */
 const ErrorHandler = {
     canHandle() {
         return true;
     },
     handle(handlerInput, error) {
-        console.log("=== ERROR EN SKILL ===");
-        if (handlerInput &&
-            handlerInput.requestEnvelope &&
-            handlerInput.requestEnvelope.session &&
-            handlerInput.requestEnvelope.session.user) {
-            console.log("USER ID (en error):", handlerInput.requestEnvelope.session.user.userId);
-        }
-        console.log(JSON.stringify(error));
-        console.log("===================================");
+        const session = handlerInput && handlerInput.requestEnvelope && handlerInput.requestEnvelope.session;
+        const userId  = session && session.user ? session.user.userId : undefined;
+        log.error('error en skill', { err: error, user: log.userHash(userId), stack: error.stack });
+        // Response interceptors do not run after an error
+        log.summary({ error: true });
 
         const speakOutput = 'Disculpa, hubo un problema. Intenta de nuevo.';
 
@@ -398,6 +957,34 @@ const ErrorHandler = {
     }
 };
 
+// ================== INTERCEPTORS ==================
+
+/**
+ * Opens the log context of every request: request id, type and intent on
+ * each line, plus a short hash of the userId (never the full id).
+ */
+const LogRequestInterceptor = {
+    process(handlerInput) {
+        const envelope = handlerInput.requestEnvelope;
+        const request  = envelope.request;
+        const userId   = envelope.session && envelope.session.user ? envelope.session.user.userId : undefined;
+
+        log.begin({
+            requestId: request.requestId,
+            type:      request.type,
+            intent:    request.intent ? request.intent.name : undefined,
+            user:      log.userHash(userId)
+        });
+    }
+};
+
+// Closes it with the request summary line
+const LogResponseInterceptor = {
+    process() {
+        log.summary();
+    }
+};
+
 // ================== EXPORT ==================
 
 // Skill entry point: registers all handlers and exposes the Lambda handler function
@@ -406,6 +993,7 @@ exports.handler = Alexa.SkillBuilders.custom()
         LaunchRequestHandler,
         StateExteriorDoorHandler,
         StateInteriorDoorHandler,
+        HomeStatusIntentHandler,
         OpenInteriorDoorIntentHandler,
         CloseInteriorDoorIntentHandler,
         HelpIntentHandler,
@@ -414,6 +1002,11 @@ exports.handler = Alexa.SkillBuilders.custom()
         SessionEndedRequestHandler,
         IntentReflectorHandler
     )
+    .addRequestInterceptors(LogRequestInterceptor)
+    .addResponseInterceptors(LogResponseInterceptor)
     .addErrorHandlers(ErrorHandler)
     .withCustomUserAgent('sample/hello-world/v1.2')
-    .lambda();
\ No newline at end of file
+    .lambda();
+
+// Cache hit rates, for tools/skill-bench.js and ad-hoc inspection
+exports.cacheStats = () => [thingCache, thingInfoCache, shadowCache].map((c) => c.stats());
\ No newline at end of file
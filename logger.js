@@ -0,0 +1,125 @@
+// Structured logging for the Lambda: one JSON object per line, with levels,
+// per-request sampling and one summary line per request.
+//
+//   LOG_LEVEL        debug | info | warn | error | off (default info)
+//   LOG_SAMPLE_RATE  fraction of requests logged at debug level whatever
+//                    LOG_LEVEL says, except off (default 0.01), so the full
+//                    detail of a few requests is still there when something
+//                    looks wrong
+//
+// Every line carries the fields given to begin() (request id, intent, ...)
+// and `ms`, the time since the request started. summary() closes the request
+// with its duration and the timings collected by timer()/timing() (DynamoDB,
+// shadow GETs, ...). A Lambda container runs one request at a time, so the
+// request context is plain module state.
+//
+// Alexa userIds are personal data: log userHash() of them, at every level
+// (sampled requests included), never the full id.
+//
+// CloudWatch EMF metrics are not routed through here: they must stay
+// top-level JSON objects and are always emitted.
+
+const crypto          = require('crypto');
+const { performance } = require('perf_hooks');
+
+const LEVELS = { debug: 10, info: 20, warn: 30, error: 40, off: 100 };
+
+const CONFIGURED  = LEVELS[process.env.LOG_LEVEL] || LEVELS.info;
+const SAMPLE_RATE = Number(process.env.LOG_SAMPLE_RATE || 0.01);
+
+let ctx = { level: CONFIGURED, sampled: false, fields: {}, start: performance.now(), timings: {}, extra: {} };
+
+const round = (ms) => Math.round(ms * 10) / 10;
+
+/**
+ * Starts the context of a new request; `fields` are added to every line.
+ */
+function begin(fields = {}) {
+    // LOG_LEVEL=off means nothing at all, sampled requests included
+    const sampled = CONFIGURED < LEVELS.off && SAMPLE_RATE > 0 && Math.random() < SAMPLE_RATE;
+    ctx = {
+        level:   sampled ? Math.min(LEVELS.debug, CONFIGURED) : CONFIGURED,
+        sampled,
+        fields,
+        start:   performance.now(),
+        timings: {},
+        extra:   {}
+    };
+}
+
+// True if `level` is written for the current request (guards costly fields)
+const enabled = (level) => LEVELS[level] >= ctx.level;
+
+// Short stable hash of an Alexa userId, to correlate lines without the id
+const userHash = (userId) => (userId ? crypto.createHash('sha256').update(userId).digest('hex').slice(0, 12) : undefined);
+
+// Errors do not survive JSON.stringify; keep what is useful of them
+function errorFields(err) {
+    return { name: err.name, message: err.message, code: err.code || err.statusCode || (err.$metadata || {}).httpStatusCode };
+}
+
+function write(level, msg, fields) {
+    if (!enabled(level)) return;
+    const line = { level, msg, ms: round(performance.now() - ctx.start), ...ctx.fields };
+    for (const [key, value] of Object.entries(fields || {})) {
+        line[key] = value instanceof Error ? errorFields(value) : value;
+    }
+    const out = JSON.stringify(line);
+    if (level === 'error')     console.error(out);
+    else if (level === 'warn') console.warn(out);
+    else                       console.log(out);
+}
+
+/**
+ * Adds `ms` to the timing `name` of the current request (summed if repeated).
+ */
+function timing(name, ms) {
+    ctx.timings[name] = round((ctx.timings[name] || 0) + ms);
+}
+
+/**
+ * Starts a timer; calling the returned function records it under `name`
+ * and returns the elapsed ms.
+ */
+function timer(name) {
+    const t0 = performance.now();
+    return () => {
+        const ms = performance.now() - t0;
+        timing(name, ms);
+        return ms;
+    };
+}
+
+/**
+ * Fields for the summary line of the current request.
+ */
+function annotate(fields) {
+    Object.assign(ctx.extra, fields);
+}
+
+/**
+ * Emits the summary line of the current request (info level).
+ */
+function summary(fields = {}) {
+    write('info', 'request', {
+        durationMs: round(performance.now() - ctx.start),
+        sampled:    ctx.sampled,
+        timings:    ctx.timings,
+        ...ctx.extra,
+        ...fields
+    });
+}
+
+module.exports = {
+    begin,
+    enabled,
+    userHash,
+    timing,
+    timer,
+    annotate,
+    summary,
+    debug: (msg, fields) => write('debug', msg, fields),
+    info:  (msg, fields) => write('info', msg, fields),
+    warn:  (msg, fields) => write('warn', msg, fields),
+    error: (msg, fields) => write('error', msg, fields)
+};
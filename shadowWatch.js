@@ -0,0 +1,451 @@
+// Shadow notifications for the Lambda: a minimal MQTT 3.1.1 client over
+// WebSocket (SigV4-presigned, the way AWS IoT accepts IAM credentials) or
+// plain TCP, with no dependencies beyond Node itself.
+//
+// Used by index.js in confirmed-actuation mode to wait for the actuator's
+// reported state on .../shadow/update/documents instead of polling
+// getThingShadow. The connection is module-scoped by the caller, so warm
+// invocations reuse it; a dead connection (e.g. after the container was
+// frozen) is detected by the SUBACK timeout and replaced. PINGREQ keeps an
+// idle connection within its keep-alive, and topics are unsubscribed once
+// waited on (at most maxTopics stay subscribed: AWS IoT refuses more than
+// 50 subscriptions per connection).
+//
+// The Lambda role needs iot:Connect, iot:Subscribe and iot:Receive on the
+// shadow topics.
+
+const crypto = require('crypto');
+const https  = require('https');
+const http   = require('http');
+const net    = require('net');
+
+// ================== SIGV4 PRESIGNED URL ==================
+
+const sha256 = (data) => crypto.createHash('sha256').update(data).digest('hex');
+const hmac   = (key, data) => crypto.createHmac('sha256', key).update(data).digest();
+
+/**
+ * wss://<endpoint>/mqtt URL signed for the iotdevicegateway service.
+ * AWS IoT expects the session token to be appended after signing.
+ */
+function presignIotUrl(endpoint, region, credentials, now = new Date()) {
+    const amzDate   = now.toISOString().replace(/[:-]|\.\d{3}/g, '');
+    const dateStamp = amzDate.slice(0, 8);
+    const scope     = `${dateStamp}/${region}/iotdevicegateway/aws4_request`;
+
+    const query = [
+        'X-Amz-Algorithm=AWS4-HMAC-SHA256',
+        `X-Amz-Credential=${encodeURIComponent(`${credentials.accessKeyId}/${scope}`)}`,
+        `X-Amz-Date=${amzDate}`,
+        'X-Amz-SignedHeaders=host'
+    ].join('&');
+
+    const canonical = ['GET', '/mqtt', query, `host:${endpoint}\n`, 'host', sha256('')].join('\n');
+    const toSign    = ['AWS4-HMAC-SHA256', amzDate, scope, sha256(canonical)].join('\n');
+
+    let key = hmac(`AWS4${credentials.secretAccessKey}`, dateStamp);
+    key = hmac(key, region);
+    key = hmac(key, 'iotdevicegateway');
+    key = hmac(key, 'aws4_request');
+    const signature = crypto.createHmac('sha256', key).update(toSign).digest('hex');
+
+    let url = `wss://${endpoint}/mqtt?${query}&X-Amz-Signature=${signature}`;
+    if (credentials.sessionToken) url += `&X-Amz-Security-Token=${encodeURIComponent(credentials.sessionToken)}`;
+    return url;
+}
+
+// ================== TRANSPORTS ==================
+
+/**
+ * Opens `url` (ws://, wss:// or mqtt://host:port) and resolves to
+ * { write(buf), close(), onData(fn), onClose(fn), unref() } carrying raw
+ * MQTT bytes.
+ */
+function openTransport(url, timeoutMs) {
+    const u = new URL(url);
+
+    if (u.protocol === 'mqtt:') {
+        return new Promise((resolve, reject) => {
+            const socket = net.connect({ host: u.hostname, port: Number(u.port || 1883) });
+            socket.setNoDelay(true);
+            socket.setTimeout(timeoutMs, () => socket.destroy(new Error('connect timeout')));
+            socket.once('error', reject);
+            socket.once('connect', () => {
+                socket.setTimeout(0);
+                socket.on('error', () => {});
+                resolve({
+                    write:   (buf) => socket.write(buf),
+                    close:   () => socket.destroy(),
+                    onData:  (fn) => socket.on('data', fn),
+                    onClose: (fn) => socket.on('close', fn),
+                    unref:   () => socket.unref()
+                });
+            });
+        });
+    }
+
+    return new Promise((resolve, reject) => {
+        const lib = u.protocol === 'wss:' ? https : http;
+        const req = lib.request({
+            host: u.hostname,
+            port: u.port || (u.protocol === 'wss:' ? 443 : 80),
+            path: u.pathname + u.search,
+            timeout: timeoutMs,
+            headers: {
+                Connection:               'Upgrade',
+                Upgrade:                  'websocket',
+                'Sec-WebSocket-Version':  '13',
+                'Sec-WebSocket-Key':      crypto.randomBytes(16).toString('base64'),
+                'Sec-WebSocket-Protocol': 'mqtt'
+            }
+        });
+        req.on('timeout', () => req.destroy(new Error('connect timeout')));
+        req.on('error', reject);
+        req.on('response', (res) => reject(new Error(`WebSocket upgrade refused: HTTP ${res.statusCode}`)));
+        req.on('upgrade', (res, socket, head) => {
+            socket.setNoDelay(true);
+            socket.on('error', () => {});
+            resolve(wrapWebSocket(socket, head));
+        });
+        req.end();
+    });
+}
+
+/**
+ * WebSocket framing (RFC 6455) for binary messages: client frames are
+ * masked, server frames are concatenated into one byte stream.
+ */
+function wrapWebSocket(socket, head) {
+    let buf = head && head.length ? Buffer.from(head) : Buffer.alloc(0);
+    let onData = () => {};
+
+    const frame = (opcode, payload) => {
+        const mask = crypto.randomBytes(4);
+        let header;
+        if (payload.length < 126) {
+            header = Buffer.from([0x80 | opcode, 0x80 | payload.length]);
+        } else if (payload.length < 65536) {
+            header = Buffer.alloc(4);
+            header[0] = 0x80 | opcode;
+            header[1] = 0x80 | 126;
+            header.writeUInt16BE(payload.length, 2);
+        } else {
+            header = Buffer.alloc(10);
+            header[0] = 0x80 | opcode;
+            header[1] = 0x80 | 127;
+            header.writeBigUInt64BE(BigInt(payload.length), 2);
+        }
+        const masked = Buffer.alloc(payload.length);
+        for (let i = 0; i < payload.length; i++) masked[i] = payload[i] ^ mask[i & 3];
+        return Buffer.concat([header, mask, masked]);
+    };
+
+    const drain = () => {
+        for (;;) {
+            if (buf.length < 2) return;
+            const opcode = buf[0] & 0x0f;
+            let len = buf[1] & 0x7f;
+            let pos = 2;
+            if (len === 126) {
+                if (buf.length < 4) return;
+                len = buf.readUInt16BE(2);
+                pos = 4;
+            } else if (len === 127) {
+                if (buf.length < 10) return;
+                len = Number(buf.readBigUInt64BE(2));
+                pos = 10;
+            }
+            if (buf[1] & 0x80) pos += 4;   // Servers must not mask, tolerate it anyway
+            if (buf.length < pos + len) return;
+
+            const payload = buf.subarray(pos, pos + len);
+            buf = buf.subarray(pos + len);
+
+            if (opcode === 0x9) socket.write(frame(0xa, payload));  // ping -> pong
+            else if (opcode === 0x8) socket.end();                  // close
+            else if (opcode <= 0x2) onData(payload);                // continuation / text / binary
+        }
+    };
+
+    socket.on('data', (chunk) => {
+        buf = buf.length ? Buffer.concat([buf, chunk]) : chunk;
+        drain();
+    });
+
+    return {
+        write:   (data) => socket.write(frame(0x2, data)),
+        close:   () => socket.destroy(),
+        onData:  (fn) => {
+            onData = fn;
+            drain();
+        },
+        onClose: (fn) => socket.on('close', fn),
+        unref:   () => socket.unref()
+    };
+}
+
+// ================== MQTT ==================
+
+function mqttString(s) {
+    const b = Buffer.from(s);
+    return Buffer.concat([Buffer.from([b.length >> 8, b.length & 0xff]), b]);
+}
+
+function mqttPacket(first, body) {
+    const len = [];
+    let n = body.length;
+    do {
+        let d = n % 128;
+        n = Math.floor(n / 128);
+        if (n > 0) d |= 0x80;
+        len.push(d);
+    } while (n > 0);
+    return Buffer.concat([Buffer.from([first, ...len]), body]);
+}
+
+/**
+ * Subscribes to shadow topics and resolves waiters on matching messages.
+ *
+ *   const watch = new ShadowWatch({ url });   // or { endpoint, region }
+ *   await watch.subscribe(topic);
+ *   const wait = watch.waitFor(topic, (doc) => ..., deadlineMs);
+ *   ... trigger the change ...
+ *   const doc = await wait;                   // null on timeout
+ *   watch.unsubscribe(topic);
+ */
+class ShadowWatch {
+    constructor({ url = null, endpoint = null, region = process.env.AWS_REGION, keepAliveS = 300, maxTopics = 40 } = {}) {
+        this.url        = url;
+        this.endpoint   = endpoint;
+        this.region     = region;
+        this.keepAliveS = keepAliveS;
+        this.maxTopics  = maxTopics;
+        this.transport  = null;
+        this.connecting = null;
+        this.pinger     = null;
+        this.waiters    = new Set();
+        this.topics     = new Set();   // Subscribed, least recently used first
+        this.acks       = new Map();   // packetId -> resolve
+        this.nextId     = 1;
+        this.rx         = Buffer.alloc(0);
+    }
+
+    connectUrl() {
+        if (this.url) return this.url;
+        return presignIotUrl(this.endpoint, this.region, {
+            accessKeyId:     process.env.AWS_ACCESS_KEY_ID,
+            secretAccessKey: process.env.AWS_SECRET_ACCESS_KEY,
+            sessionToken:    process.env.AWS_SESSION_TOKEN
+        });
+    }
+
+    async connect(timeoutMs) {
+        const transport = await openTransport(this.connectUrl(), timeoutMs);
+        this.rx = Buffer.alloc(0);
+
+        let timer;
+        const connack = new Promise((resolve, reject) => {
+            this.onConnack = (rc) => (rc === 0 ? resolve() : reject(new Error(`CONNACK rc=${rc}`)));
+            timer = setTimeout(() => reject(new Error('CONNACK timeout')), timeoutMs);
+        });
+
+        transport.onData((chunk) => this.onData(chunk));
+        transport.onClose(() => {
+            if (this.transport === transport) this.reset();
+        });
+
+        const clientId = `lambda-${crypto.randomBytes(6).toString('hex')}`;
+        const body = Buffer.concat([
+            mqttString('MQTT'),
+            Buffer.from([4, 0x02, this.keepAliveS >> 8, this.keepAliveS & 0xff]),
+            mqttString(clientId)
+        ]);
+        transport.write(mqttPacket(0x10, body));
+
+        try {
+            await connack;
+        } catch (err) {
+            transport.close();
+            throw err;
+        } finally {
+            clearTimeout(timer);
+        }
+        this.transport = transport;
+
+        // Neither the idle connection nor its PINGREQ (at half the keep-alive)
+        // may hold the process: with callbackWaitsForEmptyEventLoop the
+        // Lambda runtime only answers once the event loop is empty. Pending
+        // waits keep their own timers.
+        transport.unref();
+        this.pinger = setInterval(() => transport.write(Buffer.from([0xc0, 0])), this.keepAliveS * 500);
+        this.pinger.unref();
+    }
+
+    reset() {
+        if (this.transport) this.transport.close();
+        clearInterval(this.pinger);
+        this.pinger    = null;
+        this.transport = null;
+        this.acks.clear();
+        this.topics.clear();   // Clean session: the broker forgot them too
+    }
+
+    packetId() {
+        const id = this.nextId;
+        this.nextId = (this.nextId % 0xffff) + 1;
+        return id;
+    }
+
+    onData(chunk) {
+        this.rx = this.rx.length ? Buffer.concat([this.rx, chunk]) : chunk;
+        for (;;) {
+            if (this.rx.length < 2) return;
+            let len = 0;
+            let mult = 1;
+            let i = 1;
+            let d;
+            do {
+                if (i >= this.rx.length) return;
+                d = this.rx[i++];
+                len += (d & 0x7f) * mult;
+                mult *= 128;
+            } while (d & 0x80);
+            if (this.rx.length < i + len) return;
+
+            const type = this.rx[0] >> 4;
+            const qos  = (this.rx[0] >> 1) & 3;
+            const body = this.rx.subarray(i, i + len);
+            this.rx = this.rx.subarray(i + len);
+
+            if (type === 2 && this.onConnack) {
+                this.onConnack(body[1]);
+            } else if (type === 9) {
+                const done = this.acks.get(body.readUInt16BE(0));
+                if (done) done(body[2] !== 0x80);
+            } else if (type === 11) {
+                const done = this.acks.get(body.readUInt16BE(0));
+                if (done) done(true);
+            } else if (type === 3) {
+                const tlen  = body.readUInt16BE(0);
+                const topic = body.toString('utf8', 2, 2 + tlen);
+                let pos = 2 + tlen;
+                if (qos > 0) {
+                    this.transport.write(mqttPacket(0x40, body.subarray(pos, pos + 2)));   // PUBACK
+                    pos += 2;
+                }
+                this.dispatch(topic, body.subarray(pos));
+            }
+        }
+    }
+
+    dispatch(topic, payload) {
+        let doc;
+        try {
+            doc = JSON.parse(payload.toString());
+        } catch (err) {
+            return;
+        }
+        for (const w of this.waiters) {
+            if (w.topic === topic && w.predicate(doc)) w.finish(doc);
+        }
+    }
+
+    /**
+     * Connects if needed and subscribes to `topic`. Subscribing again to
+     * the same topic is harmless in MQTT, so every call sends SUBSCRIBE:
+     * the SUBACK doubles as a liveness check of a reused connection. A
+     * missing SUBACK within timeoutMs means the connection is stale: it is
+     * replaced and the subscription retried once.
+     */
+    async subscribe(topic, timeoutMs = 1500) {
+        for (let attempt = 0; attempt < 2; attempt++) {
+            if (!this.transport) {
+                this.connecting = this.connecting || this.connect(timeoutMs).finally(() => { this.connecting = null; });
+                await this.connecting;
+            }
+            const id = this.packetId();
+            const granted = await new Promise((resolve) => {
+                const timer = setTimeout(() => resolve(null), timeoutMs);
+                this.acks.set(id, (ok) => {
+                    clearTimeout(timer);
+                    resolve(ok);
+                });
+                this.transport.write(mqttPacket(0x82, Buffer.concat([
+                    Buffer.from([id >> 8, id & 0xff]), mqttString(topic), Buffer.from([0])
+                ])));
+            });
+            this.acks.delete(id);
+
+            if (granted === true) {
+                this.topics.delete(topic);
+                this.topics.add(topic);
+                this.evict();
+                return;
+            }
+            if (granted === false) throw new Error(`subscription to ${topic} refused`);
+            this.reset();
+        }
+        throw new Error('no SUBACK from the broker');
+    }
+
+    /**
+     * Sends UNSUBSCRIBE for `topic` unless a waiter still needs it. Resolves
+     * on the UNSUBACK, or after timeoutMs: the topic is forgotten either
+     * way, since a connection that loses an UNSUBACK is stale and the next
+     * subscribe() replaces it. Callers need not await it.
+     */
+    unsubscribe(topic, timeoutMs = 1500) {
+        if (!this.transport || !this.topics.has(topic)) return Promise.resolve();
+        for (const w of this.waiters) {
+            if (w.topic === topic) return Promise.resolve();
+        }
+        this.topics.delete(topic);
+
+        const id = this.packetId();
+        return new Promise((resolve) => {
+            const timer = setTimeout(resolve, timeoutMs);
+            timer.unref();   // Not awaited by the Lambda, see connect()
+            this.acks.set(id, () => {
+                clearTimeout(timer);
+                resolve();
+            });
+            this.transport.write(mqttPacket(0xa2, Buffer.concat([
+                Buffer.from([id >> 8, id & 0xff]), mqttString(topic)
+            ])));
+        }).finally(() => this.acks.delete(id));
+    }
+
+    // Unsubscribes the least recently used topics beyond maxTopics
+    evict() {
+        for (const topic of this.topics) {
+            if (this.topics.size <= this.maxTopics) return;
+            this.unsubscribe(topic);
+        }
+    }
+
+    /**
+     * Resolves with the first document on `topic` that satisfies
+     * `predicate`, or null once `deadline` (epoch ms) has passed.
+     * Register before triggering the change to avoid missing it.
+     */
+    waitFor(topic, predicate, deadline) {
+        let waiter;
+        const promise = new Promise((resolve) => {
+            const timer = setTimeout(() => waiter.finish(null), Math.max(0, deadline - Date.now()));
+            waiter = {
+                topic,
+                predicate,
+                finish: (doc) => {
+                    clearTimeout(timer);
+                    this.waiters.delete(waiter);
+                    resolve(doc);
+                }
+            };
+            this.waiters.add(waiter);
+        });
+        promise.cancel = () => waiter.finish(null);
+        return promise;
+    }
+}
+
+module.exports = { ShadowWatch, presignIotUrl };
\ No newline at end of file
@@ -0,0 +1,205 @@
+// Replays a recorded reed-switch waveform through the sensor's sampling
+// logic (DebounceFilter from espSensor/DebounceFilter.hpp) on the host.
+//
+//   g++ -O2 -std=c++17 -I espSensor -o /tmp/debounce-replay tools/debounce-replay.cpp
+//   /tmp/debounce-replay [--hz 1000] [--debounce-ms 20] [--jitter-us 0]
+//                        [--time-scale 1] [--sweep] [--synth N | waveform.txt]
+//
+// Waveform: one edge per line, "<time> <level>" separated by blanks or a
+// comma (a logic analyser CSV export works; header and '#' lines are
+// skipped). Time is multiplied by --time-scale to get microseconds (use
+// 1e6 for exports in seconds); level is 0/1 at the pin, 0 = OPEN.
+// --synth N generates N door movements instead: contact bounce of 1-12
+// pulses of 50 us - 3 ms on every movement, plus 1 us EMI spikes.
+//
+// The pin is sampled every 1e6/hz us (plus uniform +-jitter-us, to model
+// the timer task latency measured on the device) and fed to the filter,
+// as MagneticSensor::sample() does. Reported against the reference
+// transitions (changes of the level once it has been stable for
+// --debounce-ms): transitions found, missed and spurious, and the latency
+// from the edge that starts the stable level to its confirmation. --sweep
+// prints the same for a grid of sample rates and debounce times.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include <algorithm>
+#include <random>
+#include "DebounceFilter.hpp"
+
+struct Edge {
+    double t;      // us
+    bool   level;  // Pin level after the edge
+};
+
+struct Result {
+    uint32_t expected  = 0;
+    uint32_t found     = 0;
+    uint32_t missed    = 0;
+    uint32_t spurious  = 0;
+    double   meanLatUs = 0;
+    double   maxLatUs  = 0;
+};
+
+static std::vector<Edge> readWaveform(const char* path, double scale) {
+    FILE* f = fopen(path, "r");
+    if (!f) {
+        perror(path);
+        exit(1);
+    }
+    std::vector<Edge> edges;
+    char line[256];
+    while (fgets(line, sizeof(line), f)) {
+        if (line[0] == '#') continue;
+        for (char* p = line; *p; p++) {
+            if (*p == ',') *p = ' ';
+        }
+        double t;
+        int    level;
+        if (sscanf(line, "%lf %d", &t, &level) != 2) continue;
+        edges.push_back({t * scale, level != 0});
+    }
+    fclose(f);
+    return edges;
+}
+
+static std::vector<Edge> synthWaveform(uint32_t movements) {
+    std::mt19937 rng(42);
+    auto uniform = [&](double lo, double hi) { return std::uniform_real_distribution<double>(lo, hi)(rng); };
+
+    std::vector<Edge> edges;
+    double t     = 0;
+    bool   level = true;   // Closed: HIGH
+    edges.push_back({0, level});
+    for (uint32_t m = 0; m < movements; m++) {
+        t += uniform(200e3, 30e6);     // Stable between movements: 0.2-30 s
+        level = !level;
+        int bounces = (int)uniform(1, 13);
+        for (int b = 0; b < bounces; b++) {
+            edges.push_back({t, level});
+            t += uniform(50, 3000);
+            edges.push_back({t, !level});
+            t += uniform(50, 3000);
+        }
+        edges.push_back({t, level});
+        // EMI spike now and then while stable
+        if (uniform(0, 1) < 0.3) {
+            double at = t + uniform(30e3, 150e3);
+            edges.push_back({at, !level});
+            edges.push_back({at + 1, level});
+            t = at + 1;
+        }
+    }
+    edges.push_back({t + 1e6, level});
+    return edges;
+}
+
+// Reference transitions: level changes that then hold for at least holdUs
+static std::vector<Edge> reference(const std::vector<Edge>& edges, double holdUs) {
+    std::vector<Edge> out;
+    if (edges.empty()) return out;
+    bool settled = edges[0].level;
+    for (size_t i = 1; i < edges.size(); i++) {
+        double until = i + 1 < edges.size() ? edges[i + 1].t : edges[i].t + holdUs;
+        if (edges[i].level != settled && until - edges[i].t >= holdUs) {
+            settled = edges[i].level;
+            out.push_back(edges[i]);
+        }
+    }
+    return out;
+}
+
+static Result replay(const std::vector<Edge>& edges, uint32_t hz, uint32_t debounceMs, double jitterUs) {
+    Result r;
+    if (edges.size() < 2) return r;
+
+    double holdUs = debounceMs * 1000.0;
+    std::vector<Edge> ref = reference(edges, holdUs);
+    r.expected = ref.size();
+
+    DebounceFilter filter((uint16_t)((debounceMs * hz + 999) / 1000));
+    filter.reset(edges[0].level == 0);
+
+    std::mt19937 rng(7);
+    std::uniform_real_distribution<double> jitter(-jitterUs, jitterUs);
+    double period = 1e6 / hz;
+    double end    = edges.back().t;
+    size_t e      = 0;
+    size_t next   = 0;     // Next reference transition to match
+    double latSum = 0;
+
+    for (double tick = 0; tick <= end; tick += period) {
+        double t = tick + (jitterUs > 0 ? jitter(rng) : 0);
+        while (e + 1 < edges.size() && edges[e + 1].t <= t) e++;
+        if (!filter.update(edges[e].level == 0)) continue;
+
+        bool level = !filter.value();
+        // Reference transitions passed without being seen are missed
+        while (next < ref.size() && ref[next].level != level && ref[next].t < t) {
+            r.missed++;
+            next++;
+        }
+        // A bounce shorter than the sample period can go unseen, so the
+        // filter may confirm up to one debounce time before the reference
+        if (next < ref.size() && ref[next].level == level && ref[next].t <= t + holdUs) {
+            double lat = std::max(0.0, t - ref[next].t);
+            latSum += lat;
+            r.maxLatUs = std::max(r.maxLatUs, lat);
+            r.found++;
+            next++;
+        } else {
+            r.spurious++;
+        }
+    }
+    r.missed   += ref.size() - next;
+    r.meanLatUs = r.found ? latSum / r.found : 0;
+    return r;
+}
+
+static void print(uint32_t hz, uint32_t debounceMs, const Result& r) {
+    printf("%6u %8u %9u %7u %7u %9u %10.2f %10.2f\n", hz, debounceMs, r.expected, r.found,
+           r.missed, r.spurious, r.meanLatUs / 1000, r.maxLatUs / 1000);
+}
+
+int main(int argc, char** argv) {
+    uint32_t    hz         = 1000;
+    uint32_t    debounceMs = 20;
+    double      jitterUs   = 0;
+    double      scale      = 1;
+    bool        sweep      = false;
+    uint32_t    synth      = 0;
+    const char* path       = nullptr;
+
+    for (int i = 1; i < argc; i++) {
+        if      (!strcmp(argv[i], "--hz") && i + 1 < argc)          hz = strtoul(argv[++i], nullptr, 10);
+        else if (!strcmp(argv[i], "--debounce-ms") && i + 1 < argc) debounceMs = strtoul(argv[++i], nullptr, 10);
+        else if (!strcmp(argv[i], "--jitter-us") && i + 1 < argc)   jitterUs = atof(argv[++i]);
+        else if (!strcmp(argv[i], "--time-scale") && i + 1 < argc)  scale = atof(argv[++i]);
+        else if (!strcmp(argv[i], "--synth") && i + 1 < argc)       synth = strtoul(argv[++i], nullptr, 10);
+        else if (!strcmp(argv[i], "--sweep"))                       sweep = true;
+        else path = argv[i];
+    }
+    if (!path && !synth) {
+        fprintf(stderr, "usage: debounce-replay [--hz N] [--debounce-ms N] [--jitter-us N] "
+                        "[--time-scale N] [--sweep] (--synth N | waveform.txt)\n");
+        return 1;
+    }
+
+    std::vector<Edge> edges = path ? readWaveform(path, scale) : synthWaveform(synth);
+    std::sort(edges.begin(), edges.end(), [](const Edge& a, const Edge& b) { return a.t < b.t; });
+    printf("%zu edges over %.1f s, sample jitter +-%.0f us\n\n", edges.size(),
+           edges.empty() ? 0 : edges.back().t / 1e6, jitterUs);
+    printf("    hz debounce  expected   found  missed  spurious  mean (ms)   max (ms)\n");
+
+    if (!sweep) {
+        print(hz, debounceMs, replay(edges, hz, debounceMs, jitterUs));
+        return 0;
+    }
+    for (uint32_t h : {100u, 250u, 1000u, 4000u}) {
+        for (uint32_t d : {5u, 10u, 20u, 50u}) {
+            print(h, d, replay(edges, h, d, jitterUs));
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,391 @@
+// Host test and benchmark of the devices' delta patch decoder
+// (espSensor/DeltaPatcher.hpp, shared with the actuator) on patches made by
+// tools/ota-delta.js. Run from the repository root (it runs node).
+//
+//   g++ -O2 -std=c++17 -I espSensor -o /tmp/delta-patch-test tools/delta-patch-test.cpp
+//   /tmp/delta-patch-test [imageKB=1024] [seed=1]
+//   /tmp/delta-patch-test old.bin new.bin
+//
+// By default the images are synthetic: a seeded random source, and a target
+// made from it with the edits of a rebuild (shifted blocks, changed words,
+// inserted and removed code). Given two files, it runs on those instead:
+// the .bin of the running build and of the next one, as exported by the
+// Arduino IDE. `node tools/ota-delta.js make` builds the patch, which
+// is then applied through a PatchIO on RAM buffers that checks the source
+// hash in begin() and hashes the output, as OtaUpdater does on flash.
+//
+// Checked:
+//   apply     the output is the target, hash included, with the patch fed
+//             whole, as the MQTT chunks (76-byte header, then 900 or 400
+//             bytes) and one byte at a time
+//   truncated cut inside the header, inside an op and before END: never DONE
+//   corrupt   magic, opcode, copy out of the source, output past or short of
+//             targetSize fail with their status; a changed literal byte
+//             decodes but fails the target hash
+//   base      a patch applied to another image is rejected (ERR_REJECTED)
+// Reported: patch size, decode throughput per chunking, patcher RAM.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <chrono>
+#include <random>
+#include <string>
+#include <vector>
+#include "DeltaPatcher.hpp"
+
+typedef std::vector<uint8_t> Bytes;
+
+static double nowNs() {
+    return (double)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static void check(bool ok, const char* what) {
+    if (!ok) {
+        fprintf(stderr, "FAILED: %s\n", what);
+        exit(1);
+    }
+}
+
+//--------------------------------------------------------------------------
+// SHA-256 (FIPS 180-4), enough for the patch hashes
+//--------------------------------------------------------------------------
+class Sha256 {
+private:
+    uint32_t h[8];
+    uint8_t  block[64];
+    size_t   used;
+    uint64_t total;
+
+    static uint32_t rotr(uint32_t x, int n) { return (x >> n) | (x << (32 - n)); }
+
+    void compress(const uint8_t* p) {
+        static const uint32_t K[64] = {
+            0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+            0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+            0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+            0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+            0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+            0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+            0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+            0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+        };
+        uint32_t w[64];
+        for (int i = 0; i < 16; i++) {
+            w[i] = (uint32_t)p[4 * i] << 24 | (uint32_t)p[4 * i + 1] << 16 | (uint32_t)p[4 * i + 2] << 8 | p[4 * i + 3];
+        }
+        for (int i = 16; i < 64; i++) {
+            uint32_t s0 = rotr(w[i - 15], 7) ^ rotr(w[i - 15], 18) ^ (w[i - 15] >> 3);
+            uint32_t s1 = rotr(w[i - 2], 17) ^ rotr(w[i - 2], 19) ^ (w[i - 2] >> 10);
+            w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+        }
+        uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4], f = h[5], g = h[6], k = h[7];
+        for (int i = 0; i < 64; i++) {
+            uint32_t t1 = k + (rotr(e, 6) ^ rotr(e, 11) ^ rotr(e, 25)) + ((e & f) ^ (~e & g)) + K[i] + w[i];
+            uint32_t t2 = (rotr(a, 2) ^ rotr(a, 13) ^ rotr(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+            k = g; g = f; f = e; e = d + t1;
+            d = c; c = b; b = a; a = t1 + t2;
+        }
+        h[0] += a; h[1] += b; h[2] += c; h[3] += d; h[4] += e; h[5] += f; h[6] += g; h[7] += k;
+    }
+
+public:
+    Sha256() {
+        static const uint32_t INIT[8] = {0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+                                         0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19};
+        memcpy(h, INIT, sizeof(h));
+        used  = 0;
+        total = 0;
+    }
+
+    void update(const uint8_t* p, size_t n) {
+        total += n;
+        while (n > 0) {
+            size_t take = 64 - used < n ? 64 - used : n;
+            memcpy(block + used, p, take);
+            used += take;
+            p    += take;
+            n    -= take;
+            if (used == 64) {
+                compress(block);
+                used = 0;
+            }
+        }
+    }
+
+    void finish(uint8_t out[32]) {
+        uint64_t bits = total * 8;
+        uint8_t  pad  = 0x80;
+        update(&pad, 1);
+        pad = 0;
+        while (used != 56) update(&pad, 1);
+        for (int i = 7; i >= 0; i--) {
+            uint8_t b = (uint8_t)(bits >> (8 * i));
+            update(&b, 1);
+        }
+        for (int i = 0; i < 8; i++) {
+            out[4 * i] = (uint8_t)(h[i] >> 24); out[4 * i + 1] = (uint8_t)(h[i] >> 16);
+            out[4 * i + 2] = (uint8_t)(h[i] >> 8); out[4 * i + 3] = (uint8_t)h[i];
+        }
+    }
+};
+
+//--------------------------------------------------------------------------
+// PatchIO on RAM images, with OtaUpdater's checks
+//--------------------------------------------------------------------------
+class RamPatchIO : public PatchIO {
+public:
+    const Bytes* source;
+    Bytes        target;
+    Sha256       sha;
+    bool         hashSource = true;   // Off for the benchmark
+
+    explicit RamPatchIO(const Bytes* source) : source(source) {}
+
+    bool begin(const PatchHeader& header) override {
+        if (header.sourceSize > source->size()) return false;
+        target.clear();
+        target.reserve(header.targetSize);
+        sha = Sha256();
+        if (!hashSource) return true;
+
+        uint8_t digest[32];
+        Sha256  s;
+        s.update(source->data(), header.sourceSize);
+        s.finish(digest);
+        return memcmp(digest, header.sourceHash, 32) == 0;
+    }
+
+    bool readSource(uint32_t offset, uint8_t* buf, size_t len) override {
+        if (offset + len > source->size()) return false;
+        memcpy(buf, source->data() + offset, len);
+        return true;
+    }
+
+    bool writeTarget(const uint8_t* buf, size_t len) override {
+        target.insert(target.end(), buf, buf + len);
+        sha.update(buf, len);
+        return true;
+    }
+};
+
+struct Result {
+    DeltaPatcher::Status status;
+    bool                 hashOk;   // Output hash matches the header (DONE only)
+    Bytes                output;
+};
+
+// Feeds `patch` in pieces of `chunk` bytes (the first `first` bytes alone
+// when first > 0, as the header chunk of the MQTT protocol)
+static Result apply(const Bytes& source, const Bytes& patch, size_t chunk, size_t first = 0) {
+    RamPatchIO   io(&source);
+    DeltaPatcher patcher(&io);
+    size_t       pos = 0;
+    if (first) {
+        patcher.feed(patch.data(), first < patch.size() ? first : patch.size());
+        pos = first;
+    }
+    while (pos < patch.size() && patcher.getStatus() == DeltaPatcher::IN_PROGRESS) {
+        size_t n = patch.size() - pos < chunk ? patch.size() - pos : chunk;
+        patcher.feed(patch.data() + pos, n);
+        pos += n;
+    }
+
+    Result r;
+    r.status = patcher.getStatus();
+    r.hashOk = false;
+    if (r.status == DeltaPatcher::DONE) {
+        uint8_t digest[32];
+        io.sha.finish(digest);
+        r.hashOk = memcmp(digest, patcher.getHeader().targetHash, 32) == 0;
+    }
+    r.output = std::move(io.target);
+    return r;
+}
+
+//--------------------------------------------------------------------------
+// Synthetic images and ota-delta.js
+//--------------------------------------------------------------------------
+static Bytes makeTarget(const Bytes& source, std::mt19937& rng) {
+    std::uniform_int_distribution<uint32_t> segment(1024, 64 * 1024), insert(0, 2048),
+                                            skip(0, 1024), edits(0, 8), byte(0, 255);
+    Bytes  target;
+    size_t pos = 0;
+    while (pos < source.size()) {
+        size_t n = segment(rng);
+        if (n > source.size() - pos) n = source.size() - pos;
+        size_t start = target.size();
+        target.insert(target.end(), source.begin() + pos, source.begin() + pos + n);
+        // Relocated addresses: a few changed words in the copied block
+        for (uint32_t e = edits(rng); e > 0 && n >= 4; e--) {
+            size_t at = start + (rng() % (n / 4)) * 4;
+            for (int i = 0; i < 4; i++) target[at + i] = (uint8_t)byte(rng);
+        }
+        pos += n;
+        for (uint32_t i = insert(rng); i > 0; i--) target.push_back((uint8_t)byte(rng));
+        pos += skip(rng);
+    }
+    return target;
+}
+
+static void writeFile(const std::string& path, const Bytes& data) {
+    FILE* f = fopen(path.c_str(), "wb");
+    check(f && fwrite(data.data(), 1, data.size(), f) == data.size(), "write image");
+    fclose(f);
+}
+
+static Bytes readFile(const std::string& path) {
+    FILE* f = fopen(path.c_str(), "rb");
+    check(f != nullptr, "read file");
+    Bytes data;
+    uint8_t buf[65536];
+    size_t  n;
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0) data.insert(data.end(), buf, buf + n);
+    fclose(f);
+    return data;
+}
+
+// Offset of the first op of kind `op` in a valid patch
+static size_t findOp(const Bytes& patch, char op) {
+    size_t pos = DeltaPatcher::HEADER_SIZE;
+    while (pos < patch.size()) {
+        if (patch[pos] == op) return pos;
+        if (patch[pos] == 'C') pos += 9;
+        else if (patch[pos] == 'A') pos += 5 + (patch[pos + 1] | patch[pos + 2] << 8 | patch[pos + 3] << 16 | (uint32_t)patch[pos + 4] << 24);
+        else break;
+    }
+    check(false, "op present in the patch");
+    return 0;
+}
+
+static void putU32(Bytes& b, size_t at, uint32_t v) {
+    for (int i = 0; i < 4; i++) b[at + i] = (uint8_t)(v >> (8 * i));
+}
+
+int main(int argc, char** argv) {
+    bool files = argc > 2 && access(argv[1], R_OK) == 0;
+    char dir[] = "/tmp/delta-patch-XXXXXX";
+    check(mkdtemp(dir) != nullptr, "temporary directory");
+    std::string src = std::string(dir) + "/source.bin", tgt = std::string(dir) + "/target.bin",
+                dpt = std::string(dir) + "/patch.dpt";
+
+    Bytes source, target;
+    if (files) {
+        src    = argv[1];
+        tgt    = argv[2];
+        source = readFile(src);
+        target = readFile(tgt);
+        check(!source.empty() && !target.empty(), "both images readable");
+    } else {
+        uint32_t imageKB = argc > 1 ? strtoul(argv[1], nullptr, 10) : 1024;
+        uint32_t seed    = argc > 2 ? strtoul(argv[2], nullptr, 10) : 1;
+
+        std::mt19937 rng(seed);
+        source.resize(imageKB * 1024);
+        for (uint8_t& b : source) b = (uint8_t)rng();
+        target = makeTarget(source, rng);
+        writeFile(src, source);
+        writeFile(tgt, target);
+    }
+    std::string cmd = "node tools/ota-delta.js make " + src + " " + tgt + " " + dpt + " > /dev/null";
+    check(system(cmd.c_str()) == 0, "node tools/ota-delta.js make (run from the repository root)");
+    Bytes patch = readFile(dpt);
+    if (!files) {
+        unlink(src.c_str());
+        unlink(tgt.c_str());
+    }
+    unlink(dpt.c_str());
+    rmdir(dir);
+
+    printf("images (%s): source %zu, target %zu bytes; patch %zu bytes (%.1f%%); patcher RAM %zu bytes\n",
+           files ? "files" : "synthetic", source.size(), target.size(), patch.size(),
+           100.0 * patch.size() / target.size(), sizeof(DeltaPatcher));
+
+    // Applies, whatever the chunking
+    const size_t HEADER = DeltaPatcher::HEADER_SIZE;
+    struct { const char* name; size_t chunk, first; } feeds[] = {
+        {"whole", patch.size(), 0}, {"mqtt 900", 900, HEADER}, {"mqtt 400", 400, HEADER}, {"1 byte", 1, 0}
+    };
+    for (const auto& f : feeds) {
+        Result r = apply(source, patch, f.chunk, f.first);
+        check(r.status == DeltaPatcher::DONE, "patch applies");
+        check(r.hashOk, "target hash");
+        check(r.output == target, "output is the target");
+    }
+
+    // Truncated: inside the header, inside an op, before END
+    for (size_t cut : {(size_t)40, HEADER + 3, patch.size() - 1}) {
+        Bytes  t(patch.begin(), patch.begin() + cut);
+        Result r = apply(source, t, 900);
+        check(r.status == DeltaPatcher::IN_PROGRESS, "truncated patch never completes");
+    }
+
+    // Corrupt
+    {
+        Bytes p = patch;
+        p[0] = 'X';
+        check(apply(source, p, 900).status == DeltaPatcher::ERR_MAGIC, "bad magic");
+    }
+    {
+        Bytes p = patch;
+        p[HEADER] = 'Z';
+        check(apply(source, p, 900).status == DeltaPatcher::ERR_OPCODE, "bad opcode");
+    }
+    {
+        Bytes p = patch;
+        putU32(p, findOp(p, 'C') + 1, (uint32_t)source.size());
+        check(apply(source, p, 900).status == DeltaPatcher::ERR_RANGE, "copy outside the source");
+    }
+    {
+        Bytes p = patch;
+        putU32(p, 8, (uint32_t)target.size() - 1);
+        check(apply(source, p, 900).status == DeltaPatcher::ERR_RANGE, "output past targetSize");
+    }
+    {
+        Bytes p = patch;
+        putU32(p, 8, (uint32_t)target.size() + 1);
+        check(apply(source, p, 900).status == DeltaPatcher::ERR_SIZE, "END before targetSize");
+    }
+    {
+        Bytes p = patch;
+        p[findOp(p, 'A') + 5] ^= 0x01;
+        Result r = apply(source, p, 900);
+        check(r.status == DeltaPatcher::DONE && !r.hashOk, "changed literal fails the target hash");
+    }
+
+    // Another base image
+    {
+        Bytes other = source;
+        other[other.size() / 2] ^= 0x01;
+        check(apply(other, patch, 900).status == DeltaPatcher::ERR_REJECTED, "base hash mismatch");
+    }
+    printf("checks: apply x4, truncated x3, corrupt x6, base mismatch: ok\n");
+
+    // Decoder throughput (source hash left out: that is the flash read cost)
+    for (const auto& f : feeds) {
+        if (f.chunk == 1) continue;
+        int    runs = 20;
+        double t    = nowNs();
+        for (int i = 0; i < runs; i++) {
+            RamPatchIO   io(&source);
+            io.hashSource = false;
+            DeltaPatcher patcher(&io);
+            size_t pos = 0;
+            if (f.first) {
+                patcher.feed(patch.data(), f.first);
+                pos = f.first;
+            }
+            while (pos < patch.size()) {
+                size_t n = patch.size() - pos < f.chunk ? patch.size() - pos : f.chunk;
+                patcher.feed(patch.data() + pos, n);
+                pos += n;
+            }
+            check(patcher.getStatus() == DeltaPatcher::DONE, "benchmark run");
+        }
+        double s = (nowNs() - t) / 1e9 / runs;
+        printf("decode %-9s %7.2f ms per image, %6.1f MB/s of target (output hashed)\n",
+               f.name, s * 1e3, target.size() / s / 1e6);
+    }
+    return 0;
+}
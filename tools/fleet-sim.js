@@ -0,0 +1,767 @@
+#!/usr/bin/env node
+// Fleet load simulator: N homes, each with a virtual EspSensor, a virtual
+// EspActuator and the Lambda path that drives them, against a local broker
+// (tools/shadow-emulator.js) or any MQTT endpoint with the same topics.
+//
+//   node tools/fleet-sim.js [--homes 500] [--threads <cpus>] [--duration 60]
+//                           [--host 127.0.0.1] [--port 1883] [--http-port 8080]
+//                           [--events poisson|burst|diurnal] [--rate 0.02] [--dwell 5]
+//                           [--burst-every 60] [--burst-fraction 0.3] [--burst-window 2] [--period 600]
+//                           [--commands 0.01] [--read-ratio 0.5] [--servo-ms 0]
+//                           [--telemetry-ms <sketch>] [--bounces 0] [--connect-rate 200]
+//                           [--shared-client-ids] [--thing-prefix home-] [--report-interval 5]
+//
+// Each virtual device keeps its own MQTT connection and mirrors the
+// firmware logic in JS (Device.hpp topics, EspSensor::reportState,
+// EspActuator::handleMessage, 5 s reconnect delay of MqttClient). The C++
+// itself is not run: a host build of the sketches (tools/replay) has no
+// sockets and one device per process. What the load depends on is read
+// from the firmware sources at start-up, so it cannot drift:
+//   PublishGovernor.hpp    BURST, REFILL_MS, PAYLOAD_SIZE; shadow writes go
+//                          through a copy of its dedup, token bucket and
+//                          coalescing (actuator acks forced, as the firmware)
+//   Telemetry.hpp          KEYS: telemetry payloads are the size of a
+//                          typical sample's CBOR (as tools/telemetry-bench),
+//                          worst case MAX_ENCODED_SIZE
+//   espSensor.ino          debounceMs (a door change is reported once the
+//                          contact has been stable that long),
+//                          telemetryIntervalMs (--telemetry-ms default)
+// --bounces adds that many contact bounces, 1 ms apart, to every door edge.
+// Homes are split across worker threads; each thread runs its devices on
+// the libuv event loop (epoll on Linux).
+//
+// Door events (exterior sensor), per home:
+//   poisson  closed->open after Exp(1/rate) s, open->closed after Exp(dwell) s
+//   burst    every burst-every s, burst-fraction of the homes open within
+//            burst-window s (everybody comes home at once), close after Exp(dwell)
+//   diurnal  poisson with rate * (1 + sin(2*pi*t/period))
+//
+// Lambda path: per home, Poisson(commands) invocations per second through the
+// shadow REST API like index.js: updateThingShadow(desired.interiorDoor) or,
+// for read-ratio of them, getThingShadow.
+//
+// Reported: publish throughput, delta delivery and delta-to-actuation latency
+// percentiles (command sent -> delta received / reported state published),
+// REST round trips, connection churn and heap/RSS per client.
+//
+// --shared-client-ids gives every home the firmware's fixed client ids
+// (ESP_CLIENT_SENSOR / ESP_CLIENT_Actuator), which the broker treats as the
+// same client: the reconnect/takeover churn shows up in the counters.
+
+const fs   = require('fs');
+const os   = require('os');
+const path = require('path');
+const http = require('http');
+const { Worker, isMainThread, parentPort, workerData } = require('worker_threads');
+const { MqttClient } = require('./lib/mqtt');
+
+const SENSOR_CLIENT_ID   = 'ESP_CLIENT_SENSOR';
+const ACTUATOR_CLIENT_ID = 'ESP_CLIENT_Actuator';
+const RECONNECT_MS       = 5000;   // MqttClient::reconnect() back-off
+const KEEPALIVE_S        = 15;     // PubSubClient default
+const MAX_SAMPLES        = 200000; // Per latency series kept by the main thread
+
+const expRandom = (mean) => -Math.log(1 - Math.random()) * mean;
+
+// ================== FIRMWARE PARAMETERS ==================
+
+const REPO = path.join(__dirname, '..');
+
+function readSource(file) {
+    return fs.readFileSync(path.join(REPO, file), 'utf8');
+}
+
+function readConstant(file, name) {
+    const m = readSource(file).match(new RegExp(`\\b${name}\\s*=\\s*(\\d+)`));
+    if (!m) throw new Error(`${name} not found in ${file}`);
+    return Number(m[1]);
+}
+
+// Bytes of a CBOR head (major type + argument), as CborWriter::writeHead
+const cborHead = (v) => (v < 24 ? 1 : v < 0x100 ? 2 : v < 0x10000 ? 3 : 5);
+
+// Values of the typical sample of tools/telemetry-bench.cpp, by CBOR key
+const TYPICAL_HEALTH = {
+    up: 86400, rssi: -67, heap: 182340, minh: 151220, blk: 110580, frag: 39, rc: 2,
+    lavg: 85, lmax: 4210, cpu: 3, elat: 120, emax: 900, wake: 6000
+};
+
+function loadFirmware() {
+    const m = readSource('espSensor/Telemetry.hpp').match(/KEYS\[\]\s*=\s*\{([^}]*)\}/);
+    if (!m) throw new Error('TelemetryPublisher::KEYS not found in espSensor/Telemetry.hpp');
+    const keys = [...m[1].matchAll(/"([^"]+)"/g)].map((k) => k[1]);
+
+    // cborMaxMapSize() and the encoding of the typical sample
+    const head = keys.length < 24 ? 1 : 2;
+    let worst = head;
+    let typical = head;
+    for (const key of keys) {
+        const v = TYPICAL_HEALTH[key] || 0;
+        worst   += 1 + key.length + 5;
+        typical += 1 + key.length + cborHead(v < 0 ? -1 - v : v);
+    }
+
+    return {
+        burst:          readConstant('espSensor/PublishGovernor.hpp', 'BURST'),
+        refillMs:       readConstant('espSensor/PublishGovernor.hpp', 'REFILL_MS'),
+        payloadSize:    readConstant('espSensor/PublishGovernor.hpp', 'PAYLOAD_SIZE'),
+        debounceMs:     readConstant('espSensor/espSensor.ino', 'debounceMs'),
+        telemetryMs:    readConstant('espSensor/espSensor.ino', 'telemetryIntervalMs'),
+        telemetryBytes: typical,
+        telemetryMax:   worst
+    };
+}
+
+const FIRMWARE = loadFirmware();
+
+const DEFAULTS = {
+    homes: 500,
+    threads: Math.max(1, os.cpus().length),
+    duration: 60,
+    host: '127.0.0.1',
+    port: 1883,
+    'http-port': 8080,
+    events: 'poisson',
+    rate: 0.02,
+    dwell: 5,
+    'burst-every': 60,
+    'burst-fraction': 0.3,
+    'burst-window': 2,
+    period: 600,
+    commands: 0.01,
+    'read-ratio': 0.5,
+    'servo-ms': 0,
+    'telemetry-ms': FIRMWARE.telemetryMs,
+    bounces: 0,
+    'connect-rate': 200,
+    'shared-client-ids': false,
+    'thing-prefix': 'home-',
+    'report-interval': 5
+};
+
+// ================== WORKER: VIRTUAL DEVICES ==================
+
+/**
+ * Counters and latency samples of one worker, shipped to the main thread
+ * and reset on every report.
+ */
+class Recorder {
+    constructor() {
+        this.reset();
+    }
+
+    reset() {
+        this.counters = {};
+        this.samples  = {};
+    }
+
+    inc(name, n = 1) {
+        this.counters[name] = (this.counters[name] || 0) + n;
+    }
+
+    sample(name, ms) {
+        (this.samples[name] = this.samples[name] || []).push(ms);
+    }
+
+    take() {
+        const out = { counters: this.counters, samples: this.samples };
+        this.reset();
+        return out;
+    }
+}
+
+const nowMs = () => Number(process.hrtime.bigint()) / 1e6;
+
+/**
+ * PublishGovernor (espSensor/PublishGovernor.hpp) for one device: per key,
+ * the value last sent and the newest one waiting; a token bucket shared by
+ * all keys. Values are compared directly instead of by hash.
+ */
+class Governor {
+    constructor(rec) {
+        this.rec      = rec;
+        this.slots    = new Map();
+        this.tokens   = FIRMWARE.burst;
+        this.refillAt = 0;
+    }
+
+    refill(now) {
+        if (this.tokens === FIRMWARE.burst) {
+            this.refillAt = now;
+            return;
+        }
+        const earned = Math.floor((now - this.refillAt) / FIRMWARE.refillMs);
+        if (earned === 0) return;
+        this.refillAt += earned * FIRMWARE.refillMs;
+        this.tokens = Math.min(FIRMWARE.burst, this.tokens + earned);
+        if (this.tokens === FIRMWARE.burst) this.refillAt = now;
+    }
+
+    // 'queued', 'suppressed' or 'bypass', as PublishGovernor::submit()
+    submit(topic, key, value, payload, force) {
+        if (payload.length >= FIRMWARE.payloadSize) return 'bypass';
+        let s = this.slots.get(key);
+        if (!s) this.slots.set(key, (s = { topic, sent: null, value: null, payload: null, pending: false }));
+
+        if (!force && s.sent === value) {
+            this.rec.inc(s.pending ? 'coalesced' : 'suppressed');
+            s.pending = false;
+            return 'suppressed';
+        }
+        if (s.pending) this.rec.inc('coalesced');
+        s.value   = value;
+        s.payload = payload;
+        s.pending = true;
+        return 'queued';
+    }
+
+    next(now) {
+        this.refill(now);
+        if (this.tokens === 0) return null;
+        for (const s of this.slots.values()) if (s.pending) return s;
+        return null;
+    }
+
+    done(s, ok) {
+        if (!ok) return;
+        if (this.tokens > 0) this.tokens--;
+        s.sent    = s.value;
+        s.pending = false;
+    }
+
+    hasPending() {
+        for (const s of this.slots.values()) if (s.pending) return true;
+        return false;
+    }
+
+    msUntilToken(now) {
+        if (this.tokens > 0) return 0;
+        const since = now - this.refillAt;
+        return since >= FIRMWARE.refillMs ? 0 : FIRMWARE.refillMs - since;
+    }
+
+    forgetSent() {
+        for (const s of this.slots.values()) s.sent = null;
+    }
+}
+
+/**
+ * One MQTT connection with the firmware's reconnect behaviour.
+ */
+class VirtualDevice {
+    constructor(ctx, home, clientId, kind) {
+        this.ctx       = ctx;
+        this.kind      = kind;    // Counter name of its shadow writes
+        this.home      = home;
+        this.clientId  = clientId;
+        this.client    = null;
+        this.connected = false;
+        this.booted    = false;   // First connection done (setup() ran)
+        this.governor  = new Governor(ctx.rec);
+        this.flushTimer = null;
+    }
+
+    start() {
+        this.connect();
+    }
+
+    async connect() {
+        const { opts, rec } = this.ctx;
+        const client = new MqttClient({ host: opts.host, port: opts.port, clientId: this.clientId, keepAlive: KEEPALIVE_S });
+        this.client = client;
+
+        client.on('message', (topic, payload) => this.onMessage(topic, payload));
+        client.on('close', () => {
+            if (this.connected) rec.inc('disconnects');
+            this.connected = false;
+            if (!this.ctx.stopping && this.client === client) {
+                setTimeout(() => this.connect(), RECONNECT_MS);
+            }
+        });
+
+        try {
+            await client.connect();
+        } catch (err) {
+            rec.inc('connectErrors');
+            return;   // 'close' schedules the retry
+        }
+
+        this.connected = true;
+        rec.inc(this.booted ? 'reconnects' : 'connects');
+        this.governor.forgetSent();
+        const first = !this.booted;
+        this.booted = true;
+        await this.onConnected(first);
+        this.flushStates();
+    }
+
+    publish(topic, payload, kind) {
+        if (!this.connected) {
+            this.ctx.rec.inc('publishSkipped');
+            return false;
+        }
+        this.client.publish(topic, payload);
+        this.ctx.rec.inc(`pub.${kind}`);
+        this.ctx.rec.inc('bytesOut', payload.length);
+        return true;
+    }
+
+    // MqttClient::publishState(): shadow writes through the governor
+    publishState(key, value, payload, force = false) {
+        const verdict = this.governor.submit(this.home.updateTopic, key, value, payload, force);
+        if (verdict === 'bypass') this.publish(this.home.updateTopic, payload, this.kind);
+        else if (verdict === 'queued') this.flushStates();
+    }
+
+    // MqttClient::flushStates(), rerun when the next token is due (the
+    // firmware's loop() wakes for it)
+    flushStates() {
+        if (!this.connected || this.ctx.stopping) return;
+        let slot;
+        while ((slot = this.governor.next(nowMs())) !== null) {
+            const ok = this.publish(slot.topic, slot.payload, this.kind);
+            this.governor.done(slot, ok);
+            if (!ok) break;
+        }
+        if (this.governor.hasPending() && !this.flushTimer) {
+            this.flushTimer = setTimeout(() => {
+                this.flushTimer = null;
+                this.flushStates();
+            }, Math.max(1, this.governor.msUntilToken(nowMs())));
+        }
+    }
+
+    stop() {
+        clearTimeout(this.flushTimer);
+        if (this.client) this.client.end();
+    }
+
+    async onConnected() {}
+
+    onMessage() {}
+}
+
+/**
+ * EspSensor: reports exteriorDoor on boot and on every change, publishes
+ * telemetry periodically, listens on its OTA topic.
+ */
+class VirtualSensor extends VirtualDevice {
+    constructor(ctx, home) {
+        super(ctx, home, ctx.opts['shared-client-ids'] ? SENSOR_CLIENT_ID : `${SENSOR_CLIENT_ID}_${home.index}`, 'sensor');
+        this.telemetryTopic = `${home.thing}/telemetry/${this.clientId}`;
+        this.otaTopic       = `${home.thing}/ota/${this.clientId}`;
+        this.isOpen         = false;   // Debounced state, as reported
+        this.rawOpen        = false;   // Contact
+        this.target         = false;   // Door, before the bounces
+        this.debounceTimer  = null;
+        this.telemetryTimer = null;
+    }
+
+    async onConnected(first) {
+        await this.client.subscribe(this.otaTopic);
+        if (!first) return;
+
+        this.reportState();
+        const interval = this.ctx.opts['telemetry-ms'];
+        if (interval > 0) {
+            const payload = Buffer.alloc(FIRMWARE.telemetryBytes, 0xa0);
+            this.telemetryTimer = setInterval(() => this.publish(this.telemetryTopic, payload, 'telemetry'), interval);
+        }
+    }
+
+    doorEvent(open) {
+        if (open === this.target) return;
+        this.target = open;
+        this.contact(open);
+        for (let i = 1; i <= 2 * this.ctx.opts.bounces; i++) {
+            this.ctx.timers.push(setTimeout(() => this.contact(i % 2 ? !open : open), i));
+        }
+    }
+
+    // DebounceFilter: a change counts once the contact is stable for debounceMs
+    contact(open) {
+        if (open === this.rawOpen) return;
+        this.rawOpen = open;
+        this.ctx.rec.inc('edges');
+        clearTimeout(this.debounceTimer);
+        this.debounceTimer = setTimeout(() => {
+            if (this.rawOpen === this.isOpen || this.ctx.stopping) return;
+            this.isOpen = this.rawOpen;
+            this.ctx.rec.inc('doorEvents');
+            this.reportState();
+        }, FIRMWARE.debounceMs);
+    }
+
+    reportState() {
+        const value = this.isOpen ? 'OPEN' : 'CLOSE';
+        const out   = JSON.stringify({ state: { reported: { exteriorDoor: value } } });
+        this.publishState('exteriorDoor', value, out);
+    }
+
+    stop() {
+        clearInterval(this.telemetryTimer);
+        clearTimeout(this.debounceTimer);
+        super.stop();
+    }
+}
+
+/**
+ * EspActuator: subscribes to the delta topic, moves the servo and reports
+ * interiorDoor back.
+ */
+class VirtualActuator extends VirtualDevice {
+    constructor(ctx, home) {
+        super(ctx, home, ctx.opts['shared-client-ids'] ? ACTUATOR_CLIENT_ID : `${ACTUATOR_CLIENT_ID}_${home.index}`, 'actuator');
+        this.otaTopic = `${home.thing}/ota/${this.clientId}`;
+    }
+
+    async onConnected() {
+        await this.client.subscribe([this.home.deltaTopic, this.otaTopic]);
+    }
+
+    onMessage(topic, payload) {
+        const { rec, opts } = this.ctx;
+        if (topic === this.otaTopic) return;
+
+        rec.inc('deltas');
+        let doc;
+        let doorState;
+        try {
+            doc = JSON.parse(payload.toString());
+            doorState = doc.state && (doc.state.interiorDoor || (doc.state.desired && doc.state.desired.interiorDoor));
+        } catch (err) {
+            rec.inc('deltaParseErrors');
+            return;
+        }
+        if (!doorState) return;
+
+        const pending = this.home.pending;
+        if (pending && pending.value === doorState) rec.sample('deltaDelivery', nowMs() - pending.t0);
+
+        const token = doc.clientToken;
+        const actuate = () => {
+            const reported = { state: { reported: { interiorDoor: doorState } } };
+            if (token) reported.clientToken = token;
+            // Forced: a delta is always acked, even with the value sent last
+            this.publishState('interiorDoor', doorState, JSON.stringify(reported), true);
+            if (pending && this.home.pending === pending && pending.value === doorState) {
+                rec.sample('deltaToActuation', nowMs() - pending.t0);
+                this.home.pending = null;
+            }
+        };
+        if (opts['servo-ms'] > 0) setTimeout(actuate, opts['servo-ms']);
+        else actuate();
+    }
+}
+
+/**
+ * Door events for one home according to --events.
+ */
+function scheduleDoorEvents(ctx, home) {
+    const { opts } = ctx;
+    const later = (s, fn) => {
+        if (!ctx.stopping) ctx.timers.push(setTimeout(fn, s * 1000));
+    };
+    const closeLater = () => later(expRandom(opts.dwell), () => home.sensor.doorEvent(false));
+
+    if (opts.events === 'poisson') {
+        const next = () => later(expRandom(1 / opts.rate), () => {
+            home.sensor.doorEvent(true);
+            later(expRandom(opts.dwell), () => {
+                home.sensor.doorEvent(false);
+                next();
+            });
+        });
+        next();
+    } else if (opts.events === 'diurnal') {
+        // Thinning of a Poisson process at the peak rate
+        const peak = 2 * opts.rate;
+        const next = () => later(expRandom(1 / peak), () => {
+            const t = (Date.now() - ctx.startedAt) / 1000;
+            const rate = opts.rate * (1 + Math.sin(2 * Math.PI * t / opts.period));
+            if (Math.random() < rate / peak) {
+                home.sensor.doorEvent(true);
+                later(expRandom(opts.dwell), () => {
+                    home.sensor.doorEvent(false);
+                    next();
+                });
+            } else {
+                next();
+            }
+        });
+        next();
+    } else if (opts.events === 'burst') {
+        const tick = () => {
+            if (Math.random() < opts['burst-fraction']) {
+                later(Math.random() * opts['burst-window'], () => {
+                    home.sensor.doorEvent(true);
+                    closeLater();
+                });
+            }
+            later(opts['burst-every'], tick);
+        };
+        later(opts['burst-every'], tick);
+    } else {
+        throw new Error(`unknown --events ${opts.events}`);
+    }
+}
+
+/**
+ * Lambda-side invocations for one home (index.js setInteriorDoorDesired /
+ * getShadow over the shadow REST API).
+ */
+function scheduleCommands(ctx, home) {
+    const { opts, rec, agent } = ctx;
+    if (!(opts.commands > 0)) return;
+
+    const request = (method, body, kind, onDone) => {
+        const t0  = nowMs();
+        const req = http.request({
+            host: opts.host, port: opts['http-port'], agent, method,
+            path: `/things/${encodeURIComponent(home.thing)}/shadow`,
+            headers: body ? { 'Content-Type': 'application/json', 'Content-Length': Buffer.byteLength(body) } : {}
+        }, (res) => {
+            res.resume();
+            res.on('end', () => {
+                rec.sample(`rest.${kind}`, nowMs() - t0);
+                if (res.statusCode !== 200 && !(kind === 'get' && res.statusCode === 404)) rec.inc('restErrors');
+                if (onDone) onDone();
+            });
+        });
+        req.on('error', () => rec.inc('restErrors'));
+        req.end(body);
+    };
+
+    const next = () => {
+        if (ctx.stopping) return;
+        ctx.timers.push(setTimeout(() => {
+            if (Math.random() < opts['read-ratio']) {
+                request('GET', null, 'get');
+            } else {
+                home.desired = home.desired === 'OPEN' ? 'CLOSE' : 'OPEN';
+                const body = JSON.stringify({ state: { desired: { interiorDoor: home.desired } } });
+                home.pending = { value: home.desired, t0: nowMs() };
+                rec.inc('commands');
+                request('POST', body, 'update');
+            }
+            next();
+        }, expRandom(1 / opts.commands) * 1000));
+    };
+    next();
+}
+
+function runWorker() {
+    const { opts, homes, connectDelayMs } = workerData;
+    const ctx = {
+        opts,
+        rec: new Recorder(),
+        agent: new http.Agent({ keepAlive: true, maxSockets: 64 }),
+        timers: [],
+        stopping: false,
+        startedAt: Date.now()
+    };
+
+    const heapBefore = process.memoryUsage().heapUsed;
+    const all = homes.map((index) => {
+        const thing = `${opts['thing-prefix']}${index}`;
+        const home  = {
+            index,
+            thing,
+            updateTopic: `$aws/things/${thing}/shadow/update`,
+            deltaTopic:  `$aws/things/${thing}/shadow/update/delta`,
+            desired:     'CLOSE',
+            pending:     null
+        };
+        home.sensor   = new VirtualSensor(ctx, home);
+        home.actuator = new VirtualActuator(ctx, home);
+        return home;
+    });
+
+    // Connection ramp shared with the other workers via connectDelayMs
+    all.forEach((home, i) => {
+        ctx.timers.push(setTimeout(() => {
+            home.sensor.start();
+            home.actuator.start();
+            scheduleDoorEvents(ctx, home);
+            scheduleCommands(ctx, home);
+        }, i * connectDelayMs));
+    });
+
+    const report = () => {
+        const devices = all.length * 2;
+        const connected = all.reduce((n, h) => n + h.sensor.connected + h.actuator.connected, 0);
+        const heap = process.memoryUsage().heapUsed;
+        parentPort.postMessage({
+            type: 'report',
+            ...ctx.rec.take(),
+            connected,
+            devices,
+            heapPerClient: devices ? (heap - heapBefore) / devices : 0
+        });
+    };
+    const reportTimer = setInterval(report, 1000);
+
+    parentPort.on('message', (msg) => {
+        if (msg !== 'stop') return;
+        ctx.stopping = true;
+        ctx.timers.forEach(clearTimeout);
+        clearInterval(reportTimer);
+        report();
+        for (const home of all) {
+            home.sensor.stop();
+            home.actuator.stop();
+        }
+        ctx.agent.destroy();
+        parentPort.postMessage({ type: 'done' });
+    });
+}
+
+// ================== MAIN: AGGREGATION ==================
+
+function percentiles(values) {
+    if (values.length === 0) return null;
+    const v = Float64Array.from(values).sort();
+    const at = (p) => v[Math.max(0, Math.ceil(p * v.length) - 1)];
+    return { n: v.length, p50: at(0.5), p90: at(0.9), p99: at(0.99), max: v[v.length - 1] };
+}
+
+const fmtMs = (x) => (x < 10 ? x.toFixed(2) : x.toFixed(0));
+
+function parseArgs(argv) {
+    const opts = { ...DEFAULTS };
+    for (let i = 0; i < argv.length; i++) {
+        const key = argv[i].replace(/^--/, '');
+        if (!(key in DEFAULTS)) throw new Error(`unknown option ${argv[i]}`);
+        if (typeof DEFAULTS[key] === 'boolean') opts[key] = true;
+        else if (typeof DEFAULTS[key] === 'number') opts[key] = Number(argv[++i]);
+        else opts[key] = argv[++i];
+    }
+    return opts;
+}
+
+function runMain(argv) {
+    const opts    = parseArgs(argv);
+    const threads = Math.max(1, Math.min(opts.threads, opts.homes));
+    const rssBase = process.memoryUsage().rss;
+
+    console.log(`${opts.homes} homes (${opts.homes * 2} MQTT clients) on ${threads} threads -> ` +
+                `mqtt://${opts.host}:${opts.port}, rest :${opts['http-port']}, ` +
+                `events=${opts.events}, ${opts.duration} s`);
+    console.log(`firmware: governor burst ${FIRMWARE.burst} + 1/${FIRMWARE.refillMs} ms, ` +
+                `debounce ${FIRMWARE.debounceMs} ms, telemetry ${FIRMWARE.telemetryBytes} B ` +
+                `(worst ${FIRMWARE.telemetryMax} B) every ${opts['telemetry-ms']} ms`);
+
+    const totals   = {};
+    const window   = {};
+    const samples  = {};
+    const workers  = [];
+    const state    = new Map();   // worker -> { connected, devices, heapPerClient }
+    let finished   = 0;
+
+    // Each worker starts one home every threads / connect-rate * 2 seconds
+    const connectDelayMs = (1000 * threads * 2) / opts['connect-rate'];
+
+    for (let t = 0; t < threads; t++) {
+        const homes = [];
+        for (let i = t; i < opts.homes; i += threads) homes.push(i);
+
+        const w = new Worker(__filename, { workerData: { opts, homes, connectDelayMs } });
+        workers.push(w);
+
+        w.on('message', (msg) => {
+            if (msg.type === 'done') {
+                if (++finished === threads) summary();
+                return;
+            }
+            state.set(w, msg);
+            for (const [k, v] of Object.entries(msg.counters)) {
+                totals[k] = (totals[k] || 0) + v;
+                window[k] = (window[k] || 0) + v;
+            }
+            for (const [k, v] of Object.entries(msg.samples)) {
+                const s = (samples[k] = samples[k] || []);
+                for (const x of v) if (s.length < MAX_SAMPLES) s.push(x);
+            }
+        });
+        w.on('error', (err) => {
+            console.error(`worker ${t}: ${err.stack || err.message}`);
+            process.exitCode = 1;
+        });
+    }
+
+    const started = Date.now();
+    let last = started;
+
+    const progress = () => {
+        const now = Date.now();
+        const s   = (now - last) / 1000;
+        last = now;
+
+        let connected = 0;
+        let devices   = 0;
+        for (const st of state.values()) {
+            connected += st.connected;
+            devices   += st.devices;
+        }
+        const pubs = (window['pub.sensor'] || 0) + (window['pub.actuator'] || 0) + (window['pub.telemetry'] || 0);
+        const act  = percentiles(samples.deltaToActuation || []);
+        console.log(`t=${((now - started) / 1000).toFixed(0).padStart(4)}s conn=${connected}/${devices} ` +
+                    `pub=${(pubs / s).toFixed(1)}/s doors=${((window.doorEvents || 0) / s).toFixed(1)}/s ` +
+                    `cmds=${((window.commands || 0) / s).toFixed(1)}/s ` +
+                    (act ? `act p50=${fmtMs(act.p50)}ms p99=${fmtMs(act.p99)}ms ` : '') +
+                    `drops=${window.disconnects || 0} errs=${(window.connectErrors || 0) + (window.restErrors || 0)}`);
+        for (const k of Object.keys(window)) window[k] = 0;
+    };
+    const progressTimer = setInterval(progress, opts['report-interval'] * 1000);
+
+    setTimeout(() => {
+        clearInterval(progressTimer);
+        for (const w of workers) w.postMessage('stop');
+    }, opts.duration * 1000);
+
+    function summary() {
+        const elapsed = (Date.now() - started) / 1000;
+        const clients = opts.homes * 2;
+        const rate    = (k) => ((totals[k] || 0) / elapsed).toFixed(1);
+
+        console.log('\n===== fleet summary =====');
+        console.log(`duration ${elapsed.toFixed(1)} s, ${clients} clients`);
+        console.log(`connects ${totals.connects || 0}, reconnects ${totals.reconnects || 0}, ` +
+                    `disconnects ${totals.disconnects || 0}, connect errors ${totals.connectErrors || 0}`);
+        console.log(`publish/s: sensor ${rate('pub.sensor')}, actuator ${rate('pub.actuator')}, ` +
+                    `telemetry ${rate('pub.telemetry')} (${((totals.bytesOut || 0) / elapsed / 1024).toFixed(1)} KiB/s), ` +
+                    `skipped while offline ${totals.publishSkipped || 0}`);
+        console.log(`shadow writes suppressed ${totals.suppressed || 0}, coalesced ${totals.coalesced || 0}; ` +
+                    `contact edges ${totals.edges || 0}`);
+        console.log(`door events ${totals.doorEvents || 0}, commands ${totals.commands || 0}, ` +
+                    `deltas received ${totals.deltas || 0}, REST errors ${totals.restErrors || 0}`);
+
+        console.log('latency (ms)            n      p50      p90      p99      max');
+        for (const name of ['deltaDelivery', 'deltaToActuation', 'rest.update', 'rest.get']) {
+            const p = percentiles(samples[name] || []);
+            if (!p) continue;
+            console.log(`${name.padEnd(18)} ${String(p.n).padStart(7)} ${fmtMs(p.p50).padStart(8)} ` +
+                        `${fmtMs(p.p90).padStart(8)} ${fmtMs(p.p99).padStart(8)} ${fmtMs(p.max).padStart(8)}`);
+        }
+
+        let heap = 0;
+        for (const st of state.values()) heap += st.heapPerClient * st.devices;
+        const rss = process.memoryUsage().rss - rssBase;
+        console.log(`memory per client: heap ${(heap / clients / 1024).toFixed(1)} KiB, ` +
+                    `process RSS ${(rss / clients / 1024).toFixed(1)} KiB (includes ${threads} worker isolates)`);
+        process.exit(process.exitCode || 0);
+    }
+}
+
+if (isMainThread) {
+    if (require.main === module) {
+        try {
+            runMain(process.argv.slice(2));
+        } catch (err) {
+            console.error(err.message);
+            process.exitCode = 1;
+        }
+    }
+} else {
+    runWorker();
+}
\ No newline at end of file
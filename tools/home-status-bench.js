@@ -0,0 +1,167 @@
+#!/usr/bin/env node
+// Latency of the "estado de la casa" intent (HomeStatusIntent in index.js)
+// versus the number of things of the user, against an in-process
+// tools/shadow-emulator.js, for several shadow fetch concurrencies.
+//
+//   NODE_PATH=<same as tools/skill-bench.js> \
+//   node tools/home-status-bench.js [--things 1,2,4,8,16,32] [--concurrency 1,8]
+//                                   [--requests 50] [--http-delay-ms 5]
+//                                   [--connect-delay-ms 20] [--shadow-mode named|classic]
+//
+// For every thing count N a user owns N things (user_thing.thing_names),
+// each with a thing_info item and both doors. Caches are off, so every
+// request pays the whole path: user lookup, one BatchGetItem for the
+// thing_info items, and N (classic) or 2N (named) shadow GETs with at most
+// SHADOW_FETCH_CONCURRENCY in flight. concurrency 1 is the serial baseline.
+//
+// Reported: p50/p99 handler latency per thing count and concurrency, plus
+// answers that reported a failed read.
+
+const http   = require('http');
+const path   = require('path');
+const { fork } = require('child_process');
+const { Emulator } = require('./shadow-emulator');
+const { requestEnvelope, summarize, connectDelayProxy } = require('./skill-bench');
+
+const DEFAULTS = {
+    things: '1,2,4,8,16,32',
+    concurrency: '1,8',
+    requests: 50,
+    'http-delay-ms': 5,
+    'connect-delay-ms': 20,
+    'shadow-mode': 'named'
+};
+
+const userOf  = (n) => `amzn1.ask.account.home-${n}`;
+const thingOf = (n, i) => `home-${n}-${i}`;
+
+// ================== CHILD (one container per concurrency) ==================
+
+async function child(opts) {
+    console.log = () => {};
+
+    const skill   = require(path.join(__dirname, '..', 'index.js'));
+    const results = {};
+
+    for (const n of opts.things) {
+        const samples = [];
+        let failed = 0;
+        // One warm-up request per thing count: opens the extra connections
+        for (let i = 0; i <= opts.requests; i++) {
+            const t0  = process.hrtime.bigint();
+            const out = await skill.handler(requestEnvelope(userOf(n), 'HomeStatusIntent'), {});
+            const ms  = Number(process.hrtime.bigint() - t0) / 1e6;
+            if (i === 0) continue;
+            samples.push(ms);
+            const speech = JSON.stringify(out);
+            if (speech.includes('No pude') || speech.includes('no pude')) failed++;
+        }
+        results[n] = { ...summarize(samples), failed };
+    }
+    process.send(results);
+}
+
+// ================== MAIN ==================
+
+function seed(emu, counts, mode) {
+    for (const n of counts) {
+        const things = Array.from({ length: n }, (_, i) => thingOf(n, i));
+        emu.items.putItem({
+            TableName: 'user_thing',
+            Item: { user_id: { S: userOf(n) }, thing_name: { S: things[0] }, thing_names: { SS: things } }
+        });
+        things.forEach((thing, i) => {
+            emu.items.putItem({
+                TableName: 'thing_info',
+                Item: {
+                    thing_name: { S: thing },
+                    alias:      { S: i === 0 ? 'casa' : `casa ${i + 1}` },
+                    doors:      { L: [{ S: 'interiorDoor' }, { S: 'exteriorDoor' }] }
+                }
+            });
+            const reported = { interiorDoor: i % 2 ? 'OPEN' : 'CLOSE', exteriorDoor: 'CLOSE' };
+            if (mode === 'named') {
+                for (const door of Object.keys(reported)) {
+                    emu.store.update(thing, door, Buffer.from(JSON.stringify({ state: { reported: { [door]: reported[door] } } })));
+                }
+            } else {
+                emu.store.update(thing, '', Buffer.from(JSON.stringify({ state: { reported } })));
+            }
+        });
+    }
+}
+
+function runChild(env, opts) {
+    return new Promise((resolve, reject) => {
+        const proc = fork(__filename, ['--child', JSON.stringify(opts)], {
+            env: { ...process.env, ...env },
+            stdio: ['ignore', 'ignore', 'inherit', 'ipc']
+        });
+        let result = null;
+        proc.on('message', (m) => { result = m; });
+        proc.on('error', reject);
+        proc.on('exit', (code) => (result ? resolve(result) : reject(new Error(`child exited with ${code}`))));
+    });
+}
+
+async function main(argv) {
+    const opts = { ...DEFAULTS };
+    for (let i = 0; i < argv.length; i++) {
+        if (!argv[i].startsWith('--')) throw new Error(`unexpected argument ${argv[i]}`);
+        opts[argv[i].slice(2)] = argv[++i];
+    }
+    const counts       = String(opts.things).split(',').map(Number);
+    const concurrences = String(opts.concurrency).split(',').map(Number);
+
+    const emu    = new Emulator({ httpDelayMs: Number(opts['http-delay-ms']) });
+    const server = http.createServer((req, res) => emu.handleHttp(req, res));
+    await new Promise((resolve) => server.listen(0, '127.0.0.1', resolve));
+    const proxy = connectDelayProxy(server.address().port, Number(opts['connect-delay-ms']));
+    await new Promise((resolve) => proxy.listen(0, '127.0.0.1', resolve));
+    const endpoint = `http://127.0.0.1:${proxy.address().port}`;
+
+    seed(emu, counts, opts['shadow-mode']);
+
+    console.log(`${opts.requests} requests per point, http delay ${opts['http-delay-ms']} ms, ` +
+                `connect delay ${opts['connect-delay-ms']} ms, ${opts['shadow-mode']} shadows, caches off`);
+
+    const env = {
+        IOT_ENDPOINT:          endpoint,
+        DYNAMODB_ENDPOINT:     endpoint,
+        SHADOW_MODE:           opts['shadow-mode'],
+        PREWARM:               'false',
+        THING_CACHE_TTL_MS:    '0',
+        SHADOW_CACHE_TTL_MS:   '0',
+        AWS_REGION:            process.env.AWS_REGION || 'us-east-1',
+        AWS_ACCESS_KEY_ID:     process.env.AWS_ACCESS_KEY_ID || 'bench',
+        AWS_SECRET_ACCESS_KEY: process.env.AWS_SECRET_ACCESS_KEY || 'bench'
+    };
+
+    const results = {};
+    for (const c of concurrences) {
+        results[c] = await runChild({ ...env, SHADOW_FETCH_CONCURRENCY: String(c) },
+                                    { things: counts, requests: Number(opts.requests) });
+    }
+
+    const header = concurrences.map((c) => `c=${c} p50/p99 (ms)`.padStart(20)).join('');
+    console.log(`\n things${header}   failed`);
+    for (const n of counts) {
+        const cells = concurrences.map((c) => {
+            const r = results[c][n];
+            return `${r.p50.toFixed(1)} / ${r.p99.toFixed(1)}`.padStart(20);
+        }).join('');
+        const failed = concurrences.reduce((sum, c) => sum + results[c][n].failed, 0);
+        console.log(`${String(n).padStart(7)}${cells} ${String(failed).padStart(8)}`);
+    }
+    proxy.close();
+    server.close();
+}
+
+if (require.main === module) {
+    const argv = process.argv.slice(2);
+    const run  = argv[0] === '--child' ? child(JSON.parse(argv[1])) : main(argv);
+    run.catch((err) => {
+        console.error(err.message);
+        process.exitCode = 1;
+    });
+}
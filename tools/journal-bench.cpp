@@ -0,0 +1,279 @@
+// Host benchmark of the sensor's event journal (espSensor/EventJournal.hpp)
+// on a RAM model of NOR flash: program can only clear bits, erase sets a
+// whole 4 KB sector back to 0xFF.
+//
+//   g++ -O2 -std=c++17 -I espSensor -o /tmp/journal-bench tools/journal-bench.cpp
+//   /tmp/journal-bench [records=5000000] [sectors=1024]
+//
+// Reported:
+//   append   ns per append (sector erases included) over `records` appends,
+//            wrapping the ring many times, and the erase count spread over
+//            the sectors (wear levelling)
+//   mount    time and flash reads to rebuild the state of a full ring
+//   query    seekSeq / seekTime / seekLast cost (reads, us) and full scan
+//            speed in records/s
+//   reply    JournalReply bytes per record, vs 16 in flash
+//   recovery torn record and torn sector erase: mount must resume after them
+//   unsynced seekTime with the unsynced records of reboots (seconds since
+//            boot, written before SNTP) interleaved among synced ones: it
+//            must find the same record as a linear scan
+// Flash timings are not modelled; multiply the read/erase counts by the
+// part's figures (e.g. ~45 ms per sector erase) to estimate device costs.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include <vector>
+#include <algorithm>
+#include "EventJournal.hpp"
+
+class RamFlash {
+public:
+    static constexpr uint32_t SECTOR_SIZE = 4096;
+
+    std::vector<uint8_t>  bytes;
+    std::vector<uint32_t> erases;     // Per sector
+    uint64_t reads = 0;
+
+    explicit RamFlash(uint32_t sectors) : bytes(sectors * SECTOR_SIZE, 0xFF), erases(sectors, 0) {}
+
+    uint32_t size() const { return bytes.size(); }
+
+    bool read(uint32_t offset, void* buf, size_t len) {
+        reads++;
+        memcpy(buf, &bytes[offset], len);
+        return true;
+    }
+
+    bool write(uint32_t offset, const void* buf, size_t len) {
+        const uint8_t* in = static_cast<const uint8_t*>(buf);
+        for (size_t i = 0; i < len; i++) bytes[offset + i] &= in[i];
+        return true;
+    }
+
+    bool erase(uint32_t offset) {
+        memset(&bytes[offset], 0xFF, SECTOR_SIZE);
+        erases[offset / SECTOR_SIZE]++;
+        return true;
+    }
+};
+
+typedef EventJournal<RamFlash> Journal;
+
+static const uint32_t T0 = 1718000000;   // Epoch of the first record
+
+static double nowNs() {
+    return std::chrono::duration<double, std::nano>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static void check(bool ok, const char* what) {
+    if (!ok) {
+        fprintf(stderr, "FAILED: %s\n", what);
+        exit(1);
+    }
+}
+
+// Time of record n: door events about a minute apart
+static uint32_t timeOf(uint32_t n) {
+    return T0 + n * 60 + (n * 2654435761u) % 61;
+}
+
+int main(int argc, char** argv) {
+    uint32_t records = argc > 1 ? strtoul(argv[1], nullptr, 10) : 5000000;
+    uint32_t sectors = argc > 2 ? strtoul(argv[2], nullptr, 10) : 1024;
+
+    RamFlash flash(sectors);
+    Journal  journal(&flash);
+    check(journal.mount(), "mount empty");
+
+    printf("journal: %u sectors (%u KB), %u slots, %zu-byte records, %u appends\n",
+           sectors, sectors * 4, journal.capacity(), JournalRecord::SIZE, records);
+
+    // ---------------------------------------------------------------- append
+    double t = nowNs();
+    for (uint32_t n = 0; n < records; n++) {
+        journal.append(JOURNAL_DOOR, n & 1, timeOf(n), n % 1000, JOURNAL_SYNCED);
+    }
+    double appendNs = (nowNs() - t) / records;
+    auto   wear     = std::minmax_element(flash.erases.begin(), flash.erases.end());
+    printf("append:   %.1f ns/record, %u erases, per sector min %u max %u\n",
+           appendNs, journal.eraseCount(), *wear.first, *wear.second);
+
+    // ----------------------------------------------------------------- mount
+    Journal mounted(&flash);
+    flash.reads = 0;
+    t = nowNs();
+    check(mounted.mount(), "mount full");
+    double mountUs = (nowNs() - t) / 1e3;
+    check(mounted.nextSequence() == records + 1, "next seq after mount");
+    check(mounted.size() == journal.size(), "size after mount");
+    check(mounted.last() == (int)((records - 1) & 1), "last value after mount");
+    printf("mount:    %.1f us, %llu reads, %u records retained\n",
+           mountUs, (unsigned long long)flash.reads, mounted.size());
+
+    // ----------------------------------------------------------------- query
+    uint32_t size   = mounted.size();
+    uint32_t oldest = records - size + 1;
+    const int Q     = 10000;
+    JournalRecord first = {};
+
+    flash.reads = 0;
+    t = nowNs();
+    for (int q = 0; q < Q; q++) {
+        uint32_t after = oldest + (uint32_t)(((uint64_t)q * 7919) % size);
+        uint32_t pos   = mounted.seekSeq(after);
+        mounted.scan(pos, [&](const JournalRecord& r) { first = r; return false; });
+        check(first.seq == after + 1, "seekSeq");
+    }
+    printf("seekSeq:  %.2f us, %.1f reads per query\n",
+           (nowNs() - t) / 1e3 / Q, (double)flash.reads / Q);
+
+    flash.reads = 0;
+    t = nowNs();
+    for (int q = 0; q < Q; q++) {
+        uint32_t n    = oldest - 1 + (uint32_t)(((uint64_t)q * 104729) % size);
+        uint32_t pos  = mounted.seekTime(timeOf(n));
+        mounted.scan(pos, [&](const JournalRecord& r) { first = r; return false; });
+        check(first.seq == n + 1, "seekTime");
+    }
+    printf("seekTime: %.2f us, %.1f reads per query\n",
+           (nowNs() - t) / 1e3 / Q, (double)flash.reads / Q);
+
+    t = nowNs();
+    uint32_t seen = 0;
+    for (int q = 0; q < Q; q++) {
+        mounted.scan(mounted.seekLast(10), [&](const JournalRecord&) { seen++; return true; });
+    }
+    check(seen == 10u * Q, "seekLast");
+    printf("last 10:  %.2f us per query\n", (nowNs() - t) / 1e3 / Q);
+
+    t = nowNs();
+    uint32_t scanned = 0;
+    uint32_t prev    = 0;
+    mounted.scan(0, [&](const JournalRecord& r) {
+        check(r.seq == prev + 1 || prev == 0, "scan order");
+        prev = r.seq;
+        scanned++;
+        return true;
+    });
+    double scanNs = nowNs() - t;
+    check(scanned == size, "full scan");
+    printf("scan:     %u records in %.1f ms, %.1f M records/s\n",
+           scanned, scanNs / 1e6, scanned / scanNs * 1e3);
+
+    // ----------------------------------------------------------------- reply
+    uint8_t      page[192];
+    JournalReply reply(page, sizeof(page), 1);
+    uint64_t     bytes = 0;
+    uint32_t     pages = 0;
+    mounted.scan(0, [&](const JournalRecord& r) {
+        if (!reply.add(r)) {
+            bytes += reply.finish(REPLY_MORE);
+            pages++;
+            reply.reset();
+            reply.add(r);
+        }
+        return true;
+    });
+    bytes += reply.finish(0);
+    pages++;
+    printf("reply:    %.2f bytes/record (headers included), %.1f records per %zu-byte page\n",
+           (double)bytes / scanned, (double)scanned / pages, sizeof(page));
+
+    // -------------------------------------------------------------- recovery
+    // Torn record: a program interrupted half way leaves a bad CRC
+    {
+        RamFlash small(4);
+        Journal  j(&small);
+        j.mount();
+        for (uint32_t n = 0; n < 300; n++) j.append(JOURNAL_DOOR, n & 1, timeOf(n), 0, JOURNAL_SYNCED);
+        uint32_t slot = 300;
+        small.bytes[slot * JournalRecord::SIZE]     = 0x12;   // Half-programmed slot
+        small.bytes[slot * JournalRecord::SIZE + 1] = 0x00;
+
+        Journal r(&small);
+        check(r.mount(), "mount torn record");
+        check(r.nextSequence() == 301, "torn record: next seq");
+        r.append(JOURNAL_DOOR, 1, timeOf(300), 0, JOURNAL_SYNCED);
+        uint32_t count = 0;
+        r.scan(0, [&](const JournalRecord&) { count++; return true; });
+        check(count == 301, "torn record: skipped, others kept");
+    }
+    // Torn erase: power lost while erasing the sector the head moved into
+    {
+        RamFlash small(4);
+        Journal  j(&small);
+        j.mount();
+        uint32_t n = 0;
+        for (; n < 4 * Journal::SLOTS_PER_SECTOR; n++) j.append(JOURNAL_DOOR, n & 1, timeOf(n), 0, JOURNAL_SYNCED);
+        // Sector 0 (oldest) is next; half of it is erased when power drops
+        memset(&small.bytes[0], 0xFF, 2048);
+
+        Journal r(&small);
+        check(r.mount(), "mount torn erase");
+        check(r.nextSequence() == n + 1, "torn erase: next seq");
+        check(r.append(JOURNAL_DOOR, 0, timeOf(n), 0, JOURNAL_SYNCED), "torn erase: append");
+        JournalRecord newest = {};
+        r.scan(r.seekLast(1), [&](const JournalRecord& rec) { newest = rec; return true; });
+        check(newest.seq == n + 1, "torn erase: newest record");
+    }
+    printf("recovery: torn record and torn erase OK\n");
+
+    // -------------------------------------------------------------- unsynced
+    // A reboot every 50-300 transitions, followed by 1-3 transitions before
+    // SNTP sets the clock
+    {
+        RamFlash small(64);
+        Journal  j(&small);
+        j.mount();
+        uint32_t n = 0, unsynced = 0, nextBoot = 0;
+        for (uint32_t i = 0; i < 3 * j.capacity(); i++) {
+            if (i == nextBoot) {
+                for (uint32_t k = 0; k <= i % 3; k++, unsynced++) {
+                    j.append(JOURNAL_DOOR, (n + k) & 1, 2 + 3 * k, 0, 0);
+                }
+                nextBoot = i + 50 + (i * 2654435761u) % 251;
+            }
+            j.append(JOURNAL_DOOR, n & 1, timeOf(n), 0, JOURNAL_SYNCED);
+            n++;
+        }
+
+        // Reference: first synced record with time >= from, by linear scan
+        std::vector<JournalRecord> all;
+        j.scan(0, [&](const JournalRecord& r) { all.push_back(r); return true; });
+        auto firstFrom = [](const JournalRecord& r, uint32_t from) {
+            return (r.flags & JOURNAL_SYNCED) && r.time >= from;
+        };
+
+        uint32_t oldestTime = 0;
+        for (const JournalRecord& r : all) {
+            if (r.flags & JOURNAL_SYNCED) {
+                oldestTime = r.time;
+                break;
+            }
+        }
+
+        small.reads = 0;
+        for (int q = 0; q < Q; q++) {
+            uint32_t from = oldestTime + (uint32_t)(((uint64_t)q * 104729) % (timeOf(n) - oldestTime + 60));
+            uint32_t expect = 0;
+            for (const JournalRecord& r : all) {
+                if (firstFrom(r, from)) {
+                    expect = r.seq;
+                    break;
+                }
+            }
+            uint32_t got = 0;
+            j.scan(j.seekTime(from), [&](const JournalRecord& r) {
+                if (!firstFrom(r, from)) return true;
+                got = r.seq;
+                return false;
+            });
+            check(got == expect, "seekTime with unsynced records");
+        }
+        printf("unsynced: %u of %zu records unsynced, seekTime %.1f reads per query, matches linear scan\n",
+               unsynced, all.size(), (double)small.reads / Q);
+    }
+    return 0;
+}
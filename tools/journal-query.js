@@ -0,0 +1,165 @@
+#!/usr/bin/env node
+// History query for the sensor's event journal (espSensor/JournalService.hpp).
+//
+//   node tools/journal-query.js --thing iot_thing --client ESP_CLIENT_SENSOR
+//        [--host 127.0.0.1] [--port 1883] [--last 10 | --after SEQ]
+//        [--from DATE] [--to DATE] [--max 200] [--all] [--json]
+//
+// Publishes one JSON query on <thing>/journal/<client> and decodes the
+// binary reply pages from <thing>/journal/<client>/reply. DATE is epoch
+// seconds or anything Date.parse() accepts. With --all, truncated answers
+// are followed up with after = last seq until the range is exhausted.
+
+const { MqttClient } = require('./lib/mqtt');
+
+const REPLY_MORE      = 0x01;
+const REPLY_TRUNCATED = 0x02;
+const JOURNAL_DOOR    = 1;
+
+// ================== DECODING ==================
+
+function readVarint(buf, at) {
+    let value = 0;
+    let shift = 0;
+    for (;;) {
+        if (at.pos >= buf.length) throw new Error('truncated varint');
+        const b = buf[at.pos++];
+        value += (b & 0x7f) * 2 ** shift;
+        if (!(b & 0x80)) return value;
+        shift += 7;
+    }
+}
+
+/**
+ * Decodes one JournalReply page (see espSensor/EventJournal.hpp):
+ * { id, more, truncated, records: [{ seq, time, type, open, synced }] }
+ */
+function decodeReply(buf) {
+    if (buf.length < 14 || buf[0] !== 1) throw new Error('not a journal reply');
+    const flags = buf[1];
+    const count = buf.readUInt16LE(4);
+    let seq     = buf.readUInt32LE(6) - 1;
+    let time    = buf.readUInt32LE(10);
+
+    const records = [];
+    const at = { pos: 14 };
+    for (let i = 0; i < count; i++) {
+        const code = buf[at.pos++];
+        const z    = readVarint(buf, at);
+        const dt   = z % 2 ? -(z + 1) / 2 : z / 2;
+        const gap  = code & 0x04 ? readVarint(buf, at) : 0;
+        seq  += gap + 1;
+        time += dt;
+        records.push({ seq, time, type: code >> 4, open: Boolean(code & 1), synced: Boolean(code & 2) });
+    }
+    return {
+        id:        buf.readUInt16LE(2),
+        more:      Boolean(flags & REPLY_MORE),
+        truncated: Boolean(flags & REPLY_TRUNCATED),
+        records
+    };
+}
+
+// ================== QUERY ==================
+
+/**
+ * Sends one query and resolves with { records, truncated, bytes } once the
+ * last page arrives.
+ */
+function query(client, topic, fields, timeoutMs) {
+    return new Promise((resolve, reject) => {
+        const records = [];
+        let bytes = 0;
+        const timer = setTimeout(() => {
+            client.removeListener('message', onMessage);
+            reject(new Error(`no reply on ${topic}/reply within ${timeoutMs} ms`));
+        }, timeoutMs);
+
+        function onMessage(t, payload) {
+            if (t !== `${topic}/reply`) return;
+            const page = decodeReply(payload);
+            if (page.id !== fields.id) return;
+            bytes += payload.length;
+            records.push(...page.records);
+            if (page.more) return;
+            clearTimeout(timer);
+            client.removeListener('message', onMessage);
+            resolve({ records, truncated: page.truncated, bytes });
+        }
+        client.on('message', onMessage);
+        client.publish(topic, JSON.stringify(fields));
+    });
+}
+
+function parseDate(s) {
+    if (s === undefined) return undefined;
+    if (/^\d+$/.test(s)) return Number(s);
+    const ms = Date.parse(s);
+    if (Number.isNaN(ms)) throw new Error(`bad date ${s}`);
+    return Math.floor(ms / 1000);
+}
+
+function format(r) {
+    const when = r.synced ? new Date(r.time * 1000).toISOString() : `boot+${r.time}s (clock not synced)`;
+    const what = r.type === JOURNAL_DOOR ? (r.open ? 'OPEN' : 'CLOSE') : `type ${r.type} value ${Number(r.open)}`;
+    return `${String(r.seq).padStart(8)}  ${when}  ${what}`;
+}
+
+// ================== CLI ==================
+
+async function main(argv) {
+    const opts = { host: '127.0.0.1', port: 1883, timeout: 5000, all: false, json: false };
+    for (let i = 0; i < argv.length; i++) {
+        if (argv[i] === '--all') opts.all = true;
+        else if (argv[i] === '--json') opts.json = true;
+        else if (argv[i].startsWith('--')) opts[argv[i].slice(2)] = argv[++i];
+        else throw new Error(`unexpected argument ${argv[i]}`);
+    }
+    if (!opts.thing || !opts.client) {
+        console.log('usage: journal-query.js --thing <thing> --client <clientId> [--last N | --after SEQ]\n' +
+                    '                        [--from DATE] [--to DATE] [--max N] [--all] [--json]');
+        process.exitCode = 1;
+        return;
+    }
+
+    const topic  = `${opts.thing}/journal/${opts.client}`;
+    const client = new MqttClient({ host: opts.host, port: Number(opts.port), clientId: `journal-query-${process.pid}` });
+    await client.connect();
+    await client.subscribe(`${topic}/reply`);
+
+    const fields = { id: process.pid & 0xffff };
+    for (const key of ['last', 'after', 'max']) {
+        if (opts[key] !== undefined) fields[key] = Number(opts[key]);
+    }
+    if (opts.from !== undefined) fields.from = parseDate(opts.from);
+    if (opts.to !== undefined)   fields.to   = parseDate(opts.to);
+
+    const records = [];
+    let bytes = 0;
+    for (;;) {
+        const res = await query(client, topic, fields, Number(opts.timeout));
+        records.push(...res.records);
+        bytes += res.bytes;
+        if (!res.truncated || !opts.all || !res.records.length) break;
+        fields.after = res.records[res.records.length - 1].seq;
+        fields.id    = (fields.id + 1) & 0xffff;
+        delete fields.last;
+    }
+    client.end();
+
+    if (opts.json) {
+        console.log(JSON.stringify(records));
+        return;
+    }
+    for (const r of records) console.log(format(r));
+    console.log(`${records.length} records, ${bytes} bytes`);
+}
+
+if (require.main === module) {
+    main(process.argv.slice(2)).catch((err) => {
+        console.error(err.message);
+        process.exitCode = 1;
+    });
+}
+
+module.exports = { decodeReply };
@@ -0,0 +1,209 @@
+#!/usr/bin/env node
+// Checks that a confirmed door command lets the Lambda container finish:
+// the skill's exports.handler is called the way the Lambda runtime calls it,
+// with a callback and context.callbackWaitsForEmptyEventLoop = true, where
+// the runtime only returns the response once the event loop is empty.
+// Anything left holding the loop (the shadowWatch.js connection, a timer)
+// turns every confirmed invocation into a Lambda timeout.
+//
+//   NODE_PATH=<dir with ask-sdk-core, @aws-sdk/client-iot-data-plane,
+//              @aws-sdk/client-dynamodb and @aws-sdk/lib-dynamodb> \
+//   node tools/lambda-exit-test.js [--timeout-ms 8000]
+//
+// An in-process tools/shadow-emulator.js serves the shadow REST API, the
+// DynamoDB stand-in and MQTT (TCP and WebSocket); a virtual actuator acks
+// every delta. The skill runs in a child process (one container) with
+// CONFIRM_ACTUATION=true, once per transport of shadowWatch.js:
+//   mqtt   IOT_MQTT_URL=mqtt://...
+//   ws     IOT_MQTT_URL=ws://.../mqtt (the wss:// path, without TLS)
+// Each run sends OpenInteriorDoorIntent, then CloseInteriorDoorIntent on the
+// warm connection. Checked per invocation: the callback brings the confirmed
+// speech, and the event loop empties within --timeout-ms of it (the skill's
+// Lambda timeout). Reported: handler time and callback-to-empty-loop time.
+
+const http = require('http');
+const net  = require('net');
+const path = require('path');
+const { fork } = require('child_process');
+const { Emulator } = require('./shadow-emulator');
+const { MqttClient } = require('./lib/mqtt');
+const { requestEnvelope } = require('./skill-bench');
+
+const USER  = 'amzn1.ask.account.exit-test';
+const THING = 'home-exit-test';
+
+const DEFAULTS = { 'timeout-ms': 8000 };
+
+// ================== CHILD (one container) ==================
+
+function child() {
+    console.log = console.info = console.warn = console.error = console.debug = () => {};
+
+    const skill   = require(path.join(__dirname, '..', 'index.js'));
+    const intents = ['OpenInteriorDoorIntent', 'CloseInteriorDoorIntent'];
+    const results = [];
+    let finished  = false;
+
+    // The IPC channel must not count as work left in the event loop
+    process.channel.unref();
+
+    const invoke = () => {
+        const intent  = intents[results.length];
+        const context = { callbackWaitsForEmptyEventLoop: true, functionName: 'lambda-exit-test' };
+        const t0      = process.hrtime.bigint();
+        skill.handler(requestEnvelope(USER, intent), context, (err, response) => {
+            results.push({
+                intent,
+                error:       err ? err.message : null,
+                response:    JSON.stringify(response || null),
+                handlerMs:   Number(process.hrtime.bigint() - t0) / 1e6,
+                calledAt:    process.hrtime.bigint(),
+                emptyLoopMs: null
+            });
+        });
+    };
+
+    // 'beforeExit' fires each time the loop runs out of work: the moment the
+    // runtime would hand the response back
+    process.on('beforeExit', () => {
+        if (finished) return;
+        const last = results[results.length - 1];
+        if (!last || last.emptyLoopMs !== null) {
+            // Nothing left to run and still no callback
+            finished = true;
+            process.send({ intent: intents[results.length], error: 'callback never called', response: 'null',
+                           handlerMs: 0, emptyLoopMs: 0 });
+            process.disconnect();
+            return;
+        }
+        last.emptyLoopMs = Number(process.hrtime.bigint() - last.calledAt) / 1e6;
+        delete last.calledAt;
+        process.send(last);
+        if (results.length < intents.length) {
+            invoke();
+        } else {
+            finished = true;
+            process.disconnect();
+        }
+    });
+    invoke();
+}
+
+// ================== MAIN ==================
+
+/**
+ * Actuator stand-in: reports every desired interiorDoor it receives.
+ */
+async function startActuator(port) {
+    const prefix = `$aws/things/${THING}/shadow/name/interiorDoor`;
+    const client = new MqttClient({ port, clientId: 'exit-test-actuator' });
+    await client.connect();
+    client.on('message', (topic, payload) => {
+        const state = JSON.parse(payload.toString()).state || {};
+        if (!state.interiorDoor) return;
+        client.publish(`${prefix}/update`, JSON.stringify({ state: { reported: { interiorDoor: state.interiorDoor } } }));
+    });
+    await client.subscribe(`${prefix}/update/delta`);
+    return client;
+}
+
+function runContainer(name, env, timeoutMs) {
+    return new Promise((resolve) => {
+        const proc = fork(__filename, ['--child'], {
+            env: { ...process.env, ...env },
+            stdio: ['ignore', 'ignore', 'inherit', 'ipc']
+        });
+        const invocations = [];
+        let stalled = false;
+        let timer = null;
+        const arm = () => {
+            clearTimeout(timer);
+            timer = setTimeout(() => {
+                stalled = true;
+                proc.kill();
+            }, timeoutMs);
+        };
+        proc.on('message', (m) => {
+            invocations.push(m);
+            arm();
+        });
+        proc.on('exit', () => {
+            clearTimeout(timer);
+            resolve({ name, invocations, stalled });
+        });
+        arm();
+    });
+}
+
+async function main(argv) {
+    const opts = { ...DEFAULTS };
+    for (let i = 0; i < argv.length; i++) {
+        const key = argv[i].replace(/^--/, '');
+        if (!(key in DEFAULTS)) throw new Error(`unknown option ${argv[i]}`);
+        opts[key] = Number(argv[++i]);
+    }
+
+    const emu = new Emulator();
+    emu.items.putItem({ TableName: 'user_thing', Item: { user_id: { S: USER }, thing_name: { S: THING } } });
+    for (const door of ['interiorDoor', 'exteriorDoor']) {
+        emu.store.update(THING, door, Buffer.from(JSON.stringify({ state: { reported: { [door]: 'CLOSE' } } })));
+    }
+
+    const mqttServer = net.createServer((s) => emu.attach(s));
+    const httpServer = http.createServer((req, res) => emu.handleHttp(req, res));
+    httpServer.on('upgrade', (req, socket, head) => emu.upgrade(req, socket, head));
+    await new Promise((resolve) => mqttServer.listen(0, '127.0.0.1', resolve));
+    await new Promise((resolve) => httpServer.listen(0, '127.0.0.1', resolve));
+    const mqttPort = mqttServer.address().port;
+    const httpPort = httpServer.address().port;
+    const actuator = await startActuator(mqttPort);
+
+    const baseEnv = {
+        IOT_ENDPOINT:          `http://127.0.0.1:${httpPort}`,
+        DYNAMODB_ENDPOINT:     `http://127.0.0.1:${httpPort}`,
+        SHADOW_MODE:           'named',
+        CONFIRM_ACTUATION:     'true',
+        PREWARM:               'false',
+        AWS_REGION:            process.env.AWS_REGION || 'us-east-1',
+        AWS_ACCESS_KEY_ID:     process.env.AWS_ACCESS_KEY_ID || 'test',
+        AWS_SECRET_ACCESS_KEY: process.env.AWS_SECRET_ACCESS_KEY || 'test'
+    };
+    const transports = [
+        ['mqtt', `mqtt://127.0.0.1:${mqttPort}`],
+        ['ws',   `ws://127.0.0.1:${httpPort}/mqtt`]
+    ];
+
+    let failed = false;
+    for (const [name, url] of transports) {
+        const run = await runContainer(name, { ...baseEnv, IOT_MQTT_URL: url }, opts['timeout-ms']);
+        for (const inv of run.invocations) {
+            const confirmed = !inv.error && inv.response.includes('Listo');
+            if (!confirmed) failed = true;
+            console.log(`${name.padEnd(5)} ${inv.intent.padEnd(24)} handler ${inv.handlerMs.toFixed(1).padStart(7)} ms, ` +
+                        `empty loop ${inv.emptyLoopMs.toFixed(1).padStart(7)} ms after the callback` +
+                        (confirmed ? '' : `  FAIL: not confirmed (${inv.error || inv.response})`));
+        }
+        if (run.stalled || run.invocations.length < 2) {
+            failed = true;
+            console.log(`${name.padEnd(5)} FAIL: event loop still busy ${opts['timeout-ms']} ms after ` +
+                        `invocation ${run.invocations.length + 1}: the Lambda would time out`);
+        }
+    }
+
+    actuator.end();
+    mqttServer.close();
+    httpServer.close();
+    console.log(failed ? 'FAILED' : 'ok');
+    process.exit(failed ? 1 : 0);
+}
+
+if (require.main === module) {
+    if (process.argv[2] === '--child') {
+        child();
+    } else {
+        main(process.argv.slice(2)).catch((err) => {
+            console.error(err.message);
+            process.exitCode = 1;
+        });
+    }
+}
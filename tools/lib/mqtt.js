@@ -0,0 +1,298 @@
+// Minimal MQTT 3.1.1 codec + client, no dependencies.
+// Shared by the local tools (shadow emulator, load simulator, ...).
+// Only what the devices and tools use is implemented: QoS 0/1 publish,
+// subscribe/unsubscribe with wildcards, ping, clean sessions.
+
+const net          = require('net');
+const tls          = require('tls');
+const EventEmitter = require('events');
+
+const TYPE = {
+    CONNECT: 1, CONNACK: 2, PUBLISH: 3, PUBACK: 4,
+    SUBSCRIBE: 8, SUBACK: 9, UNSUBSCRIBE: 10, UNSUBACK: 11,
+    PINGREQ: 12, PINGRESP: 13, DISCONNECT: 14
+};
+
+// ================== ENCODING ==================
+
+function encodeLength(n) {
+    const bytes = [];
+    do {
+        let digit = n % 128;
+        n = Math.floor(n / 128);
+        if (n > 0) digit |= 0x80;
+        bytes.push(digit);
+    } while (n > 0);
+    return Buffer.from(bytes);
+}
+
+function encodeString(s) {
+    const str = Buffer.from(s, 'utf8');
+    const len = Buffer.alloc(2);
+    len.writeUInt16BE(str.length, 0);
+    return Buffer.concat([len, str]);
+}
+
+function packet(type, flags, body) {
+    return Buffer.concat([Buffer.from([(type << 4) | flags]), encodeLength(body.length), body]);
+}
+
+function encodeConnect(clientId, keepAliveS = 60) {
+    const head = Buffer.concat([
+        encodeString('MQTT'),
+        Buffer.from([4, 0x02, keepAliveS >> 8, keepAliveS & 0xff])   // level 4, clean session
+    ]);
+    return packet(TYPE.CONNECT, 0, Buffer.concat([head, encodeString(clientId)]));
+}
+
+function encodePublish(topic, payload, qos = 0, packetId = 0) {
+    const parts = [encodeString(topic)];
+    if (qos > 0) parts.push(Buffer.from([packetId >> 8, packetId & 0xff]));
+    parts.push(Buffer.isBuffer(payload) ? payload : Buffer.from(payload));
+    return packet(TYPE.PUBLISH, qos << 1, Buffer.concat(parts));
+}
+
+function encodeSubscribe(packetId, topics) {
+    const parts = [Buffer.from([packetId >> 8, packetId & 0xff])];
+    for (const t of topics) parts.push(encodeString(t), Buffer.from([0]));
+    return packet(TYPE.SUBSCRIBE, 0x02, Buffer.concat(parts));
+}
+
+// Acks that only carry the packet id (PUBACK, UNSUBACK)
+const encodeAck = (type, packetId) => packet(type, 0, Buffer.from([packetId >> 8, packetId & 0xff]));
+
+// ================== DECODING ==================
+
+/**
+ * Reassembles packets from a byte stream. push() returns the complete
+ * packets as { type, flags, body }.
+ */
+class PacketParser {
+    constructor() {
+        this.buf = Buffer.alloc(0);
+    }
+
+    push(chunk) {
+        this.buf = this.buf.length ? Buffer.concat([this.buf, chunk]) : chunk;
+        const out = [];
+
+        for (;;) {
+            if (this.buf.length < 2) break;
+            let len = 0;
+            let mult = 1;
+            let i = 1;
+            let digit;
+            do {
+                if (i >= this.buf.length) return out;
+                digit = this.buf[i++];
+                len += (digit & 0x7f) * mult;
+                mult *= 128;
+            } while (digit & 0x80);
+
+            if (this.buf.length < i + len) break;
+            out.push({
+                type:  this.buf[0] >> 4,
+                flags: this.buf[0] & 0x0f,
+                body:  this.buf.subarray(i, i + len)
+            });
+            this.buf = this.buf.subarray(i + len);
+        }
+        return out;
+    }
+}
+
+function readString(buf, pos) {
+    const len = buf.readUInt16BE(pos);
+    return [buf.toString('utf8', pos + 2, pos + 2 + len), pos + 2 + len];
+}
+
+function decodeConnect(body) {
+    let [, pos] = readString(body, 0);          // protocol name
+    const flags     = body[pos + 1];
+    const keepAlive = body.readUInt16BE(pos + 2);
+    pos += 4;
+    const [clientId] = readString(body, pos);
+    return { clientId, keepAlive, cleanSession: !!(flags & 0x02) };
+}
+
+function decodePublish(pkt) {
+    const qos = (pkt.flags >> 1) & 0x03;
+    let [topic, pos] = readString(pkt.body, 0);
+    let packetId = 0;
+    if (qos > 0) {
+        packetId = pkt.body.readUInt16BE(pos);
+        pos += 2;
+    }
+    return { topic, qos, packetId, retain: !!(pkt.flags & 1), payload: pkt.body.subarray(pos) };
+}
+
+function decodeSubscribe(body) {
+    const packetId = body.readUInt16BE(0);
+    const topics = [];
+    let pos = 2;
+    while (pos < body.length) {
+        const [topic, next] = readString(body, pos);
+        topics.push({ topic, qos: body[next] });
+        pos = next + 1;
+    }
+    return { packetId, topics };
+}
+
+function decodeUnsubscribe(body) {
+    const packetId = body.readUInt16BE(0);
+    const topics = [];
+    let pos = 2;
+    while (pos < body.length) {
+        const [topic, next] = readString(body, pos);
+        topics.push(topic);
+        pos = next;
+    }
+    return { packetId, topics };
+}
+
+/**
+ * MQTT topic filter match with '+' and '#'.
+ */
+function topicMatches(filter, topic) {
+    if (filter === topic) return true;
+    const f = filter.split('/');
+    const t = topic.split('/');
+    for (let i = 0; i < f.length; i++) {
+        if (f[i] === '#') return true;
+        if (i >= t.length) return false;
+        if (f[i] !== '+' && f[i] !== t[i]) return false;
+    }
+    return f.length === t.length;
+}
+
+// ================== CLIENT ==================
+
+/**
+ * Small promise-based client. Events: 'message' (topic, payload), 'close'.
+ *
+ *   const c = new MqttClient({ host, port, clientId });
+ *   await c.connect();
+ *   await c.subscribe(['a/+']);
+ *   c.publish('a/b', '{}');
+ */
+class MqttClient extends EventEmitter {
+    constructor({ host = '127.0.0.1', port = 1883, clientId, keepAlive = 60, tlsOptions = null }) {
+        super();
+        this.host       = host;
+        this.port       = port;
+        this.clientId   = clientId;
+        this.keepAlive  = keepAlive;
+        this.tlsOptions = tlsOptions;
+        this.parser     = new PacketParser();
+        this.nextId     = 1;
+        this.pending    = new Map();   // packetId -> resolve
+        this.socket     = null;
+        this.pingTimer  = null;
+    }
+
+    connect() {
+        return new Promise((resolve, reject) => {
+            const onConnect = () => this.socket.write(encodeConnect(this.clientId, this.keepAlive));
+            this.socket = this.tlsOptions
+                ? tls.connect({ host: this.host, port: this.port, ...this.tlsOptions }, onConnect)
+                : net.connect({ host: this.host, port: this.port }, onConnect);
+            this.socket.setNoDelay(true);
+
+            this.connackResolve = resolve;
+            // Errors before CONNACK reject connect(); later ones end in 'close'
+            this.socket.on('error', (err) => {
+                if (this.connackResolve) reject(err);
+                this.connackResolve = null;
+            });
+            this.socket.on('data', (chunk) => this.onData(chunk));
+            this.socket.on('close', () => {
+                clearInterval(this.pingTimer);
+                if (this.connackResolve) reject(new Error('connection closed'));
+                this.connackResolve = null;
+                this.pending.clear();
+                this.emit('close');
+            });
+
+            this.pingTimer = setInterval(() => this.socket.write(packet(TYPE.PINGREQ, 0, Buffer.alloc(0))),
+                                         this.keepAlive * 500);
+            this.pingTimer.unref();
+        });
+    }
+
+    onData(chunk) {
+        for (const pkt of this.parser.push(chunk)) {
+            switch (pkt.type) {
+                case TYPE.CONNACK:
+                    if (pkt.body[1] !== 0) this.socket.destroy(new Error(`CONNACK rc=${pkt.body[1]}`));
+                    else if (this.connackResolve) this.connackResolve();
+                    this.connackResolve = null;
+                    break;
+                case TYPE.PUBLISH: {
+                    const msg = decodePublish(pkt);
+                    if (msg.qos === 1) this.socket.write(encodeAck(TYPE.PUBACK, msg.packetId));
+                    this.emit('message', msg.topic, msg.payload);
+                    break;
+                }
+                case TYPE.PUBACK:
+                case TYPE.SUBACK:
+                case TYPE.UNSUBACK: {
+                    const id = pkt.body.readUInt16BE(0);
+                    const done = this.pending.get(id);
+                    this.pending.delete(id);
+                    if (done) done();
+                    break;
+                }
+                default:
+                    break;
+            }
+        }
+    }
+
+    allocId() {
+        const id = this.nextId;
+        this.nextId = (this.nextId % 0xffff) + 1;
+        return id;
+    }
+
+    subscribe(topics) {
+        const id = this.allocId();
+        return new Promise((resolve) => {
+            this.pending.set(id, resolve);
+            this.socket.write(encodeSubscribe(id, Array.isArray(topics) ? topics : [topics]));
+        });
+    }
+
+    /**
+     * QoS 0 resolves immediately; QoS 1 resolves on PUBACK.
+     */
+    publish(topic, payload, qos = 0) {
+        if (qos === 0) {
+            this.socket.write(encodePublish(topic, payload, 0));
+            return Promise.resolve();
+        }
+        const id = this.allocId();
+        return new Promise((resolve) => {
+            this.pending.set(id, resolve);
+            this.socket.write(encodePublish(topic, payload, 1, id));
+        });
+    }
+
+    end() {
+        clearInterval(this.pingTimer);
+        if (this.socket) this.socket.end(packet(TYPE.DISCONNECT, 0, Buffer.alloc(0)));
+    }
+}
+
+module.exports = {
+    TYPE,
+    packet,
+    encodePublish,
+    encodeAck,
+    PacketParser,
+    decodeConnect,
+    decodePublish,
+    decodeSubscribe,
+    decodeUnsubscribe,
+    topicMatches,
+    MqttClient
+};
\ No newline at end of file
@@ -0,0 +1,239 @@
+#!/usr/bin/env node
+// Delta OTA tool for the ESP32 firmwares (see espSensor/DeltaPatcher.hpp
+// for the DPT1 format and espSensor/OtaUpdater.hpp for the chunk protocol).
+//
+//   node tools/ota-delta.js make  <running.bin> <new.bin> <out.dpt>
+//   node tools/ota-delta.js apply <running.bin> <patch.dpt> <out.bin>
+//   node tools/ota-delta.js send  <patch.dpt> <thing> <clientId> [chunkBytes] [delayMs] [prepareMs]
+//
+// `make` builds the patch, `apply` decodes it with the JavaScript reference
+// decoder (same checks as the device, whole images in memory), `send`
+// publishes it in numbered chunks on <thing>/ota/<clientId> through AWS IoT
+// Data. The device's own decoder (DeltaPatcher.hpp) is tested and
+// benchmarked on patches made here by tools/delta-patch-test.cpp.
+
+const fs     = require('fs');
+const crypto = require('crypto');
+
+const MAGIC       = Buffer.from('DPT1');
+const HEADER_SIZE = 76;
+const BLOCK       = 32;   // Minimum match length worth a COPY (9-byte op)
+const INDEX_STEP  = 4;    // Source positions indexed (ESP32 code is 4-byte aligned)
+
+const sha256 = (buf) => crypto.createHash('sha256').update(buf).digest();
+
+// FNV-1a over BLOCK bytes starting at `pos`
+function blockHash(buf, pos) {
+    let h = 0x811c9dc5;
+    for (let i = 0; i < BLOCK; i++) {
+        h ^= buf[pos + i];
+        h = Math.imul(h, 0x01000193);
+    }
+    return h >>> 0;
+}
+
+// ================== MAKE ==================
+
+/**
+ * Greedy block matcher: indexes source blocks, then scans the target and
+ * emits COPY for every match of at least BLOCK bytes (extended forwards and
+ * backwards) and ADD for the bytes in between.
+ */
+function makePatch(source, target) {
+    const index = new Map();
+    for (let p = 0; p + BLOCK <= source.length; p += INDEX_STEP) {
+        const h = blockHash(source, p);
+        if (!index.has(h)) index.set(h, p);
+    }
+
+    const ops = [];
+    let literalStart = 0;
+    let i = 0;
+
+    const flushLiteral = (end) => {
+        if (end > literalStart) ops.push({ op: 'A', data: target.subarray(literalStart, end) });
+    };
+
+    while (i + BLOCK <= target.length) {
+        const cand = index.get(blockHash(target, i));
+        if (cand === undefined || source.compare(target, i, i + BLOCK, cand, cand + BLOCK) !== 0) {
+            i++;
+            continue;
+        }
+
+        // Extend backwards into the pending literal, then forwards
+        let s = cand;
+        let t = i;
+        while (s > 0 && t > literalStart && source[s - 1] === target[t - 1]) { s--; t--; }
+        let len = i + BLOCK - t;
+        while (s + len < source.length && t + len < target.length && source[s + len] === target[t + len]) len++;
+
+        flushLiteral(t);
+        ops.push({ op: 'C', offset: s, length: len });
+        i = literalStart = t + len;
+    }
+    flushLiteral(target.length);
+
+    const parts = [];
+    const header = Buffer.alloc(HEADER_SIZE);
+    MAGIC.copy(header, 0);
+    header.writeUInt32LE(source.length, 4);
+    header.writeUInt32LE(target.length, 8);
+    sha256(source).copy(header, 12);
+    sha256(target).copy(header, 44);
+    parts.push(header);
+
+    for (const o of ops) {
+        if (o.op === 'C') {
+            const b = Buffer.alloc(9);
+            b.write('C', 0);
+            b.writeUInt32LE(o.offset, 1);
+            b.writeUInt32LE(o.length, 5);
+            parts.push(b);
+        } else {
+            const b = Buffer.alloc(5);
+            b.write('A', 0);
+            b.writeUInt32LE(o.data.length, 1);
+            parts.push(b, o.data);
+        }
+    }
+    parts.push(Buffer.from('E'));
+
+    return { patch: Buffer.concat(parts), ops };
+}
+
+// ================== APPLY ==================
+
+/**
+ * Reference decoder mirroring DeltaPatcher: sequential output, bounded
+ * lookahead, hash checks on both ends. Throws on any error.
+ */
+function applyPatch(source, patch) {
+    if (patch.length < HEADER_SIZE || !patch.subarray(0, 4).equals(MAGIC)) throw new Error('not a DPT1 patch');
+
+    const sourceSize = patch.readUInt32LE(4);
+    const targetSize = patch.readUInt32LE(8);
+    if (sourceSize > source.length || !sha256(source.subarray(0, sourceSize)).equals(patch.subarray(12, 44))) {
+        throw new Error('patch was made for a different source image');
+    }
+
+    const out = Buffer.alloc(targetSize);
+    let written = 0;
+    let pos = HEADER_SIZE;
+
+    for (;;) {
+        const op = String.fromCharCode(patch[pos++]);
+        if (op === 'E') break;
+        if (op === 'C') {
+            const offset = patch.readUInt32LE(pos);
+            const length = patch.readUInt32LE(pos + 4);
+            pos += 8;
+            if (offset + length > sourceSize || written + length > targetSize) throw new Error('copy out of range');
+            source.copy(out, written, offset, offset + length);
+            written += length;
+        } else if (op === 'A') {
+            const length = patch.readUInt32LE(pos);
+            pos += 4;
+            if (written + length > targetSize) throw new Error('add out of range');
+            patch.copy(out, written, pos, pos + length);
+            pos += length;
+            written += length;
+        } else {
+            throw new Error(`unknown opcode at ${pos - 1}`);
+        }
+    }
+
+    if (written !== targetSize) throw new Error('short output');
+    if (!sha256(out).equals(patch.subarray(44, 76))) throw new Error('target hash mismatch');
+    return out;
+}
+
+// ================== SEND ==================
+
+/**
+ * Publishes the patch as <u32 seq LE><bytes> chunks. Chunk 0 is the header
+ * alone; the device then reads and hashes its whole running image before it
+ * takes the next chunk (status "ready"), hence the prepareMs pause; a chunk
+ * sent earlier fails the update. Chunks must fit in the device MQTT buffer minus the
+ * MQTT/topic overhead: ~900 for the actuator (1024-byte buffer), ~400 for
+ * the sensor (512).
+ */
+async function sendPatch(patch, thing, clientId, chunkBytes, delayMs, prepareMs) {
+    const AWS     = require('aws-sdk');
+    const IotData = new AWS.IotData({
+        endpoint: process.env.IOT_ENDPOINT || 'a1acybki981kqw-ats.iot.us-east-2.amazonaws.com'
+    });
+    const topic = `${thing}/ota/${clientId}`;
+    const total = 1 + Math.ceil((patch.length - HEADER_SIZE) / chunkBytes);
+
+    for (let seq = 0; seq < total; seq++) {
+        const header = Buffer.alloc(4);
+        header.writeUInt32LE(seq, 0);
+        const start   = seq === 0 ? 0 : HEADER_SIZE + (seq - 1) * chunkBytes;
+        const end     = seq === 0 ? HEADER_SIZE : start + chunkBytes;
+        const payload = Buffer.concat([header, patch.subarray(start, end)]);
+
+        await IotData.publish({ topic, qos: 1, payload }).promise();
+        if (seq % 64 === 0) console.log(`chunk ${seq + 1}/${total}`);
+        // Leave the device time to check its image, then to erase/write flash
+        await new Promise((resolve) => setTimeout(resolve, seq === 0 ? prepareMs : delayMs));
+    }
+    console.log(`sent ${total} chunks (${patch.length} bytes) to ${topic}; watch ${topic}/status`);
+}
+
+// ================== CLI ==================
+
+async function main(argv) {
+    const [cmd, ...args] = argv;
+
+    if (cmd === 'make' && args.length === 3) {
+        const source = fs.readFileSync(args[0]);
+        const target = fs.readFileSync(args[1]);
+        const t0 = process.hrtime.bigint();
+        const { patch, ops } = makePatch(source, target);
+        const ms = Number(process.hrtime.bigint() - t0) / 1e6;
+        fs.writeFileSync(args[2], patch);
+
+        const copies = ops.filter((o) => o.op === 'C').length;
+        console.log(`patch ${patch.length} bytes (${(100 * patch.length / target.length).toFixed(1)}% of ${target.length}), ` +
+                    `${copies} copies, ${ops.length - copies} literals, ${ms.toFixed(0)} ms`);
+        return;
+    }
+
+    if (cmd === 'apply' && args.length === 3) {
+        const source = fs.readFileSync(args[0]);
+        const patch  = fs.readFileSync(args[1]);
+        const rssBefore = process.memoryUsage().rss;
+        const t0 = process.hrtime.bigint();
+        const out = applyPatch(source, patch);
+        const s = Number(process.hrtime.bigint() - t0) / 1e9;
+        fs.writeFileSync(args[2], out);
+
+        console.log(`applied: ${out.length} bytes in ${(s * 1000).toFixed(1)} ms ` +
+                    `(${(out.length / s / 1048576).toFixed(1)} MiB/s), ` +
+                    `rss +${((process.memoryUsage().rss - rssBefore) / 1024).toFixed(0)} KiB`);
+        return;
+    }
+
+    if (cmd === 'send' && args.length >= 3) {
+        const patch = fs.readFileSync(args[0]);
+        await sendPatch(patch, args[1], args[2], Number(args[3] || 900), Number(args[4] || 50),
+                        Number(args[5] || 2000));
+        return;
+    }
+
+    console.log('usage:\n' +
+                '  ota-delta.js make  <running.bin> <new.bin> <out.dpt>\n' +
+                '  ota-delta.js apply <running.bin> <patch.dpt> <out.bin>\n' +
+                '  ota-delta.js send  <patch.dpt> <thing> <clientId> [chunkBytes=900] [delayMs=50] [prepareMs=2000]');
+    process.exitCode = 1;
+}
+
+if (require.main === module) {
+    main(process.argv.slice(2)).catch((err) => {
+        console.error(err.message);
+        process.exitCode = 1;
+    });
+}
+
+module.exports = { makePatch, applyPatch };
\ No newline at end of file
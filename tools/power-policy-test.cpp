@@ -0,0 +1,159 @@
+// Host test of the sensor's sleep decisions (PowerPolicy from
+// espSensor/PowerProfile.hpp) on a simulated millis() clock.
+//
+//   g++ -O2 -std=c++17 -I espSensor -o /tmp/power-policy-test tools/power-policy-test.cpp
+//   /tmp/power-policy-test [hours=24] [seed=1]
+//
+// Checked, for every profile:
+//   - never sleeps with a publish pending, and only the profile's action
+//     (NAP for LIGHT_SLEEP, DEEP_SLEEP for DEEP_SLEEP, nothing otherwise)
+//   - sleeps exactly idleMs after the last activity, also across the
+//     millis() wrap at 2^32 ms
+//   - msUntilIdle() agrees with next(): an event-driven loop that only
+//     wakes at msUntilIdle() deadlines is running when a loop polling
+//     every millisecond would start to sleep
+//   - reportOnWake() for each wake cause
+// Then `hours` of a LIGHT_SLEEP sensor on a random door (seeded): door
+// changes every 1 s - 30 min, each followed by a publish that takes 50 -
+// 400 ms. Reported: naps, and the share of the time spent napping (an
+// upper bound of the light-sleep share; beacons and timers wake the chip
+// in between).
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <random>
+#include "PowerProfile.hpp"
+
+static void check(bool ok, const char* what) {
+    if (!ok) {
+        fprintf(stderr, "FAILED: %s\n", what);
+        exit(1);
+    }
+}
+
+static SleepAction sleepActionOf(PowerMode mode) {
+    if (mode == PowerMode::LIGHT_SLEEP) return SleepAction::NAP;
+    if (mode == PowerMode::DEEP_SLEEP)  return SleepAction::DEEP_SLEEP;
+    return SleepAction::STAY_AWAKE;
+}
+
+// idleMs after activity at `startMs` (which may be just before the wrap)
+static void checkIdleTimer(const PowerProfile& profile, uint32_t startMs) {
+    PowerPolicy policy(profile);
+    policy.activity(startMs);
+    SleepAction expect = sleepActionOf(profile.mode);
+
+    for (uint32_t dt = 0; dt <= profile.idleMs + 50; dt++) {
+        uint32_t    now    = startMs + dt;
+        SleepAction action = policy.next(now, false);
+        check(policy.next(now, true) == SleepAction::STAY_AWAKE, "no sleep with a publish pending");
+
+        if (expect == SleepAction::STAY_AWAKE) {
+            check(action == SleepAction::STAY_AWAKE, "profile without sleep stays awake");
+            check(policy.msUntilIdle(now) == UINT32_MAX, "profile without sleep has no deadline");
+            continue;
+        }
+        check(action == (dt >= profile.idleMs ? expect : SleepAction::STAY_AWAKE), "sleeps after idleMs");
+        check(policy.msUntilIdle(now) == (dt >= profile.idleMs ? 0 : profile.idleMs - dt),
+              "msUntilIdle counts down to the sleep");
+    }
+}
+
+// Activity at fixed offsets; an event-driven loop (wakes on activity and
+// at msUntilIdle() deadlines) must be running at the first instant of every
+// window in which a loop polling each millisecond would sleep
+static void checkEventLoop(const PowerProfile& profile, uint32_t startMs) {
+    static const uint32_t ACTIVITY[] = {0, 37, 120, 121, 500, 1500};
+    PowerPolicy policy(profile);
+    size_t      next     = 0;          // Index in ACTIVITY
+    uint32_t    deadline = startMs;    // Event-driven loop: next wakeup
+    bool        sleeping = false;      // Polled loop, previous millisecond
+
+    for (uint32_t dt = 0; dt < 3000; dt++) {
+        uint32_t now   = startMs + dt;
+        bool     event = next < sizeof(ACTIVITY) / sizeof(ACTIVITY[0]) && ACTIVITY[next] == dt;
+        if (event) {
+            next++;
+            policy.activity(now);
+        }
+
+        bool sleeps = policy.next(now, false) != SleepAction::STAY_AWAKE;
+        bool awake  = event || now == deadline;
+        if (awake) {
+            uint32_t in = policy.msUntilIdle(now);
+            deadline    = now + (in == 0 ? 1 : in == UINT32_MAX ? 1000 : in);
+        }
+        if (sleeps && !sleeping) check(awake, "event loop wakes for the first instant it may sleep");
+        sleeping = sleeps;
+    }
+}
+
+int main(int argc, char** argv) {
+    double   hours = argc > 1 ? atof(argv[1]) : 24;
+    uint32_t seed  = argc > 2 ? strtoul(argv[2], nullptr, 10) : 1;
+
+    const PowerProfile profiles[] = {
+        PowerProfile::alwaysOn(), PowerProfile::modemSleep(),
+        PowerProfile::lightSleep(), PowerProfile::deepSleep(),
+        { PowerMode::DEEP_SLEEP, 0, 5000, 0, 3600 }
+    };
+    const uint32_t starts[] = {0, 123456, UINT32_MAX - 100, UINT32_MAX};
+
+    for (const PowerProfile& p : profiles) {
+        for (uint32_t start : starts) {
+            checkIdleTimer(p, start);
+            checkEventLoop(p, start);
+        }
+
+        PowerPolicy policy(p);
+        bool deep = p.mode == PowerMode::DEEP_SLEEP;
+        check(policy.reportOnWake(WakeCause::POWER_ON), "report on power on");
+        check(policy.reportOnWake(WakeCause::REED_PIN) == deep, "report on reed wake (deep sleep only)");
+        check(policy.reportOnWake(WakeCause::TIMER) == deep, "heartbeat report (deep sleep only)");
+    }
+    printf("policy: %zu profiles x %zu clock origins ok\n",
+           sizeof(profiles) / sizeof(profiles[0]), sizeof(starts) / sizeof(starts[0]));
+
+    // Simulated day of a LIGHT_SLEEP sensor, 1 ms steps
+    PowerProfile    profile = PowerProfile::lightSleep();
+    PowerPolicy     policy(profile);
+    std::mt19937    rng(seed);
+    std::uniform_int_distribution<uint32_t> gap(1000, 30 * 60 * 1000), publish(50, 400);
+
+    uint64_t total     = (uint64_t)(hours * 3600 * 1000);
+    uint64_t nextDoor  = gap(rng);
+    uint64_t publishAt = 0;          // End of the publish in flight, 0 = none
+    uint64_t napMs     = 0, naps = 0, changes = 0;
+    uint32_t clock     = UINT32_MAX - 60000;   // millis() wraps a minute in
+
+    for (uint64_t t = 0; t < total; ) {
+        uint32_t now = clock + (uint32_t)t;
+        if (t >= nextDoor) {
+            changes++;
+            policy.activity(now);
+            publishAt = t + publish(rng);
+            nextDoor  = t + gap(rng);
+        }
+        if (publishAt && t >= publishAt) {
+            publishAt = 0;
+            policy.activity(now);   // onPublished()
+        }
+
+        if (policy.next(now, publishAt != 0) == SleepAction::NAP) {
+            check(publishAt == 0, "nap with a publish pending");
+            // Blocks up to napMs; the reed pin ends it early
+            uint64_t end = t + profile.napMs;
+            if (end > nextDoor) end = nextDoor;
+            napMs += end - t;
+            naps++;
+            t = end;
+        } else {
+            t++;
+        }
+    }
+    printf("light sleep: %.1f h, %llu door changes, %llu naps, %.2f%% of the time napping\n",
+           hours, (unsigned long long)changes, (unsigned long long)naps, 100.0 * napMs / total);
+    check(naps > 0, "naps happen");
+    return 0;
+}
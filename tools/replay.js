@@ -0,0 +1,349 @@
+#!/usr/bin/env node
+// Deterministic replay of device sessions and a regression benchmark on top.
+//
+//   node tools/replay.js extract <serial.log> [--out trace.rec]
+//   node tools/replay.js synth   [--dir traces] [--scale 1]
+//   node tools/replay.js build   [--arduinojson <dir>] [--bin /tmp/replay]
+//   node tools/replay.js run     [--bin /tmp/replay] [--repeat 5] [--tolerance 0.25]
+//                                [--baseline file.json] [--save file.json] [--json] <trace>...
+//
+// Traces are the "@rec" lines printed by a device built with
+// recordEvents = true (see espSensor/EventRecorder.hpp): GPIO levels, MQTT
+// messages and wall-clock readings, timestamped with esp_timer. A raw Serial
+// log works as a trace; `extract` only strips the other lines. `synth`
+// writes host-simulated traces for both sketches instead, from a fixed seed
+// and with the topics of the sketches' current configuration:
+//   sensor-doors      door movements with contact bounce and EMI spikes,
+//                     SNTP time, history queries
+//   sensor-flapping   a door flapping faster than the shadow write rate
+//   actuator-commands shadow deltas, repeated commands, both document
+//                     forms, and documents larger than the MQTT buffer
+//
+// `build` compiles tools/replay/replay-{sensor,actuator}.cpp, i.e. the
+// sketches themselves on host shims, against ArduinoJson from the Arduino
+// libraries folder (default ~/Arduino/libraries/ArduinoJson, or
+// $ARDUINOJSON). Linux only: the wall clock, select() and the eventfd are
+// redirected with ld --wrap. It also builds payload-sizes-{sensor,actuator}
+// (tools/replay/payload-sizes.cpp), the message size test; run them as is.
+//
+// `run` replays each trace --repeat times and reports the best
+// throughput (events/s) and per-event handler latency percentiles, the
+// firmware's heap use at boot (allocations / bytes, static construction
+// and setup()) and during the replay, and the digest of what it published (see
+// tools/replay/ReplayEngine.hpp). With --baseline it flags regressions and
+// exits with 1: throughput down or p99 up by more than --tolerance, more
+// allocations or boot heap bytes, or a different digest (the firmware now behaves differently
+// on the same inputs; re-save the baseline if that is intended). --save
+// writes the results as a new baseline. Baselines are machine specific and
+// are not kept in the repository.
+
+const fs     = require('fs');
+const os     = require('os');
+const path   = require('path');
+const { execFileSync } = require('child_process');
+
+const ROOT = path.resolve(__dirname, '..');
+
+// ================== TRACES ==================
+
+function recLine(us, kind, ...fields) {
+    return `@rec ${Math.round(us)} ${kind} ${fields.join(' ')}`;
+}
+
+function messageLine(us, topic, payload) {
+    const buf = Buffer.from(payload);
+    return recLine(us, 'M', topic, buf.length, buf.toString('base64'));
+}
+
+function extract(file, out) {
+    const lines = fs.readFileSync(file, 'utf8').split('\n');
+    const recs  = [];
+    for (const line of lines) {
+        const at = line.indexOf('@rec ');
+        if (at >= 0) recs.push(line.slice(at).trimEnd());
+    }
+    fs.writeFileSync(out, recs.join('\n') + '\n');
+    return recs.length;
+}
+
+// Deterministic PRNG (mulberry32), so synthetic traces never change
+function rng(seed) {
+    let a = seed >>> 0;
+    const next = () => {
+        a = (a + 0x6D2B79F5) >>> 0;
+        let t = a;
+        t = Math.imul(t ^ (t >>> 15), t | 1);
+        t ^= t + Math.imul(t ^ (t >>> 7), t | 61);
+        return ((t ^ (t >>> 14)) >>> 0) / 4294967296;
+    };
+    return { next, uniform: (lo, hi) => lo + (hi - lo) * next() };
+}
+
+// constexpr settings of a sketch's Config struct
+function sketchConfig(sketch) {
+    const src = fs.readFileSync(path.join(ROOT, sketch, `${sketch}.ino`), 'utf8');
+    const cfg = {};
+    const re  = /static constexpr \w+\s+(\w+)(\[\])?\s*=\s*("([^"]*)"|[^;]+);/g;
+    let m;
+    while ((m = re.exec(src)) !== null) cfg[m[1]] = m[4] !== undefined ? m[4] : m[3].trim();
+    return cfg;
+}
+
+function shadowTopic(cfg, suffix) {
+    return cfg.shadowName ? `$aws/things/${cfg.thingName}/shadow/name/${cfg.shadowName}${suffix}`
+                          : `$aws/things/${cfg.thingName}/shadow${suffix}`;
+}
+
+// Door movements: 1-12 bounce pulses of 50 us - 3 ms, then the new level;
+// now and then a 1 us EMI spike while stable
+function doorMovements(r, lines, pin, count, gapLo, gapHi, startUs) {
+    let t     = startUs;
+    let level = 1;   // Closed
+    for (let m = 0; m < count; m++) {
+        t += r.uniform(gapLo, gapHi);
+        level ^= 1;
+        const bounces = Math.floor(r.uniform(1, 13));
+        for (let b = 0; b < bounces; b++) {
+            lines.push(recLine(t, 'G', pin, level));
+            t += r.uniform(50, 3000);
+            lines.push(recLine(t, 'G', pin, level ^ 1));
+            t += r.uniform(50, 3000);
+        }
+        lines.push(recLine(t, 'G', pin, level));
+        if (r.next() < 0.3) {
+            const at = t + r.uniform(30e3, 150e3);
+            lines.push(recLine(at, 'G', pin, level ^ 1));
+            lines.push(recLine(at + 1, 'G', pin, level));
+            t = at + 1;
+        }
+    }
+    return t;
+}
+
+function synthSensorDoors(scale) {
+    const cfg   = sketchConfig('espSensor');
+    const pin   = Number(cfg.sensorPin);
+    const topic = `${cfg.thingName}/journal/${cfg.clientId}`;
+    const r     = rng(42);
+    const lines = [recLine(0, 'H', 'sensor', 1), recLine(50e3, 'G', pin, 1), recLine(2e6, 'C', 1718000000)];
+
+    const count = Math.round(400 * scale);
+    let   t     = 3e6;
+    for (let block = 0; block < count / 50; block++) {
+        t = doorMovements(r, lines, pin, 50, 200e3, 20e6, t);
+        t += 1e6;
+        lines.push(messageLine(t, topic, JSON.stringify({ id: block + 1, last: 20 })));
+        lines.push(messageLine(t + 500e3, topic, JSON.stringify({ id: 1000 + block, after: block * 40, max: 100 })));
+    }
+    return lines;
+}
+
+function synthSensorFlapping(scale) {
+    const cfg   = sketchConfig('espSensor');
+    const pin   = Number(cfg.sensorPin);
+    const r     = rng(7);
+    const lines = [recLine(0, 'H', 'sensor', 1), recLine(50e3, 'G', pin, 1)];
+    doorMovements(r, lines, pin, Math.round(300 * scale), 40e3, 400e3, 1e6);
+    return lines;
+}
+
+function synthActuatorCommands(scale) {
+    const cfg   = sketchConfig('espActuator');
+    const topic = shadowTopic(cfg, '/update/delta');
+    const r     = rng(11);
+    const lines = [recLine(0, 'H', 'actuator', 1), recLine(3e6, 'C', 1718000000)];
+
+    let t       = 5e6;
+    let state   = 'CLOSE';
+    let version = 1;
+    for (let i = 0; i < Math.round(1000 * scale); i++) {
+        t += r.uniform(200e3, 10e6);
+        if (r.next() > 0.2) state = state === 'OPEN' ? 'CLOSE' : 'OPEN';   // Else a repeated command
+        const token = `cmd${i}:${1718000000000 + Math.round(t / 1000)}`;
+        const roll  = r.next();
+        let doc;
+        if (roll < 0.1) {
+            // Larger than the MQTT buffer: metadata of a big shadow document
+            const metadata = {};
+            for (let k = 0; k < 40; k++) metadata[`sensor${k}`] = { timestamp: 1718000000 + k, value: 'x'.repeat(16) };
+            doc = { version: version++, timestamp: 1718000000, state: { interiorDoor: state }, metadata, clientToken: token };
+        } else if (roll < 0.3) {
+            doc = { state: { desired: { interiorDoor: state } }, clientToken: token };
+        } else {
+            doc = { version: version++, timestamp: 1718000000, state: { interiorDoor: state },
+                    metadata: { interiorDoor: { timestamp: 1718000000 } }, clientToken: token };
+        }
+        lines.push(messageLine(t, topic, JSON.stringify(doc)));
+    }
+    return lines;
+}
+
+const SCENARIOS = {
+    'sensor-doors':      synthSensorDoors,
+    'sensor-flapping':   synthSensorFlapping,
+    'actuator-commands': synthActuatorCommands
+};
+
+// ================== BUILD / RUN ==================
+
+function arduinoJsonDir(opt) {
+    const base = opt || process.env.ARDUINOJSON || path.join(os.homedir(), 'Arduino', 'libraries', 'ArduinoJson');
+    for (const dir of [path.join(base, 'src'), base]) {
+        if (fs.existsSync(path.join(dir, 'ArduinoJson.h'))) return dir;
+    }
+    throw new Error(`ArduinoJson.h not found under ${base} (use --arduinojson <dir>)`);
+}
+
+function build(opts) {
+    const json = arduinoJsonDir(opts.arduinojson);
+    fs.mkdirSync(opts.bin, { recursive: true });
+    const programs = [['replay-sensor', 'espSensor', 'replay-sensor.cpp'],
+                      ['replay-actuator', 'espActuator', 'replay-actuator.cpp'],
+                      ['payload-sizes-sensor', 'espSensor', 'payload-sizes.cpp'],
+                      ['payload-sizes-actuator', 'espActuator', 'payload-sizes.cpp']];
+    for (const [name, sketch, source] of programs) {
+        const out = path.join(opts.bin, name);
+        execFileSync('g++', ['-O2', '-std=gnu++17', '-I', path.join(ROOT, 'tools/replay/shim'),
+                             '-I', path.join(ROOT, sketch), '-I', json,
+                             '-Wl,--wrap=time', '-Wl,--wrap=gettimeofday',
+                             '-Wl,--wrap=select', '-Wl,--wrap=read', '-Wl,--wrap=write',
+                             '-o', out, path.join(ROOT, 'tools/replay', source)],
+                     { stdio: 'inherit' });
+        console.log(`built ${out}`);
+    }
+}
+
+function traceDevice(file) {
+    const head = fs.readFileSync(file, 'utf8').match(/@rec \d+ H (\w+)/);
+    if (!head) throw new Error(`${file}: no "@rec ... H" header line`);
+    return head[1];
+}
+
+// Timings are best-of-N: on a shared host the noise only ever adds time
+const FASTEST = ['p50Us', 'p90Us', 'p99Us', 'maxUs', 'hostMs'];
+
+function replayTrace(file, opts) {
+    const bin  = path.join(opts.bin, `replay-${traceDevice(file)}`);
+    if (!fs.existsSync(bin)) throw new Error(`${bin} missing, run "replay.js build" first`);
+    const runs = [];
+    for (let i = 0; i < opts.repeat; i++) {
+        runs.push(JSON.parse(execFileSync(bin, [file], { encoding: 'utf8' })));
+    }
+    const result = { ...runs[0], trace: path.basename(file) };
+    for (const key of FASTEST) result[key] = Math.min(...runs.map((r) => r[key]));
+    result.eventsPerS = Math.max(...runs.map((r) => r.eventsPerS));
+    if (runs.some((r) => r.digest !== runs[0].digest || r.allocs !== runs[0].allocs)) {
+        result.nondeterministic = true;
+    }
+    return result;
+}
+
+// Regressions of `cur` against `base`, as readable strings
+function compare(cur, base, tolerance) {
+    const issues = [];
+    if (cur.eventsPerS < base.eventsPerS * (1 - tolerance)) {
+        issues.push(`throughput ${base.eventsPerS} -> ${cur.eventsPerS} events/s`);
+    }
+    // 1 us of slack: sub-microsecond handlers are mostly timer noise
+    if (cur.p99Us > base.p99Us * (1 + tolerance) + 1) {
+        issues.push(`p99 ${base.p99Us} -> ${cur.p99Us} us`);
+    }
+    if (cur.allocs > base.allocs) issues.push(`allocations ${base.allocs} -> ${cur.allocs}`);
+    if (cur.bootBytes > base.bootBytes) issues.push(`boot heap ${base.bootBytes} -> ${cur.bootBytes} bytes`);
+    if (cur.digest !== base.digest) {
+        issues.push(`outputs changed (${base.publishes} -> ${cur.publishes} publishes, digest ${cur.digest})`);
+    }
+    if (cur.nondeterministic) issues.push('outputs differ between repeats');
+    return issues;
+}
+
+function printTable(results, regressions) {
+    console.log('trace                  events  msgs  events/s    p50 us    p90 us    p99 us    max us   boot heap  allocs  pubs  digest');
+    for (const r of results) {
+        console.log(`${r.trace.padEnd(20)} ${String(r.events).padStart(8)} ${String(r.messages).padStart(5)} ` +
+                    `${String(r.eventsPerS).padStart(9)} ${r.p50Us.toFixed(2).padStart(9)} ${r.p90Us.toFixed(2).padStart(9)} ` +
+                    `${r.p99Us.toFixed(2).padStart(9)} ${r.maxUs.toFixed(2).padStart(9)} ` +
+                    `${`${r.bootAllocs}/${r.bootBytes}`.padStart(11)} ${String(r.allocs).padStart(7)} ` +
+                    `${String(r.publishes).padStart(5)}  ${r.digest}`);
+        if (r.partial) console.log(`  ${r.partial} message(s) recorded truncated, replayed as recorded`);
+        for (const issue of regressions[r.trace] || []) console.log(`  REGRESSION: ${issue}`);
+    }
+}
+
+// ================== CLI ==================
+
+async function main(argv) {
+    const [cmd, ...rest] = argv;
+    const opts  = { bin: path.join(os.tmpdir(), 'replay'), dir: 'traces', repeat: 5, tolerance: 0.25, scale: 1, json: false };
+    const files = [];
+    for (let i = 0; i < rest.length; i++) {
+        if (rest[i] === '--json') opts.json = true;
+        else if (rest[i].startsWith('--')) opts[rest[i].slice(2)] = rest[++i];
+        else files.push(rest[i]);
+    }
+
+    if (cmd === 'extract' && files.length === 1) {
+        const out = opts.out || files[0].replace(/(\.\w+)?$/, '.rec');
+        console.log(`${extract(files[0], out)} records -> ${out}`);
+        return;
+    }
+
+    if (cmd === 'synth') {
+        fs.mkdirSync(opts.dir, { recursive: true });
+        for (const [name, make] of Object.entries(SCENARIOS)) {
+            const lines = make(Number(opts.scale));
+            const file  = path.join(opts.dir, `${name}.rec`);
+            fs.writeFileSync(file, lines.join('\n') + '\n');
+            console.log(`${file}: ${lines.length - 1} events`);
+        }
+        return;
+    }
+
+    if (cmd === 'build') {
+        build(opts);
+        return;
+    }
+
+    if (cmd === 'run' && files.length) {
+        opts.repeat    = Math.max(1, Number(opts.repeat));
+        opts.tolerance = Number(opts.tolerance);
+        const results  = files.map((f) => replayTrace(f, opts));
+
+        const baseline    = opts.baseline ? JSON.parse(fs.readFileSync(opts.baseline, 'utf8')) : {};
+        const regressions = {};
+        let   failed      = false;
+        for (const r of results) {
+            if (!baseline[r.trace]) continue;
+            regressions[r.trace] = compare(r, baseline[r.trace], opts.tolerance);
+            if (regressions[r.trace].length) failed = true;
+        }
+
+        if (opts.json) console.log(JSON.stringify({ results, regressions }, null, 2));
+        else           printTable(results, regressions);
+
+        if (opts.save) {
+            const out = {};
+            for (const r of results) out[r.trace] = r;
+            fs.writeFileSync(opts.save, JSON.stringify(out, null, 2) + '\n');
+            console.log(`baseline saved to ${opts.save}`);
+        }
+        if (failed) process.exitCode = 1;
+        return;
+    }
+
+    console.log('usage:\n' +
+                '  replay.js extract <serial.log> [--out trace.rec]\n' +
+                '  replay.js synth   [--dir traces] [--scale 1]\n' +
+                '  replay.js build   [--arduinojson dir] [--bin dir]\n' +
+                '  replay.js run     [--bin dir] [--repeat 5] [--tolerance 0.25] [--baseline f] [--save f] [--json] traces...');
+    process.exitCode = 1;
+}
+
+if (require.main === module) {
+    main(process.argv.slice(2)).catch((err) => {
+        console.error(err.message);
+        process.exitCode = 1;
+    });
+}
+
+module.exports = { extract, compare, SCENARIOS };
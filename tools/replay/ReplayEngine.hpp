@@ -0,0 +1,412 @@
+// ReplayEngine.hpp
+//
+// Deterministic replay of a recorded session (espSensor/EventRecorder.hpp)
+// through the real firmware classes, on the host shims of shim/. Used by
+// replay-sensor.cpp / replay-actuator.cpp, one binary per sketch (the two
+// sketches define classes with the same names), driven by tools/replay.js.
+//
+// Replay policy, all on the virtual clock of shim/HostWorld.h:
+//  - every trace event is applied at its recorded time: "G" sets the pin
+//    level (and runs its interrupt handler), "M" queues the message for
+//    PubSubClient::loop(), "C" sets the wall clock;
+//  - esp_timer callbacks (the reed sampler) fire at their own due times;
+//  - loop() runs every --loop-us (1 ms) for --active-ms (200 ms) after an
+//    event, and every --idle-ms (100 ms) otherwise, so telemetry and other
+//    periodic work still happen between events without simulating hours
+//    of idle spinning. The firmware's select() (EventDispatcher) never
+//    blocks: the engine owns the clock, and loop() finds nothing ready
+//    between events as it would after a timeout. Its socket and eventfd
+//    are HostWorld state, so waiting costs no system call.
+// The same trace and firmware always give the same outputs (publishes and
+// servo moves, with their virtual times); their FNV-1a digest is reported
+// so a change of behaviour shows up next to a change of speed.
+//
+// Reported (one JSON line on stdout):
+//   events, gpio, messages, partial   events replayed, by kind; partial =
+//                                     messages recorded truncated
+//   virtualS, hostMs, eventsPerS      recorded span, host time, throughput
+//   handled, p50Us .. maxUs           host time of the loop() calls that did
+//                                     work (delivered a message, published,
+//                                     logged), i.e. per-event handler cost
+//   bootAllocs, bootBytes             firmware heap allocations (and bytes)
+//                                     of boot: construction of the sketch's
+//                                     global objects, then setup()
+//   allocs                            firmware heap allocations during the
+//                                     replay (boot excluded)
+//   outputs, publishes, digest        behaviour
+#pragma once
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/time.h>
+#include <sys/select.h>
+#include <unistd.h>
+#include <new>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include "shim/HostWorld.h"
+
+//--------------------------------------------------------------------------
+// Allocation counting: every operator new of the binary goes through here
+//--------------------------------------------------------------------------
+void* operator new(size_t n) {
+    if (host::countAllocs) {
+        host::allocs++;
+        host::allocBytes += n;
+    }
+    if (void* p = malloc(n ? n : 1)) return p;
+    throw std::bad_alloc();
+}
+void* operator new[](size_t n) { return operator new(n); }
+void  operator delete(void* p) noexcept { free(p); }
+void  operator delete[](void* p) noexcept { free(p); }
+void  operator delete(void* p, size_t) noexcept { free(p); }
+void  operator delete[](void* p, size_t) noexcept { free(p); }
+
+//--------------------------------------------------------------------------
+// Wall clock of the firmware (time(), gettimeofday()), redirected with
+// -Wl,--wrap=time -Wl,--wrap=gettimeofday
+//--------------------------------------------------------------------------
+extern "C" time_t __wrap_time(time_t* out) {
+    time_t t = (time_t)(host::wallUs() / 1000000);
+    if (out) *out = t;
+    return t;
+}
+
+extern "C" int __wrap_gettimeofday(struct timeval* tv, void*) {
+    int64_t us  = host::wallUs();
+    tv->tv_sec  = (time_t)(us / 1000000);
+    tv->tv_usec = (suseconds_t)(us % 1000000);
+    return 0;
+}
+
+//--------------------------------------------------------------------------
+// The firmware's socket and eventfd (EventDispatcher), redirected with
+// -Wl,--wrap=select -Wl,--wrap=read -Wl,--wrap=write. select() only knows
+// host::socketFd, readable while a message is waiting, and host::eventFd,
+// readable while its counter is set; it never blocks.
+//--------------------------------------------------------------------------
+extern "C" ssize_t __real_read(int, void*, size_t);
+extern "C" ssize_t __real_write(int, const void*, size_t);
+
+extern "C" int __wrap_select(int nfds, fd_set* rd, fd_set* wr, fd_set* ex, struct timeval*) {
+    bool socket = rd && host::socketFd < nfds && FD_ISSET(host::socketFd, rd);
+    bool event  = rd && host::eventFd < nfds && FD_ISSET(host::eventFd, rd);
+    if (rd) FD_ZERO(rd);
+    if (wr) FD_ZERO(wr);
+    if (ex) FD_ZERO(ex);
+
+    int n = 0;
+    if (socket && host::inboundNext < host::inbound.size()) {
+        FD_SET(host::socketFd, rd);
+        n++;
+    }
+    if (event && host::eventCount) {
+        FD_SET(host::eventFd, rd);
+        n++;
+    }
+    return n;
+}
+
+extern "C" ssize_t __wrap_read(int fd, void* buf, size_t n) {
+    if (fd != host::eventFd) return __real_read(fd, buf, n);
+    memcpy(buf, &host::eventCount, sizeof(host::eventCount));
+    host::eventCount = 0;
+    return sizeof(host::eventCount);
+}
+
+extern "C" ssize_t __wrap_write(int fd, const void* buf, size_t n) {
+    if (fd != host::eventFd) return __real_write(fd, buf, n);
+    uint64_t add;
+    memcpy(&add, buf, sizeof(add));
+    host::eventCount += add;
+    return sizeof(add);
+}
+
+namespace replay {
+
+// Counts from static initialization on: the sketch included after this
+// header defines its global objects later in the same translation unit, so
+// they are constructed after this one. cli() stops counting until setup().
+struct BootCount {
+    BootCount() { host::countAllocs = true; }
+};
+static BootCount bootCount;
+
+struct Event {
+    int64_t       atUs;
+    char          kind;      // 'G', 'M' or 'C'
+    int           pin;
+    int           level;
+    int64_t       epochS;
+    host::Message message;
+};
+
+struct Trace {
+    std::string        device;
+    std::vector<Event> events;
+};
+
+struct Options {
+    int64_t loopUs   = 1000;
+    int64_t activeUs = 200000;
+    int64_t idleUs   = 100000;
+    bool    listOutputs = false;
+};
+
+inline bool decodeBase64(const char* in, std::string& out) {
+    static int8_t map[256];
+    if (!map[(uint8_t)'B']) {
+        memset(map, -1, sizeof(map));
+        const char* a = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+        for (int i = 0; i < 64; i++) map[(uint8_t)a[i]] = (int8_t)i;
+    }
+    uint32_t acc  = 0;
+    int      bits = 0;
+    for (; *in && *in != '='; in++) {
+        int v = map[(uint8_t)*in];
+        if (v < 0) return false;
+        acc   = (acc << 6) | (uint32_t)v;
+        bits += 6;
+        if (bits >= 8) {
+            bits -= 8;
+            out.push_back((char)((acc >> bits) & 0xFF));
+        }
+    }
+    return true;
+}
+
+//--------------------------------------------------------------------------
+// loadTrace(): the "@rec" lines of a file (a raw Serial log works as is),
+// sorted by time; other lines are skipped
+//--------------------------------------------------------------------------
+inline bool loadTrace(const char* path, Trace& trace) {
+    FILE* f = fopen(path, "r");
+    if (!f) {
+        perror(path);
+        return false;
+    }
+    std::string line;
+    int         c;
+    size_t      lineNo = 0;
+    for (;;) {
+        line.clear();
+        while ((c = fgetc(f)) != EOF && c != '\n') line.push_back((char)c);
+        if (line.empty() && c == EOF) break;
+        lineNo++;
+        size_t at = line.find("@rec ");
+        if (at == std::string::npos) continue;
+
+        const char* p = line.c_str() + at + 5;
+        char*       end;
+        Event       e = {};
+        e.atUs = strtoll(p, &end, 10);
+        while (*end == ' ') end++;
+        e.kind = *end++;
+        while (*end == ' ') end++;
+
+        bool ok = true;
+        switch (e.kind) {
+            case 'H': {
+                const char* s = end;
+                while (*end && *end != ' ' && *end != '\r') end++;
+                trace.device.assign(s, end - s);
+                continue;
+            }
+            case 'G':
+                e.pin   = (int)strtol(end, &end, 10);
+                e.level = (int)strtol(end, &end, 10);
+                ok      = e.pin >= 0 && e.pin < 64;
+                break;
+            case 'C':
+                e.epochS = strtoll(end, &end, 10);
+                break;
+            case 'M': {
+                const char* s = end;
+                while (*end && *end != ' ') end++;
+                e.message.topic.assign(s, end - s);
+                e.message.total = strtoul(end, &end, 10);
+                while (*end == ' ') end++;
+                std::string b64(end);
+                while (!b64.empty() && (b64.back() == '\r' || b64.back() == ' ')) b64.pop_back();
+                ok = decodeBase64(b64.c_str(), e.message.payload);
+                break;
+            }
+            default:
+                ok = false;
+        }
+        if (!ok) {
+            fprintf(stderr, "%s:%zu: bad record skipped\n", path, lineNo);
+            continue;
+        }
+        trace.events.push_back(std::move(e));
+    }
+    fclose(f);
+    std::stable_sort(trace.events.begin(), trace.events.end(),
+                     [](const Event& a, const Event& b) { return a.atUs < b.atUs; });
+    return true;
+}
+
+inline uint64_t fnv1a(uint64_t h, const void* data, size_t len) {
+    const uint8_t* p = (const uint8_t*)data;
+    for (size_t i = 0; i < len; i++) {
+        h ^= p[i];
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+inline double percentile(std::vector<double>& sorted, double q) {
+    if (sorted.empty()) return 0;
+    size_t i = (size_t)(q * (sorted.size() - 1) + 0.5);
+    return sorted[std::min(i, sorted.size() - 1)];
+}
+
+//--------------------------------------------------------------------------
+// run(): replays `trace` through setup()/loop() of the sketch and prints
+// the result line
+//--------------------------------------------------------------------------
+inline int run(const char* path, const Trace& trace, const Options& opt, void (*setup)(), void (*loop)()) {
+    using Clock = std::chrono::steady_clock;
+
+    host::inbound.reserve(trace.events.size());
+    host::outputs.reserve(trace.events.size() * 2 + 64);
+    // Pins start at their first recorded level (the recorder logs it at boot)
+    bool seen[64] = {};
+    for (const Event& e : trace.events) {
+        if (e.kind != 'G' || seen[e.pin]) continue;
+        seen[e.pin]       = true;
+        host::pins[e.pin] = (uint8_t)e.level;
+    }
+
+    host::countAllocs = true;
+    setup();
+    host::countAllocs = false;
+    uint64_t bootAllocs = host::allocs, bootBytes = host::allocBytes;
+    host::allocs = host::allocBytes = 0;
+
+    std::vector<double> handled;
+    handled.reserve(trace.events.size() + 1024);
+    host::countAllocs = true;
+    uint32_t gpio = 0, messages = 0, partial = 0;
+    size_t   next = 0;
+    int64_t  activeUntil = 0;
+    int64_t  lastLoop    = host::nowUs;
+
+    Clock::time_point start = Clock::now();
+    while (next < trace.events.size() || host::nowUs < activeUntil) {
+        int64_t step     = host::nowUs < activeUntil ? opt.loopUs : opt.idleUs;
+        int64_t loopAt   = lastLoop + step;
+        int64_t eventAt  = next < trace.events.size() ? trace.events[next].atUs : INT64_MAX;
+
+        if (eventAt <= loopAt) {
+            // Applied before the timers due at the same instant: a recorded
+            // level is the one the sampler saw at that time
+            const Event& e = trace.events[next++];
+            host::advance(eventAt - 1);
+            host::nowUs = std::max(host::nowUs, eventAt);
+            switch (e.kind) {
+                case 'G': {
+                    bool edge = host::pins[e.pin] != e.level;
+                    host::pins[e.pin] = (uint8_t)e.level;
+                    if (edge && host::isrs[e.pin].fn) host::isrs[e.pin].fn(host::isrs[e.pin].arg);
+                    gpio++;
+                    break;
+                }
+                case 'M':
+                    host::inbound.push_back(&e.message);
+                    messages++;
+                    if (e.message.total > e.message.payload.size()) partial++;
+                    break;
+                case 'C':
+                    host::wallEpochS = e.epochS;
+                    host::wallAtUs   = host::nowUs;
+                    break;
+            }
+            activeUntil = std::max(activeUntil, host::nowUs + opt.activeUs);
+            continue;
+        }
+
+        host::advance(loopAt);
+        lastLoop = loopAt;
+
+        size_t   inboundBefore = host::inboundNext;
+        size_t   outputsBefore = host::outputs.size();
+        uint64_t serialBefore  = host::serialBytes;
+        Clock::time_point t0 = Clock::now();
+        loop();
+        double us = std::chrono::duration<double, std::micro>(Clock::now() - t0).count();
+        if (host::inboundNext != inboundBefore || host::outputs.size() != outputsBefore ||
+            host::serialBytes != serialBefore) {
+            host::ShimScope engine;
+            handled.push_back(us);
+        }
+    }
+    double hostMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    host::countAllocs = false;
+
+    uint64_t digest    = 1469598103934665603ULL;
+    uint32_t publishes = 0;
+    for (const host::Output& o : host::outputs) {
+        digest = fnv1a(digest, &o.atUs, sizeof(o.atUs));
+        digest = fnv1a(digest, &o.kind, 1);
+        digest = fnv1a(digest, o.topic.data(), o.topic.size() + 1);
+        digest = fnv1a(digest, o.payload.data(), o.payload.size());
+        if (o.kind == 'P') publishes++;
+        if (opt.listOutputs) {
+            fprintf(stderr, "%12.3f ms %c %s %.*s\n", o.atUs / 1000.0, o.kind, o.topic.c_str(),
+                    (int)std::min<size_t>(o.payload.size(), 160), o.payload.c_str());
+        }
+    }
+
+    std::sort(handled.begin(), handled.end());
+    size_t events = trace.events.size();
+    double virtualS = events ? (trace.events.back().atUs - trace.events.front().atUs) / 1e6 : 0;
+    printf("{\"trace\":\"%s\",\"device\":\"%s\",\"events\":%zu,\"gpio\":%u,\"messages\":%u,\"partial\":%u,"
+           "\"virtualS\":%.3f,\"hostMs\":%.3f,\"eventsPerS\":%.0f,\"handled\":%zu,"
+           "\"p50Us\":%.2f,\"p90Us\":%.2f,\"p99Us\":%.2f,\"maxUs\":%.2f,\"bootAllocs\":%llu,\"bootBytes\":%llu,"
+           "\"allocs\":%llu,\"outputs\":%zu,\"publishes\":%u,\"digest\":\"%016llx\"}\n",
+           path, trace.device.c_str(), events, gpio, messages, partial,
+           virtualS, hostMs, hostMs > 0 ? events / (hostMs / 1000) : 0, handled.size(),
+           percentile(handled, 0.50), percentile(handled, 0.90), percentile(handled, 0.99),
+           handled.empty() ? 0 : handled.back(), (unsigned long long)bootAllocs, (unsigned long long)bootBytes,
+           (unsigned long long)host::allocs,
+           host::outputs.size(), publishes, (unsigned long long)digest);
+    return 0;
+}
+
+//--------------------------------------------------------------------------
+// cli(): command line shared by the replay binaries
+//--------------------------------------------------------------------------
+inline int cli(int argc, char** argv, const char* device, void (*setup)(), void (*loop)()) {
+    host::countAllocs = false;   // Boot so far: static construction
+    Options     opt;
+    const char* path = nullptr;
+    for (int i = 1; i < argc; i++) {
+        if      (!strcmp(argv[i], "--loop-us") && i + 1 < argc)   opt.loopUs   = atoll(argv[++i]);
+        else if (!strcmp(argv[i], "--active-ms") && i + 1 < argc) opt.activeUs = atoll(argv[++i]) * 1000;
+        else if (!strcmp(argv[i], "--idle-ms") && i + 1 < argc)   opt.idleUs   = atoll(argv[++i]) * 1000;
+        else if (!strcmp(argv[i], "--outputs"))                   opt.listOutputs = true;
+        else if (!strcmp(argv[i], "--echo"))                      host::echoSerial = true;
+        else path = argv[i];
+    }
+    if (!path || opt.loopUs <= 0 || opt.idleUs <= 0) {
+        fprintf(stderr, "usage: replay-%s [--loop-us N] [--active-ms N] [--idle-ms N] [--outputs] [--echo] trace\n",
+                device);
+        return 1;
+    }
+
+    Trace trace;
+    host::reset();
+    if (!loadTrace(path, trace)) return 1;
+    if (!trace.device.empty() && trace.device != device) {
+        fprintf(stderr, "%s: recorded on the %s, this is the %s replay\n", path, trace.device.c_str(), device);
+        return 2;
+    }
+    return run(path, trace, opt, setup, loop);
+}
+
+} // namespace replay
@@ -0,0 +1,187 @@
+// Host test of incoming message sizes against the MQTT packet buffer: the
+// sketch (sensor or actuator, whichever folder is on the include path) on
+// the shims of tools/replay/shim, fed messages from 128 B to 16 KB through
+// the PubSubClient emulation, with the library's buffer handling.
+//
+//   g++ -O2 -std=gnu++17 -I tools/replay/shim -I espActuator -I <ArduinoJson>/src
+//       -Wl,--wrap=time -Wl,--wrap=gettimeofday
+//       -Wl,--wrap=select -Wl,--wrap=read -Wl,--wrap=write
+//       -o /tmp/payload-sizes-actuator tools/replay/payload-sizes.cpp
+//   (-I espSensor -o /tmp/payload-sizes-sensor for the sensor)
+//
+// Actuator: shadow deltas with the door key before and after a "metadata"
+// section padded to the size. Every one must move the door and be reported,
+// the larger ones through the streaming parser (ShadowStreamParser).
+// Sensor: history queries padded to the size. Those that fit are answered,
+// the larger ones are not and are counted as dropped.
+// Both: the oversized / dropped counters of the next health report (ovs,
+// drop) must match, and no heap allocation may happen while messages are
+// handled: memory use is the device object plus the packet buffer, whatever
+// the message size. Exits with 1 on the first failure.
+
+#include "ReplayEngine.hpp"
+
+#if __has_include("espSensor.ino")
+#include "espSensor.ino"
+#define DEVICE      espSensor
+#define IS_SENSOR   1
+typedef SensorConfig Config;
+#else
+#include "espActuator.ino"
+#define DEVICE      espActuator
+#define IS_SENSOR   0
+typedef ActuatorConfig Config;
+#endif
+
+typedef decltype(DEVICE) DeviceType;
+
+static const size_t SIZES[] = {128, 256, 512, 1024, 2048, 4096, 8192, 16384};
+
+static void check(bool ok, const char* what, size_t size) {
+    if (!ok) {
+        fprintf(stderr, "FAILED: %s (%zu bytes)\n", what, size);
+        exit(1);
+    }
+}
+
+// Runs loop() every millisecond for `ms` of virtual time
+static void runFor(int64_t ms) {
+    int64_t end = host::nowUs + ms * 1000;
+    while (host::nowUs < end) {
+        host::advance(host::nowUs + 1000);
+        loop();
+    }
+}
+
+// Unsigned value of `key` in the CBOR map of a health report, -1 if absent
+static int64_t cborField(const std::string& cbor, const char* key) {
+    size_t at = 0;
+    auto head = [&](uint8_t& major) -> uint64_t {
+        uint8_t  b    = (uint8_t)cbor[at++];
+        uint8_t  info = b & 31;
+        uint64_t arg  = info;
+        major = b >> 5;
+        if (info >= 24) {
+            arg = 0;
+            for (int n = 1 << (info - 24); n > 0; n--) arg = (arg << 8) | (uint8_t)cbor[at++];
+        }
+        return arg;
+    };
+    uint8_t  major;
+    uint64_t pairs = head(major);
+    for (uint64_t i = 0; i < pairs && at < cbor.size(); i++) {
+        uint64_t    len = head(major);
+        std::string k   = cbor.substr(at, len);
+        at += len;
+        uint64_t v = head(major);
+        if (k == key) return major == 0 ? (int64_t)v : -1;
+    }
+    return -1;
+}
+
+// Counters of the first health report published after `from`
+static bool healthAfter(size_t from, int64_t& oversized, int64_t& dropped) {
+    for (size_t i = from; i < host::outputs.size(); i++) {
+        const host::Output& o = host::outputs[i];
+        if (o.kind != 'P' || o.topic != DeviceType::telemetryTopic.c_str()) continue;
+        oversized = cborField(o.payload, "ovs");
+        dropped   = cborField(o.payload, "drop");
+        return true;
+    }
+    return false;
+}
+
+// Message of exactly `size` bytes: `head` + padding + `tail`
+static std::string padded(const std::string& head, const std::string& tail, size_t size) {
+    size_t fixed = head.size() + tail.size();
+    return head + std::string(size > fixed ? size - fixed : 0, 'x') + tail;
+}
+
+// Whether the whole packet fits the buffer, as PubSubClient counts it
+static bool fits(const std::string& topic, size_t payload) {
+    size_t remaining = 2 + topic.size() + payload;
+    size_t llen      = remaining < 128 ? 1 : remaining < 16384 ? 2 : 3;
+    return 1 + llen + remaining <= Config::mqttBufferSize;
+}
+
+static bool publishedAfter(size_t from, const std::string& topic, const std::string& contains) {
+    for (size_t i = from; i < host::outputs.size(); i++) {
+        const host::Output& o = host::outputs[i];
+        if (o.kind == 'P' && o.topic == topic && o.payload.find(contains) != std::string::npos) return true;
+    }
+    return false;
+}
+
+int main() {
+    host::countAllocs = false;   // Boot is counted by the replay binaries
+    host::allocs      = 0;
+    host::reset();
+    setup();
+    runFor(1000);
+
+    std::vector<host::Message> messages;
+    messages.reserve(2 * sizeof(SIZES) / sizeof(SIZES[0]));
+    int64_t  expectOversized = 0, expectDropped = 0;
+    uint32_t n = 0;
+
+    printf("%s: %u-byte MQTT buffer, device object %zu bytes\n",
+           IS_SENSOR ? "sensor" : "actuator", (unsigned)Config::mqttBufferSize, sizeof(DEVICE));
+    printf("%8s %-6s %-5s %-8s %4s %4s\n", "bytes", "case", "fits", "handled", "ovs", "drop");
+
+    for (size_t size : SIZES) {
+        for (int variant = 0; variant < (IS_SENSOR ? 1 : 2); variant++) {
+            n++;
+            std::string topic, expect, replyTopic;
+            host::Message m;
+#if IS_SENSOR
+            topic      = DeviceType::journalTopic.c_str();
+            replyTopic = topic + "/reply";
+            m.payload  = padded("{\"id\":" + std::to_string(n) + ",\"last\":1,\"pad\":\"", "\"}", size);
+            expect     = "";
+#else
+            // Door key ahead of the metadata (within the buffer head) or after it
+            const char* state = n % 2 ? "OPEN" : "CLOSED";
+            std::string door  = std::string("\"state\":{\"interiorDoor\":\"") + state + "\"}";
+            topic      = DeviceType::deltaTopic.c_str();
+            replyTopic = DeviceType::updateTopic.c_str();
+            m.payload  = variant == 0
+                ? padded("{\"version\":" + std::to_string(n) + "," + door + ",\"metadata\":{\"pad\":\"", "\"}}", size)
+                : padded("{\"version\":" + std::to_string(n) + ",\"metadata\":{\"pad\":\"", "\"}," + door + "}", size);
+            expect     = std::string("\"interiorDoor\":\"") + state + "\"";
+#endif
+            m.topic = topic;
+            m.total = m.payload.size();
+            messages.push_back(m);
+
+            bool whole = fits(topic, m.payload.size());
+            if (!whole) expectOversized++;
+            if (!whole && IS_SENSOR) expectDropped++;
+
+            size_t outputsBefore = host::outputs.size();
+            host::inbound.push_back(&messages.back());
+            host::countAllocs = true;   // The firmware's, not the test's own strings
+            runFor(2000);
+            bool handled = publishedAfter(outputsBefore, replyTopic, expect);
+
+            // Next health report (every telemetryIntervalMs)
+            size_t reportFrom = host::outputs.size();
+            runFor(Config::telemetryIntervalMs + 1000);
+            host::countAllocs = false;
+            int64_t oversized = -1, dropped = -1;
+            check(healthAfter(reportFrom, oversized, dropped), "health report", size);
+
+            printf("%8zu %-6s %-5s %-8s %4lld %4lld\n", m.payload.size(),
+                   IS_SENSOR ? "query" : variant == 0 ? "head" : "tail", whole ? "yes" : "no",
+                   handled ? "yes" : "no", (long long)oversized, (long long)dropped);
+
+            check(m.payload.size() == size, "message size", size);
+            check(handled == (whole || !IS_SENSOR), IS_SENSOR ? "query answered iff it fits" : "door reported", size);
+            check(oversized == expectOversized, "oversized count", size);
+            check(dropped == expectDropped, "dropped count", size);
+        }
+    }
+
+    printf("heap allocations while handling: %llu\n", (unsigned long long)host::allocs);
+    check(host::allocs == 0, "no heap allocation", 0);
+    return 0;
+}
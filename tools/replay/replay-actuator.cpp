@@ -0,0 +1,20 @@
+// Host replay of the interior door actuator: the sketch itself
+// (espActuator/espActuator.ino, its ActuatorConfig and Device<>) on the
+// shims of tools/replay/shim, driven by a recorded or synthetic trace. See
+// ReplayEngine.hpp; normally built and run by tools/replay.js:
+//
+//   g++ -O2 -std=gnu++17 -I tools/replay/shim -I espActuator -I <ArduinoJson>/src
+//       -Wl,--wrap=time -Wl,--wrap=gettimeofday
+//       -Wl,--wrap=select -Wl,--wrap=read -Wl,--wrap=write
+//       -o /tmp/replay-actuator tools/replay/replay-actuator.cpp
+//   /tmp/replay-actuator [--loop-us N] [--active-ms N] [--idle-ms N] [--outputs] [--echo] trace
+//
+// <ArduinoJson> is the ArduinoJson library of the Arduino installation
+// (e.g. ~/Arduino/libraries/ArduinoJson).
+
+#include "ReplayEngine.hpp"
+#include "espActuator.ino"
+
+int main(int argc, char** argv) {
+    return replay::cli(argc, argv, "actuator", setup, loop);
+}
@@ -0,0 +1,121 @@
+// Arduino.h (host shim for tools/replay)
+//
+// The part of the Arduino core the sketches use, on the virtual clock of
+// HostWorld.h. Serial output is formatted (its cost is part of a handler's
+// cost) and then discarded, or echoed to stderr with --echo.
+#pragma once
+#include <stdint.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include "HostWorld.h"
+
+typedef uint8_t byte;
+
+#define LOW          0
+#define HIGH         1
+#define INPUT        0x01
+#define OUTPUT       0x03
+#define INPUT_PULLUP 0x05
+#define CHANGE       0x03
+#define IRAM_ATTR
+#define RTC_DATA_ATTR
+
+inline unsigned long millis() { return (unsigned long)(host::nowUs / 1000); }
+inline unsigned long micros() { return (unsigned long)host::nowUs; }
+inline void delay(unsigned long ms) { host::advance(host::nowUs + (int64_t)ms * 1000); }
+inline void yield() {}
+
+inline uint32_t getCpuFrequencyMhz() { return 240; }
+inline uint32_t getXtalFrequencyMhz() { return 40; }
+
+inline void pinMode(int, int) {}
+inline int  digitalRead(int pin) { return host::pins[pin & 63]; }
+
+inline void attachInterruptArg(int pin, void (*fn)(void*), void* arg, int) { host::isrs[pin & 63] = {fn, arg}; }
+inline void detachInterrupt(int pin) { host::isrs[pin & 63] = {}; }
+
+class String : public std::string {
+public:
+    using std::string::string;
+    String() {}
+    String(const std::string& s) : std::string(s) {}
+};
+
+class Print {
+public:
+    virtual ~Print() {}
+    virtual size_t write(uint8_t b) = 0;
+    virtual size_t write(const uint8_t* buf, size_t n) {
+        for (size_t i = 0; i < n; i++) write(buf[i]);
+        return n;
+    }
+    size_t write(const char* s) { return write((const uint8_t*)s, strlen(s)); }
+
+    size_t printf(const char* fmt, ...) __attribute__((format(printf, 2, 3))) {
+        char    buf[256];
+        va_list ap;
+        va_start(ap, fmt);
+        int n = vsnprintf(buf, sizeof(buf), fmt, ap);
+        va_end(ap);
+        if (n < 0) return 0;
+        return write((const uint8_t*)buf, (size_t)n < sizeof(buf) ? (size_t)n : sizeof(buf) - 1);
+    }
+
+    size_t print(const char* s)          { return write(s); }
+    size_t print(const String& s)        { return write(s.c_str()); }
+    size_t print(char c)                 { return write((uint8_t)c); }
+    size_t print(int v)                  { return printf("%d", v); }
+    size_t print(unsigned int v)         { return printf("%u", v); }
+    size_t print(long v)                 { return printf("%ld", v); }
+    size_t print(unsigned long v)        { return printf("%lu", v); }
+    size_t print(double v, int digits = 2) { return printf("%.*f", digits, v); }
+
+    size_t println()                     { return write("\r\n"); }
+    template <typename T>
+    size_t println(const T& v)           { size_t n = print(v); return n + println(); }
+};
+
+class Stream : public Print {
+public:
+    virtual int  available() = 0;
+    virtual int  read() = 0;
+    virtual int  peek() = 0;
+    virtual void flush() {}
+};
+
+class HardwareSerial : public Stream {
+public:
+    void begin(unsigned long) {}
+    using Print::write;
+    size_t write(uint8_t b) override {
+        host::serialBytes++;
+        if (host::echoSerial) fputc(b, stderr);
+        return 1;
+    }
+    size_t write(const uint8_t* buf, size_t n) override {
+        host::serialBytes += n;
+        if (host::echoSerial) fwrite(buf, 1, n, stderr);
+        return n;
+    }
+    int available() override { return 0; }
+    int read() override { return -1; }
+    int peek() override { return -1; }
+};
+
+inline HardwareSerial Serial;
+
+struct EspClass {
+    uint32_t getFreeHeap()    { return 200000; }
+    uint32_t getMinFreeHeap() { return 180000; }
+    uint32_t getMaxAllocHeap(){ return 110000; }
+    uint32_t getSketchSize()  { return 1000000; }
+    void     restart()        { fprintf(stderr, "replay: ESP.restart() called\n"); exit(3); }
+};
+
+inline EspClass ESP;
+
+// SNTP start: the clock itself comes from the trace ("C" events)
+inline void configTime(long, int, const char*, const char* = nullptr, const char* = nullptr) {}
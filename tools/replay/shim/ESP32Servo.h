@@ -0,0 +1,14 @@
+// ESP32Servo.h (host shim for tools/replay): angles land in host::outputs
+#pragma once
+#include <string>
+#include "HostWorld.h"
+
+class Servo {
+public:
+    void setPeriodHertz(int) {}
+    void attach(int, int, int) {}
+    void write(int angle) {
+        host::ShimScope shim;
+        host::outputs.push_back({host::nowUs, 'S', "servo", std::to_string(angle)});
+    }
+};
@@ -0,0 +1,129 @@
+// HostWorld.h
+//
+// State shared by the host shims of the Arduino / ESP-IDF API used by the
+// sketches (tools/replay/shim/*.h). Everything the firmware can observe
+// comes from here and is driven by the replay engine (ReplayEngine.hpp):
+//
+//   nowUs      virtual esp_timer clock; millis(), micros(), delay() and
+//              esp_timer callbacks all follow it
+//   wall*      wall clock set by "C" trace events (time(), gettimeofday())
+//   pins       input levels set by "G" trace events, which also run the
+//              pin's interrupt handler (isrs) on a change
+//   inbound    MQTT messages waiting to be delivered by PubSubClient::loop();
+//              while any is left, socketFd is readable for select()
+//   eventCount counter of the firmware's eventfd (eventFd)
+//   outputs    what the firmware did: publishes and servo moves, with the
+//              virtual time they happened at
+//   allocs     heap allocations made by the firmware, and their bytes
+//              (allocBytes), counted by the replay's operator new; the
+//              shims' own bookkeeping is not
+//
+// Single-threaded: esp_timer callbacks run inline from advance(), in due
+// time order, which makes a replay fully deterministic.
+#pragma once
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+namespace host {
+
+struct Timer {
+    void      (*callback)(void*);
+    void*     arg;
+    int64_t   periodUs;    // 0 = one-shot
+    int64_t   dueUs;
+    bool      active;
+};
+
+struct Isr {
+    void (*fn)(void*);
+    void* arg;
+};
+
+struct Message {
+    std::string topic;
+    std::string payload;
+    size_t      total;     // Recorded size; > payload.size() for a partial message
+};
+
+struct Output {
+    int64_t     atUs;
+    char        kind;      // 'P' publish, 'S' servo angle
+    std::string topic;
+    std::string payload;
+};
+
+inline int64_t              nowUs        = 0;
+inline int64_t              wallEpochS   = 0;     // 0 until the first "C" event
+inline int64_t              wallAtUs     = 0;     // nowUs when wallEpochS was recorded
+inline uint8_t              pins[64]     = {};
+inline Isr                  isrs[64]     = {};    // attachInterruptArg(), CHANGE only
+inline std::vector<const Message*> inbound;     // Reserved up front, consumed from inboundNext
+inline size_t               inboundNext  = 0;
+inline constexpr int        socketFd     = 1000;  // WiFiClientSecure::fd(), below FD_SETSIZE
+inline constexpr int        eventFd      = 1001;  // eventfd()
+inline uint64_t             eventCount   = 0;
+inline std::vector<Output>  outputs;
+inline std::vector<Timer*>  timers;
+inline uint64_t             serialBytes  = 0;     // Log output, discarded
+inline bool                 echoSerial   = false; // Copy the log to stderr
+inline uint64_t             allocs       = 0;
+inline uint64_t             allocBytes   = 0;
+inline bool                 countAllocs  = false;
+
+// Keeps the shims' own allocations out of host::allocs
+struct ShimScope {
+    bool saved;
+    ShimScope() : saved(countAllocs) { countAllocs = false; }
+    ~ShimScope() { countAllocs = saved; }
+};
+
+// Moves the virtual clock to `toUs`, running every timer that falls due
+// on the way at its own due time
+inline void advance(int64_t toUs) {
+    for (;;) {
+        Timer* next = nullptr;
+        for (Timer* t : timers) {
+            if (t->active && t->dueUs <= toUs && (!next || t->dueUs < next->dueUs)) next = t;
+        }
+        if (!next) break;
+        if (next->dueUs > nowUs) nowUs = next->dueUs;
+        if (next->periodUs) next->dueUs += next->periodUs;
+        else                next->active = false;
+        next->callback(next->arg);
+    }
+    if (toUs > nowUs) nowUs = toUs;
+}
+
+// Earliest due time of an active timer, or INT64_MAX
+inline int64_t nextTimerUs() {
+    int64_t due = INT64_MAX;
+    for (Timer* t : timers) {
+        if (t->active && t->dueUs < due) due = t->dueUs;
+    }
+    return due;
+}
+
+// Wall clock as the device would see it: SNTP time once a "C" event was
+// replayed, seconds since boot before that (as with no SNTP sync)
+inline int64_t wallUs() {
+    if (!wallEpochS) return nowUs;
+    return wallEpochS * 1000000 + (nowUs - wallAtUs);
+}
+
+inline void reset() {
+    nowUs      = 0;
+    wallEpochS = 0;
+    wallAtUs   = 0;
+    std::fill(std::begin(pins), std::end(pins), 1);   // Pull-ups
+    std::fill(std::begin(isrs), std::end(isrs), Isr{});
+    inbound.clear();
+    inboundNext = 0;
+    outputs.clear();
+    timers.clear();
+    serialBytes = 0;
+    eventCount  = 0;
+}
+
+} // namespace host
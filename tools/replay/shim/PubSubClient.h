@@ -0,0 +1,139 @@
+// PubSubClient.h (host shim for tools/replay)
+//
+// Always connected. publish() lands in host::outputs, with the library's
+// size check against the packet buffer; loop() delivers at most one message
+// of host::inbound per call (as the library reads one packet per call),
+// only for subscribed topics, with the library's buffer handling: an
+// attached stream gets every payload byte, the callback gets what fits in
+// the buffer, and without a stream a packet larger than the buffer is
+// dropped.
+#pragma once
+#include <Arduino.h>
+#include <WiFiClientSecure.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#define MQTT_MAX_HEADER_SIZE 5
+#define MQTT_CONNECTED       0
+#define MQTT_KEEPALIVE       15
+
+#define MQTT_CALLBACK_SIGNATURE void (*callback)(char*, uint8_t*, unsigned int)
+
+class PubSubClient {
+private:
+    MQTT_CALLBACK_SIGNATURE = nullptr;
+    Stream*                  stream     = nullptr;
+    uint8_t*                 buffer     = nullptr;
+    uint16_t                 bufferSize = 0;
+    bool                     isConnected = false;
+    std::vector<std::string> subscriptions;
+
+    static bool topicMatches(const std::string& filter, const std::string& topic) {
+        size_t f = 0, t = 0;
+        while (f < filter.size()) {
+            if (filter[f] == '#') return true;
+            if (filter[f] == '+') {
+                while (t < topic.size() && topic[t] != '/') t++;
+                f++;
+                continue;
+            }
+            if (t >= topic.size() || filter[f] != topic[t]) return false;
+            f++;
+            t++;
+        }
+        return t == topic.size();
+    }
+
+    bool subscribed(const std::string& topic) const {
+        for (const std::string& s : subscriptions) {
+            if (topicMatches(s, topic)) return true;
+        }
+        return false;
+    }
+
+    void deliver(const host::Message& m) {
+        size_t   tl        = m.topic.size();
+        size_t   remaining = 2 + tl + m.payload.size();
+        size_t   llen      = remaining < 128 ? 1 : remaining < 16384 ? 2 : 3;
+        size_t   head      = 1 + llen + 2 + tl;
+        size_t   packet    = head + m.payload.size();
+
+        if (stream) {
+            for (unsigned char c : m.payload) stream->write(c);
+        } else if (packet > bufferSize) {
+            return;   // Ignored by the library
+        }
+        if (head + 1 > bufferSize) return;
+
+        // Topic as a C string followed by the payload head, in the buffer
+        size_t len = (packet < bufferSize ? packet : bufferSize) - head;
+        memcpy(buffer + llen + 2, m.topic.data(), tl);
+        buffer[llen + 2 + tl] = 0;
+        memcpy(buffer + head, m.payload.data(), len);
+        if (callback) callback((char*)buffer + llen + 2, buffer + head, (unsigned int)len);
+    }
+
+public:
+    PubSubClient() { setBufferSize(256); }
+    explicit PubSubClient(Client&) { setBufferSize(256); }
+    ~PubSubClient() { free(buffer); }
+
+    PubSubClient& setClient(Client&) { return *this; }
+    PubSubClient& setServer(const char*, uint16_t) { return *this; }
+    PubSubClient& setCallback(MQTT_CALLBACK_SIGNATURE) { this->callback = callback; return *this; }
+    PubSubClient& setStream(Stream& s) { stream = &s; return *this; }
+    PubSubClient& setKeepAlive(uint16_t) { return *this; }
+    PubSubClient& setSocketTimeout(uint16_t) { return *this; }
+
+    bool setBufferSize(uint16_t size) {
+        if (size == 0) return false;
+        uint8_t* b = (uint8_t*)realloc(buffer, size);
+        if (!b) return false;
+        // The library's heap: counted as the firmware's (net bytes)
+        if (host::countAllocs) {
+            host::allocs++;
+            host::allocBytes += size - bufferSize;
+        }
+        buffer     = b;
+        bufferSize = size;
+        return true;
+    }
+    uint16_t getBufferSize() { return bufferSize; }
+
+    bool connect(const char*) { isConnected = true; return true; }
+    bool connected() { return isConnected; }
+    void disconnect() { isConnected = false; }
+    int  state() { return MQTT_CONNECTED; }
+
+    bool publish(const char* topic, const char* payload) {
+        return publish(topic, (const uint8_t*)payload, strlen(payload));
+    }
+
+    bool publish(const char* topic, const uint8_t* payload, unsigned int length) {
+        if (!isConnected) return false;
+        if (bufferSize < MQTT_MAX_HEADER_SIZE + 2 + strnlen(topic, bufferSize) + length) return false;
+        host::ShimScope shim;
+        host::outputs.push_back({host::nowUs, 'P', topic, std::string((const char*)payload, length)});
+        return true;
+    }
+
+    bool subscribe(const char* topic) {
+        if (!isConnected) return false;
+        host::ShimScope shim;
+        if (!subscribed(topic)) subscriptions.push_back(topic);
+        return true;
+    }
+
+    bool loop() {
+        if (!isConnected) return false;
+        while (host::inboundNext < host::inbound.size()) {
+            const host::Message& m = *host::inbound[host::inboundNext++];
+            if (!subscribed(m.topic)) continue;
+            deliver(m);
+            break;
+        }
+        return true;
+    }
+};
@@ -0,0 +1,29 @@
+// WiFi.h (host shim for tools/replay): always connected
+#pragma once
+#include <Arduino.h>
+#include <WiFiClientSecure.h>
+#include <esp_wifi.h>
+
+#define WL_CONNECTED 3
+#define WIFI_STA     1
+
+class WiFiClass {
+public:
+    void     begin(const char*, const char*, int32_t = 0, const uint8_t* = nullptr, bool = true) {}
+    int      status() { return WL_CONNECTED; }
+    void     mode(int) {}
+    void     setSleep(bool) {}
+    void     setSleep(wifi_ps_type_t) {}
+    bool     reconnect() { return true; }
+    void     setAutoReconnect(bool) {}
+    void     persistent(bool) {}
+    void     disconnect(bool = false, bool = false) {}
+    int32_t  RSSI() { return -60; }
+    int32_t  channel() { return 6; }
+    uint8_t* BSSID() { return bssid; }
+
+private:
+    uint8_t bssid[6] = {0x02, 0, 0, 0, 0, 1};
+};
+
+inline WiFiClass WiFi;
@@ -0,0 +1,22 @@
+// WiFiClientSecure.h (host shim for tools/replay): no socket, PubSubClient's
+// shim talks to HostWorld directly. fd() is host::socketFd, which the
+// replay's select() reports readable while a message is waiting.
+#pragma once
+#include <Arduino.h>
+
+class Client : public Stream {
+public:
+    using Print::write;
+    size_t write(uint8_t) override { return 1; }
+    int available() override { return 0; }
+    int read() override { return -1; }
+    int peek() override { return -1; }
+    int fd() const { return host::socketFd; }
+};
+
+class WiFiClientSecure : public Client {
+public:
+    void setCACert(const char*) {}
+    void setCertificate(const char*) {}
+    void setPrivateKey(const char*) {}
+};
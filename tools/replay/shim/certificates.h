@@ -0,0 +1,5 @@
+// certificates.h (host shim for tools/replay): no TLS on the host
+#pragma once
+const char AWS_ROOT_CA_CERTIFICATE[] = "";
+const char AWS_CLIENT_CERTIFICATE[]  = "";
+const char AWS_PRIVATE_KEY[]         = "";
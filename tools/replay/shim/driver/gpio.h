@@ -0,0 +1,11 @@
+// driver/gpio.h (host shim for tools/replay): levels from host::pins
+#pragma once
+#include "esp_err.h"
+#include "HostWorld.h"
+
+typedef enum { GPIO_NUM_0 = 0, GPIO_NUM_MAX = 64 } gpio_num_t;
+typedef enum { GPIO_INTR_ANYEDGE = 3, GPIO_INTR_LOW_LEVEL = 4, GPIO_INTR_HIGH_LEVEL = 5 } gpio_int_type_t;
+
+inline int       gpio_get_level(gpio_num_t pin) { return host::pins[pin & 63]; }
+inline esp_err_t gpio_wakeup_enable(gpio_num_t, gpio_int_type_t) { return ESP_OK; }
+inline esp_err_t gpio_wakeup_disable(gpio_num_t) { return ESP_OK; }
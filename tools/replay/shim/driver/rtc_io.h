@@ -0,0 +1,7 @@
+// driver/rtc_io.h (host shim for tools/replay)
+#pragma once
+#include "driver/gpio.h"
+
+inline esp_err_t rtc_gpio_deinit(gpio_num_t) { return ESP_OK; }
+inline esp_err_t rtc_gpio_pullup_en(gpio_num_t) { return ESP_OK; }
+inline esp_err_t rtc_gpio_pulldown_dis(gpio_num_t) { return ESP_OK; }
@@ -0,0 +1,3 @@
+// esp_idf_version.h (host shim for tools/replay)
+#pragma once
+#define ESP_IDF_VERSION_MAJOR 5
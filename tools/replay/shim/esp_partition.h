@@ -0,0 +1,67 @@
+// esp_partition.h (host shim for tools/replay): data partitions in RAM,
+// with NOR semantics (a write can only clear bits, erase sets 0xFF)
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <vector>
+#include "esp_err.h"
+
+typedef enum { ESP_PARTITION_TYPE_APP = 0, ESP_PARTITION_TYPE_DATA = 1 } esp_partition_type_t;
+typedef enum { ESP_PARTITION_SUBTYPE_ANY = 0xff } esp_partition_subtype_t;
+
+typedef struct {
+    esp_partition_type_t type;
+    uint32_t             address;
+    uint32_t             size;
+    const char*          label;
+} esp_partition_t;
+
+namespace host {
+
+struct Partition {
+    esp_partition_t      info;
+    std::vector<uint8_t> bytes;
+};
+
+// The "journal" partition of espSensor/partitions.csv (flash, so not part
+// of the firmware's heap)
+inline Partition journalPartition = [] {
+    ShimScope shim;
+    return Partition{{ESP_PARTITION_TYPE_DATA, 0x290000, 0x40000, "journal"}, std::vector<uint8_t>(0x40000, 0xFF)};
+}();
+
+inline Partition* partitionOf(const esp_partition_t* p) {
+    return p == &journalPartition.info ? &journalPartition : nullptr;
+}
+
+} // namespace host
+
+inline const esp_partition_t* esp_partition_find_first(esp_partition_type_t type, esp_partition_subtype_t,
+                                                       const char* label) {
+    const esp_partition_t& j = host::journalPartition.info;
+    if (type == j.type && label && strcmp(label, j.label) == 0) return &j;
+    return nullptr;
+}
+
+inline esp_err_t esp_partition_read(const esp_partition_t* p, size_t offset, void* buf, size_t len) {
+    host::Partition* part = host::partitionOf(p);
+    if (!part || offset + len > part->bytes.size()) return ESP_FAIL;
+    memcpy(buf, &part->bytes[offset], len);
+    return ESP_OK;
+}
+
+inline esp_err_t esp_partition_write(const esp_partition_t* p, size_t offset, const void* buf, size_t len) {
+    host::Partition* part = host::partitionOf(p);
+    if (!part || offset + len > part->bytes.size()) return ESP_FAIL;
+    const uint8_t* src = (const uint8_t*)buf;
+    for (size_t i = 0; i < len; i++) part->bytes[offset + i] &= src[i];
+    return ESP_OK;
+}
+
+inline esp_err_t esp_partition_erase_range(const esp_partition_t* p, size_t offset, size_t len) {
+    host::Partition* part = host::partitionOf(p);
+    if (!part || offset + len > part->bytes.size()) return ESP_FAIL;
+    memset(&part->bytes[offset], 0xFF, len);
+    return ESP_OK;
+}
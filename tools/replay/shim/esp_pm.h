@@ -0,0 +1,13 @@
+// esp_pm.h (host shim for tools/replay): replays run always-on, automatic
+// light sleep is accepted and has no effect
+#pragma once
+#include "esp_err.h"
+#include "esp_idf_version.h"
+
+typedef struct {
+    int  max_freq_mhz;
+    int  min_freq_mhz;
+    bool light_sleep_enable;
+} esp_pm_config_t;
+
+inline esp_err_t esp_pm_configure(const void*) { return ESP_OK; }
@@ -0,0 +1,20 @@
+// esp_sleep.h (host shim for tools/replay): replays run always-on, sleep
+// requests return at once
+#pragma once
+#include <stdint.h>
+#include "esp_err.h"
+#include "driver/gpio.h"
+
+typedef enum {
+    ESP_SLEEP_WAKEUP_UNDEFINED,
+    ESP_SLEEP_WAKEUP_EXT0,
+    ESP_SLEEP_WAKEUP_TIMER,
+    ESP_SLEEP_WAKEUP_GPIO
+} esp_sleep_wakeup_cause_t;
+
+inline esp_sleep_wakeup_cause_t esp_sleep_get_wakeup_cause() { return ESP_SLEEP_WAKEUP_UNDEFINED; }
+inline esp_err_t esp_sleep_enable_ext0_wakeup(gpio_num_t, int) { return ESP_OK; }
+inline esp_err_t esp_sleep_enable_timer_wakeup(uint64_t) { return ESP_OK; }
+inline esp_err_t esp_sleep_enable_gpio_wakeup() { return ESP_OK; }
+inline esp_err_t esp_light_sleep_start() { return ESP_OK; }
+inline void      esp_deep_sleep_start() {}
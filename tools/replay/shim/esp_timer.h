@@ -0,0 +1,47 @@
+// esp_timer.h (host shim for tools/replay): timers run from host::advance()
+#pragma once
+#include <stdint.h>
+#include "esp_err.h"
+#include "HostWorld.h"
+
+typedef host::Timer* esp_timer_handle_t;
+typedef void (*esp_timer_cb_t)(void*);
+
+typedef enum { ESP_TIMER_TASK, ESP_TIMER_ISR } esp_timer_dispatch_t;
+
+typedef struct {
+    esp_timer_cb_t       callback;
+    void*                arg;
+    esp_timer_dispatch_t dispatch_method;
+    const char*          name;
+    bool                 skip_unhandled_events;
+} esp_timer_create_args_t;
+
+inline int64_t esp_timer_get_time() { return host::nowUs; }
+
+inline esp_err_t esp_timer_create(const esp_timer_create_args_t* args, esp_timer_handle_t* out) {
+    host::ShimScope shim;
+    host::Timer* t = new host::Timer{args->callback, args->arg, 0, 0, false};
+    host::timers.push_back(t);
+    *out = t;
+    return ESP_OK;
+}
+
+inline esp_err_t esp_timer_start_periodic(esp_timer_handle_t t, uint64_t periodUs) {
+    t->periodUs = (int64_t)periodUs;
+    t->dueUs    = host::nowUs + t->periodUs;
+    t->active   = true;
+    return ESP_OK;
+}
+
+inline esp_err_t esp_timer_start_once(esp_timer_handle_t t, uint64_t timeoutUs) {
+    t->periodUs = 0;
+    t->dueUs    = host::nowUs + (int64_t)timeoutUs;
+    t->active   = true;
+    return ESP_OK;
+}
+
+inline esp_err_t esp_timer_stop(esp_timer_handle_t t) {
+    t->active = false;
+    return ESP_OK;
+}
@@ -0,0 +1,18 @@
+// esp_vfs_eventfd.h (host shim for tools/replay): one eventfd,
+// host::eventFd, whose counter lives in HostWorld (see the read(), write()
+// and select() wrappers in ReplayEngine.hpp)
+#pragma once
+#include <stddef.h>
+#include "esp_err.h"
+#include "HostWorld.h"
+
+#define EFD_SUPPORT_ISR 1
+
+typedef struct {
+    size_t max_fds;
+} esp_vfs_eventfd_config_t;
+
+#define ESP_VFS_EVENTD_CONFIG_DEFAULT() esp_vfs_eventfd_config_t{5}
+
+inline esp_err_t esp_vfs_eventfd_register(const esp_vfs_eventfd_config_t*) { return ESP_OK; }
+inline int       eventfd(unsigned int, int) { return host::eventFd; }
@@ -0,0 +1,11 @@
+// esp_wifi.h (host shim for tools/replay)
+#pragma once
+#include <stdint.h>
+#include "esp_err.h"
+
+typedef enum { WIFI_IF_STA } wifi_interface_t;
+typedef enum { WIFI_PS_NONE, WIFI_PS_MIN_MODEM, WIFI_PS_MAX_MODEM } wifi_ps_type_t;
+typedef struct { struct { uint16_t listen_interval; } sta; } wifi_config_t;
+
+inline esp_err_t esp_wifi_get_config(wifi_interface_t, wifi_config_t* conf) { *conf = {}; return ESP_OK; }
+inline esp_err_t esp_wifi_set_config(wifi_interface_t, wifi_config_t*) { return ESP_OK; }
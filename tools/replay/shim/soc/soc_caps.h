@@ -0,0 +1,3 @@
+// soc/soc_caps.h (host shim for tools/replay): no GPIO glitch filter, the
+// trace already holds the levels the sampler saw
+#pragma once
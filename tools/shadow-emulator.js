@@ -0,0 +1,780 @@
+#!/usr/bin/env node
+// Local stand-in for AWS IoT Core: an MQTT broker plus the Device Shadow
+// service, so the firmwares and the Alexa handlers (index.js) can be run
+// and load-tested without an AWS account.
+//
+//   node tools/shadow-emulator.js [--mqtt-port 1883] [--http-port 8080]
+//                                 [--tls-port 8883 --tls-cert c.pem --tls-key k.pem [--tls-ca ca.pem]]
+//                                 [--stats-interval 10] [--http-delay-ms 0] [--verbose]
+//
+// MQTT (plain and/or TLS): same topics as AWS IoT, classic and named shadows
+//   $aws/things/<thing>/shadow[/name/<shadow>]/update   -> /update/accepted, /update/rejected,
+//                                                          /update/delta, /update/documents
+//   $aws/things/<thing>/shadow[/name/<shadow>]/get      -> /get/accepted, /get/rejected
+//   $aws/things/<thing>/shadow[/name/<shadow>]/delete   -> /delete/accepted, /delete/rejected
+// Every other topic is plain pub/sub (telemetry, OTA chunks, ...).
+//
+// HTTP, the REST API used by the IoT data plane SDK clients:
+//   GET|POST|DELETE /things/<thing>/shadow[?name=<shadow>]
+//   POST            /topics/<topic>[?qos=N]
+//   GET             /stats                  per-operation latency / throughput as JSON
+//   GET (upgrade)   /mqtt                   MQTT over WebSocket (no SigV4 check), as used
+//                                           by shadowWatch.js with IOT_MQTT_URL=ws://localhost:8080/mqtt
+//   POST            /  (X-Amz-Target)       DynamoDB JSON protocol: GetItem, PutItem and
+//                                           BatchGetItem on in-memory tables (user_thing)
+// --http-delay-ms adds a fixed delay to every HTTP response, to stand in for
+// the round trip from a Lambda to the AWS endpoints.
+//
+// Lambda:   IOT_ENDPOINT=http://localhost:8080 DYNAMODB_ENDPOINT=http://localhost:8080
+//           AWS_REGION=us-east-1 (plus any dummy AWS credentials)
+// Firmware: point server/port at this host's --tls-port and load the CA that
+//           signed --tls-cert (NetworkConfig's custom-certificate constructor).
+//
+// Simplifications: deliveries are QoS 0, no retained messages or persistent
+// sessions, no authorization. As on AWS, a connection gets at most 50
+// subscriptions and is dropped after 1.5 keep-alive periods of silence. Shadow documents are kept in memory.
+
+const net          = require('net');
+const tls          = require('tls');
+const fs           = require('fs');
+const http         = require('http');
+const crypto       = require('crypto');
+const EventEmitter = require('events');
+const mqtt         = require('./lib/mqtt');
+
+const MAX_DOCUMENT_BYTES = 8192;   // AWS limit for the state part of a shadow
+const MAX_SUBSCRIPTIONS  = 50;     // AWS limit per connection, beyond it SUBACK 0x80
+const LATENCY_SAMPLES    = 4096;   // Per-operation ring used for percentiles
+
+const now = () => Math.floor(Date.now() / 1000);
+const isObject = (v) => v !== null && typeof v === 'object' && !Array.isArray(v);
+
+// ================== STATS ==================
+
+/**
+ * Counters per operation name ("mqtt.update", "http.get", ...). Latency is
+ * measured from request receipt to the last response byte handed to the
+ * socket(s), i.e. the emulator's own processing cost.
+ */
+class Stats {
+    constructor() {
+        this.ops     = new Map();
+        this.started = process.hrtime.bigint();
+    }
+
+    op(name) {
+        let s = this.ops.get(name);
+        if (!s) {
+            s = { count: 0, errors: 0, bytesIn: 0, bytesOut: 0, lat: new Float64Array(LATENCY_SAMPLES), windowCount: 0 };
+            this.ops.set(name, s);
+        }
+        return s;
+    }
+
+    record(name, t0, bytesIn, bytesOut, error = false) {
+        const s  = this.op(name);
+        const us = Number(process.hrtime.bigint() - t0) / 1000;
+        s.lat[s.count % LATENCY_SAMPLES] = us;
+        s.count++;
+        s.windowCount++;
+        s.bytesIn  += bytesIn;
+        s.bytesOut += bytesOut;
+        if (error) s.errors++;
+    }
+
+    snapshot(windowS) {
+        const out = {};
+        for (const [name, s] of this.ops) {
+            const n   = Math.min(s.count, LATENCY_SAMPLES);
+            const lat = Array.from(s.lat.subarray(0, n)).sort((a, b) => a - b);
+            const pct = (p) => (n ? lat[Math.max(0, Math.ceil(p * n) - 1)] : 0);
+            out[name] = {
+                count:    s.count,
+                errors:   s.errors,
+                perSec:   windowS ? s.windowCount / windowS : undefined,
+                p50Us:    +pct(0.5).toFixed(1),
+                p99Us:    +pct(0.99).toFixed(1),
+                maxUs:    +(n ? lat[n - 1] : 0).toFixed(1),
+                bytesIn:  s.bytesIn,
+                bytesOut: s.bytesOut
+            };
+        }
+        return out;
+    }
+
+    print(windowS) {
+        const snap = this.snapshot(windowS);
+        for (const s of this.ops.values()) s.windowCount = 0;
+        const names = Object.keys(snap).sort();
+        if (names.length === 0) return;
+
+        console.log(`--- stats (${windowS.toFixed(0)} s window) ---`);
+        for (const name of names) {
+            const s = snap[name];
+            console.log(`${name.padEnd(16)} n=${String(s.count).padStart(7)} ${s.perSec.toFixed(1).padStart(8)}/s ` +
+                        `p50=${s.p50Us}us p99=${s.p99Us}us max=${s.maxUs}us ` +
+                        `in=${(s.bytesIn / 1024).toFixed(1)}KiB out=${(s.bytesOut / 1024).toFixed(1)}KiB err=${s.errors}`);
+        }
+    }
+}
+
+// ================== SHADOW DOCUMENTS ==================
+
+class ShadowError extends Error {
+    constructor(code, message) {
+        super(message);
+        this.code = code;
+    }
+}
+
+/**
+ * Merges `patch` into `target`, keeping `meta` (same shape, leaves are
+ * { timestamp }) in sync. null deletes a key, objects merge recursively,
+ * anything else (arrays included) replaces the value.
+ */
+function mergeState(target, meta, patch, ts) {
+    for (const [key, value] of Object.entries(patch)) {
+        if (value === null) {
+            delete target[key];
+            delete meta[key];
+        } else if (isObject(value)) {
+            if (!isObject(target[key])) target[key] = {};
+            if (!isObject(meta[key]) || 'timestamp' in meta[key]) meta[key] = {};
+            mergeState(target[key], meta[key], value, ts);
+        } else {
+            target[key] = value;
+            meta[key]   = { timestamp: ts };
+        }
+    }
+}
+
+// Metadata for the request itself: same shape, every leaf -> { timestamp }
+function metadataFor(patch, ts) {
+    const out = {};
+    for (const [key, value] of Object.entries(patch)) {
+        out[key] = isObject(value) ? metadataFor(value, ts) : { timestamp: ts };
+    }
+    return out;
+}
+
+const deepEqual = (a, b) => JSON.stringify(a) === JSON.stringify(b);
+
+/**
+ * Desired keys whose value differs from reported (recursively for objects).
+ * Returns [delta, deltaMetadata] or [null, null] when in sync.
+ */
+function computeDelta(desired, reported, desiredMeta) {
+    const delta = {};
+    const meta  = {};
+    for (const [key, value] of Object.entries(desired)) {
+        if (isObject(value) && isObject(reported[key])) {
+            const [d, m] = computeDelta(value, reported[key], (desiredMeta || {})[key]);
+            if (d) {
+                delta[key] = d;
+                meta[key]  = m;
+            }
+        } else if (!deepEqual(value, reported[key])) {
+            delta[key] = value;
+            meta[key]  = (desiredMeta || {})[key];
+        }
+    }
+    return Object.keys(delta).length ? [delta, meta] : [null, null];
+}
+
+const clone = (v) => JSON.parse(JSON.stringify(v));
+
+/**
+ * In-memory shadows keyed by thing + shadow name ('' = classic shadow).
+ * Every method returns the messages to publish as [suffix, document] pairs
+ * (suffix relative to the shadow topic prefix) or throws a ShadowError.
+ */
+class ShadowStore {
+    constructor() {
+        this.shadows = new Map();
+    }
+
+    key(thing, name) {
+        return `${thing}\u0000${name || ''}`;
+    }
+
+    describe(thing, name) {
+        return name ? `${thing}/${name}` : thing;
+    }
+
+    // Full document as returned by GET
+    document(shadow) {
+        const doc   = { state: {}, metadata: {}, version: shadow.version, timestamp: now() };
+        const state = shadow.state;
+        if (Object.keys(state.desired).length) {
+            doc.state.desired    = clone(state.desired);
+            doc.metadata.desired = clone(shadow.metadata.desired);
+        }
+        if (Object.keys(state.reported).length) {
+            doc.state.reported    = clone(state.reported);
+            doc.metadata.reported = clone(shadow.metadata.reported);
+        }
+        const [delta] = computeDelta(state.desired, state.reported, shadow.metadata.desired);
+        if (delta) doc.state.delta = delta;
+        return doc;
+    }
+
+    get(thing, name, clientToken) {
+        const shadow = this.shadows.get(this.key(thing, name));
+        if (!shadow) throw new ShadowError(404, `No shadow exists with name: '${this.describe(thing, name)}'`);
+
+        const doc = this.document(shadow);
+        if (clientToken !== undefined) doc.clientToken = clientToken;
+        return [['get/accepted', doc]];
+    }
+
+    update(thing, name, raw) {
+        if (raw.length > MAX_DOCUMENT_BYTES) {
+            throw new ShadowError(413, 'The payload exceeds the maximum size allowed');
+        }
+
+        let request;
+        try {
+            request = JSON.parse(raw.toString());
+        } catch (err) {
+            throw new ShadowError(400, 'Payload contains invalid json');
+        }
+        if (!isObject(request) || !isObject(request.state)) {
+            throw new ShadowError(400, 'Missing required node: state');
+        }
+        const { desired, reported } = request.state;
+        if ((desired !== undefined && desired !== null && !isObject(desired)) ||
+            (reported !== undefined && reported !== null && !isObject(reported))) {
+            throw new ShadowError(400, 'Invalid JSON');
+        }
+
+        const key = this.key(thing, name);
+        let shadow = this.shadows.get(key);
+        if (request.version !== undefined && (shadow ? shadow.version : 0) !== request.version) {
+            throw new ShadowError(409, 'Version conflict');
+        }
+
+        const previous = shadow ? this.document(shadow) : null;
+        if (!shadow) {
+            shadow = { state: { desired: {}, reported: {} }, metadata: { desired: {}, reported: {} }, version: 0 };
+            this.shadows.set(key, shadow);
+        }
+
+        const ts = now();
+        for (const section of ['desired', 'reported']) {
+            const patch = request.state[section];
+            if (patch === null) {
+                shadow.state[section]    = {};
+                shadow.metadata[section] = {};
+            } else if (patch !== undefined) {
+                mergeState(shadow.state[section], shadow.metadata[section], patch, ts);
+            }
+        }
+        shadow.version++;
+
+        const token    = request.clientToken !== undefined ? { clientToken: request.clientToken } : {};
+        const accepted = {
+            state:     request.state,
+            metadata:  {},
+            version:   shadow.version,
+            timestamp: ts,
+            ...token
+        };
+        for (const section of ['desired', 'reported']) {
+            if (isObject(request.state[section])) accepted.metadata[section] = metadataFor(request.state[section], ts);
+        }
+
+        const current = this.document(shadow);
+        const out = [['update/accepted', accepted]];
+
+        // Like AWS, the delta goes out when the request touched `desired`
+        if (desired !== undefined) {
+            const [delta, deltaMeta] = computeDelta(shadow.state.desired, shadow.state.reported, shadow.metadata.desired);
+            if (delta) {
+                out.push(['update/delta', { version: shadow.version, timestamp: ts, state: delta, metadata: deltaMeta, ...token }]);
+            }
+        }
+
+        const strip = (doc) => doc && { state: { desired: doc.state.desired, reported: doc.state.reported },
+                                         metadata: doc.metadata, version: doc.version };
+        out.push(['update/documents', { previous: strip(previous), current: strip(current), timestamp: ts, ...token }]);
+        return out;
+    }
+
+    delete(thing, name, clientToken) {
+        const key    = this.key(thing, name);
+        const shadow = this.shadows.get(key);
+        if (!shadow) throw new ShadowError(404, `No shadow exists with name: '${this.describe(thing, name)}'`);
+
+        this.shadows.delete(key);
+        const doc = { version: shadow.version, timestamp: now() };
+        if (clientToken !== undefined) doc.clientToken = clientToken;
+        return [['delete/accepted', doc]];
+    }
+}
+
+// $aws/things/<thing>/shadow[/name/<shadow>]/<op>
+const SHADOW_TOPIC = /^(\$aws\/things\/([^/]+)\/shadow(?:\/name\/([^/]+))?)\/(update|get|delete)$/;
+
+function clientTokenOf(payload) {
+    try {
+        const doc = JSON.parse(payload.toString());
+        return isObject(doc) ? doc.clientToken : undefined;
+    } catch (err) {
+        return undefined;
+    }
+}
+
+// ================== DYNAMODB ==================
+
+/**
+ * Minimal DynamoDB: items are kept in attribute-value form ({S: ...}) and
+ * keyed by the JSON of their key attributes, which every request names.
+ * Tables are created on first write; reading a missing table returns no item.
+ */
+class ItemStore {
+    constructor() {
+        this.tables = new Map();   // table -> Map(keyJson -> item)
+    }
+
+    static keyOf(key) {
+        return JSON.stringify(Object.keys(key).sort().map((k) => [k, key[k]]));
+    }
+
+    getItem({ TableName, Key }) {
+        const table = this.tables.get(TableName);
+        const item  = table && table.get(ItemStore.keyOf(Key));
+        return item ? { Item: item } : {};
+    }
+
+    // The partition key is taken to be the item's first attribute
+    putItem({ TableName, Item }) {
+        if (!this.tables.has(TableName)) this.tables.set(TableName, new Map());
+        const k = Object.keys(Item)[0];
+        this.tables.get(TableName).set(ItemStore.keyOf({ [k]: Item[k] }), Item);
+        return {};
+    }
+
+    batchGetItem({ RequestItems }) {
+        const Responses = {};
+        for (const [table, { Keys }] of Object.entries(RequestItems)) {
+            if (Keys.length > 100) throw new ShadowError(400, 'Too many items requested for the BatchGetItem call');
+            Responses[table] = Keys.map((Key) => this.getItem({ TableName: table, Key }).Item).filter(Boolean);
+        }
+        return { Responses, UnprocessedKeys: {} };
+    }
+}
+
+// ================== BROKER ==================
+
+class Emulator {
+    constructor({ verbose = false, httpDelayMs = 0 } = {}) {
+        this.verbose     = verbose;
+        this.httpDelayMs = httpDelayMs;
+        this.sessions    = new Map();   // clientId -> { socket, subs:Set }
+        this.store       = new ShadowStore();
+        this.items       = new ItemStore();
+        this.stats       = new Stats();
+    }
+
+    log(...args) {
+        if (this.verbose) console.log(...args);
+    }
+
+    // Delivers to every matching subscription; returns bytes written
+    publish(topic, payload) {
+        const buf = Buffer.isBuffer(payload) ? payload : Buffer.from(payload);
+        let encoded = null;
+        let bytes   = 0;
+        for (const session of this.sessions.values()) {
+            for (const filter of session.subs) {
+                if (!mqtt.topicMatches(filter, topic)) continue;
+                encoded = encoded || mqtt.encodePublish(topic, buf, 0);
+                session.socket.write(encoded);
+                bytes += encoded.length;
+                break;
+            }
+        }
+        return bytes;
+    }
+
+    /**
+     * Runs a shadow operation and publishes the responses under `prefix`.
+     * Returns { status, body, bytesOut } where body is the primary response.
+     * Over HTTP, as on AWS, only successful updates/deletes are published.
+     */
+    shadowOp(prefix, thing, name, op, payload, viaHttp = false) {
+        let responses;
+        let status = 200;
+        try {
+            if (op === 'update')   responses = this.store.update(thing, name, payload);
+            else if (op === 'get') responses = this.store.get(thing, name, clientTokenOf(payload));
+            else                   responses = this.store.delete(thing, name, clientTokenOf(payload));
+        } catch (err) {
+            if (!(err instanceof ShadowError)) throw err;
+            status = err.code;
+            const doc = { code: err.code, message: err.message, timestamp: now() };
+            const clientToken = clientTokenOf(payload);
+            if (clientToken !== undefined) doc.clientToken = clientToken;
+            responses = [[`${op}/rejected`, doc]];
+        }
+
+        let bytesOut = 0;
+        if (viaHttp && (op === 'get' || status !== 200)) return { status, body: responses[0][1], bytesOut };
+        for (const [suffix, doc] of responses) {
+            const body = JSON.stringify(doc);
+            bytesOut += this.publish(`${prefix}/${suffix}`, body);
+            this.log(`-> ${prefix}/${suffix} ${body}`);
+        }
+        return { status, body: responses[0][1], bytesOut };
+    }
+
+    // ---------- MQTT sessions ----------
+
+    attach(socket) {
+        const parser = new mqtt.PacketParser();
+        let session  = null;
+        let timer    = null;
+
+        const armKeepAlive = (keepAlive) => {
+            clearTimeout(timer);
+            if (keepAlive > 0) timer = setTimeout(() => socket.destroy(), keepAlive * 1500);
+        };
+
+        socket.setNoDelay(true);
+        socket.on('error', () => {});
+        socket.on('close', () => {
+            clearTimeout(timer);
+            if (session && this.sessions.get(session.clientId) === session) {
+                this.sessions.delete(session.clientId);
+                this.log(`disconnected ${session.clientId}`);
+            }
+        });
+
+        socket.on('data', (chunk) => {
+            let packets;
+            try {
+                packets = parser.push(chunk);
+            } catch (err) {
+                socket.destroy();
+                return;
+            }
+
+            for (const pkt of packets) {
+                const t0 = process.hrtime.bigint();
+
+                if (!session && pkt.type !== mqtt.TYPE.CONNECT) {
+                    socket.destroy();
+                    return;
+                }
+
+                switch (pkt.type) {
+                    case mqtt.TYPE.CONNECT: {
+                        const { clientId, keepAlive } = mqtt.decodeConnect(pkt.body);
+                        // Same client id takes over the old connection, as on AWS
+                        const old = this.sessions.get(clientId);
+                        if (old) old.socket.destroy();
+                        session = { clientId, socket, subs: new Set(), keepAlive };
+                        this.sessions.set(clientId, session);
+                        socket.write(mqtt.packet(mqtt.TYPE.CONNACK, 0, Buffer.from([0, 0])));
+                        this.stats.record('mqtt.connect', t0, pkt.body.length, 4);
+                        this.log(`connected ${clientId} (keepalive ${keepAlive}s)`);
+                        break;
+                    }
+
+                    case mqtt.TYPE.SUBSCRIBE: {
+                        const { packetId, topics } = mqtt.decodeSubscribe(pkt.body);
+                        const codes = topics.map((t) => {
+                            if (!session.subs.has(t.topic) && session.subs.size >= MAX_SUBSCRIPTIONS) return 0x80;
+                            session.subs.add(t.topic);
+                            return 0;
+                        });
+                        const granted = Buffer.from([packetId >> 8, packetId & 0xff, ...codes]);
+                        socket.write(mqtt.packet(mqtt.TYPE.SUBACK, 0, granted));
+                        this.stats.record('mqtt.subscribe', t0, pkt.body.length, granted.length + 2);
+                        this.log(`${session.clientId} subscribed ${topics.map((t) => t.topic).join(', ')}`);
+                        break;
+                    }
+
+                    case mqtt.TYPE.UNSUBSCRIBE: {
+                        const { packetId, topics } = mqtt.decodeUnsubscribe(pkt.body);
+                        for (const t of topics) session.subs.delete(t);
+                        socket.write(mqtt.encodeAck(mqtt.TYPE.UNSUBACK, packetId));
+                        break;
+                    }
+
+                    case mqtt.TYPE.PUBLISH: {
+                        const msg = mqtt.decodePublish(pkt);
+                        if (msg.qos === 1) socket.write(mqtt.encodeAck(mqtt.TYPE.PUBACK, msg.packetId));
+                        this.log(`<- ${session.clientId} ${msg.topic} (${msg.payload.length} B)`);
+
+                        let bytesOut = this.publish(msg.topic, msg.payload);
+                        const m = SHADOW_TOPIC.exec(msg.topic);
+                        if (m) {
+                            const res = this.shadowOp(m[1], m[2], m[3], m[4], msg.payload);
+                            bytesOut += res.bytesOut;
+                            this.stats.record(`mqtt.${m[4]}`, t0, pkt.body.length, bytesOut, res.status !== 200);
+                        } else {
+                            this.stats.record('mqtt.publish', t0, pkt.body.length, bytesOut);
+                        }
+                        break;
+                    }
+
+                    case mqtt.TYPE.PINGREQ:
+                        socket.write(mqtt.packet(mqtt.TYPE.PINGRESP, 0, Buffer.alloc(0)));
+                        break;
+
+                    case mqtt.TYPE.DISCONNECT:
+                        socket.end();
+                        break;
+
+                    default:
+                        break;   // PUBACK from clients, QoS 2 flows: ignored
+                }
+                armKeepAlive(session ? session.keepAlive : 0);
+            }
+        });
+    }
+
+    // ---------- MQTT over WebSocket ----------
+
+    /**
+     * Accepts a WebSocket upgrade on /mqtt and runs an MQTT session on it.
+     * Query parameters (SigV4 presigning) are accepted and ignored.
+     */
+    upgrade(req, socket, head) {
+        const key = req.headers['sec-websocket-key'];
+        if (!key || !req.url.startsWith('/mqtt')) {
+            socket.destroy();
+            return;
+        }
+        const accept = crypto.createHash('sha1').update(`${key}258EAFA5-E914-47DA-95CA-C5AB0DC85B11`).digest('base64');
+        socket.write('HTTP/1.1 101 Switching Protocols\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n' +
+                     `Sec-WebSocket-Accept: ${accept}\r\nSec-WebSocket-Protocol: mqtt\r\n\r\n`);
+        const conn = new WebSocketStream(socket);
+        this.attach(conn);
+        if (head && head.length) socket.emit('data', head);
+    }
+
+    // ---------- HTTP (IoT data plane REST API) ----------
+
+    handleHttp(req, res) {
+        const t0     = process.hrtime.bigint();
+        const url    = new URL(req.url, 'http://localhost');
+        const chunks = [];
+
+        req.on('data', (c) => chunks.push(c));
+        req.on('end', () => {
+            const body = Buffer.concat(chunks);
+            const send = (op, status, doc, bytesOut = 0, contentType = 'application/json') => {
+                const out = JSON.stringify(doc);
+                const headers = { 'Content-Type': contentType };
+                if (status !== 200) headers['x-amzn-ErrorType'] = ERROR_TYPES[status] || 'InternalFailureException';
+                const respond = () => {
+                    res.writeHead(status, headers);
+                    res.end(out);
+                    if (op) this.stats.record(op, t0, body.length, bytesOut + out.length, status !== 200);
+                };
+                if (this.httpDelayMs > 0) setTimeout(respond, this.httpDelayMs);
+                else respond();
+            };
+
+            const target = req.headers['x-amz-target'];
+            if (target && target.startsWith('DynamoDB_20120810.')) {
+                const action = target.slice('DynamoDB_20120810.'.length);
+                const fn     = { GetItem: 'getItem', PutItem: 'putItem', BatchGetItem: 'batchGetItem' }[action];
+                const type   = 'application/x-amz-json-1.0';
+                if (!fn) return send(null, 400, { __type: 'UnknownOperationException' }, 0, type);
+                try {
+                    return send(`dynamodb.${fn}`, 200, this.items[fn](JSON.parse(body.toString())), 0, type);
+                } catch (err) {
+                    return send(`dynamodb.${fn}`, 400, { __type: 'ValidationException', message: err.message }, 0, type);
+                }
+            }
+
+            const shadowPath = /^\/things\/([^/]+)\/shadow$/.exec(url.pathname);
+            const topicPath  = /^\/topics\/(.+)$/.exec(url.pathname);
+
+            if (shadowPath) {
+                const thing = decodeURIComponent(shadowPath[1]);
+                const name  = url.searchParams.get('name') || '';
+                const op    = { GET: 'get', POST: 'update', DELETE: 'delete' }[req.method];
+                if (!op) return send(null, 405, { message: 'Method not allowed' });
+
+                const prefix = `$aws/things/${thing}/shadow${name ? `/name/${name}` : ''}`;
+                const r = this.shadowOp(prefix, thing, name, op, body, true);
+                const doc = r.status === 200 ? r.body : { message: r.body.message };
+                return send(`http.${op}`, r.status, doc, r.bytesOut);
+            }
+
+            if (topicPath && req.method === 'POST') {
+                const topic = decodeURIComponent(topicPath[1]);
+                const bytesOut = this.publish(topic, body);
+                const m = SHADOW_TOPIC.exec(topic);
+                if (m) this.shadowOp(m[1], m[2], m[3], m[4], body);
+                return send('http.publish', 200, {}, bytesOut);
+            }
+
+            if (url.pathname === '/stats' && req.method === 'GET') {
+                const windowS = Number(process.hrtime.bigint() - this.stats.started) / 1e9;
+                return send(null, 200, { uptimeS: +windowS.toFixed(1), clients: this.sessions.size, ops: this.stats.snapshot() });
+            }
+
+            send(null, 404, { message: `No route for ${req.method} ${url.pathname}` });
+        });
+    }
+}
+
+/**
+ * Binary WebSocket messages (RFC 6455, server side) exposed with the part
+ * of the net.Socket interface that Emulator.attach() uses.
+ */
+class WebSocketStream extends EventEmitter {
+    constructor(socket) {
+        super();
+        this.socket = socket;
+        this.buf    = Buffer.alloc(0);
+        socket.on('data', (chunk) => this.onChunk(chunk));
+        socket.on('error', (err) => this.emit('error', err));
+        socket.on('close', () => this.emit('close'));
+    }
+
+    onChunk(chunk) {
+        this.buf = this.buf.length ? Buffer.concat([this.buf, chunk]) : chunk;
+        for (;;) {
+            if (this.buf.length < 2) return;
+            const opcode = this.buf[0] & 0x0f;
+            const masked = this.buf[1] & 0x80;
+            let len = this.buf[1] & 0x7f;
+            let pos = 2;
+            if (len === 126) {
+                if (this.buf.length < 4) return;
+                len = this.buf.readUInt16BE(2);
+                pos = 4;
+            } else if (len === 127) {
+                if (this.buf.length < 10) return;
+                len = Number(this.buf.readBigUInt64BE(2));
+                pos = 10;
+            }
+            const mask = masked ? this.buf.subarray(pos, pos + 4) : null;
+            if (masked) pos += 4;
+            if (this.buf.length < pos + len) return;
+
+            const payload = Buffer.from(this.buf.subarray(pos, pos + len));
+            this.buf = this.buf.subarray(pos + len);
+            if (mask) for (let i = 0; i < payload.length; i++) payload[i] ^= mask[i & 3];
+
+            if (opcode === 0x8) this.socket.end();
+            else if (opcode === 0x9) this.socket.write(this.frame(0xa, payload));
+            else if (opcode <= 0x2) this.emit('data', payload);
+        }
+    }
+
+    frame(opcode, payload) {
+        let header;
+        if (payload.length < 126) {
+            header = Buffer.from([0x80 | opcode, payload.length]);
+        } else if (payload.length < 65536) {
+            header = Buffer.from([0x80 | opcode, 126, payload.length >> 8, payload.length & 0xff]);
+        } else {
+            header = Buffer.alloc(10);
+            header[0] = 0x80 | opcode;
+            header[1] = 127;
+            header.writeBigUInt64BE(BigInt(payload.length), 2);
+        }
+        return Buffer.concat([header, payload]);
+    }
+
+    write(data) {
+        return this.socket.write(this.frame(0x2, data));
+    }
+
+    end() {
+        this.socket.end();
+    }
+
+    destroy() {
+        this.socket.destroy();
+    }
+
+    setNoDelay(v) {
+        this.socket.setNoDelay(v);
+    }
+}
+
+const ERROR_TYPES = {
+    400: 'InvalidRequestException',
+    404: 'ResourceNotFoundException',
+    405: 'MethodNotAllowedException',
+    409: 'ConflictException',
+    413: 'RequestEntityTooLargeException'
+};
+
+// ================== CLI ==================
+
+function parseArgs(argv) {
+    const opts = { 'mqtt-port': 1883, 'http-port': 8080, 'stats-interval': 10 };
+    for (let i = 0; i < argv.length; i++) {
+        const arg = argv[i];
+        if (!arg.startsWith('--')) throw new Error(`unexpected argument ${arg}`);
+        const key = arg.slice(2);
+        if (key === 'verbose') opts.verbose = true;
+        else opts[key] = argv[++i];
+    }
+    return opts;
+}
+
+function main(argv) {
+    const opts = parseArgs(argv);
+    const emu  = new Emulator({ verbose: opts.verbose, httpDelayMs: Number(opts['http-delay-ms'] || 0) });
+
+    net.createServer((s) => emu.attach(s)).listen(Number(opts['mqtt-port']), () => {
+        console.log(`MQTT      on :${opts['mqtt-port']}`);
+    });
+
+    if (opts['tls-port']) {
+        const tlsOpts = {
+            cert: fs.readFileSync(opts['tls-cert']),
+            key:  fs.readFileSync(opts['tls-key'])
+        };
+        // Mutual TLS like AWS IoT when a CA for the device certificates is given
+        if (opts['tls-ca']) {
+            tlsOpts.ca                 = fs.readFileSync(opts['tls-ca']);
+            tlsOpts.requestCert        = true;
+            tlsOpts.rejectUnauthorized = true;
+        }
+        tls.createServer(tlsOpts, (s) => emu.attach(s)).listen(Number(opts['tls-port']), () => {
+            console.log(`MQTT+TLS  on :${opts['tls-port']}`);
+        });
+    }
+
+    const server = http.createServer((req, res) => emu.handleHttp(req, res));
+    server.on('upgrade', (req, socket, head) => emu.upgrade(req, socket, head));
+    server.listen(Number(opts['http-port']), () => {
+        console.log(`HTTP      on :${opts['http-port']} (IOT_ENDPOINT=http://localhost:${opts['http-port']})`);
+    });
+
+    const intervalS = Number(opts['stats-interval']);
+    let last = Date.now();
+    if (intervalS > 0) {
+        setInterval(() => {
+            emu.stats.print((Date.now() - last) / 1000);
+            last = Date.now();
+        }, intervalS * 1000);
+    }
+
+    process.on('SIGINT', () => {
+        emu.stats.print((Date.now() - last) / 1000);
+        process.exit(0);
+    });
+}
+
+if (require.main === module) {
+    try {
+        main(process.argv.slice(2));
+    } catch (err) {
+        console.error(err.message);
+        process.exitCode = 1;
+    }
+}
+
+module.exports = { Emulator, ShadowStore, ShadowError, ItemStore, Stats };
\ No newline at end of file
@@ -0,0 +1,108 @@
+#!/usr/bin/env node
+// Payload size / parse time per shadow operation, classic shadow vs one
+// named shadow per door, using the shadow logic of tools/shadow-emulator.js.
+//
+//   node tools/shadow-payload-bench.js [cycles=200] [parseIterations=2000]
+//
+// One cycle is what a home does for one command plus one door event:
+//   sensor.report     sensor publishes reported.exteriorDoor
+//   lambda.command    Lambda sets desired.interiorDoor (-> delta to actuator)
+//   actuator.report   actuator publishes reported.interiorDoor
+//   lambda.getInt     Lambda reads the interior door state
+//   lambda.getExt     Lambda reads the exterior door state
+//
+// For every operation: bytes of the request and of each message the shadow
+// service sends back (accepted, delta, documents, get), and the JSON parse
+// time of the message its receiver has to parse (delta: actuator,
+// get: Lambda). Parse times are host JSON.parse times; on the ESP32 the
+// ArduinoJson cost scales the same way with the payload size.
+
+const { ShadowStore } = require('./shadow-emulator');
+
+function parseTimeUs(text, iterations) {
+    let sink = 0;
+    const t0 = process.hrtime.bigint();
+    for (let i = 0; i < iterations; i++) sink += JSON.parse(text).version || 0;
+    const us = Number(process.hrtime.bigint() - t0) / 1000 / iterations;
+    return sink >= 0 ? us : 0;
+}
+
+function run(mode, cycles, iterations) {
+    const store = new ShadowStore();
+    const ops   = new Map();
+    const thing = 'iot_thing';
+    const shadowOf = (door) => (mode === 'named' ? door : '');
+
+    const record = (name, request, responses, parsed) => {
+        let s = ops.get(name);
+        if (!s) {
+            s = { n: 0, request: 0, bytes: {}, parseUs: 0, parsed: 0 };
+            ops.set(name, s);
+        }
+        s.n++;
+        s.request += request ? Buffer.byteLength(request) : 0;
+        for (const [suffix, doc] of responses) {
+            const text = JSON.stringify(doc);
+            const kind = suffix === 'get/accepted' ? 'get' : suffix.split('/').pop();
+            s.bytes[kind] = (s.bytes[kind] || 0) + Buffer.byteLength(text);
+            if (kind === parsed) {
+                s.parseUs += parseTimeUs(text, iterations);
+                s.parsed++;
+            }
+        }
+    };
+
+    const update = (name, door, state, parsed) => {
+        const request = JSON.stringify({ state });
+        record(name, request, store.update(thing, shadowOf(door), Buffer.from(request)), parsed);
+    };
+    const get = (name, door) => record(name, null, store.get(thing, shadowOf(door)), 'get');
+
+    for (let i = 0; i < cycles; i++) {
+        const ext = i % 2 ? 'CLOSE' : 'OPEN';
+        const int = i % 2 ? 'OPEN' : 'CLOSE';
+        update('sensor.report',   'exteriorDoor', { reported: { exteriorDoor: ext } });
+        update('lambda.command',  'interiorDoor', { desired:  { interiorDoor: int } }, 'delta');
+        update('actuator.report', 'interiorDoor', { reported: { interiorDoor: int } });
+        get('lambda.getInt', 'interiorDoor');
+        get('lambda.getExt', 'exteriorDoor');
+    }
+    return ops;
+}
+
+function main(argv) {
+    const cycles     = Number(argv[0] || 200);
+    const iterations = Number(argv[1] || 2000);
+
+    const results = { classic: run('classic', cycles, iterations), named: run('named', cycles, iterations) };
+    const avg = (s, v) => (s.n ? v / s.n : 0);
+
+    console.log(`${cycles} cycles, bytes are averages per operation\n`);
+    console.log('operation        layout    request  accepted    delta  documents     get   parse(us)');
+    for (const name of results.classic.keys()) {
+        for (const mode of ['classic', 'named']) {
+            const s = results[mode].get(name);
+            const b = (k) => String(Math.round(avg(s, s.bytes[k] || 0))).padStart(8);
+            console.log(`${(mode === 'classic' ? name : '').padEnd(16)} ${mode.padEnd(8)} ${String(Math.round(avg(s, s.request))).padStart(8)} ` +
+                        `${b('accepted')} ${b('delta')} ${b('documents').padStart(10)} ` +
+                        `${b('get').slice(1)} ` +
+                        `${(s.parsed ? s.parseUs / s.parsed : 0).toFixed(2).padStart(11)}`);
+        }
+    }
+
+    const total = (mode) => {
+        let bytes = 0;
+        for (const s of results[mode].values()) {
+            for (const v of Object.values(s.bytes)) bytes += v;
+        }
+        return bytes;
+    };
+    const c = total('classic');
+    const n = total('named');
+    console.log(`\nservice -> client bytes per cycle: classic ${(c / cycles).toFixed(0)}, named ${(n / cycles).toFixed(0)} ` +
+                `(${(100 * (c - n) / c).toFixed(1)}% less)`);
+}
+
+if (require.main === module) main(process.argv.slice(2));
+
+module.exports = { run };
\ No newline at end of file
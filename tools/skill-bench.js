@@ -0,0 +1,285 @@
+#!/usr/bin/env node
+// Init time and handler latency of the Alexa skill (index.js) against an
+// in-process tools/shadow-emulator.js (shadow REST API + DynamoDB stand-in),
+// with and without the warm-invocation caches, HTTP keep-alive and prewarm.
+//
+//   NODE_PATH=<dir with ask-sdk-core, @aws-sdk/client-iot-data-plane,
+//              @aws-sdk/client-dynamodb and @aws-sdk/lib-dynamodb> \
+//   node tools/skill-bench.js [--requests 2000] [--users 50] [--think-ms 20]
+//                             [--http-delay-ms 5] [--connect-delay-ms 20]
+//                             [--init-gap-ms 50] [--shadow-mode named|classic]
+//                             [--suite clients|logging]
+//
+// Every run forks one process per configuration — a single Lambda
+// container — that loads index.js (init), then calls exports.handler back to
+// back (think-ms apart, the first one init-gap-ms after init, the time the
+// Lambda service takes to hand over the first event) with this intent mix
+// from users picked at random:
+//   StateInteriorDoorIntent 40%, StateExteriorDoorIntent 30%,
+//   OpenInteriorDoorIntent 15%, CloseInteriorDoorIntent 15%
+// The first invocation (cold clients and caches) is reported on its own and
+// excluded from the percentiles.
+//
+// http-delay-ms is added to every emulator response, as a stand-in for the
+// Lambda -> DynamoDB / IoT round trip. connect-delay-ms holds back the first
+// request of every new connection, as a stand-in for the TCP + TLS handshake
+// that keep-alive and prewarm save.
+//
+// Suites (sets of configurations):
+//   clients  caches, HTTP keep-alive and prewarm on / off
+//   logging  LOG_LEVEL / LOG_SAMPLE_RATE of logger.js
+//
+// Reported per configuration: init (require) time, first invocation,
+// p50/p90/p99/max handler latency, per intent p50, bytes logged per request
+// and the cache hit rates from index.js's cacheStats().
+
+const http   = require('http');
+const net    = require('net');
+const path   = require('path');
+const util   = require('util');
+const { fork } = require('child_process');
+const { Emulator } = require('./shadow-emulator');
+
+const INTENTS = [
+    ['StateInteriorDoorIntent', 0.40],
+    ['StateExteriorDoorIntent', 0.30],
+    ['OpenInteriorDoorIntent',  0.15],
+    ['CloseInteriorDoorIntent', 0.15]
+];
+
+const SUITES = {
+    clients: [
+        ['no cache',             { THING_CACHE_TTL_MS: '0', SHADOW_CACHE_TTL_MS: '0' }],
+        ['cache, no keep-alive', { HTTP_KEEP_ALIVE: 'false' }],
+        ['cache',                {}],
+        ['cache + prewarm',      { PREWARM: 'true' }]
+    ],
+    // Caches off so every request reads (and at debug level dumps) its shadow
+    logging: [
+        ['debug',                { LOG_LEVEL: 'debug', THING_CACHE_TTL_MS: '0', SHADOW_CACHE_TTL_MS: '0' }],
+        ['info, 1% sampled',     { LOG_LEVEL: 'info', LOG_SAMPLE_RATE: '0.01', THING_CACHE_TTL_MS: '0', SHADOW_CACHE_TTL_MS: '0' }],
+        ['info, not sampled',    { LOG_LEVEL: 'info', LOG_SAMPLE_RATE: '0', THING_CACHE_TTL_MS: '0', SHADOW_CACHE_TTL_MS: '0' }],
+        ['warn',                 { LOG_LEVEL: 'warn', LOG_SAMPLE_RATE: '0', THING_CACHE_TTL_MS: '0', SHADOW_CACHE_TTL_MS: '0' }]
+    ]
+};
+
+const DEFAULTS = {
+    requests: 2000,
+    users: 50,
+    'think-ms': 20,
+    'http-delay-ms': 5,
+    'connect-delay-ms': 20,
+    'init-gap-ms': 50,
+    'shadow-mode': 'named',
+    suite: 'clients'
+};
+
+const sleep = (ms) => new Promise((resolve) => setTimeout(resolve, ms));
+
+function pickIntent() {
+    let r = Math.random();
+    for (const [name, p] of INTENTS) {
+        if ((r -= p) < 0) return name;
+    }
+    return INTENTS[0][0];
+}
+
+function requestEnvelope(userId, intentName) {
+    return {
+        version: '1.0',
+        session: { new: false, sessionId: 'bench', user: { userId } },
+        context: { System: { user: { userId } } },
+        request: {
+            type: 'IntentRequest',
+            requestId: `bench.${Date.now()}`,
+            timestamp: new Date().toISOString(),
+            locale: 'es-ES',
+            intent: { name: intentName, confirmationStatus: 'NONE' }
+        }
+    };
+}
+
+function summarize(values) {
+    if (values.length === 0) return null;
+    const v  = Float64Array.from(values).sort();
+    const at = (p) => v[Math.max(0, Math.ceil(p * v.length) - 1)];
+    return { n: v.length, p50: at(0.5), p90: at(0.9), p99: at(0.99), max: v[v.length - 1] };
+}
+
+// ================== CHILD (one warm container) ==================
+
+// ask-sdk's lambda() handler answers through the runtime's callback
+function invoke(handler, event) {
+    return new Promise((resolve, reject) => {
+        handler(event, { callbackWaitsForEmptyEventLoop: true }, (err, response) => (err ? reject(err) : resolve(response)));
+    });
+}
+
+async function child(opts) {
+    // Count what the handler logs (formatting included, like the Lambda
+    // runtime's console) but keep it out of the measurement pipe
+    let logBytes = 0;
+    const sink = (...args) => { logBytes += Buffer.byteLength(util.format(...args)) + 1; };
+    console.log = console.info = console.warn = console.error = console.debug = sink;
+
+    const since = (t0) => Number(process.hrtime.bigint() - t0) / 1e6;
+
+    const tInit   = process.hrtime.bigint();
+    const skill   = require(path.join(__dirname, '..', 'index.js'));
+    const initMs  = since(tInit);
+    const samples = [];
+    let firstMs   = 0;
+    await sleep(opts.initGapMs);
+    let firstLogBytes = 0;
+
+    for (let i = 0; i <= opts.requests; i++) {
+        const userId = `amzn1.ask.account.bench-${Math.floor(Math.random() * opts.users)}`;
+        const intent = pickIntent();
+        const t0 = process.hrtime.bigint();
+        await invoke(skill.handler, requestEnvelope(userId, intent));
+        if (i > 0) samples.push([intent, since(t0)]);
+        else [firstMs, firstLogBytes] = [since(t0), logBytes];
+        if (opts.thinkMs > 0) await sleep(opts.thinkMs);
+    }
+
+    process.send({
+        initMs,
+        firstMs,
+        samples,
+        logBytesPerRequest: (logBytes - firstLogBytes) / opts.requests,
+        cache: skill.cacheStats ? skill.cacheStats() : []
+    });
+}
+
+// ================== MAIN ==================
+
+function seed(emu, users, mode) {
+    for (let u = 0; u < users; u++) {
+        const thing = `home-${u}`;
+        emu.items.putItem({
+            TableName: 'user_thing',
+            Item: { user_id: { S: `amzn1.ask.account.bench-${u}` }, thing_name: { S: thing } }
+        });
+        const reported = { interiorDoor: 'CLOSE', exteriorDoor: 'CLOSE' };
+        if (mode === 'named') {
+            for (const door of Object.keys(reported)) {
+                emu.store.update(thing, door, Buffer.from(JSON.stringify({ state: { reported: { [door]: reported[door] } } })));
+            }
+        } else {
+            emu.store.update(thing, '', Buffer.from(JSON.stringify({ state: { reported } })));
+        }
+    }
+}
+
+function runConfig(name, env, opts) {
+    return new Promise((resolve, reject) => {
+        const proc = fork(__filename, ['--child', JSON.stringify(opts)], {
+            env: { ...process.env, ...env },
+            stdio: ['ignore', 'ignore', 'inherit', 'ipc']
+        });
+        let result = null;
+        proc.on('message', (m) => { result = m; });
+        proc.on('error', reject);
+        proc.on('exit', (code) => (result ? resolve(result) : reject(new Error(`${name}: child exited with ${code}`))));
+    });
+}
+
+/**
+ * TCP proxy in front of `port` that holds every new connection back for
+ * delayMs before forwarding anything (handshake stand-in).
+ */
+function connectDelayProxy(port, delayMs) {
+    return net.createServer((client) => {
+        client.pause();
+        setTimeout(() => {
+            const upstream = net.connect(port, '127.0.0.1', () => {
+                client.pipe(upstream);
+                upstream.pipe(client);
+                client.resume();
+            });
+            upstream.on('error', () => client.destroy());
+            client.on('error', () => upstream.destroy());
+        }, delayMs);
+    });
+}
+
+function printResult(name, { initMs, firstMs, samples, logBytesPerRequest, cache }) {
+    const fmt = (x) => x.toFixed(2).padStart(8);
+    const all = summarize(samples.map(([, ms]) => ms));
+    console.log(`\n${name}: init ${initMs.toFixed(1)} ms, first invocation ${firstMs.toFixed(1)} ms`);
+    console.log(`    n=${all.n}  p50 ${fmt(all.p50)}  p90 ${fmt(all.p90)}  p99 ${fmt(all.p99)}  max ${fmt(all.max)} ms, ` +
+                `${logBytesPerRequest.toFixed(0)} log bytes/request`);
+    for (const [intent] of INTENTS) {
+        const s = summarize(samples.filter(([i]) => i === intent).map(([, ms]) => ms));
+        if (s) console.log(`    ${intent.padEnd(26)} n=${String(s.n).padStart(5)}  p50 ${fmt(s.p50)}  p99 ${fmt(s.p99)} ms`);
+    }
+    for (const c of cache) {
+        if (c.hits + c.misses > 0) console.log(`    cache ${c.name.padEnd(8)} hit rate ${(100 * c.hitRate).toFixed(1)}% (${c.hits}/${c.hits + c.misses}), ${c.size} entries`);
+    }
+    return { ...all, initMs, firstMs, logBytesPerRequest };
+}
+
+async function main(argv) {
+    const opts = { ...DEFAULTS };
+    for (let i = 0; i < argv.length; i++) {
+        if (!argv[i].startsWith('--')) throw new Error(`unexpected argument ${argv[i]}`);
+        opts[argv[i].slice(2)] = argv[++i];
+    }
+
+    const emu    = new Emulator({ httpDelayMs: Number(opts['http-delay-ms']) });
+    const server = http.createServer((req, res) => emu.handleHttp(req, res));
+    await new Promise((resolve) => server.listen(0, '127.0.0.1', resolve));
+    const proxy = connectDelayProxy(server.address().port, Number(opts['connect-delay-ms']));
+    await new Promise((resolve) => proxy.listen(0, '127.0.0.1', resolve));
+    const endpoint = `http://127.0.0.1:${proxy.address().port}`;
+
+    const users = Number(opts.users);
+    seed(emu, users, opts['shadow-mode']);
+
+    console.log(`${opts.requests} requests per configuration, ${users} users, think ${opts['think-ms']} ms, ` +
+                `http delay ${opts['http-delay-ms']} ms, connect delay ${opts['connect-delay-ms']} ms, ` +
+                `${opts['shadow-mode']} shadows`);
+
+    const childOpts = {
+        requests:  Number(opts.requests),
+        users,
+        thinkMs:   Number(opts['think-ms']),
+        initGapMs: Number(opts['init-gap-ms'])
+    };
+    const baseEnv   = {
+        IOT_ENDPOINT:          endpoint,
+        DYNAMODB_ENDPOINT:     endpoint,
+        SHADOW_MODE:           opts['shadow-mode'],
+        PREWARM:               'false',
+        AWS_REGION:            process.env.AWS_REGION || 'us-east-1',
+        AWS_ACCESS_KEY_ID:     process.env.AWS_ACCESS_KEY_ID || 'bench',
+        AWS_SECRET_ACCESS_KEY: process.env.AWS_SECRET_ACCESS_KEY || 'bench'
+    };
+
+    const configs = SUITES[opts.suite];
+    if (!configs) throw new Error(`unknown suite ${opts.suite} (${Object.keys(SUITES).join(', ')})`);
+
+    const results = [];
+    for (const [name, env] of configs) {
+        results.push([name, printResult(name, await runConfig(name, { ...baseEnv, ...env }, childOpts))]);
+    }
+
+    console.log('\nconfiguration            init(ms)  first(ms)   p50(ms)   p99(ms)  log B/req');
+    for (const [name, r] of results) {
+        console.log(`${name.padEnd(24)} ${r.initMs.toFixed(1).padStart(8)} ${r.firstMs.toFixed(1).padStart(10)} ` +
+                    `${r.p50.toFixed(2).padStart(9)} ${r.p99.toFixed(2).padStart(9)} ${r.logBytesPerRequest.toFixed(0).padStart(10)}`);
+    }
+    proxy.close();
+    server.close();
+}
+
+if (require.main === module) {
+    const argv = process.argv.slice(2);
+    const run  = argv[0] === '--child' ? child(JSON.parse(argv[1])) : main(argv);
+    run.catch((err) => {
+        console.error(err.message);
+        process.exitCode = 1;
+    });
+}
+
+module.exports = { requestEnvelope, summarize, connectDelayProxy };
@@ -0,0 +1,115 @@
+// Host benchmark of the device health encoding (TelemetryPublisher from
+// espSensor/Telemetry.hpp, shared with the actuator), against the JSON
+// the same sample costs with ArduinoJson.
+//
+//   g++ -O2 -std=gnu++17 -I tools/replay/shim -I espSensor -I <ArduinoJson>/src
+//       -o /tmp/telemetry-bench tools/telemetry-bench.cpp
+//   /tmp/telemetry-bench [iterations=2000000]
+//
+// Reported, for a typical sample (values seen on a sensor after a day) and
+// the worst case (every value at its widest: 32-bit maximum, rssi at
+// INT32_MIN):
+//   bytes    CBOR encoding vs serializeJson() of the same keys and values
+//   encode   ns per encode() / serializeJson()
+// Checks that the worst case is exactly TelemetryPublisher::MAX_ENCODED_SIZE,
+// fits the publish buffer and that one byte less is reported as overflow.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include <ArduinoJson.h>
+#include "Telemetry.hpp"
+
+static double nowNs() {
+    return (double)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static void check(bool ok, const char* what) {
+    if (!ok) {
+        fprintf(stderr, "FAILED: %s\n", what);
+        exit(1);
+    }
+}
+
+// Same keys and order as TelemetryPublisher::encode()
+static size_t encodeJson(const DeviceHealth& h, char* out, size_t capacity) {
+    StaticJsonDocument<512> doc;
+    const char* const* k = TelemetryPublisher::KEYS;
+    doc[*k++] = h.uptimeS;
+    doc[*k++] = h.rssi;
+    doc[*k++] = h.freeHeap;
+    doc[*k++] = h.minFreeHeap;
+    doc[*k++] = h.largestBlock;
+    doc[*k++] = h.fragmentationPct;
+    doc[*k++] = h.reconnects;
+    doc[*k++] = h.oversized;
+    doc[*k++] = h.dropped;
+    doc[*k++] = h.suppressed;
+    doc[*k++] = h.coalesced;
+    doc[*k++] = h.loopAvgUs;
+    doc[*k++] = h.loopMaxUs;
+    doc[*k++] = h.cpuPct;
+    doc[*k++] = h.eventLatAvgUs;
+    doc[*k++] = h.eventLatMaxUs;
+    doc[*k++] = h.wakeups;
+    return serializeJson(doc, out, capacity);
+}
+
+static void run(const char* name, const DeviceHealth& h, uint32_t iterations) {
+    uint8_t cbor[256];
+    char    json[512];
+    size_t  cborLen = TelemetryPublisher::encode(h, cbor, sizeof(cbor));
+    size_t  jsonLen = encodeJson(h, json, sizeof(json));
+    check(cborLen > 0, "encode");
+
+    volatile size_t sink = 0;
+    double t = nowNs();
+    for (uint32_t i = 0; i < iterations; i++) sink += TelemetryPublisher::encode(h, cbor, sizeof(cbor));
+    double cborNs = (nowNs() - t) / iterations;
+
+    uint32_t jsonIterations = iterations / 10 ? iterations / 10 : 1;
+    t = nowNs();
+    for (uint32_t i = 0; i < jsonIterations; i++) sink += encodeJson(h, json, sizeof(json));
+    double jsonNs = (nowNs() - t) / jsonIterations;
+    (void)sink;
+
+    printf("%-8s bytes: cbor %3zu  json %3zu (%.0f%%)   encode: cbor %6.1f ns  json %7.1f ns\n",
+           name, cborLen, jsonLen, 100.0 * cborLen / jsonLen, cborNs, jsonNs);
+}
+
+int main(int argc, char** argv) {
+    uint32_t iterations = argc > 1 ? strtoul(argv[1], nullptr, 10) : 2000000;
+
+    DeviceHealth typical = {};
+    typical.uptimeS          = 86400;
+    typical.rssi             = -67;
+    typical.freeHeap         = 182340;
+    typical.minFreeHeap      = 151220;
+    typical.largestBlock     = 110580;
+    typical.fragmentationPct = 39;
+    typical.reconnects       = 2;
+    typical.loopAvgUs        = 85;
+    typical.loopMaxUs        = 4210;
+    typical.cpuPct           = 3;
+    typical.eventLatAvgUs    = 120;
+    typical.eventLatMaxUs    = 900;
+    typical.wakeups          = 6000;
+
+    DeviceHealth worst;
+    memset(&worst, 0xFF, sizeof(worst));
+    worst.rssi = INT32_MIN;
+
+    printf("telemetry: %zu keys, worst case %zu bytes\n",
+           TelemetryPublisher::FIELDS, TelemetryPublisher::MAX_ENCODED_SIZE);
+    run("typical", typical, iterations);
+    run("worst", worst, iterations);
+
+    uint8_t buf[TelemetryPublisher::MAX_ENCODED_SIZE];
+    check(TelemetryPublisher::encode(worst, buf, sizeof(buf)) == TelemetryPublisher::MAX_ENCODED_SIZE,
+          "worst case fills MAX_ENCODED_SIZE exactly");
+    check(TelemetryPublisher::encode(worst, buf, sizeof(buf) - 1) == 0,
+          "one byte short is an overflow");
+    check(TelemetryPublisher::encode(typical, buf, sizeof(buf)) > 0, "typical fits");
+    return 0;
+}
@@ -0,0 +1,240 @@
+#!/usr/bin/env node
+// End-to-end command traces: Alexa -> Lambda -> shadow -> actuator -> servo.
+//
+//   node tools/trace-collector.js record  [--host 127.0.0.1] [--port 1883] [--out traces.jsonl]
+//   node tools/trace-collector.js analyze [--json] <traces.jsonl | lambda.log>...   (stdin if none)
+//
+// Trace sources, one JSON object per line (other lines are ignored):
+//   lambda    "trace" log lines of index.js (CloudWatch export or a local
+//             run): token, alexa, start, sent, ack (epoch ms)
+//   actuator  records published on <thing>/trace/<clientId> by
+//             espActuator/Tracer.hpp: token, rx (epoch ms), actUs, pubUs, synced
+//   shadow    update/accepted messages carrying a clientToken, captured by
+//             `record`: shows the actuator's echo reached the shadow
+//
+// `record` subscribes to the trace and shadow topics of a broker (e.g.
+// tools/shadow-emulator.js) and appends what it sees to a file; `analyze`
+// joins all records by token and prints per-hop latency histograms.
+// Cross-host hops (Lambda -> device) assume SNTP/NTP-synced clocks and skip
+// device records with synced=0.
+
+const fs       = require('fs');
+const readline = require('readline');
+const { MqttClient } = require('./lib/mqtt');
+
+// ================== RECORD ==================
+
+async function record(opts) {
+    const out    = fs.createWriteStream(opts.out, { flags: 'a' });
+    const client = new MqttClient({ host: opts.host, port: opts.port, clientId: `trace-collector-${process.pid}` });
+    await client.connect();
+    await client.subscribe([
+        '+/trace/+',
+        '$aws/things/+/shadow/update/accepted',
+        '$aws/things/+/shadow/name/+/update/accepted'
+    ]);
+
+    let count = 0;
+    client.on('message', (topic, payload) => {
+        let doc;
+        try {
+            doc = JSON.parse(payload.toString());
+        } catch (err) {
+            return;
+        }
+
+        if (topic.startsWith('$aws/')) {
+            if (!doc.clientToken || !doc.state) return;
+            doc = {
+                hop:   'shadow',
+                token: doc.clientToken,
+                topic,
+                kind:  doc.state.reported ? 'reported' : 'desired',
+                ts:    doc.timestamp
+            };
+        }
+        doc.recv = Date.now();
+        out.write(JSON.stringify(doc) + '\n');
+        if (++count % 100 === 0) console.log(`${count} records`);
+    });
+
+    console.log(`recording to ${opts.out} (Ctrl+C to stop)`);
+    client.on('close', () => {
+        console.log('broker closed the connection');
+        out.end();
+    });
+}
+
+// ================== ANALYZE ==================
+
+function parseLine(line) {
+    const marker = line.indexOf('TRACE {');
+    const start  = marker >= 0 ? marker + 6 : line.indexOf('{');
+    if (start < 0) return null;
+    try {
+        const doc = JSON.parse(line.slice(start));
+        return doc && doc.hop && doc.token ? doc : null;
+    } catch (err) {
+        return null;
+    }
+}
+
+async function readRecords(files) {
+    const records = [];
+    const streams = files.length ? files.map((f) => fs.createReadStream(f)) : [process.stdin];
+    for (const stream of streams) {
+        const rl = readline.createInterface({ input: stream, crlfDelay: Infinity });
+        for await (const line of rl) {
+            const doc = parseLine(line);
+            if (doc) records.push(doc);
+        }
+    }
+    return records;
+}
+
+const HOPS = [
+    ['alexa->lambda',   'request issued by Alexa -> handler start'],
+    ['lambda',          'handler start -> shadow update sent (user lookup)'],
+    ['shadow.update',   'updateThingShadow round trip'],
+    ['lambda->device',  'update sent -> delta received on the actuator'],
+    ['device.servo',    'delta received -> servo commanded'],
+    ['device.report',   'servo commanded -> reported state published'],
+    ['voice->servo',    'request issued by Alexa -> servo commanded']
+];
+
+/**
+ * Joins records by token and returns { hops: {name: [ms]}, counts }.
+ */
+function analyze(records) {
+    const byToken = new Map();
+    for (const r of records) {
+        let t = byToken.get(r.token);
+        if (!t) {
+            t = {};
+            byToken.set(r.token, t);
+        }
+        // Keep the first record of each kind (QoS 1 may duplicate)
+        if (r.hop === 'shadow') t[`shadow.${r.kind}`] = t[`shadow.${r.kind}`] || r;
+        else t[r.hop] = t[r.hop] || r;
+    }
+
+    const hops   = Object.fromEntries(HOPS.map(([name]) => [name, []]));
+    const counts = { commands: 0, withDevice: 0, unsynced: 0, echoed: 0, failed: 0, deviceOnly: 0 };
+    const add    = (name, v) => {
+        if (Number.isFinite(v)) hops[name].push(v);
+    };
+
+    for (const t of byToken.values()) {
+        const l = t.lambda;
+        const a = t.actuator;
+        if (!l) {
+            if (a) counts.deviceOnly++;
+            continue;
+        }
+
+        counts.commands++;
+        if (!l.ok && l.ok !== undefined) counts.failed++;
+        if (l.alexa != null) add('alexa->lambda', l.start - l.alexa);
+        if (l.start != null) add('lambda', l.sent - l.start);
+        add('shadow.update', l.ack - l.sent);
+
+        if (t['shadow.reported']) counts.echoed++;
+        if (!a) continue;
+
+        counts.withDevice++;
+        add('device.servo', a.actUs / 1000);
+        add('device.report', (a.pubUs - a.actUs) / 1000);
+        if (!a.synced) {
+            counts.unsynced++;
+            continue;
+        }
+        add('lambda->device', a.rx - l.sent);
+        if (l.alexa != null) add('voice->servo', a.rx + a.actUs / 1000 - l.alexa);
+    }
+    return { hops, counts };
+}
+
+function summarize(values) {
+    if (values.length === 0) return null;
+    const v  = Float64Array.from(values).sort();
+    const at = (p) => v[Math.max(0, Math.ceil(p * v.length) - 1)];
+    return { n: v.length, min: v[0], p50: at(0.5), p90: at(0.9), p99: at(0.99), max: v[v.length - 1] };
+}
+
+// Log2 buckets in ms: <1, 1-2, 2-4, ...
+function histogram(values) {
+    const buckets = new Map();
+    for (const x of values) {
+        const b = x < 1 ? 0 : Math.floor(Math.log2(x)) + 1;
+        buckets.set(b, (buckets.get(b) || 0) + 1);
+    }
+    const keys = [...buckets.keys()].sort((a, b) => a - b);
+    const max  = Math.max(...buckets.values());
+    return keys.map((b) => {
+        const lo = b === 0 ? 0 : 2 ** (b - 1);
+        const hi = 2 ** b;
+        const n  = buckets.get(b);
+        return `    ${`${lo}-${hi} ms`.padStart(16)} ${String(n).padStart(6)} ${'#'.repeat(Math.max(1, Math.round(40 * n / max)))}`;
+    });
+}
+
+const fmt = (x) => (Math.abs(x) < 10 ? x.toFixed(2) : x.toFixed(0));
+
+function printReport({ hops, counts }) {
+    console.log(`commands ${counts.commands}, with device record ${counts.withDevice} ` +
+                `(clock not synced: ${counts.unsynced}), echo seen in shadow ${counts.echoed}, ` +
+                `update failed ${counts.failed}, device records without Lambda record ${counts.deviceOnly}`);
+
+    for (const [name, desc] of HOPS) {
+        const s = summarize(hops[name]);
+        if (!s) continue;
+        console.log(`\n${name} — ${desc}`);
+        console.log(`    n=${s.n} min=${fmt(s.min)} p50=${fmt(s.p50)} p90=${fmt(s.p90)} ` +
+                    `p99=${fmt(s.p99)} max=${fmt(s.max)} ms`);
+        if (s.min >= 0) histogram(hops[name]).forEach((line) => console.log(line));
+    }
+}
+
+// ================== CLI ==================
+
+async function main(argv) {
+    const [cmd, ...rest] = argv;
+    const opts  = { host: '127.0.0.1', port: 1883, out: 'traces.jsonl', json: false };
+    const files = [];
+    for (let i = 0; i < rest.length; i++) {
+        if (rest[i] === '--json') opts.json = true;
+        else if (rest[i].startsWith('--')) opts[rest[i].slice(2)] = rest[++i];
+        else files.push(rest[i]);
+    }
+
+    if (cmd === 'record') {
+        await record({ ...opts, port: Number(opts.port) });
+        return;
+    }
+
+    if (cmd === 'analyze') {
+        const result = analyze(await readRecords(files));
+        if (opts.json) {
+            const out = { counts: result.counts, hops: {} };
+            for (const [name] of HOPS) out.hops[name] = summarize(result.hops[name]);
+            console.log(JSON.stringify(out, null, 2));
+        } else {
+            printReport(result);
+        }
+        return;
+    }
+
+    console.log('usage:\n' +
+                '  trace-collector.js record  [--host h] [--port 1883] [--out traces.jsonl]\n' +
+                '  trace-collector.js analyze [--json] [files...]');
+    process.exitCode = 1;
+}
+
+if (require.main === module) {
+    main(process.argv.slice(2)).catch((err) => {
+        console.error(err.message);
+        process.exitCode = 1;
+    });
+}
+
+module.exports = { parseLine, analyze, summarize };
\ No newline at end of file